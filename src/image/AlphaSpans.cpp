@@ -0,0 +1,32 @@
+#include "AlphaSpans.h"
+#include "Image.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+void AlphaSpans::Reset(const int height) {
+	m_rows.assign(static_cast<size_t>(height), std::vector<Span>());
+	m_count = 0;
+}
+
+void AlphaSpans::SetRow(const Image& image, const int imageY, const int y) {
+	std::vector<Span>& spans = m_rows[static_cast<size_t>(y)];
+	spans.clear();
+
+	const int w = image.GetWidth();
+	const size_t channels = static_cast<size_t>(image.GetChannels());
+	const uint8_t* alpha = image.GetRow(imageY) + channels - 1;
+
+	int x = 0;
+	while (x < w) {
+		// Start of the next run
+		while (x < w && alpha[static_cast<size_t>(x) * channels] != 0) ++x;
+		if (x == w) break;
+
+		const int start = x;
+		while (x < w && alpha[static_cast<size_t>(x) * channels] == 0) ++x;
+
+		spans.push_back({ start, x });
+		m_count += static_cast<size_t>(x - start);
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Image.h"
+#include <cstddef>
+#include <vector>
+
+/// <summary>
+/// <para>Runs of fully transparent pixels in each row of an image - for the "skipTransparent" setting</para>
+/// <para>Dithering skips them instead of searching the palette and spreading error for every pixel</para>
+/// </summary>
+class AlphaSpans {
+public:
+	AlphaSpans() {};
+	~AlphaSpans() {};
+
+	struct Span {
+		// end is one past the last transparent pixel
+		int start = 0, end = 0;
+	};
+
+	/// <summary>
+	/// Walks the runs of one row from left to right
+	/// </summary>
+	class Cursor {
+	public:
+		/// <param name="spans">nullptr for a row without runs</param>
+		Cursor(const std::vector<Span>* spans) : m_spans(spans) {};
+
+		/// <summary>
+		/// x must not go backwards between calls
+		/// </summary>
+		/// <param name="x"></param>
+		/// <returns>End of the run x is in - x if it isn't transparent</returns>
+		inline int Skip(const int x) {
+			if (!m_spans) return x;
+
+			while (m_next < m_spans->size() && (*m_spans)[m_next].end <= x) ++m_next;
+			return m_next < m_spans->size() && (*m_spans)[m_next].start <= x ? (*m_spans)[m_next].end : x;
+		};
+
+	private:
+		const std::vector<Span>* m_spans;
+		size_t m_next = 0;
+	};
+
+	/// <summary>
+	/// Forgets every row
+	/// </summary>
+	/// <param name="height">Rows of the image</param>
+	void Reset(const int height);
+
+	/// <summary>
+	/// Finds the runs of a row - pixels with an alpha of 0
+	/// </summary>
+	/// <param name="image">Must have an alpha channel</param>
+	/// <param name="imageY">Row in image</param>
+	/// <param name="y">Row in the whole image</param>
+	void SetRow(const Image& image, const int imageY, const int y);
+
+	inline const std::vector<Span>& GetRow(const int y) const { return m_rows[static_cast<size_t>(y)]; };
+
+	/// <summary>
+	/// Transparent pixels in every row set since Reset()
+	/// </summary>
+	/// <returns></returns>
+	inline size_t GetCount() const { return m_count; };
+
+private:
+	std::vector<std::vector<Span>> m_rows;
+	size_t m_count = 0;
+};
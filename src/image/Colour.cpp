@@ -4,6 +4,7 @@
 #include "../wrapper/Maths.hpp"
 #include "Colour.h"
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
@@ -16,7 +17,7 @@
 
 constexpr double M_TAU = M_PI * 2;
 
-Colour::MathMode Colour::m_mathMode = Colour::MathMode::OkLab_Lightness;
+thread_local Colour::MathMode Colour::m_mathMode = Colour::MathMode::OkLab_Lightness;
 const Colour Colour::Black = Colour(0., 0., 0.);
 const Colour Colour::White = Colour(1., 0., 0.);
 
@@ -28,6 +29,8 @@ Colour::Colour() {
 	m_srgb = { 0, 0, 0 };
 	m_oklch = { 0., 0., 0. };
 	m_srgbUint = { 0, 0, 0 };
+	m_valid = Space_All;
+	m_source = Space_sRGB;
 }
 
 Colour::Colour(const Colour& other) {
@@ -38,6 +41,8 @@ Colour::Colour(const Colour& other) {
 	m_srgb = other.m_srgb;
 	m_oklch = other.m_oklch;
 	m_srgbUint = other.m_srgbUint;
+	m_valid = other.m_valid;
+	m_source = other.m_source;
 }
 
 Colour::Colour(const double l, const double a, const double b, const double alpha) {
@@ -64,35 +69,72 @@ Colour& Colour::operator=(const Colour& other) {
 	m_srgb = other.m_srgb;
 	m_oklch = other.m_oklch;
 	m_srgbUint = other.m_srgbUint;
+	m_valid = other.m_valid;
+	m_source = other.m_source;
 	return *this;
 }
 
 void Colour::Update() {
-	if (m_mathMode == MathMode::sRGB) {
-		sRGBtoLRGB();
-		LRGBtoOkLab();
-		OkLabToOkLCh();
-		sRGBToUint();
-	} else if (m_mathMode == MathMode::Linear_RGB) {
-		LRGBtosRGB();
-		LRGBtoOkLab();
-		OkLabToOkLCh();
-		sRGBToUint();
-	} else if (m_mathMode == MathMode::OkLCh) {
-		OkLChToOkLAB();
-		OkLabtoLRGB();
-		LRGBtosRGB();
-		sRGBToUint();
-	} else if (m_mathMode == MathMode::sRGB_Uint) {
-		UintTosRGB();
-		sRGBtoLRGB();
-		LRGBtoOkLab();
-		OkLabToOkLCh();
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	SetSource(space);
+}
+
+void Colour::ConvertAll() const {
+	Require(Space_sRGB_Uint);
+	Require(Space_sRGB);
+	Require(Space_LRGB);
+	Require(Space_OkLab);
+	Require(Space_OkLCh);
+}
+
+uint8_t Colour::SpaceOf(const MathMode mode) {
+	switch (mode) {
+	case MathMode::sRGB:
+		return Space_sRGB;
+	case MathMode::Linear_RGB:
+		return Space_LRGB;
+	case MathMode::OkLCh:
+		return Space_OkLCh;
+	case MathMode::sRGB_Uint:
+		return Space_sRGB_Uint;
+	default:
+		return Space_OkLab;
+	}
+}
+
+uint8_t Colour::OperandSpaceOf(const uint8_t space) {
+	return space == Space_OkLCh ? static_cast<uint8_t>(Space_OkLab) : space;
+}
+
+void Colour::Require(const uint8_t space) const {
+	if (m_valid & space) return;
+
+	// Walk one colour space at a time towards the source - the source is always up to date
+	if (space > m_source) {
+		Require(static_cast<uint8_t>(space >> 1));
+
+		if (space == Space_sRGB) {
+			UintTosRGB();
+		} else if (space == Space_LRGB) {
+			sRGBtoLRGB();
+		} else if (space == Space_OkLab) {
+			LRGBtoOkLab();
+		} else {
+			OkLabToOkLCh();
+		}
 	} else {
-		OkLabtoLRGB();
-		LRGBtosRGB();
-		OkLabToOkLCh();
-		sRGBToUint();
+		Require(static_cast<uint8_t>(space << 1));
+
+		if (space == Space_sRGB_Uint) {
+			sRGBToUint();
+		} else if (space == Space_sRGB) {
+			LRGBtosRGB();
+		} else if (space == Space_LRGB) {
+			OkLabtoLRGB();
+		} else {
+			OkLChToOkLAB();
+		}
 	}
 }
 
@@ -123,8 +165,11 @@ Colour Colour::FromLCH(const double l, const double c, const double h, const dou
 	return out;
 }
 
-void Colour::Clamp() {
-	switch (m_mathMode) {
+void Colour::Clamp(const MathMode mode) {
+	const uint8_t space = SpaceOf(mode);
+	Require(space);
+
+	switch (mode) {
 	case Colour::MathMode::sRGB:
 		m_srgb.r = m_srgb.r > 1. ? 1. : m_srgb.r;
 		m_srgb.r = m_srgb.r < 0. ? 0. : m_srgb.r;
@@ -134,16 +179,19 @@ void Colour::Clamp() {
 
 		m_srgb.b = m_srgb.b > 1. ? 1. : m_srgb.b;
 		m_srgb.b = m_srgb.b < 0. ? 0. : m_srgb.b;
+		SetSource(space);
 		break;
 	case Colour::MathMode::OkLab:
 		m_oklab.l = m_oklab.l > 1. ? 1. : m_oklab.l;
 		m_oklab.l = m_oklab.l < 0. ? 0. : m_oklab.l;
+		SetSource(space);
 
 		OkLabFallback();
 		break;
 	case Colour::MathMode::OkLab_Lightness:
 		m_oklab.l = m_oklab.l > 1. ? 1. : m_oklab.l;
 		m_oklab.l = m_oklab.l < 0. ? 0. : m_oklab.l;
+		SetSource(space);
 
 		OkLabFallback();
 		break;
@@ -156,6 +204,7 @@ void Colour::Clamp() {
 
 		m_lrgb.b = m_lrgb.b > 1. ? 1. : m_lrgb.b;
 		m_lrgb.b = m_lrgb.b < 0. ? 0. : m_lrgb.b;
+		SetSource(space);
 		break;
 	case Colour::MathMode::OkLCh:
 		m_oklch.l = m_oklch.l > 1. ? 1. : m_oklch.l;
@@ -163,6 +212,7 @@ void Colour::Clamp() {
 
 		m_oklch.h = m_oklch.h > M_PI * 2. ? M_PI * 2. : m_oklch.h;
 		m_oklch.h = m_oklch.h < 0. ? 0. : m_oklch.h;
+		SetSource(space);
 		OkLChFallback();
 		break;
 	case Colour::MathMode::sRGB_Uint:
@@ -174,6 +224,7 @@ void Colour::Clamp() {
 
 		m_srgbUint.b = m_srgbUint.b > 255 ? 255 : m_srgbUint.b;
 		m_srgbUint.b = m_srgbUint.b < 0 ? 0 : m_srgbUint.b;
+		SetSource(space);
 		break;
 	default:
 		break;
@@ -184,6 +235,10 @@ void Colour::Clamp() {
 }
 
 Colour& Colour::operator/=(const Colour& other) {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	other.Require(OperandSpaceOf(space));
+
 	double r = 0, g = 0, b = 0;
 	switch (m_mathMode) {
 	case MathMode::sRGB:
@@ -234,10 +289,18 @@ Colour& Colour::operator/=(const Colour& other) {
 	default:
 		break;
 	}
+
+	SetSource(space);
+	// OkLCh maths goes through OkLab so both are up to date
+	if (space == Space_OkLCh) m_valid |= Space_OkLab;
 	return *this;
 }
 
 Colour& Colour::operator*=(const Colour& other) {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	other.Require(OperandSpaceOf(space));
+
 	double r = 0, g = 0, b = 0;
 	switch (m_mathMode) {
 	case MathMode::sRGB:
@@ -288,10 +351,18 @@ Colour& Colour::operator*=(const Colour& other) {
 	default:
 		break;
 	}
+
+	SetSource(space);
+	// OkLCh maths goes through OkLab so both are up to date
+	if (space == Space_OkLCh) m_valid |= Space_OkLab;
 	return *this;
 }
 
 Colour& Colour::operator+=(const Colour& other) {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	other.Require(OperandSpaceOf(space));
+
 	double r = 0, g = 0, b = 0;
 	switch (m_mathMode) {
 	case MathMode::sRGB:
@@ -342,10 +413,18 @@ Colour& Colour::operator+=(const Colour& other) {
 	default:
 		break;
 	}
+
+	SetSource(space);
+	// OkLCh maths goes through OkLab so both are up to date
+	if (space == Space_OkLCh) m_valid |= Space_OkLab;
 	return *this;
 }
 
 Colour& Colour::operator-=(const Colour& other) {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	other.Require(OperandSpaceOf(space));
+
 	double r = 0, g = 0, b = 0;
 	switch (m_mathMode) {
 	case MathMode::sRGB:
@@ -396,10 +475,17 @@ Colour& Colour::operator-=(const Colour& other) {
 	default:
 		break;
 	}
+
+	SetSource(space);
+	// OkLCh maths goes through OkLab so both are up to date
+	if (space == Space_OkLCh) m_valid |= Space_OkLab;
 	return *this;
 }
 
 Colour& Colour::operator*=(const double scalar) {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+
 	double r = 0, g = 0, b = 0;
 	switch (m_mathMode) {
 	case MathMode::sRGB:
@@ -450,6 +536,10 @@ Colour& Colour::operator*=(const double scalar) {
 	default:
 		break;
 	}
+
+	SetSource(space);
+	// OkLCh maths goes through OkLab so both are up to date
+	if (space == Space_OkLCh) m_valid |= Space_OkLab;
 	return *this;
 }
 
@@ -484,6 +574,10 @@ Colour Colour::operator*(const double scalar) const {
 }
 
 bool Colour::operator==(const Colour& other) const {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	other.Require(space);
+
 	switch (m_mathMode) {
 	case Colour::MathMode::sRGB:
 		return std::tie(m_srgb.r, m_srgb.g, m_srgb.b, m_alpha) ==
@@ -509,6 +603,10 @@ bool Colour::operator==(const Colour& other) const {
 }
 
 bool Colour::operator<(const Colour& other) const {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	other.Require(space);
+
 	if (m_mathMode == Colour::MathMode::sRGB) {
 		return std::tie(m_srgb.r, m_srgb.g, m_srgb.b, m_alpha) <
 			std::tie(other.m_srgb.r, other.m_srgb.g, other.m_srgb.b, other.m_alpha);
@@ -525,27 +623,8 @@ bool Colour::operator<(const Colour& other) const {
 		return std::tie(m_srgbUint.r, m_srgbUint.g, m_srgbUint.b, m_alpha) <
 			std::tie(other.m_srgbUint.r, other.m_srgbUint.g, other.m_srgbUint.b, other.m_alpha);
 	} else {
-		const Colour red(static_cast<uint8_t>(255), 0, 0);
-		const double n = 12.;
-		const double offset = -red.m_oklch.h + (M_PI / n);
-
-		double currH = m_oklch.h + offset;
-		double otherH = other.m_oklch.h + offset;
-
-		// Wrapped clamp
-		currH = currH < 0. ? currH + M_TAU : currH;
-		otherH = otherH < 0. ? otherH + M_TAU : otherH;
-
-		currH = currH >= M_TAU ? currH - M_TAU : currH;
-		otherH = otherH >= M_TAU ? otherH - M_TAU : otherH;
-
-		// Rounding
-		currH = (std::floor((n * currH) / M_TAU) * M_TAU) / (n - 1.);
-		otherH = (std::floor((n * otherH) / M_TAU) * M_TAU) / (n - 1.);
-
-		// check grayscale
-		if (m_oklch.c <= 1. / 100.) currH = -1.;
-		if (other.m_oklch.c <= 1. / 100.) otherH = -1.;
+		const int currH = GetHueBucket();
+		const int otherH = other.GetHueBucket();
 
 		if (currH != otherH) return currH < otherH;
 
@@ -558,6 +637,7 @@ bool Colour::operator<(const Colour& other) const {
 }
 
 std::string Colour::LRGBDebug() const {
+	Require(Space_LRGB);
 	std::string rStr = Log::LeadingCharacter(Log::ToString(m_lrgb.r, 4), 7, ' ');
 	std::string gStr = Log::LeadingCharacter(Log::ToString(m_lrgb.g, 4), 7, ' ');
 	std::string bStr = Log::LeadingCharacter(Log::ToString(m_lrgb.b, 4), 7, ' ');
@@ -565,6 +645,7 @@ std::string Colour::LRGBDebug() const {
 }
 
 std::string Colour::OkLabDebug() const {
+	Require(Space_OkLab);
 	std::string lStr = Log::LeadingCharacter(Log::ToString(m_oklab.l, 4), 7, ' ');
 	std::string aStr = Log::LeadingCharacter(Log::ToString(m_oklab.a, 4), 7, ' ');
 	std::string bStr = Log::LeadingCharacter(Log::ToString(m_oklab.b, 4), 7, ' ');
@@ -572,12 +653,14 @@ std::string Colour::OkLabDebug() const {
 }
 
 std::string Colour::sRGBUintDebug() const {
+	Require(Space_sRGB_Uint);
 	return Log::ToString((unsigned int)m_srgbUint.r, 3, ' ') + ' ' +
 		Log::ToString((unsigned int)m_srgbUint.g, 3, ' ') + ' ' +
 		Log::ToString((unsigned int)m_srgbUint.b, 3, ' ');
 }
 
 std::string Colour::OkLChDebug() const {
+	Require(Space_OkLCh);
 	std::string lStr = Log::LeadingCharacter(Log::ToString(m_oklch.l, 4), 7, ' ');
 	std::string cStr = Log::LeadingCharacter(Log::ToString(m_oklch.c, 4), 7, ' ');
 	std::string hStr = Log::LeadingCharacter(Log::ToString(m_oklch.h * (180. / M_PI), 2), 7, ' ');
@@ -585,6 +668,7 @@ std::string Colour::OkLChDebug() const {
 }
 
 std::string Colour::GetHex() const {
+	Require(Space_sRGB_Uint);
 	const unsigned int r = static_cast<unsigned int>(m_srgbUint.r) << 16;
 	const unsigned int g = static_cast<unsigned int>(m_srgbUint.g) << 8;
 	const unsigned int b = static_cast<unsigned int>(m_srgbUint.b);
@@ -596,6 +680,10 @@ std::string Colour::GetHex() const {
 }
 
 double Colour::MagSq(const Colour& other) const {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	other.Require(space);
+
 	double r = 0., g = 0., b = 0.;
 	double otherR = 0., otherG = 0., otherB = 0.;
 
@@ -631,6 +719,8 @@ double Colour::MagSq(const Colour& other) const {
 }
 
 double Colour::LengthSq() const {
+	Require(SpaceOf(m_mathMode));
+
 	double r = 0., g = 0., b = 0.;
 
 	switch (m_mathMode) {
@@ -662,6 +752,10 @@ double Colour::LengthSq() const {
 }
 
 double Colour::Dot(const Colour& other) const {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+	other.Require(space);
+
 	double r = 0., g = 0., b = 0.;
 	double otherR = 0., otherG = 0., otherB = 0.;
 
@@ -702,7 +796,29 @@ double Colour::MonoDistance(const Colour& other, const double min, const double
 	return std::abs(MonoGetLightness() - otherL);
 }
 
+int Colour::GetHueBucket() const {
+	Require(Space_OkLCh);
+
+	// check grayscale
+	if (m_oklch.c <= 1. / 100.) return -1;
+
+	const double n = 12.;
+
+	// Red sits in the middle of the first group - worked out once instead of for every comparison
+	static const double offset = -Colour(static_cast<uint8_t>(255), 0, 0).GetOkLCh().h + (M_PI / n);
+
+	double h = m_oklch.h + offset;
+
+	// Wrapped clamp
+	h = h < 0. ? h + M_TAU : h;
+	h = h >= M_TAU ? h - M_TAU : h;
+
+	return static_cast<int>(std::floor((n * h) / M_TAU));
+}
+
 double Colour::MonoGetLightness() const {
+	Require(SpaceOf(m_mathMode));
+
 	if (m_mathMode == MathMode::sRGB) {
 		return 0.2126 * m_srgb.r + 0.7152 * m_srgb.g + 0.0722 * m_srgb.b;
 	} else if (m_mathMode == MathMode::Linear_RGB) {
@@ -742,6 +858,9 @@ void Colour::ToGrayscale() {
 }
 
 void Colour::Abs() {
+	const uint8_t space = SpaceOf(m_mathMode);
+	Require(space);
+
 	switch (m_mathMode) {
 	case Colour::MathMode::sRGB:
 		m_srgb.r = std::abs(m_srgb.r);
@@ -762,9 +881,11 @@ void Colour::Abs() {
 		m_lrgb.b = std::abs(m_lrgb.b);
 		break;
 	default:
-		break;
+		m_alpha = std::abs(m_alpha);
+		return;
 	}
 
+	SetSource(space);
 	m_alpha = std::abs(m_alpha);
 }
 
@@ -782,33 +903,38 @@ void Colour::PureBlack(const uint8_t alpha) {
 	m_oklch = { 0., 0., 0. };
 	m_srgbUint = { 0, 0, 0 };
 	m_isGrayscale = true;
+	m_valid = Space_All;
+	m_source = Space_sRGB;
 
 	m_alpha = static_cast<double>(alpha) / 255.;
 }
 
 void Colour::OkLabFallback() {
+	Require(Space_OkLab);
+
 	if (m_oklab.l >= 1. || m_oklab.l <= 0.) {
 		m_oklab.l = std::clamp(m_oklab.l, 0., 1.);
 		m_oklab.a = 0.;
 		m_oklab.b = 0.;
+		SetSource(Space_OkLab);
 		return;
 	}
 
 	Colour s0 = Colour::FromOkLab(m_oklab.l, m_oklab.a, m_oklab.b, m_alpha);
 	s0.OkLChFallback();
 
-	m_oklab = s0.m_oklab;
-	OkLabToOkLCh();
-	OkLabtoLRGB();
-	LRGBtosRGB();
-	sRGBToUint();
+	m_oklab = s0.GetOkLab();
+	SetSource(Space_OkLab);
 }
 
 void Colour::OkLChFallback() {
+	Require(Space_OkLCh);
+
 	if (m_oklch.l >= 1. || m_oklch.l <= 0.) {
 		m_oklch.l = std::clamp(m_oklch.l, 0., 1.);
 		m_oklch.c = 0.;
 		m_oklch.h = 0.;
+		SetSource(Space_OkLCh);
 		return;
 	}
 
@@ -817,9 +943,10 @@ void Colour::OkLChFallback() {
 	Colour s0 = Colour::FromLCH(m_oklch.l, m_oklch.c, m_oklch.h, m_alpha);
 
 	auto inGamut = [](const Colour& s) {
-		return s.m_srgb.r >= 0. && s.m_srgb.r <= 1. &&
-			s.m_srgb.g >= 0. && s.m_srgb.g <= 1. &&
-			s.m_srgb.b >= 0. && s.m_srgb.b <= 1.;
+		const sRGB srgb = s.GetsRGB();
+		return srgb.r >= 0. && srgb.r <= 1. &&
+			srgb.g >= 0. && srgb.g <= 1. &&
+			srgb.b >= 0. && srgb.b <= 1.;
 		};
 
 	if (inGamut(s0)) return;
@@ -837,56 +964,74 @@ void Colour::OkLChFallback() {
 	}
 
 	m_oklch = { s0.m_oklch.l, lo, s0.m_oklch.h };
-	OkLChToOkLAB();
-	OkLabtoLRGB();
-	LRGBtosRGB();
-	sRGBToUint();
+	SetSource(Space_OkLCh);
 }
 
-void Colour::sRGBtoLRGB() {
+double Colour::sRGBChannelToLRGB(const double v) {
 	constexpr double Y = 2.4125093745073549;
 	constexpr double C = 0.056317370387926696;
 	constexpr double A = 12.920750283132739;
 	constexpr double X = 0.039870440086508217;
+	return v <= X ? v / A : std::pow((v + C) / (C + 1.), Y);
+}
+
+double Colour::sRGBUintToLRGB(const uint8_t v) {
+	static const std::array<double, 256> table = []() {
+		std::array<double, 256> out{};
+		for (size_t i = 0; i < out.size(); ++i) out[i] = sRGBChannelToLRGB(static_cast<double>(i) / 255.);
+		return out;
+		}();
+
+	return table[v];
+}
+
+void Colour::sRGBtoLRGB() const {
+	m_valid |= Space_LRGB;
 	if (m_srgb.r == m_srgb.g && m_srgb.r == m_srgb.b) {
 		// grayscale - to avoid extra calculations
 		m_isGrayscale = true;
 
-		const double v = m_srgb.r <= X ? m_srgb.r / A : std::pow((m_srgb.r + C) / (C + 1.), Y);
+		const double v = sRGBChannelToLRGB(m_srgb.r);
 		m_lrgb = { v, v, v };
 	} else {
 		m_isGrayscale = false;
 		m_lrgb = {
-			m_srgb.r <= X ? m_srgb.r / A : std::pow((m_srgb.r + C) / (C + 1.), Y),
-			m_srgb.g <= X ? m_srgb.g / A : std::pow((m_srgb.g + C) / (C + 1.), Y),
-			m_srgb.b <= X ? m_srgb.b / A : std::pow((m_srgb.b + C) / (C + 1.), Y)
+			sRGBChannelToLRGB(m_srgb.r),
+			sRGBChannelToLRGB(m_srgb.g),
+			sRGBChannelToLRGB(m_srgb.b)
 		};
 	}
 }
 
-void Colour::LRGBtosRGB() {
+double Colour::LRGBChannelTosRGB(const double v) {
 	constexpr double Y = 2.4125093745073549;
 	constexpr double C = 0.056317370387926696;
 	constexpr double A = 12.920750283132739;
 	constexpr double X = 0.0030857681800844569;
+	return v <= X ? A * v : (Maths::NRoot(v, Y) * (C + 1.)) - C;
+}
+
+void Colour::LRGBtosRGB() const {
+	m_valid |= Space_sRGB;
 
 	if (m_lrgb.r == m_lrgb.g && m_lrgb.r == m_lrgb.b) {
 		// grayscale - to avoid extra calculations
 		m_isGrayscale = true;
 
-		const double v = m_lrgb.r <= X ? A * m_lrgb.r : (Maths::NRoot(m_lrgb.r, Y) * (C + 1.)) - C;
+		const double v = LRGBChannelTosRGB(m_lrgb.r);
 		m_srgb = { v, v, v };
 	} else {
 		m_isGrayscale = false;
 		m_srgb = {
-			m_lrgb.r <= X ? A * m_lrgb.r : (Maths::NRoot(m_lrgb.r, Y) * (C + 1.)) - C,
-			m_lrgb.g <= X ? A * m_lrgb.g : (Maths::NRoot(m_lrgb.g, Y) * (C + 1.)) - C,
-			m_lrgb.b <= X ? A * m_lrgb.b : (Maths::NRoot(m_lrgb.b, Y) * (C + 1.)) - C
+			LRGBChannelTosRGB(m_lrgb.r),
+			LRGBChannelTosRGB(m_lrgb.g),
+			LRGBChannelTosRGB(m_lrgb.b)
 		};
 	}
 }
 
-void Colour::LRGBtoOkLab() {
+void Colour::LRGBtoOkLab() const {
+	m_valid |= Space_OkLab;
 	if (m_lrgb.r == m_lrgb.g && m_lrgb.r == m_lrgb.b) {
 		// if graycale - can skip some conversions
 		m_isGrayscale = true;
@@ -924,7 +1069,8 @@ void Colour::LRGBtoOkLab() {
 	}
 }
 
-void Colour::OkLabtoLRGB() {
+void Colour::OkLabtoLRGB() const {
+	m_valid |= Space_LRGB;
 	if (m_oklab.a == 0. && m_oklab.b == 0) {
 		// if graycale - can skip some conversions
 		m_isGrayscale = true;
@@ -961,7 +1107,8 @@ void Colour::OkLabtoLRGB() {
 	}
 }
 
-void Colour::OkLabToOkLCh() {
+void Colour::OkLabToOkLCh() const {
+	m_valid |= Space_OkLCh;
 	m_oklch = {
 		m_oklab.l,
 		std::sqrt(m_oklab.a * m_oklab.a + m_oklab.b * m_oklab.b),
@@ -970,7 +1117,8 @@ void Colour::OkLabToOkLCh() {
 	if (m_oklch.h < 0.) m_oklch.h += M_TAU;
 }
 
-void Colour::OkLChToOkLAB() {
+void Colour::OkLChToOkLAB() const {
+	m_valid |= Space_OkLab;
 	m_oklab = {
 		m_oklch.l,
 		m_oklch.c * std::cos(m_oklch.h),
@@ -978,7 +1126,8 @@ void Colour::OkLChToOkLAB() {
 	};
 }
 
-void Colour::sRGBToUint() {
+void Colour::sRGBToUint() const {
+	m_valid |= Space_sRGB_Uint;
 	double r = m_srgb.r * 256.;
 	double g = m_srgb.g * 256.;
 	double b = m_srgb.b * 256.;
@@ -999,7 +1148,8 @@ void Colour::sRGBToUint() {
 	m_srgbUint = { static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b)};
 }
 
-void Colour::UintTosRGB() {
+void Colour::UintTosRGB() const {
+	m_valid |= Space_sRGB;
 	m_srgb = {
 		static_cast<double>(m_srgbUint.r) / 255.,
 		static_cast<double>(m_srgbUint.g) / 255.,
@@ -1011,18 +1161,20 @@ void Colour::SetsRGB(const uint8_t r, const uint8_t g, const uint8_t b, const ui
 	m_srgbUint = { r, g, b };
 	m_alpha = (double)a / 255.;
 
+	m_isGrayscale = false;
+	if (r == g && r == b) m_isGrayscale = true;
+
+	// Both sRGB values are set here - sRGB_Uint keeps the input when alpha is 0
+	m_source = Space_sRGB;
+
 	if (m_alpha <= 0.) {
 		m_srgb = { 0., 0., 0. };
+		m_valid = Space_sRGB | Space_sRGB_Uint;
 	} else {
 		m_srgb = { (double)r / 255., (double)g / 255., (double)b / 255. };
+		m_lrgb = { sRGBUintToLRGB(r), sRGBUintToLRGB(g), sRGBUintToLRGB(b) };
+		m_valid = Space_sRGB | Space_sRGB_Uint | Space_LRGB;
 	}
-
-	m_isGrayscale = false;
-	if (r == g && r == b) m_isGrayscale = true;
-
-	sRGBtoLRGB();
-	LRGBtoOkLab();
-	OkLabToOkLCh();
 }
 
 void Colour::SetsRGB_D(const double r, const double g, const double b, const double a) {
@@ -1037,10 +1189,7 @@ void Colour::SetsRGB_D(const double r, const double g, const double b, const dou
 	m_isGrayscale = false;
 	if (r == g && r == b) m_isGrayscale = true;
 
-	sRGBtoLRGB();
-	LRGBtoOkLab();
-	OkLabToOkLCh();
-	sRGBToUint();
+	SetSource(Space_sRGB);
 }
 
 void Colour::SetOkLCh(const double l, const double c, const double h, const double a) {
@@ -1054,10 +1203,7 @@ void Colour::SetOkLCh(const double l, const double c, const double h, const doub
 	m_isGrayscale = false;
 	if (c == 0.) m_isGrayscale = true;
 
-	OkLChToOkLAB();
-	OkLabtoLRGB();
-	LRGBtosRGB();
-	sRGBToUint();
+	SetSource(Space_OkLCh);
 }
 
 void Colour::SetOkLab(const double l, const double a, const double b, const double alpha) {
@@ -1072,10 +1218,7 @@ void Colour::SetOkLab(const double l, const double a, const double b, const doub
 	m_isGrayscale = false;
 	if (a == 0. && b == 0.) m_isGrayscale = true;
 
-	OkLabtoLRGB();
-	LRGBtosRGB();
-	OkLabToOkLCh();
-	sRGBToUint();
+	SetSource(Space_OkLab);
 }
 
 void Colour::SetHex(const char* hex) {
@@ -1091,6 +1234,20 @@ void Colour::SetHex(const char* hex) {
 	SetsRGB(r, g, b);
 }
 
+void Colour::SetConverted(const sRGB_UInt& srgb, const LRGB& lrgb, const OkLab& oklab, const OkLCh& oklch) {
+	m_srgbUint = srgb;
+	m_srgb = { (double)srgb.r / 255., (double)srgb.g / 255., (double)srgb.b / 255. };
+	m_lrgb = lrgb;
+	m_oklab = oklab;
+	m_oklch = oklch;
+	m_alpha = 1.;
+
+	m_isGrayscale = srgb.r == srgb.g && srgb.r == srgb.b;
+
+	m_source = Space_sRGB;
+	m_valid = Space_All;
+}
+
 void Colour::SetLRGB(const double r, const double g, const double b, const double a) {
 	m_alpha = a;
 
@@ -1103,8 +1260,5 @@ void Colour::SetLRGB(const double r, const double g, const double b, const doubl
 	m_isGrayscale = false;
 	if (r == g && r == b) m_isGrayscale = true;
 
-	LRGBtosRGB();
-	LRGBtoOkLab();
-	OkLabToOkLCh();
-	sRGBToUint();
+	SetSource(Space_LRGB);
 }
\ No newline at end of file
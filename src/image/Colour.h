@@ -14,11 +14,17 @@ public:
 	Colour& operator=(const Colour& other);
 
 	/// <summary>
-	/// Choose update function based on mathMode
+	/// <para>Marks the colour space of mathMode as the source of every other colour space</para>
+	/// <para>Other colour spaces are only converted when they are read</para>
 	/// </summary>
-	/// <param name="mathMode"></param>
 	void Update();
 
+	/// <summary>
+	/// <para>Converts every colour space now instead of when they are read</para>
+	/// <para>NOTE: Must be called before a Colour is read by more than one thread</para>
+	/// </summary>
+	void ConvertAll() const;
+
 	/// <summary>
 	/// Assign Colour based on sRGB values
 	/// </summary>
@@ -81,7 +87,13 @@ public:
 	/// <para>Clamp value based on m_mathMode</para>
 	/// <para>NOTE: Will not update other colour space - must call UPDATE functions</para>
 	/// </summary>
-	void Clamp();
+	void Clamp() { Clamp(m_mathMode); };
+
+	/// <summary>
+	/// Clamp value based on mode instead of m_mathMode
+	/// </summary>
+	/// <param name="mode"></param>
+	void Clamp(const MathMode mode);
 
 	Colour& operator/=(const Colour& other);
 	Colour& operator*=(const Colour& other);
@@ -164,6 +176,12 @@ public:
 
 	double MonoGetLightness() const;
 
+	/// <summary>
+	/// One of 12 hue groups starting just before red, or -1 for colours with almost no chroma - operator< sorts OkLCh colours by it first
+	/// </summary>
+	/// <returns></returns>
+	int GetHueBucket() const;
+
 	void ToGrayscale();
 
 	void Abs();
@@ -172,44 +190,114 @@ public:
 
 	static const Colour Black, White;
 
+	// ========== BULK CONVERSION ==========
+
+	/// <summary>
+	/// Lookup table version of the sRGB to Linear RGB transfer curve for 8 bit values
+	/// </summary>
+	/// <param name="v">0 to 255</param>
+	/// <returns>Same value as converting v / 255 with std::pow</returns>
+	static double sRGBUintToLRGB(const uint8_t v);
+
+	/// <summary>
+	/// sRGB to Linear RGB transfer curve for one channel
+	/// </summary>
+	/// <param name="v">0 to 1</param>
+	/// <returns></returns>
+	static double sRGBChannelToLRGB(const double v);
+
+	/// <summary>
+	/// Linear RGB to sRGB transfer curve for one channel
+	/// </summary>
+	/// <param name="v">0 to 1</param>
+	/// <returns></returns>
+	static double LRGBChannelTosRGB(const double v);
+
 private:
-	LRGB m_lrgb;
-	OkLab m_oklab;
-	sRGB m_srgb;
-	OkLCh m_oklch;
-	sRGB_UInt m_srgbUint;
+	/// <summary>
+	/// <para>Colour spaces as bit flags - in the order they are converted between</para>
+	/// <para>sRGB_Uint - sRGB - Linear RGB - OkLab - OkLCh</para>
+	/// </summary>
+	enum Space : uint8_t {
+		Space_sRGB_Uint = 1 << 0,
+		Space_sRGB = 1 << 1,
+		Space_LRGB = 1 << 2,
+		Space_OkLab = 1 << 3,
+		Space_OkLCh = 1 << 4,
+		Space_All = Space_sRGB_Uint | Space_sRGB | Space_LRGB | Space_OkLab | Space_OkLCh
+	};
+
+	mutable LRGB m_lrgb;
+	mutable OkLab m_oklab;
+	mutable sRGB m_srgb;
+	mutable OkLCh m_oklch;
+	mutable sRGB_UInt m_srgbUint;
 
 	double m_alpha;
 
-	bool m_isGrayscale;
+	mutable bool m_isGrayscale;
+
+	/// <summary>
+	/// Colour spaces that hold up to date values
+	/// </summary>
+	mutable uint8_t m_valid;
+
+	/// <summary>
+	/// Colour space every other colour space is converted from
+	/// </summary>
+	uint8_t m_source;
+
+	static uint8_t SpaceOf(const MathMode mode);
+
+	/// <summary>
+	/// Colour space the other colour of an operator is read in - OkLCh maths goes through OkLab
+	/// </summary>
+	/// <param name="space"></param>
+	/// <returns></returns>
+	static uint8_t OperandSpaceOf(const uint8_t space);
+
+	/// <summary>
+	/// Converts a colour space from the source if it is out of date
+	/// </summary>
+	/// <param name="space"></param>
+	void Require(const uint8_t space) const;
+
+	/// <summary>
+	/// Only the given colour space is up to date
+	/// </summary>
+	/// <param name="space"></param>
+	void SetSource(const uint8_t space) { m_source = space; m_valid = space; }
 
 	//static OkLab sRGBtoOkLab(const sRGB val);
 
-	static MathMode m_mathMode;
+	// One per thread so dither workers can switch between distance and maths modes - new threads must set it
+	static thread_local MathMode m_mathMode;
 
 	void OkLabFallback();
 	void OkLChFallback();
 
 	// Convert sRGB to Linear RGB
-	void sRGBtoLRGB();
+	void sRGBtoLRGB() const;
 	// Convert Linear RGB to sRGB
-	void LRGBtosRGB();
+	void LRGBtosRGB() const;
 
 	// Convert Linear RGB to OkLab
-	void LRGBtoOkLab();
+	void LRGBtoOkLab() const;
 	// Convert OkLab to Linear RGB
-	void OkLabtoLRGB();
+	void OkLabtoLRGB() const;
 
-	void OkLabToOkLCh();
-	void OkLChToOkLAB();
+	void OkLabToOkLCh() const;
+	void OkLChToOkLAB() const;
 
-	void sRGBToUint();
-	void UintTosRGB();
+	void sRGBToUint() const;
+	void UintTosRGB() const;
 
 public:
-	sRGB GetsRGB() const { return m_srgb; }
-	OkLab GetOkLab() const { return m_oklab; }
-	sRGB_UInt GetsRGB_UInt() const { return m_srgbUint; }
+	sRGB GetsRGB() const { Require(Space_sRGB); return m_srgb; }
+	OkLab GetOkLab() const { Require(Space_OkLab); return m_oklab; }
+	LRGB GetLRGB() const { Require(Space_LRGB); return m_lrgb; }
+	OkLCh GetOkLCh() const { Require(Space_OkLCh); return m_oklch; }
+	sRGB_UInt GetsRGB_UInt() const { Require(Space_sRGB_Uint); return m_srgbUint; }
 
 	double GetAlpha() const { return m_alpha; }
 	void SetAlpha(const double alpha) { m_alpha = alpha; }
@@ -222,4 +310,9 @@ public:
 	void SetsRGB(const uint8_t r, const uint8_t g, const uint8_t b, const uint8_t a = 255);
 	void SetsRGB_D(const double r, const double g, const double b, const double a = 1.);
 	void SetOkLCh(const double l, const double c, const double h, const double a = 1.);
+
+	/// <summary>
+	/// Opaque 8 bit sRGB colour with every other colour space already converted - the same as SetsRGB() then ConvertAll()
+	/// </summary>
+	void SetConverted(const sRGB_UInt& srgb, const LRGB& lrgb, const OkLab& oklab, const OkLCh& oklch);
 };
@@ -0,0 +1,708 @@
+#include "Colour.h"
+#include "ColourBatch.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+#include <intrin.h>
+#include <string>
+
+ColourBatch::Instructions ColourBatch::m_instructions = ColourBatch::GetSupported();
+
+// ========== CUBE ROOT ==========
+
+// cbrt(m) for m in [0.5, 1) - least squares fit, relative error < 1.7e-4
+constexpr double CBRT_C0 = 0.4414043786785203;
+constexpr double CBRT_C1 = 0.9217988114911607;
+constexpr double CBRT_C2 = -0.5046530327524211;
+constexpr double CBRT_C3 = 0.14155092292463126;
+
+constexpr double CBRT_2 = 1.2599210498948732;
+constexpr double CBRT_4 = 1.5874010519681994;
+
+/// <summary>
+/// <para>Cube root of 2 doubles - polynomial guess then two Halley iterations</para>
+/// <para>Zero, subnormal, infinite and NaN lanes use std::cbrt</para>
+/// </summary>
+static inline __m128d Cbrt_SSE41(const __m128d x) {
+	const __m128d signMask = _mm_set1_pd(-0.);
+	const __m128d ax = _mm_andnot_pd(signMask, x);
+	const __m128i bits = _mm_castpd_si128(ax);
+
+	const __m128i exponent = _mm_srli_epi64(bits, 52);
+	const __m128i isSpecial = _mm_or_si128(_mm_cmpeq_epi64(exponent, _mm_setzero_si128()),
+		_mm_cmpeq_epi64(exponent, _mm_set1_epi64x(0x7FF)));
+	const int special = _mm_movemask_pd(_mm_castsi128_pd(isSpecial));
+
+	// ax = m * 2^e with m in [0.5, 1)
+	const __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFF)),
+		_mm_set1_epi64x(0x3FE0000000000000)));
+	const __m128d e = _mm_sub_pd(_mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(exponent, _mm_set1_epi64x(0x4330000000000000))),
+		_mm_set1_pd(4503599627370496.)), _mm_set1_pd(1022.));
+
+	// e = 3q + rem
+	const __m128d q = _mm_floor_pd(_mm_div_pd(_mm_add_pd(e, _mm_set1_pd(0.5)), _mm_set1_pd(3.)));
+	const __m128d rem = _mm_sub_pd(e, _mm_mul_pd(q, _mm_set1_pd(3.)));
+
+	__m128d factor = _mm_set1_pd(1.);
+	factor = _mm_blendv_pd(factor, _mm_set1_pd(CBRT_2), _mm_cmpeq_pd(rem, _mm_set1_pd(1.)));
+	factor = _mm_blendv_pd(factor, _mm_set1_pd(CBRT_4), _mm_cmpeq_pd(rem, _mm_set1_pd(2.)));
+
+	// 2^q
+	const __m128i qBits = _mm_castpd_si128(_mm_add_pd(q, _mm_set1_pd(4503599627370496. + 1023.)));
+	const __m128d scale = _mm_castsi128_pd(_mm_slli_epi64(qBits, 52));
+
+	__m128d y = _mm_add_pd(_mm_mul_pd(m, _mm_set1_pd(CBRT_C3)), _mm_set1_pd(CBRT_C2));
+	y = _mm_add_pd(_mm_mul_pd(m, y), _mm_set1_pd(CBRT_C1));
+	y = _mm_add_pd(_mm_mul_pd(m, y), _mm_set1_pd(CBRT_C0));
+	y = _mm_mul_pd(_mm_mul_pd(y, factor), scale);
+
+	// Halley - written as a correction to y so the last iteration only rounds once
+	for (int i = 0; i < 2; ++i) {
+		const __m128d y3 = _mm_mul_pd(_mm_mul_pd(y, y), y);
+		y = _mm_sub_pd(y, _mm_div_pd(_mm_mul_pd(y, _mm_sub_pd(y3, ax)), _mm_add_pd(_mm_add_pd(y3, y3), ax)));
+	}
+
+	y = _mm_or_pd(y, _mm_and_pd(x, signMask));
+
+	if (special != 0) {
+		alignas(16) double xs[2], ys[2];
+		_mm_store_pd(xs, x);
+		_mm_store_pd(ys, y);
+		for (int i = 0; i < 2; ++i) {
+			if (special & (1 << i)) ys[i] = std::cbrt(xs[i]);
+		}
+		y = _mm_load_pd(ys);
+	}
+
+	return y;
+}
+
+/// <summary>
+/// Same as Cbrt_SSE41 for 4 doubles
+/// </summary>
+static inline __m256d Cbrt_AVX2(const __m256d x) {
+	const __m256d signMask = _mm256_set1_pd(-0.);
+	const __m256d ax = _mm256_andnot_pd(signMask, x);
+	const __m256i bits = _mm256_castpd_si256(ax);
+
+	const __m256i exponent = _mm256_srli_epi64(bits, 52);
+	const __m256i isSpecial = _mm256_or_si256(_mm256_cmpeq_epi64(exponent, _mm256_setzero_si256()),
+		_mm256_cmpeq_epi64(exponent, _mm256_set1_epi64x(0x7FF)));
+	const int special = _mm256_movemask_pd(_mm256_castsi256_pd(isSpecial));
+
+	const __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFF)),
+		_mm256_set1_epi64x(0x3FE0000000000000)));
+	const __m256d e = _mm256_sub_pd(_mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(exponent, _mm256_set1_epi64x(0x4330000000000000))),
+		_mm256_set1_pd(4503599627370496.)), _mm256_set1_pd(1022.));
+
+	const __m256d q = _mm256_floor_pd(_mm256_div_pd(_mm256_add_pd(e, _mm256_set1_pd(0.5)), _mm256_set1_pd(3.)));
+	const __m256d rem = _mm256_sub_pd(e, _mm256_mul_pd(q, _mm256_set1_pd(3.)));
+
+	__m256d factor = _mm256_set1_pd(1.);
+	factor = _mm256_blendv_pd(factor, _mm256_set1_pd(CBRT_2), _mm256_cmp_pd(rem, _mm256_set1_pd(1.), _CMP_EQ_OQ));
+	factor = _mm256_blendv_pd(factor, _mm256_set1_pd(CBRT_4), _mm256_cmp_pd(rem, _mm256_set1_pd(2.), _CMP_EQ_OQ));
+
+	const __m256i qBits = _mm256_castpd_si256(_mm256_add_pd(q, _mm256_set1_pd(4503599627370496. + 1023.)));
+	const __m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(qBits, 52));
+
+	__m256d y = _mm256_add_pd(_mm256_mul_pd(m, _mm256_set1_pd(CBRT_C3)), _mm256_set1_pd(CBRT_C2));
+	y = _mm256_add_pd(_mm256_mul_pd(m, y), _mm256_set1_pd(CBRT_C1));
+	y = _mm256_add_pd(_mm256_mul_pd(m, y), _mm256_set1_pd(CBRT_C0));
+	y = _mm256_mul_pd(_mm256_mul_pd(y, factor), scale);
+
+	for (int i = 0; i < 2; ++i) {
+		const __m256d y3 = _mm256_mul_pd(_mm256_mul_pd(y, y), y);
+		y = _mm256_sub_pd(y, _mm256_div_pd(_mm256_mul_pd(y, _mm256_sub_pd(y3, ax)), _mm256_add_pd(_mm256_add_pd(y3, y3), ax)));
+	}
+
+	y = _mm256_or_pd(y, _mm256_and_pd(x, signMask));
+
+	if (special != 0) {
+		alignas(32) double xs[4], ys[4];
+		_mm256_store_pd(xs, x);
+		_mm256_store_pd(ys, y);
+		for (int i = 0; i < 4; ++i) {
+			if (special & (1 << i)) ys[i] = std::cbrt(xs[i]);
+		}
+		y = _mm256_load_pd(ys);
+	}
+
+	return y;
+}
+
+/// <summary>
+/// <para>Cube root of 4 floats - same polynomial guess as Cbrt_SSE41 then one Halley iteration</para>
+/// <para>Zero, subnormal, infinite and NaN lanes use std::cbrt</para>
+/// </summary>
+static inline __m128 Cbrt_SSE41(const __m128 x) {
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	const __m128 ax = _mm_andnot_ps(signMask, x);
+	const __m128i bits = _mm_castps_si128(ax);
+
+	const __m128i exponent = _mm_srli_epi32(bits, 23);
+	const __m128i isSpecial = _mm_or_si128(_mm_cmpeq_epi32(exponent, _mm_setzero_si128()),
+		_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0xFF)));
+	const int special = _mm_movemask_ps(_mm_castsi128_ps(isSpecial));
+
+	// ax = m * 2^e with m in [0.5, 1)
+	const __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F000000)));
+	const __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(exponent, _mm_set1_epi32(126)));
+
+	// e = 3q + rem
+	const __m128 q = _mm_floor_ps(_mm_div_ps(_mm_add_ps(e, _mm_set1_ps(0.5f)), _mm_set1_ps(3.f)));
+	const __m128 rem = _mm_sub_ps(e, _mm_mul_ps(q, _mm_set1_ps(3.f)));
+
+	__m128 factor = _mm_set1_ps(1.f);
+	factor = _mm_blendv_ps(factor, _mm_set1_ps(static_cast<float>(CBRT_2)), _mm_cmpeq_ps(rem, _mm_set1_ps(1.f)));
+	factor = _mm_blendv_ps(factor, _mm_set1_ps(static_cast<float>(CBRT_4)), _mm_cmpeq_ps(rem, _mm_set1_ps(2.f)));
+
+	// 2^q
+	const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(q), _mm_set1_epi32(127)), 23));
+
+	__m128 y = _mm_add_ps(_mm_mul_ps(m, _mm_set1_ps(static_cast<float>(CBRT_C3))), _mm_set1_ps(static_cast<float>(CBRT_C2)));
+	y = _mm_add_ps(_mm_mul_ps(m, y), _mm_set1_ps(static_cast<float>(CBRT_C1)));
+	y = _mm_add_ps(_mm_mul_ps(m, y), _mm_set1_ps(static_cast<float>(CBRT_C0)));
+	y = _mm_mul_ps(_mm_mul_ps(y, factor), scale);
+
+	// One iteration is past float precision
+	const __m128 y3 = _mm_mul_ps(_mm_mul_ps(y, y), y);
+	y = _mm_sub_ps(y, _mm_div_ps(_mm_mul_ps(y, _mm_sub_ps(y3, ax)), _mm_add_ps(_mm_add_ps(y3, y3), ax)));
+
+	y = _mm_or_ps(y, _mm_and_ps(x, signMask));
+
+	if (special != 0) {
+		alignas(16) float xs[4], ys[4];
+		_mm_store_ps(xs, x);
+		_mm_store_ps(ys, y);
+		for (int i = 0; i < 4; ++i) {
+			if (special & (1 << i)) ys[i] = std::cbrt(xs[i]);
+		}
+		y = _mm_load_ps(ys);
+	}
+
+	return y;
+}
+
+/// <summary>
+/// Same as Cbrt_SSE41 for 8 floats
+/// </summary>
+static inline __m256 Cbrt_AVX2(const __m256 x) {
+	const __m256 signMask = _mm256_set1_ps(-0.f);
+	const __m256 ax = _mm256_andnot_ps(signMask, x);
+	const __m256i bits = _mm256_castps_si256(ax);
+
+	const __m256i exponent = _mm256_srli_epi32(bits, 23);
+	const __m256i isSpecial = _mm256_or_si256(_mm256_cmpeq_epi32(exponent, _mm256_setzero_si256()),
+		_mm256_cmpeq_epi32(exponent, _mm256_set1_epi32(0xFF)));
+	const int special = _mm256_movemask_ps(_mm256_castsi256_ps(isSpecial));
+
+	const __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F000000)));
+	const __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(exponent, _mm256_set1_epi32(126)));
+
+	const __m256 q = _mm256_floor_ps(_mm256_div_ps(_mm256_add_ps(e, _mm256_set1_ps(0.5f)), _mm256_set1_ps(3.f)));
+	const __m256 rem = _mm256_sub_ps(e, _mm256_mul_ps(q, _mm256_set1_ps(3.f)));
+
+	__m256 factor = _mm256_set1_ps(1.f);
+	factor = _mm256_blendv_ps(factor, _mm256_set1_ps(static_cast<float>(CBRT_2)), _mm256_cmp_ps(rem, _mm256_set1_ps(1.f), _CMP_EQ_OQ));
+	factor = _mm256_blendv_ps(factor, _mm256_set1_ps(static_cast<float>(CBRT_4)), _mm256_cmp_ps(rem, _mm256_set1_ps(2.f), _CMP_EQ_OQ));
+
+	const __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(q), _mm256_set1_epi32(127)), 23));
+
+	__m256 y = _mm256_add_ps(_mm256_mul_ps(m, _mm256_set1_ps(static_cast<float>(CBRT_C3))), _mm256_set1_ps(static_cast<float>(CBRT_C2)));
+	y = _mm256_add_ps(_mm256_mul_ps(m, y), _mm256_set1_ps(static_cast<float>(CBRT_C1)));
+	y = _mm256_add_ps(_mm256_mul_ps(m, y), _mm256_set1_ps(static_cast<float>(CBRT_C0)));
+	y = _mm256_mul_ps(_mm256_mul_ps(y, factor), scale);
+
+	const __m256 y3 = _mm256_mul_ps(_mm256_mul_ps(y, y), y);
+	y = _mm256_sub_ps(y, _mm256_div_ps(_mm256_mul_ps(y, _mm256_sub_ps(y3, ax)), _mm256_add_ps(_mm256_add_ps(y3, y3), ax)));
+
+	y = _mm256_or_ps(y, _mm256_and_ps(x, signMask));
+
+	if (special != 0) {
+		alignas(32) float xs[8], ys[8];
+		_mm256_store_ps(xs, x);
+		_mm256_store_ps(ys, y);
+		for (int i = 0; i < 8; ++i) {
+			if (special & (1 << i)) ys[i] = std::cbrt(xs[i]);
+		}
+		y = _mm256_load_ps(ys);
+	}
+
+	return y;
+}
+
+// ========== DISPATCH ==========
+
+ColourBatch::Instructions ColourBatch::GetSupported() {
+	int info[4] = { 0, 0, 0, 0 };
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx) {
+		// OS must save the YMM registers
+		const bool ymmEnabled = (_xgetbv(0) & 0x6) == 0x6;
+
+		__cpuidex(info, 7, 0);
+		avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+	}
+
+	if (avx2) return Instructions::AVX2;
+	if (sse41) return Instructions::SSE41;
+	return Instructions::Scalar;
+}
+
+ColourBatch::Instructions ColourBatch::GetInstructions() {
+	return m_instructions;
+}
+
+void ColourBatch::SetInstructions(const Instructions instructions) {
+	const Instructions supported = GetSupported();
+	m_instructions = static_cast<int>(instructions) <= static_cast<int>(supported) ? instructions : supported;
+}
+
+std::string ColourBatch::ToString(const Instructions instructions) {
+	switch (instructions) {
+	case Instructions::AVX2:
+		return "AVX2";
+	case Instructions::SSE41:
+		return "SSE4.1";
+	default:
+		return "Scalar";
+	}
+}
+
+void ColourBatch::LRGBtoOkLab(const double* r, const double* g, const double* b, double* outL, double* outA, double* outB, const size_t count) {
+	switch (m_instructions) {
+	case Instructions::AVX2:
+		LRGBtoOkLab_AVX2(r, g, b, outL, outA, outB, count);
+		break;
+	case Instructions::SSE41:
+		LRGBtoOkLab_SSE41(r, g, b, outL, outA, outB, count);
+		break;
+	default:
+		LRGBtoOkLab_Scalar(r, g, b, outL, outA, outB, count);
+		break;
+	}
+}
+
+void ColourBatch::LRGBtoOkLab(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, const size_t count) {
+	switch (m_instructions) {
+	case Instructions::AVX2:
+		LRGBtoOkLab_AVX2(r, g, b, outL, outA, outB, count);
+		break;
+	case Instructions::SSE41:
+		LRGBtoOkLab_SSE41(r, g, b, outL, outA, outB, count);
+		break;
+	default:
+		LRGBtoOkLab_Scalar(r, g, b, outL, outA, outB, count);
+		break;
+	}
+}
+
+void ColourBatch::OkLabtoLRGB(const double* l, const double* a, const double* b, double* outR, double* outG, double* outB, const size_t count) {
+	switch (m_instructions) {
+	case Instructions::AVX2:
+		OkLabtoLRGB_AVX2(l, a, b, outR, outG, outB, count);
+		break;
+	case Instructions::SSE41:
+		OkLabtoLRGB_SSE41(l, a, b, outR, outG, outB, count);
+		break;
+	default:
+		OkLabtoLRGB_Scalar(l, a, b, outR, outG, outB, count);
+		break;
+	}
+}
+
+void ColourBatch::sRGBtoLRGB(const uint8_t* in, double* out, const size_t count) {
+	for (size_t i = 0; i < count; ++i) out[i] = Colour::sRGBUintToLRGB(in[i]);
+}
+
+void ColourBatch::LRGBtosRGB(const double* in, double* out, const size_t count) {
+	for (size_t i = 0; i < count; ++i) out[i] = Colour::LRGBChannelTosRGB(in[i]);
+}
+
+void ColourBatch::sRGBToUint(const double* in, uint8_t* out, const size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		double v = std::floor(in[i] * 256.);
+		v = v > 255. ? 255. : v;
+		v = v < 0. ? 0. : v;
+		out[i] = static_cast<uint8_t>(v);
+	}
+}
+
+// ========== LINEAR RGB TO OKLAB ==========
+
+void ColourBatch::LRGBtoOkLab_Scalar(const double* r, const double* g, const double* b, double* outL, double* outA, double* outB, const size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		if (r[i] == g[i] && r[i] == b[i]) {
+			// grayscale - same shortcut as Colour
+			outL[i] = std::cbrt(r[i]);
+			outA[i] = 0.;
+			outB[i] = 0.;
+			continue;
+		}
+
+		// to Linear LMS
+		const double l2 = 0.4122214708 * r[i] + 0.5363325363 * g[i] + 0.0514459929 * b[i];
+		const double a2 = 0.2119034982 * r[i] + 0.6806995451 * g[i] + 0.1073969566 * b[i];
+		const double b2 = 0.0883024619 * r[i] + 0.2817188376 * g[i] + 0.6299787005 * b[i];
+
+		// to LMS
+		const double l1 = std::cbrt(l2);
+		const double a1 = std::cbrt(a2);
+		const double b1 = std::cbrt(b2);
+
+		// to OkLab
+		outL[i] = 0.2104542553 * l1 + 0.7936177850 * a1 - 0.0040720468 * b1;
+		outA[i] = 1.9779984951 * l1 - 2.4285922050 * a1 + 0.4505937099 * b1;
+		outB[i] = 0.0259040371 * l1 + 0.7827717662 * a1 - 0.8086757660 * b1;
+	}
+}
+
+void ColourBatch::LRGBtoOkLab_SSE41(const double* r, const double* g, const double* b, double* outL, double* outA, double* outB, const size_t count) {
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const __m128d r1 = _mm_loadu_pd(r + i);
+		const __m128d g1 = _mm_loadu_pd(g + i);
+		const __m128d b1 = _mm_loadu_pd(b + i);
+
+		// to Linear LMS
+		const __m128d l2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.4122214708), r1), _mm_mul_pd(_mm_set1_pd(0.5363325363), g1)), _mm_mul_pd(_mm_set1_pd(0.0514459929), b1));
+		const __m128d m2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.2119034982), r1), _mm_mul_pd(_mm_set1_pd(0.6806995451), g1)), _mm_mul_pd(_mm_set1_pd(0.1073969566), b1));
+		const __m128d s2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.0883024619), r1), _mm_mul_pd(_mm_set1_pd(0.2817188376), g1)), _mm_mul_pd(_mm_set1_pd(0.6299787005), b1));
+
+		// to LMS
+		const __m128d l1 = Cbrt_SSE41(l2);
+		const __m128d m1 = Cbrt_SSE41(m2);
+		const __m128d s1 = Cbrt_SSE41(s2);
+
+		// to OkLab
+		const __m128d l = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.2104542553), l1), _mm_mul_pd(_mm_set1_pd(0.7936177850), m1)), _mm_mul_pd(_mm_set1_pd(0.0040720468), s1));
+		const __m128d a = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(1.9779984951), l1), _mm_mul_pd(_mm_set1_pd(2.4285922050), m1)), _mm_mul_pd(_mm_set1_pd(0.4505937099), s1));
+		const __m128d bb = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(0.0259040371), l1), _mm_mul_pd(_mm_set1_pd(0.7827717662), m1)), _mm_mul_pd(_mm_set1_pd(0.8086757660), s1));
+
+		_mm_storeu_pd(outL + i, l);
+		_mm_storeu_pd(outA + i, a);
+		_mm_storeu_pd(outB + i, bb);
+
+		// Grayscale goes through the scalar shortcut so gray images keep the exact values of Colour
+		const int gray = _mm_movemask_pd(_mm_and_pd(_mm_cmpeq_pd(r1, g1), _mm_cmpeq_pd(r1, b1)));
+		for (size_t j = 0; j < 2; ++j) {
+			if (gray & (1 << j)) LRGBtoOkLab_Scalar(r + i + j, g + i + j, b + i + j, outL + i + j, outA + i + j, outB + i + j, 1);
+		}
+	}
+
+	// Pad the end of the row so every colour takes the same path wherever it is in the row
+	if (i < count) {
+		double pad[6][2] = {};
+		for (size_t j = i; j < count; ++j) {
+			pad[0][j - i] = r[j];
+			pad[1][j - i] = g[j];
+			pad[2][j - i] = b[j];
+		}
+
+		LRGBtoOkLab_SSE41(pad[0], pad[1], pad[2], pad[3], pad[4], pad[5], 2);
+
+		for (size_t j = i; j < count; ++j) {
+			outL[j] = pad[3][j - i];
+			outA[j] = pad[4][j - i];
+			outB[j] = pad[5][j - i];
+		}
+	}
+}
+
+void ColourBatch::LRGBtoOkLab_AVX2(const double* r, const double* g, const double* b, double* outL, double* outA, double* outB, const size_t count) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m256d r1 = _mm256_loadu_pd(r + i);
+		const __m256d g1 = _mm256_loadu_pd(g + i);
+		const __m256d b1 = _mm256_loadu_pd(b + i);
+
+		// to Linear LMS
+		const __m256d l2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(0.4122214708), r1), _mm256_mul_pd(_mm256_set1_pd(0.5363325363), g1)), _mm256_mul_pd(_mm256_set1_pd(0.0514459929), b1));
+		const __m256d m2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(0.2119034982), r1), _mm256_mul_pd(_mm256_set1_pd(0.6806995451), g1)), _mm256_mul_pd(_mm256_set1_pd(0.1073969566), b1));
+		const __m256d s2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(0.0883024619), r1), _mm256_mul_pd(_mm256_set1_pd(0.2817188376), g1)), _mm256_mul_pd(_mm256_set1_pd(0.6299787005), b1));
+
+		// to LMS
+		const __m256d l1 = Cbrt_AVX2(l2);
+		const __m256d m1 = Cbrt_AVX2(m2);
+		const __m256d s1 = Cbrt_AVX2(s2);
+
+		// to OkLab
+		const __m256d l = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(0.2104542553), l1), _mm256_mul_pd(_mm256_set1_pd(0.7936177850), m1)), _mm256_mul_pd(_mm256_set1_pd(0.0040720468), s1));
+		const __m256d a = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(1.9779984951), l1), _mm256_mul_pd(_mm256_set1_pd(2.4285922050), m1)), _mm256_mul_pd(_mm256_set1_pd(0.4505937099), s1));
+		const __m256d bb = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(0.0259040371), l1), _mm256_mul_pd(_mm256_set1_pd(0.7827717662), m1)), _mm256_mul_pd(_mm256_set1_pd(0.8086757660), s1));
+
+		_mm256_storeu_pd(outL + i, l);
+		_mm256_storeu_pd(outA + i, a);
+		_mm256_storeu_pd(outB + i, bb);
+
+		// Grayscale goes through the scalar shortcut so gray images keep the exact values of Colour
+		const int gray = _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(r1, g1, _CMP_EQ_OQ), _mm256_cmp_pd(r1, b1, _CMP_EQ_OQ)));
+		for (size_t j = 0; j < 4; ++j) {
+			if (gray & (1 << j)) LRGBtoOkLab_Scalar(r + i + j, g + i + j, b + i + j, outL + i + j, outA + i + j, outB + i + j, 1);
+		}
+	}
+
+	// Pad the end of the row so every colour takes the same path wherever it is in the row
+	if (i < count) {
+		double pad[6][4] = {};
+		for (size_t j = i; j < count; ++j) {
+			pad[0][j - i] = r[j];
+			pad[1][j - i] = g[j];
+			pad[2][j - i] = b[j];
+		}
+
+		LRGBtoOkLab_AVX2(pad[0], pad[1], pad[2], pad[3], pad[4], pad[5], 4);
+
+		for (size_t j = i; j < count; ++j) {
+			outL[j] = pad[3][j - i];
+			outA[j] = pad[4][j - i];
+			outB[j] = pad[5][j - i];
+		}
+	}
+}
+
+// ========== LINEAR RGB TO OKLAB (FLOAT) ==========
+
+void ColourBatch::LRGBtoOkLab_Scalar(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, const size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		if (r[i] == g[i] && r[i] == b[i]) {
+			// grayscale - same shortcut as Colour
+			outL[i] = std::cbrt(r[i]);
+			outA[i] = 0.f;
+			outB[i] = 0.f;
+			continue;
+		}
+
+		// to Linear LMS
+		const float l2 = 0.4122214708f * r[i] + 0.5363325363f * g[i] + 0.0514459929f * b[i];
+		const float a2 = 0.2119034982f * r[i] + 0.6806995451f * g[i] + 0.1073969566f * b[i];
+		const float b2 = 0.0883024619f * r[i] + 0.2817188376f * g[i] + 0.6299787005f * b[i];
+
+		// to LMS
+		const float l1 = std::cbrt(l2);
+		const float a1 = std::cbrt(a2);
+		const float b1 = std::cbrt(b2);
+
+		// to OkLab
+		outL[i] = 0.2104542553f * l1 + 0.7936177850f * a1 - 0.0040720468f * b1;
+		outA[i] = 1.9779984951f * l1 - 2.4285922050f * a1 + 0.4505937099f * b1;
+		outB[i] = 0.0259040371f * l1 + 0.7827717662f * a1 - 0.8086757660f * b1;
+	}
+}
+
+void ColourBatch::LRGBtoOkLab_SSE41(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, const size_t count) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 r1 = _mm_loadu_ps(r + i);
+		const __m128 g1 = _mm_loadu_ps(g + i);
+		const __m128 b1 = _mm_loadu_ps(b + i);
+
+		// to Linear LMS
+		const __m128 l2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.4122214708f), r1), _mm_mul_ps(_mm_set1_ps(0.5363325363f), g1)), _mm_mul_ps(_mm_set1_ps(0.0514459929f), b1));
+		const __m128 m2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.2119034982f), r1), _mm_mul_ps(_mm_set1_ps(0.6806995451f), g1)), _mm_mul_ps(_mm_set1_ps(0.1073969566f), b1));
+		const __m128 s2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.0883024619f), r1), _mm_mul_ps(_mm_set1_ps(0.2817188376f), g1)), _mm_mul_ps(_mm_set1_ps(0.6299787005f), b1));
+
+		// to LMS
+		const __m128 l1 = Cbrt_SSE41(l2);
+		const __m128 m1 = Cbrt_SSE41(m2);
+		const __m128 s1 = Cbrt_SSE41(s2);
+
+		// to OkLab
+		const __m128 l = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.2104542553f), l1), _mm_mul_ps(_mm_set1_ps(0.7936177850f), m1)), _mm_mul_ps(_mm_set1_ps(0.0040720468f), s1));
+		const __m128 a = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(1.9779984951f), l1), _mm_mul_ps(_mm_set1_ps(2.4285922050f), m1)), _mm_mul_ps(_mm_set1_ps(0.4505937099f), s1));
+		const __m128 bb = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.0259040371f), l1), _mm_mul_ps(_mm_set1_ps(0.7827717662f), m1)), _mm_mul_ps(_mm_set1_ps(0.8086757660f), s1));
+
+		_mm_storeu_ps(outL + i, l);
+		_mm_storeu_ps(outA + i, a);
+		_mm_storeu_ps(outB + i, bb);
+
+		// Grayscale keeps a & b at exactly 0
+		const int gray = _mm_movemask_ps(_mm_and_ps(_mm_cmpeq_ps(r1, g1), _mm_cmpeq_ps(r1, b1)));
+		for (size_t j = 0; j < 4; ++j) {
+			if (gray & (1 << j)) LRGBtoOkLab_Scalar(r + i + j, g + i + j, b + i + j, outL + i + j, outA + i + j, outB + i + j, 1);
+		}
+	}
+
+	// Pad the end of the row so every colour takes the same path wherever it is in the row
+	if (i < count) {
+		float pad[6][4] = {};
+		for (size_t j = i; j < count; ++j) {
+			pad[0][j - i] = r[j];
+			pad[1][j - i] = g[j];
+			pad[2][j - i] = b[j];
+		}
+
+		LRGBtoOkLab_SSE41(pad[0], pad[1], pad[2], pad[3], pad[4], pad[5], 4);
+
+		for (size_t j = i; j < count; ++j) {
+			outL[j] = pad[3][j - i];
+			outA[j] = pad[4][j - i];
+			outB[j] = pad[5][j - i];
+		}
+	}
+}
+
+void ColourBatch::LRGBtoOkLab_AVX2(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, const size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 r1 = _mm256_loadu_ps(r + i);
+		const __m256 g1 = _mm256_loadu_ps(g + i);
+		const __m256 b1 = _mm256_loadu_ps(b + i);
+
+		// to Linear LMS
+		const __m256 l2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.4122214708f), r1), _mm256_mul_ps(_mm256_set1_ps(0.5363325363f), g1)), _mm256_mul_ps(_mm256_set1_ps(0.0514459929f), b1));
+		const __m256 m2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.2119034982f), r1), _mm256_mul_ps(_mm256_set1_ps(0.6806995451f), g1)), _mm256_mul_ps(_mm256_set1_ps(0.1073969566f), b1));
+		const __m256 s2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.0883024619f), r1), _mm256_mul_ps(_mm256_set1_ps(0.2817188376f), g1)), _mm256_mul_ps(_mm256_set1_ps(0.6299787005f), b1));
+
+		// to LMS
+		const __m256 l1 = Cbrt_AVX2(l2);
+		const __m256 m1 = Cbrt_AVX2(m2);
+		const __m256 s1 = Cbrt_AVX2(s2);
+
+		// to OkLab
+		const __m256 l = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.2104542553f), l1), _mm256_mul_ps(_mm256_set1_ps(0.7936177850f), m1)), _mm256_mul_ps(_mm256_set1_ps(0.0040720468f), s1));
+		const __m256 a = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(1.9779984951f), l1), _mm256_mul_ps(_mm256_set1_ps(2.4285922050f), m1)), _mm256_mul_ps(_mm256_set1_ps(0.4505937099f), s1));
+		const __m256 bb = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.0259040371f), l1), _mm256_mul_ps(_mm256_set1_ps(0.7827717662f), m1)), _mm256_mul_ps(_mm256_set1_ps(0.8086757660f), s1));
+
+		_mm256_storeu_ps(outL + i, l);
+		_mm256_storeu_ps(outA + i, a);
+		_mm256_storeu_ps(outB + i, bb);
+
+		// Grayscale keeps a & b at exactly 0
+		const int gray = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(r1, g1, _CMP_EQ_OQ), _mm256_cmp_ps(r1, b1, _CMP_EQ_OQ)));
+		for (size_t j = 0; j < 8; ++j) {
+			if (gray & (1 << j)) LRGBtoOkLab_Scalar(r + i + j, g + i + j, b + i + j, outL + i + j, outA + i + j, outB + i + j, 1);
+		}
+	}
+
+	// Pad the end of the row so every colour takes the same path wherever it is in the row
+	if (i < count) {
+		float pad[6][8] = {};
+		for (size_t j = i; j < count; ++j) {
+			pad[0][j - i] = r[j];
+			pad[1][j - i] = g[j];
+			pad[2][j - i] = b[j];
+		}
+
+		LRGBtoOkLab_AVX2(pad[0], pad[1], pad[2], pad[3], pad[4], pad[5], 8);
+
+		for (size_t j = i; j < count; ++j) {
+			outL[j] = pad[3][j - i];
+			outA[j] = pad[4][j - i];
+			outB[j] = pad[5][j - i];
+		}
+	}
+}
+
+// ========== OKLAB TO LINEAR RGB ==========
+
+void ColourBatch::OkLabtoLRGB_Scalar(const double* l, const double* a, const double* b, double* outR, double* outG, double* outB, const size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		if (a[i] == 0. && b[i] == 0.) {
+			// grayscale - same shortcut as Colour
+			const double v = l[i] * l[i] * l[i];
+			outR[i] = v;
+			outG[i] = v;
+			outB[i] = v;
+			continue;
+		}
+
+		// to LMS
+		const double r2 = l[i] + 0.3963377774 * a[i] + 0.2158037573 * b[i];
+		const double g2 = l[i] - 0.1055613458 * a[i] - 0.0638541728 * b[i];
+		const double b2 = l[i] - 0.0894841775 * a[i] - 1.2914855480 * b[i];
+
+		// to Linear LMS
+		const double r1 = r2 * r2 * r2;
+		const double g1 = g2 * g2 * g2;
+		const double b1 = b2 * b2 * b2;
+
+		// to Linear RGB
+		outR[i] = +4.0767416621 * r1 - 3.3077115913 * g1 + 0.2309699292 * b1;
+		outG[i] = -1.2684380046 * r1 + 2.6097574011 * g1 - 0.3413193965 * b1;
+		outB[i] = -0.0041960863 * r1 - 0.7034186147 * g1 + 1.7076147010 * b1;
+	}
+}
+
+void ColourBatch::OkLabtoLRGB_SSE41(const double* l, const double* a, const double* b, double* outR, double* outG, double* outB, const size_t count) {
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const __m128d l1 = _mm_loadu_pd(l + i);
+		const __m128d a1 = _mm_loadu_pd(a + i);
+		const __m128d b1 = _mm_loadu_pd(b + i);
+
+		// to LMS
+		const __m128d r2 = _mm_add_pd(_mm_add_pd(l1, _mm_mul_pd(_mm_set1_pd(0.3963377774), a1)), _mm_mul_pd(_mm_set1_pd(0.2158037573), b1));
+		const __m128d g2 = _mm_sub_pd(_mm_sub_pd(l1, _mm_mul_pd(_mm_set1_pd(0.1055613458), a1)), _mm_mul_pd(_mm_set1_pd(0.0638541728), b1));
+		const __m128d b2 = _mm_sub_pd(_mm_sub_pd(l1, _mm_mul_pd(_mm_set1_pd(0.0894841775), a1)), _mm_mul_pd(_mm_set1_pd(1.2914855480), b1));
+
+		// to Linear LMS
+		const __m128d r3 = _mm_mul_pd(_mm_mul_pd(r2, r2), r2);
+		const __m128d g3 = _mm_mul_pd(_mm_mul_pd(g2, g2), g2);
+		const __m128d b3 = _mm_mul_pd(_mm_mul_pd(b2, b2), b2);
+
+		// to Linear RGB
+		__m128d r = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(4.0767416621), r3), _mm_mul_pd(_mm_set1_pd(3.3077115913), g3)), _mm_mul_pd(_mm_set1_pd(0.2309699292), b3));
+		__m128d g = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(-1.2684380046), r3), _mm_mul_pd(_mm_set1_pd(2.6097574011), g3)), _mm_mul_pd(_mm_set1_pd(0.3413193965), b3));
+		__m128d bb = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(-0.0041960863), r3), _mm_mul_pd(_mm_set1_pd(0.7034186147), g3)), _mm_mul_pd(_mm_set1_pd(1.7076147010), b3));
+
+		// grayscale - same shortcut as Colour
+		const __m128d gray = _mm_and_pd(_mm_cmpeq_pd(a1, _mm_setzero_pd()), _mm_cmpeq_pd(b1, _mm_setzero_pd()));
+		const __m128d grayV = _mm_mul_pd(_mm_mul_pd(l1, l1), l1);
+		r = _mm_blendv_pd(r, grayV, gray);
+		g = _mm_blendv_pd(g, grayV, gray);
+		bb = _mm_blendv_pd(bb, grayV, gray);
+
+		_mm_storeu_pd(outR + i, r);
+		_mm_storeu_pd(outG + i, g);
+		_mm_storeu_pd(outB + i, bb);
+	}
+
+	OkLabtoLRGB_Scalar(l + i, a + i, b + i, outR + i, outG + i, outB + i, count - i);
+}
+
+void ColourBatch::OkLabtoLRGB_AVX2(const double* l, const double* a, const double* b, double* outR, double* outG, double* outB, const size_t count) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m256d l1 = _mm256_loadu_pd(l + i);
+		const __m256d a1 = _mm256_loadu_pd(a + i);
+		const __m256d b1 = _mm256_loadu_pd(b + i);
+
+		// to LMS
+		const __m256d r2 = _mm256_add_pd(_mm256_add_pd(l1, _mm256_mul_pd(_mm256_set1_pd(0.3963377774), a1)), _mm256_mul_pd(_mm256_set1_pd(0.2158037573), b1));
+		const __m256d g2 = _mm256_sub_pd(_mm256_sub_pd(l1, _mm256_mul_pd(_mm256_set1_pd(0.1055613458), a1)), _mm256_mul_pd(_mm256_set1_pd(0.0638541728), b1));
+		const __m256d b2 = _mm256_sub_pd(_mm256_sub_pd(l1, _mm256_mul_pd(_mm256_set1_pd(0.0894841775), a1)), _mm256_mul_pd(_mm256_set1_pd(1.2914855480), b1));
+
+		// to Linear LMS
+		const __m256d r3 = _mm256_mul_pd(_mm256_mul_pd(r2, r2), r2);
+		const __m256d g3 = _mm256_mul_pd(_mm256_mul_pd(g2, g2), g2);
+		const __m256d b3 = _mm256_mul_pd(_mm256_mul_pd(b2, b2), b2);
+
+		// to Linear RGB
+		__m256d r = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(4.0767416621), r3), _mm256_mul_pd(_mm256_set1_pd(3.3077115913), g3)), _mm256_mul_pd(_mm256_set1_pd(0.2309699292), b3));
+		__m256d g = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(-1.2684380046), r3), _mm256_mul_pd(_mm256_set1_pd(2.6097574011), g3)), _mm256_mul_pd(_mm256_set1_pd(0.3413193965), b3));
+		__m256d bb = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(-0.0041960863), r3), _mm256_mul_pd(_mm256_set1_pd(0.7034186147), g3)), _mm256_mul_pd(_mm256_set1_pd(1.7076147010), b3));
+
+		// grayscale - same shortcut as Colour
+		const __m256d gray = _mm256_and_pd(_mm256_cmp_pd(a1, _mm256_setzero_pd(), _CMP_EQ_OQ), _mm256_cmp_pd(b1, _mm256_setzero_pd(), _CMP_EQ_OQ));
+		const __m256d grayV = _mm256_mul_pd(_mm256_mul_pd(l1, l1), l1);
+		r = _mm256_blendv_pd(r, grayV, gray);
+		g = _mm256_blendv_pd(g, grayV, gray);
+		bb = _mm256_blendv_pd(bb, grayV, gray);
+
+		_mm256_storeu_pd(outR + i, r);
+		_mm256_storeu_pd(outG + i, g);
+		_mm256_storeu_pd(outB + i, bb);
+	}
+
+	OkLabtoLRGB_Scalar(l + i, a + i, b + i, outR + i, outG + i, outB + i, count - i);
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// <para>Colour space conversions for rows of colours stored as separate channels</para>
+/// <para>Uses AVX2 or SSE4.1 when the CPU supports it - picked at runtime</para>
+/// </summary>
+class ColourBatch {
+public:
+	ColourBatch() {};
+	~ColourBatch() {};
+
+	enum class Instructions { Scalar, SSE41, AVX2 };
+
+	/// <summary>
+	/// Best instruction set supported by the CPU
+	/// </summary>
+	/// <returns></returns>
+	static Instructions GetSupported();
+
+	/// <summary>
+	/// Instruction set currently used by the conversions - defaults to GetSupported()
+	/// </summary>
+	/// <returns></returns>
+	static Instructions GetInstructions();
+
+	/// <summary>
+	/// Force an instruction set - falls back to GetSupported() if the CPU can't run it
+	/// </summary>
+	/// <param name="instructions"></param>
+	static void SetInstructions(const Instructions instructions);
+
+	static std::string ToString(const Instructions instructions);
+
+	/// <summary>
+	/// <para>Linear RGB to OkLab</para>
+	/// <para>SIMD versions use a polynomial cube root - within 1e-12 of Colour::GetOkLab()</para>
+	/// </summary>
+	/// <param name="r">Linear RGB input</param>
+	/// <param name="g">Linear RGB input</param>
+	/// <param name="b">Linear RGB input</param>
+	/// <param name="outL">OkLab output</param>
+	/// <param name="outA">OkLab output</param>
+	/// <param name="outB">OkLab output</param>
+	/// <param name="count"></param>
+	static void LRGBtoOkLab(const double* r, const double* g, const double* b, double* outL, double* outA, double* outB, const size_t count);
+
+	/// <summary>
+	/// <para>Linear RGB to OkLab in float - for the float dither buffers</para>
+	/// <para>Within 1e-5 of Colour::GetOkLab() - float rounding, the SIMD cube root adds no more</para>
+	/// </summary>
+	static void LRGBtoOkLab(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, const size_t count);
+
+	/// <summary>
+	/// OkLab to Linear RGB - same values as Colour::GetLRGB()
+	/// </summary>
+	/// <param name="l">OkLab input</param>
+	/// <param name="a">OkLab input</param>
+	/// <param name="b">OkLab input</param>
+	/// <param name="outR">Linear RGB output</param>
+	/// <param name="outG">Linear RGB output</param>
+	/// <param name="outB">Linear RGB output</param>
+	/// <param name="count"></param>
+	static void OkLabtoLRGB(const double* l, const double* a, const double* b, double* outR, double* outG, double* outB, const size_t count);
+
+	/// <summary>
+	/// 8 bit sRGB to Linear RGB using Colour::sRGBUintToLRGB
+	/// </summary>
+	/// <param name="in"></param>
+	/// <param name="out"></param>
+	/// <param name="count"></param>
+	static void sRGBtoLRGB(const uint8_t* in, double* out, const size_t count);
+
+	/// <summary>
+	/// <para>Linear RGB to sRGB for one channel - same values as Colour::GetsRGB()</para>
+	/// <para>NOTE: Not vectorised - uses std::pow</para>
+	/// </summary>
+	/// <param name="in"></param>
+	/// <param name="out"></param>
+	/// <param name="count"></param>
+	static void LRGBtosRGB(const double* in, double* out, const size_t count);
+
+	/// <summary>
+	/// sRGB (0 to 1) to 8 bit sRGB - same rounding as Colour::GetsRGB_UInt()
+	/// </summary>
+	/// <param name="in"></param>
+	/// <param name="out"></param>
+	/// <param name="count"></param>
+	static void sRGBToUint(const double* in, uint8_t* out, const size_t count);
+
+private:
+	static Instructions m_instructions;
+
+	static void LRGBtoOkLab_Scalar(const double* r, const double* g, const double* b, double* outL, double* outA, double* outB, const size_t count);
+	static void LRGBtoOkLab_SSE41(const double* r, const double* g, const double* b, double* outL, double* outA, double* outB, const size_t count);
+	static void LRGBtoOkLab_AVX2(const double* r, const double* g, const double* b, double* outL, double* outA, double* outB, const size_t count);
+
+	static void LRGBtoOkLab_Scalar(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, const size_t count);
+	static void LRGBtoOkLab_SSE41(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, const size_t count);
+	static void LRGBtoOkLab_AVX2(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, const size_t count);
+
+	static void OkLabtoLRGB_Scalar(const double* l, const double* a, const double* b, double* outR, double* outG, double* outB, const size_t count);
+	static void OkLabtoLRGB_SSE41(const double* l, const double* a, const double* b, double* outR, double* outG, double* outB, const size_t count);
+	static void OkLabtoLRGB_AVX2(const double* l, const double* a, const double* b, double* outR, double* outG, double* outB, const size_t count);
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include "Colour.h"
+#include "Image.h"
+#include "PixelBuffer.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+/// <summary>
+/// <para>An 8 bit image and its PixelBuffer copies in each MathMode - each made once and shared by every profile dithering the same image</para>
+/// <para>Thread safe - a profile wanting something another profile is making waits for it</para>
+/// </summary>
+class ConvertedImage {
+public:
+	ConvertedImage() {};
+	~ConvertedImage() {};
+
+	ConvertedImage(const ConvertedImage& other) = delete;
+	ConvertedImage& operator=(const ConvertedImage& other) = delete;
+
+	/// <summary>
+	/// Makes the image the first time it's called - later calls wait for it and give the same result
+	/// </summary>
+	/// <param name="make">Fills the image - false if it failed</param>
+	/// <returns>False if make failed</returns>
+	bool Make(const std::function<bool(Image& image)>& make) {
+		std::call_once(m_made, [&]() { m_valid = make(m_image); });
+		return m_valid;
+	}
+
+	/// <summary>
+	/// Only valid once Make() returned true
+	/// </summary>
+	/// <returns></returns>
+	const Image& GetImage() const { return m_image; };
+
+	/// <summary>
+	/// Every row of the image in a MathMode's channels - converted by the first call for each type and mode, see PixelBuffer::SetRow()
+	/// </summary>
+	/// <typeparam name="T">float or double</typeparam>
+	/// <param name="mode"></param>
+	/// <returns></returns>
+	template<typename T>
+	const PixelBuffer<T>& GetPixels(const Colour::MathMode mode) {
+		Converted<T>* converted = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			std::unique_ptr<Converted<T>>& slot = GetConverted<T>()[mode];
+			if (!slot) slot = std::make_unique<Converted<T>>();
+			converted = slot.get();
+		}
+
+		// Other modes can be converted at the same time
+		std::call_once(converted->made, [&]() {
+			converted->pixels.Resize(m_image.GetWidth(), m_image.GetHeight(), mode);
+			for (int y = 0; y < m_image.GetHeight(); ++y) converted->pixels.SetRow(m_image, y);
+		});
+
+		return converted->pixels;
+	}
+
+private:
+	template<typename T>
+	struct Converted {
+		std::once_flag made;
+		PixelBuffer<T> pixels;
+	};
+
+	Image m_image;
+	std::once_flag m_made;
+	bool m_valid = false;
+
+	std::mutex m_mutex;
+	std::map<Colour::MathMode, std::unique_ptr<Converted<float>>> m_float;
+	std::map<Colour::MathMode, std::unique_ptr<Converted<double>>> m_double;
+
+	template<typename T>
+	std::map<Colour::MathMode, std::unique_ptr<Converted<T>>>& GetConverted() {
+		if constexpr (std::is_same_v<T, float>) {
+			return m_float;
+		} else {
+			return m_double;
+		}
+	}
+};
+
+/// <summary>
+/// <para>Every ConvertedImage made from one image file, by how it was made - like the decoded file or its grayscale version</para>
+/// <para>Thread safe - shared by the profiles dithering the image</para>
+/// </summary>
+class SharedImage {
+public:
+	SharedImage() {};
+	~SharedImage() {};
+
+	SharedImage(const SharedImage& other) = delete;
+	SharedImage& operator=(const SharedImage& other) = delete;
+
+	/// <summary>
+	/// The image for key - not made yet if it's new, see ConvertedImage::Make()
+	/// </summary>
+	/// <param name="key"></param>
+	/// <returns>Stays valid until Clear()</returns>
+	ConvertedImage& Get(const std::string& key) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::unique_ptr<ConvertedImage>& slot = m_images[key];
+		if (!slot) slot = std::make_unique<ConvertedImage>();
+		return *slot;
+	}
+
+	/// <summary>
+	/// Frees every image - once no profile is using them
+	/// </summary>
+	void Clear() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_images.clear();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::map<std::string, std::unique_ptr<ConvertedImage>> m_images;
+};
@@ -1,38 +1,53 @@
+#include "../misc/ThreadPool.h"
 #include "../wrapper/Log.h"
+#include "../wrapper/Metrics.h"
 #include "../wrapper/Threshold.h"
 #include "Colour.h"
+#include "ColourBatch.h"
+#include "ConvertedImage.hpp"
 #include "Dither.h"
+#include "DitherCache.h"
+#include "DitherKernel.h"
 #include "Image.h"
+#include "ImageRows.h"
 #include "Palette.h"
+#include "PaletteLUT.h"
+#include "PaletteTree.h"
+#include "PixelBuffer.hpp"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
-#include <map>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-bool Dither::m_ditherAlpha = false;
-bool Dither::m_mono = false;
-bool Dither::m_normaliseCol = true;
-std::string Dither::m_distanceMode = "oklab";
-std::string Dither::m_ditherAlphaType = "ordered";
-std::string Dither::m_mathMode = "srgb";
-std::string Dither::m_matrixType = "bayer";
-unsigned int Dither::m_ditherAlphaFactor = 1;
+void Dither::OrderedDither(Image& image, const Palette& palette, ConvertedImage* converted) {
+	MemoryRows rows(image);
+	if (m_useFloat) {
+		OrderedDitherBuffer<float>(rows, palette, converted);
+	} else {
+		OrderedDitherBuffer<double>(rows, palette, converted);
+	}
+}
 
-void Dither::OrderedDither(Image& image, const Palette& palette) {
-	const int imgWidth = image.GetWidth();
-	const int imgHeight = image.GetHeight();
+bool Dither::OrderedDither(ImageRows& rows, const Palette& palette) {
+	return m_useFloat ? OrderedDitherBuffer<float>(rows, palette, nullptr) : OrderedDitherBuffer<double>(rows, palette, nullptr);
+}
 
-	Threshold pixelThreshold;
-	pixelThreshold.GenerateThreshold(m_matrixType);
+template<typename T>
+bool Dither::OrderedDitherBuffer(ImageRows& rows, const Palette& palette, ConvertedImage* converted) {
+	const int imgWidth = rows.GetWidth();
+	const int imgHeight = rows.GetHeight();
+	const int bandHeight = rows.GetBandHeight();
 
-	// Create a copy of of image in Colour form
-	const size_t coloursSize = (size_t)image.GetHeight() * image.GetWidth();
-	std::vector<Colour> colours;
-	colours.reserve(coloursSize);
+	const Threshold& pixelThreshold = GetThreshold();
+
+	uint32_t* const indices = StartIndices(rows);
+	AlphaSpans* const spans = StartSpans(rows);
 
 	double imgMinL = -1., imgMaxL = -1.;
 
@@ -43,17 +58,30 @@ void Dither::OrderedDither(Image& image, const Palette& palette) {
 
 	SetColourMathMode(m_distanceMode);
 
-	Log::StartTime();
-	for (int y = 0; y < imgHeight; ++y) {
-		for (int x = 0; x < imgWidth; ++x) {
-			const size_t index = image.GetIndex(x, y);
-			//Colour pixel = GetColourFromImage(image, x, y);
-			colours.emplace_back(GetColourFromImage(image, x, y));
-			Log::DebugProgress(double(x + y * imgWidth), double(2 * imgHeight * imgWidth), 5.);
+	const bool ditherAlpha = rows.HasAlphaChannel() && m_ditherAlpha;
+
+	// The image converted once for every profile dithering it is read in place - copied when Floyd-Steinberg alpha error is written into it
+	// Otherwise a copy of of image in the distance mode's channels - a band and the row after it at a time
+	PixelBuffer<T> ownPixels;
+	const PixelBuffer<T>* sharedPixels = nullptr;
+	{
+		Metrics::Timer timer(Metrics::Stage::Colour);
+		if (converted && !(ditherAlpha && m_fsAlpha)) {
+			sharedPixels = &converted->GetPixels<T>(Colour::GetMathMode());
+		} else if (converted) {
+			ownPixels = converted->GetPixels<T>(Colour::GetMathMode());
+		} else {
+			ownPixels.Resize(imgWidth, imgHeight, Colour::GetMathMode(), std::min(bandHeight + 1, imgHeight));
+		}
+	}
+	const PixelBuffer<T>& pixels = sharedPixels ? *sharedPixels : ownPixels;
 
-			if (colours.back().GetAlpha() <= 0.) continue;
+	const auto addRange = [&](const PixelBuffer<T>& buffer, const int y) {
+		for (int x = 0; x < imgWidth; ++x) {
+			const size_t index = buffer.GetIndex(x, y);
+			if (buffer.GetAlpha(index) <= 0.) continue;
 
-			const double currL = colours.back().MonoGetLightness();
+			const double currL = buffer.GetColour(index).MonoGetLightness();
 
 			if (imgMinL <= 0 && imgMaxL <= 0.) {
 				imgMinL = currL;
@@ -63,359 +91,1066 @@ void Dither::OrderedDither(Image& image, const Palette& palette) {
 			if (currL < imgMinL) imgMinL = currL;
 			if (currL > imgMaxL) imgMaxL = currL;
 		}
+	};
+
+	// Normalised mono needs the lightness range of every row before the first band
+	const bool rangePass = bandHeight < imgHeight;
+	if (rangePass && m_mono && m_normaliseCol) {
+		PixelBuffer<T> row(imgWidth, 1, Colour::GetMathMode());
+		const Colour::MathMode distanceMode = Colour::GetMathMode();
+
+		Metrics::Timer timer(Metrics::Stage::Colour);
+		const bool success = rows.ForEachRow([&](const Image& image, const int imageY) {
+			Colour::SetMathMode(distanceMode);
+			row.SetRow(image, imageY, 0);
+			addRange(row, 0);
+		});
+		if (!success) return false;
 	}
 
-	struct DitherInfo {
-		double alpha = 0.;
-		Colour p0;
-		Colour p1;
-	};
+	Metrics::Timer paletteTimer(Metrics::Stage::Palette);
 
-	std::map<Colour, DitherInfo> ditherMem;
-	Log::WriteOneLine("  Dithering");
-	Log::StartTime();
-	for (int y = 0; y < imgHeight; ++y) {
-		for (int x = 0; x < imgWidth; ++x) {
-			const size_t indexCol = size_t(x + y * imgWidth);
-			const size_t index = image.GetIndex(x, y);
+	// Palette colours are read by every thread - convert them now instead of lazily
+	palette.ConvertAll();
+	const PaletteTree& paletteTree = palette.GetTree(Colour::GetMathMode());
 
-			Colour pixel = colours[indexCol];
-			double pixelAlpha = pixel.GetAlpha();
-			pixel.SetAlpha(1.); // to reduce size of ditherMem - search for colour regardless of alpha
+	// Replaces the two nearest search - mono only looks at lightness so doesn't need it
+	const bool useLUT = m_useLUT && !m_mono &&
+		m_orderedLUT->Prepare(palette, Colour::GetMathMode(), PaletteLUT::Type::TwoNearest, std::is_same_v<T, float>, m_lutDirectory, m_threads);
 
-			// ===== CHECK MEMOIZATION =====
+	ThreadPool threadPool(m_threads);
 
-			DitherInfo info;
+	// One memo per thread - a colour gives the same result on every thread so the output matches a serial run
+	// Kept between images with the same palette and settings
+	if (m_orderedCaches.size() < threadPool.GetThreadCount()) m_orderedCaches.resize(threadPool.GetThreadCount());
 
-			if (ditherMem.find(pixel) != ditherMem.end()) {
-				info = ditherMem[pixel]; // found
-			} else if (palette.size() <= 1) { // palette has one colour
-				info.p0 = palette.GetColour(0);
-				info.p1 = palette.GetColour(0);
+	const int tileWidth = 64;
+	const int tileHeight = 64;
+	const int tilesX = (imgWidth + tileWidth - 1) / tileWidth;
+	const size_t bandCount = static_cast<size_t>((imgHeight + bandHeight - 1) / bandHeight);
+	const size_t totalTiles = static_cast<size_t>(tilesX) * static_cast<size_t>((bandHeight + tileHeight - 1) / tileHeight) * bandCount;
+	size_t tilesDone = 0;
 
-				info.alpha = 0.;
+	// MathMode is per thread - workers copy the calling thread's
+	const Colour::MathMode distanceMode = Colour::GetMathMode();
 
-				ditherMem[pixel] = info;
-			} else {
-				if (m_mono) {
-					double currL = pixel.MonoGetLightness();
+	// 8 bit colours written for each palette index - a pixel with no palette colour keeps a blank colour
+	const std::vector<uint8_t>& paletteBytes = palette.GetBytes();
+	const Colour::sRGB_UInt blank = Colour().GetsRGB_UInt();
+	const uint8_t noColourBytes[3] = { blank.r, blank.g, blank.b };
+
+	std::vector<OrderedRow<T>> orderedRows(threadPool.GetThreadCount());
 
-					// normalise image min&max
+	// Memo hits and misses of each thread - added to Metrics by this thread
+	std::vector<std::array<size_t, 2>> cacheCounts(threadPool.GetThreadCount(), { 0, 0 });
 
-					if (m_normaliseCol) currL = (currL - imgMinL) / (imgMaxL - imgMinL);
+	paletteTimer.Stop();
 
-					const double palMinL = palette.front().MonoGetLightness();
-					const double palMaxL = palette.back().MonoGetLightness();
+	Log::StartTime();
+	int copiedEnd = 0;
+	for (int bandStart = 0; bandStart < imgHeight; bandStart += bandHeight) {
+		const int bandEnd = std::min(bandStart + bandHeight, imgHeight);
+
+		// Floyd-Steinberg alpha error reaches the row after the band
+		const int loadEnd = std::min(bandEnd + 1, imgHeight);
+		{
+			Metrics::Timer timer(Metrics::Stage::Stream);
+			if (!rows.Load(bandStart, loadEnd)) return false;
+		}
 
-					for (size_t i = 0; i < palette.size() - 1; ++i) {
-						double p0_l = palette.GetColour(i).MonoGetLightness();
-						double p1_l = palette.GetColour(i + 1).MonoGetLightness();
+		Image& image = rows.GetImage();
+		ownPixels.MoveWindow(bandStart);
 
-						p0_l = (p0_l - palMinL) / (palMaxL - palMinL);
-						p1_l = (p1_l - palMinL) / (palMaxL - palMinL);
+		{
+			Metrics::Timer timer(Metrics::Stage::Colour);
 
-						if (currL >= p0_l && currL <= p1_l) {
-							info.p0 = palette.GetColour(i);
-							info.p1 = palette.GetColour(i + 1);
+			Colour::SetMathMode(distanceMode);
 
-							const double p0_d = currL - p0_l;
-							//const double p1_d = p1_l - currL;
+			for (int y = copiedEnd; y < loadEnd; ++y) {
+				if (!converted) ownPixels.SetRow(image, y - bandStart, y);
+				if (spans) spans->SetRow(image, y - bandStart, y);
+				Log::DebugProgress(double(y * imgWidth), double(imgHeight * imgWidth), 5.);
 
-							const double sum_d = p1_l - p0_l;
+				// Only normalised mono uses the range
+				if (!rangePass && m_mono && m_normaliseCol) addRange(pixels, y);
+			}
+			copiedEnd = loadEnd;
+		}
 
-							info.alpha = p0_d / sum_d;
-						}
-					}
-				} else {
-					size_t i0 = 0, i1 = 1; // find p0 and p1
+		// The range is only known after the first copy when the whole image is in memory
+		if (bandStart == 0) {
+			Metrics::Timer timer(Metrics::Stage::Palette);
+
+			const std::string cacheSettings = "ordered " + CacheSettings(imgMinL, imgMaxL);
+			for (DitherCache& cache : m_orderedCaches) cache.Prepare(palette, cacheSettings);
 
-					double d0 = pixel.Mag(palette.GetColour(0));
-					double d1 = pixel.Mag(palette.GetColour(1));
+			Log::WriteOneLine("  Dithering");
+			Log::StartTime();
+		}
 
-					if (d1 < d0) {
-						std::swap(d0, d1);
-						std::swap(i0, i1);
+		const int tilesY = (bandEnd - bandStart + tileHeight - 1) / tileHeight;
+		const size_t tileCount = static_cast<size_t>(tilesX) * static_cast<size_t>(tilesY);
+
+		Metrics::Timer ditherTimer(Metrics::Stage::Dither);
+		threadPool.ParallelFor(tileCount, [&](const size_t tile, const unsigned int thread) {
+			DitherCache& ditherCache = m_orderedCaches[thread];
+			size_t cacheHits = 0, cacheMisses = 0;
+			Colour::SetMathMode(distanceMode);
+
+			const int startX = static_cast<int>(tile % static_cast<size_t>(tilesX)) * tileWidth;
+			const int startY = bandStart + static_cast<int>(tile / static_cast<size_t>(tilesX)) * tileHeight;
+			const int endX = std::min(startX + tileWidth, imgWidth);
+			const int endY = std::min(startY + tileHeight, bandEnd);
+
+			OrderedRow<T>& row = orderedRows[thread];
+			const size_t count = static_cast<size_t>(endX - startX);
+			row.Resize(count);
+
+			for (int y = startY; y < endY; ++y) {
+				const int imageY = y - bandStart;
+				AlphaSpans::Cursor transparent(spans ? &spans->GetRow(y) : nullptr);
+
+				for (int x = startX; x < endX; ++x) {
+					const size_t indexCol = pixels.GetIndex(x, y);
+					const size_t rowX = static_cast<size_t>(x - startX);
+
+					// Fully transparent runs are the first palette colour without a search
+					const int transparentEnd = std::min(transparent.Skip(x), endX);
+					if (transparentEnd > x) {
+						const size_t rowEnd = static_cast<size_t>(transparentEnd - startX);
+						std::fill(row.i0.begin() + rowX, row.i0.begin() + rowEnd, 0u);
+						std::fill(row.i1.begin() + rowX, row.i1.begin() + rowEnd, 0u);
+						std::fill(row.alpha.begin() + rowX, row.alpha.begin() + rowEnd, T(0));
+
+						x = transparentEnd - 1;
+						continue;
 					}
 
-					for (size_t i = 2; i < palette.size(); ++i) {
-						double d = pixel.Mag(palette.GetColour(i));
+					// ===== CHECK MEMOIZATION =====
 
-						if (d < d0) {
-							d1 = d0; i1 = i0;
-							d0 = d;  i0 = i;
-						} else if (d < d1) {
-							d1 = d;  i1 = i;
-						}
-					}
+					const uint32_t key = DitherCache::GetKey(image, x, imageY);
+					const DitherCache::Entry* cached = ditherCache.Find(key);
+
+					uint32_t i0 = DitherCache::NoColour, i1 = DitherCache::NoColour;
+					double alpha = 0.;
+
+					if (cached) { // found
+						i0 = cached->p0;
+						i1 = cached->p1;
+						alpha = cached->alpha;
+						++cacheHits;
+					} else if (palette.size() <= 1) { // palette has one colour
+						i0 = 0;
+						i1 = 0;
+
+						ditherCache.Insert(key, i0, i1, alpha);
+						++cacheMisses;
+					} else {
+						++cacheMisses;
+
+						Colour pixel = pixels.GetColour(indexCol);
+						pixel.SetAlpha(1.);
+
+						if (m_mono) {
+							double currL = pixel.MonoGetLightness();
+
+							// normalise image min&max
+
+							if (m_normaliseCol) currL = (currL - imgMinL) / (imgMaxL - imgMinL);
+
+							const double palMinL = palette.front().MonoGetLightness();
+							const double palMaxL = palette.back().MonoGetLightness();
+
+							for (size_t i = 0; i < palette.size() - 1; ++i) {
+								double p0_l = palette.GetColour(i).MonoGetLightness();
+								double p1_l = palette.GetColour(i + 1).MonoGetLightness();
+
+								p0_l = (p0_l - palMinL) / (palMaxL - palMinL);
+								p1_l = (p1_l - palMinL) / (palMaxL - palMinL);
+
+								if (currL >= p0_l && currL <= p1_l) {
+									i0 = static_cast<uint32_t>(i);
+									i1 = static_cast<uint32_t>(i + 1);
 
-					info.p0 = palette.GetColour(i0);
-					info.p1 = palette.GetColour(i1);
+									const double p0_d = currL - p0_l;
+									//const double p1_d = p1_l - currL;
 
-					const double p0_l = info.p0.GetOkLab().l;
-					const double p1_l = info.p1.GetOkLab().l;
+									const double sum_d = p1_l - p0_l;
 
-					if (p0_l < p1_l) std::swap(info.p0, info.p1);
+									alpha = p0_d / sum_d;
+								}
+							}
+						} else {
+							size_t n0 = 0, n1 = 1; // find p0 and p1
+							if (useLUT) {
+								n0 = m_orderedLUT->GetP0(key);
+								n1 = m_orderedLUT->GetP1(key);
+							} else {
+								paletteTree.TwoNearest(pixel, n0, n1);
 
-					const double p0_d = info.p0.Mag(pixel);
-					const double p1_d = info.p1.Mag(pixel);
+								const double p0_l = palette.GetColour(n0).GetOkLab().l;
+								const double p1_l = palette.GetColour(n1).GetOkLab().l;
 
-					const double sum_d = p0_d + p1_d;
+								if (p0_l < p1_l) std::swap(n0, n1);
+							}
 
-					info.alpha = p0_d / sum_d;
+							const double p0_d = palette.GetColour(n0).Mag(pixel);
+							const double p1_d = palette.GetColour(n1).Mag(pixel);
+
+							const double sum_d = p0_d + p1_d;
+
+							i0 = static_cast<uint32_t>(n0);
+							i1 = static_cast<uint32_t>(n1);
+							alpha = p0_d / sum_d;
+						}
+
+						alpha = std::clamp(alpha, 0., 1.);
+						ditherCache.Insert(key, i0, i1, alpha);
+					}
+
+					row.i0[rowX] = i0;
+					row.i1[rowX] = i1;
+					row.alpha[rowX] = static_cast<T>(alpha);
 				}
 
-				info.alpha = std::clamp(info.alpha, 0., 1.);
-				ditherMem[pixel] = info;
-			}
+				// ===== APPLY DITHER =====
 
-			// ===== APPLY DITHER =====
+				// Thresholds are compared in the buffer's precision
+				pixelThreshold.GetRow(startX, y, row.threshold.data(), count);
+				DitherKernel::SelectIndices(row.alpha.data(), row.threshold.data(), row.i0.data(), row.i1.data(), row.indices.data(), count);
 
-			// This is to cancel out the (-0.5) inside GetThreshold() function
-			const double threshold = pixelThreshold.GetThreshold(x, y) + 0.5;
+				// Alpha is dithered after the band
+				for (int x = startX; x < endX; ++x) {
+					row.alphaBytes[static_cast<size_t>(x - startX)] = ToAlphaByte(pixels.GetAlpha(pixels.GetIndex(x, y)));
+				}
 
-			Colour nearest = info.alpha > threshold ? info.p1 : info.p0;
-			nearest.SetAlpha(pixelAlpha);
+				DitherKernel::WriteRow(image, startX, imageY, row.indices.data(), row.alphaBytes.data(), paletteBytes.data(), noColourBytes, count);
+				if (indices) std::copy(row.indices.begin(), row.indices.begin() + count, indices + static_cast<size_t>(y) * static_cast<size_t>(imgWidth) + static_cast<size_t>(startX));
+			}
 
-			if (image.HasAlphaChannel() && m_ditherAlpha)
-				DitherAlpha(nearest, colours, x, y, imgWidth, imgHeight, pixelThreshold);
+			cacheCounts[thread][0] += cacheHits;
+			cacheCounts[thread][1] += cacheMisses;
 
-			SetColourToImage(nearest, image, x, y);
+			// Only the calling thread reports progress so the lines stay with this image
+			if (thread == 0) Log::DebugProgress(double(tilesDone + tile), double(totalTiles), 5.);
+		});
+		ditherTimer.Stop();
 
-			Log::DebugProgress(double(x + y * imgWidth), double(2 * imgHeight * imgWidth), 5.);
+		if (ditherAlpha && m_fsAlpha) {
+			DiffuseAlphaBand(ownPixels, image, bandStart, bandEnd, spans);
+		} else if (ditherAlpha) {
+			DitherAlphaBand(pixels, image, bandStart, bandEnd, threadPool);
 		}
+
+		tilesDone += tileCount;
+	}
+	for (const std::array<size_t, 2>& counts : cacheCounts) Metrics::AddCache(counts[0], counts[1]);
+	if (spans) Log::WriteOneLine("  Transparent pixels skipped: " + Log::ToString(spans->GetCount()));
+
+	return true;
+}
+
+void Dither::FloydDither(Image& image, const Palette& palette, ConvertedImage* converted) {
+	MemoryRows rows(image);
+	if (m_useFloat) {
+		FloydDitherBuffer<float>(rows, palette, converted);
+	} else {
+		FloydDitherBuffer<double>(rows, palette, converted);
 	}
 }
 
-void Dither::FloydDither(Image& image, const Palette& palette) {
-	const int imgWidth = image.GetWidth();
-	const int imgHeight = image.GetHeight();
+bool Dither::FloydDither(ImageRows& rows, const Palette& palette) {
+	return m_useFloat ? FloydDitherBuffer<float>(rows, palette, nullptr) : FloydDitherBuffer<double>(rows, palette, nullptr);
+}
 
-	Threshold alphaThreshold;
-	alphaThreshold.GenerateThreshold(m_matrixType);
+template<typename T>
+bool Dither::FloydDitherBuffer(ImageRows& rows, const Palette& palette, ConvertedImage* converted) {
+	const int imgWidth = rows.GetWidth();
+	const int imgHeight = rows.GetHeight();
+	const int bandHeight = rows.GetBandHeight();
 
-	// Create a copy of of image in Colour form
-	const size_t coloursSize = (size_t)image.GetHeight() * image.GetWidth();
-	std::vector<Colour> colours;
-	colours.reserve(coloursSize);
+	uint32_t* const indices = StartIndices(rows);
+	AlphaSpans* const spans = StartSpans(rows);
 
 	Log::StartTime();
 	Log::WriteOneLine("FLOYD STEINBERG DITHERING...");
 
 	double imgMinL = -1., imgMaxL = -1.;
 
+	const bool normalise = m_normaliseCol && m_mono;
+
+	// Error is diffused in mathMode so the copy keeps those channels - OkLab_Lightness still needs a & b
+	// A band and the row after it are stored so error carries over to the next band
+	const Colour::MathMode bufferMode = ToColourMathMode(m_mathMode) == Colour::MathMode::OkLab_Lightness ?
+		Colour::MathMode::OkLab : ToColourMathMode(m_mathMode);
+	// The image converted once for every profile dithering it is copied - error is written into the copy
+	PixelBuffer<T> pixels;
+	{
+		Metrics::Timer timer(Metrics::Stage::Colour);
+		if (converted && !m_mono) {
+			pixels = converted->GetPixels<T>(bufferMode);
+		} else {
+			pixels.Resize(imgWidth, imgHeight, bufferMode, std::min(bandHeight + 1, imgHeight));
+		}
+	}
+
 	SetColourMathMode(m_distanceMode);
 
-	Log::WriteOneLine("  Copying Pixels");
-	for (int y = 0; y < imgHeight; ++y) {
-		for (int x = 0; x < imgWidth; ++x) {
-			const size_t index = image.GetIndex(x, y);
-			//Colour pixel = GetColourFromImage(image, x, y);
-			colours.emplace_back(GetColourFromImage(image, x, y));
-			if (m_mono) colours.back().ToGrayscale();
+	if (normalise) {
+		// Lightness range of image
+		const Colour::MathMode distanceMode = Colour::GetMathMode();
 
-			// -- Check Time --
-			if (Log::CheckTimeSeconds(5.)) {
-				const std::string maxStr = Log::ToString(2 * imgHeight * imgWidth);
-				const std::string currStr = Log::ToString(x + y * imgWidth, static_cast<unsigned int>(maxStr.size()), ' ');
+		Metrics::Timer timer(Metrics::Stage::Colour);
+		const bool success = rows.ForEachRow([&](const Image& image, const int imageY) {
+			Colour::SetMathMode(distanceMode);
 
-				Log::WriteOneLine("    " + currStr + " / " + maxStr);
+			for (int x = 0; x < imgWidth; ++x) {
+				Colour col = GetColourFromImage(image, x, imageY);
+				col.ToGrayscale();
 
-				Log::StartTime();
+				const double colL = col.MonoGetLightness();
+				if (imgMinL < 0 && imgMaxL < 0) {
+					imgMinL = colL;
+					imgMaxL = colL;
+					continue;
+				}
+				if (colL < imgMinL) imgMinL = colL;
+				if (colL > imgMaxL) imgMaxL = colL;
 			}
+		});
+		if (!success) return false;
+	}
+
+	SetColourMathMode(m_mathMode);
+	const double palMinL = palette.front().MonoGetLightness();
+	const double palMaxL = palette.back().MonoGetLightness();
+
+	const Colour::MathMode distanceMode = ToColourMathMode(m_distanceMode);
+	const Colour::MathMode mathMode = ToColourMathMode(m_mathMode);
+
+	Metrics::Timer paletteTimer(Metrics::Stage::Palette);
+
+	// Shared colours are read by every row - convert them now instead of lazily
+	palette.ConvertAll();
+	Colour::White.ConvertAll();
+	// Everything a row needs - the mode switches are picked once here instead of for every pixel
+	FloydState<T> state;
+	state.dither = this;
+	state.palette = &palette;
+	state.paletteBytes = palette.GetBytes().data();
+	state.spans = spans;
+	state.distanceMode = distanceMode;
+	state.mathMode = mathMode;
+	state.palMinL = palMinL;
+	state.palMaxL = palMaxL;
+
+	if (!m_mono) {
+		state.tree = &palette.GetTree(distanceMode);
+
+		state.paletteMath.resize(palette.size());
+		for (size_t i = 0; i < palette.size(); ++i) {
+			const Colour& col = palette.GetColour(i);
+
+			if (mathMode == Colour::MathMode::sRGB) {
+				const Colour::sRGB v = col.GetsRGB();
+				state.paletteMath[i] = { static_cast<T>(v.r), static_cast<T>(v.g), static_cast<T>(v.b) };
+			} else if (mathMode == Colour::MathMode::Linear_RGB) {
+				const Colour::LRGB v = col.GetLRGB();
+				state.paletteMath[i] = { static_cast<T>(v.r), static_cast<T>(v.g), static_cast<T>(v.b) };
+			} else {
+				const Colour::OkLab v = col.GetOkLab();
+				state.paletteMath[i] = { static_cast<T>(v.l), static_cast<T>(v.a), static_cast<T>(v.b) };
+			}
+		}
+	}
+
+	paletteTimer.Stop();
+
+	const FloydRowFunc<T> floydRow = GetFloydRow<T>();
+	const bool ditherAlpha = rows.HasAlphaChannel() && m_ditherAlpha;
+
+	ThreadPool threadPool(m_threads);
+
+	// Pixels finished in each row of a band - rows run at the same time with each row kept behind the row above it
+	std::vector<std::atomic<int>> rowProgress(static_cast<size_t>(bandHeight));
+
+	Log::WriteOneLine("  Copying Pixels");
 
-			const double colL = colours.back().MonoGetLightness();
-			if (imgMinL < 0 && imgMaxL < 0) {
-				imgMinL = colL;
-				imgMaxL = colL;
+	int copiedEnd = 0;
+	for (int bandStart = 0; bandStart < imgHeight; bandStart += bandHeight) {
+		const int bandEnd = std::min(bandStart + bandHeight, imgHeight);
+
+		// Error reaches the row after the band
+		const int loadEnd = std::min(bandEnd + 1, imgHeight);
+		{
+			Metrics::Timer timer(Metrics::Stage::Stream);
+			if (!rows.Load(bandStart, loadEnd)) return false;
+		}
+
+		Image& image = rows.GetImage();
+		pixels.MoveWindow(bandStart);
+
+		Metrics::Timer colourTimer(Metrics::Stage::Colour);
+		Colour::SetMathMode(distanceMode);
+
+		for (int y = copiedEnd; y < loadEnd; ++y) {
+			const int imageY = y - bandStart;
+			if (spans) spans->SetRow(image, imageY, y);
+
+			if (!m_mono) {
+				if (!converted) pixels.SetRow(image, imageY, y);
 				continue;
 			}
-			if (colL < imgMinL) imgMinL = colL;
-			if (colL > imgMaxL) imgMaxL = colL;
+
+			for (int x = 0; x < imgWidth; ++x) {
+				Colour col = GetColourFromImage(image, x, imageY);
+				col.ToGrayscale();
+
+				if (normalise) {
+					const double alpha = col.GetAlpha();
+					col = Colour::White * ((col.MonoGetLightness() - imgMinL) / (imgMaxL - imgMinL));
+					col.SetAlpha(alpha);
+				}
+
+				pixels.SetColour(pixels.GetIndex(x, y), col);
+
+				// -- Check Time --
+				if (Log::CheckTimeSeconds(5.)) {
+					const std::string maxStr = Log::ToString(imgHeight * imgWidth);
+					const std::string currStr = Log::ToString(x + y * imgWidth, static_cast<unsigned int>(maxStr.size()), ' ');
+
+					Log::WriteOneLine("    " + currStr + " / " + maxStr);
+
+					Log::StartTime();
+				}
+			}
+		}
+		copiedEnd = loadEnd;
+		Colour::SetMathMode(mathMode);
+		colourTimer.Stop();
+
+		for (std::atomic<int>& progress : rowProgress) progress.store(0, std::memory_order_relaxed);
+
+		// Dither
+		if (bandStart == 0) {
+			Log::WriteOneLine("  Dithering");
+			Log::StartTime();
+		}
+		state.pixels = &pixels;
+		state.image = &image;
+		state.indices = indices ? indices + static_cast<size_t>(bandStart) * static_cast<size_t>(imgWidth) : nullptr;
+
+		Metrics::Timer ditherTimer(Metrics::Stage::Dither);
+		threadPool.ParallelFor(static_cast<size_t>(bandEnd - bandStart), [&](const size_t row, const unsigned int thread) {
+			const int y = bandStart + static_cast<int>(row);
+
+			// The row above the band was finished with the last band
+			const std::atomic<int>* above = row > 0 ? &rowProgress[row - 1] : nullptr;
+
+			floydRow(state, y, static_cast<int>(row), above, rowProgress[row]);
+
+			// Only the calling thread reports progress so the lines stay with this image
+			if (thread == 0) Log::DebugProgress(double(y), double(imgHeight), 5.);
+		});
+		ditherTimer.Stop();
+
+		if (ditherAlpha && m_fsAlpha) {
+			DiffuseAlphaBand(pixels, image, bandStart, bandEnd, spans);
+		} else if (ditherAlpha) {
+			DitherAlphaBand(pixels, image, bandStart, bandEnd, threadPool);
 		}
 	}
+	if (spans) Log::WriteOneLine("  Transparent pixels skipped: " + Log::ToString(spans->GetCount()));
+
+	return true;
+}
+
+template<Colour::MathMode Mode>
+static constexpr bool IsOkLabMode() {
+	return Mode == Colour::MathMode::OkLab || Mode == Colour::MathMode::OkLab_Lightness;
+}
+
+// Float versions of Colour's conversions for the float buffers - double buffers go through Colour so they keep its exact values
+
+static inline float sRGBChannelToLRGB(const float v) {
+	constexpr float Y = 2.4125093745073549f;
+	constexpr float C = 0.056317370387926696f;
+	constexpr float A = 12.920750283132739f;
+	constexpr float X = 0.039870440086508217f;
+	return v <= X ? v / A : std::pow((v + C) / (C + 1.f), Y);
+}
+
+static inline float LRGBChannelTosRGB(const float v) {
+	constexpr float Y = 2.4125093745073549f;
+	constexpr float C = 0.056317370387926696f;
+	constexpr float A = 12.920750283132739f;
+	constexpr float X = 0.0030857681800844569f;
+	if (v <= X) return A * v;
+
+	// Same as Maths::NRoot for a root that isn't a whole number
+	return std::pow(v, 1.f / Y) * (C + 1.f) - C;
+}
+
+static inline std::array<float, 3> LRGBToOkLab(const std::array<float, 3>& col) {
+	// grayscale - same shortcut as Colour
+	if (col[0] == col[1] && col[0] == col[2]) return { std::cbrt(col[0]), 0.f, 0.f };
+
+	const float l = std::cbrt(0.4122214708f * col[0] + 0.5363325363f * col[1] + 0.0514459929f * col[2]);
+	const float m = std::cbrt(0.2119034982f * col[0] + 0.6806995451f * col[1] + 0.1073969566f * col[2]);
+	const float s = std::cbrt(0.0883024619f * col[0] + 0.2817188376f * col[1] + 0.6299787005f * col[2]);
+
+	return {
+		0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+		1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+		0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s
+	};
+}
+
+static inline std::array<float, 3> OkLabToLRGB(const std::array<float, 3>& col) {
+	if (col[1] == 0.f && col[2] == 0.f) {
+		const float v = col[0] * col[0] * col[0];
+		return { v, v, v };
+	}
+
+	float l = col[0] + 0.3963377774f * col[1] + 0.2158037573f * col[2];
+	float m = col[0] - 0.1055613458f * col[1] - 0.0638541728f * col[2];
+	float s = col[0] - 0.0894841775f * col[1] - 1.2914855480f * col[2];
+
+	l = l * l * l;
+	m = m * m * m;
+	s = s * s * s;
 
-	if (m_normaliseCol && m_mono) {
-		for (size_t i = 0; i < colours.size(); ++i) {
-			const double alpha = colours[i].GetAlpha();
-			colours[i] = Colour::White * ((colours[i].MonoGetLightness() - imgMinL) / (imgMaxL - imgMinL));
-			colours[i].SetAlpha(alpha);
+	return {
+		+4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s,
+		-1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s,
+		-0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s
+	};
+}
+
+/// <summary>
+/// Buffer channels in Math's colour space to a point in Distance's - same values as PaletteTree gets from a Colour
+/// </summary>
+template<typename T, Colour::MathMode Distance, Colour::MathMode Math>
+static inline PaletteTree::Point ToDistancePoint(const std::array<T, 3>& col) {
+	if constexpr (Distance == Colour::MathMode::OkLab_Lightness && IsOkLabMode<Math>()) {
+		return { col[0], 0., 0. };
+	} else if constexpr (Distance == Math || (IsOkLabMode<Distance>() && IsOkLabMode<Math>())) {
+		return { col[0], col[1], col[2] };
+	} else if constexpr (std::is_same_v<T, float>) {
+		// Every space goes through Linear RGB like Colour
+		std::array<float, 3> lrgb = col;
+		if constexpr (Math == Colour::MathMode::sRGB) {
+			for (float& v : lrgb) v = sRGBChannelToLRGB(v);
+		} else if constexpr (IsOkLabMode<Math>()) {
+			lrgb = OkLabToLRGB(col);
+		}
+
+		if constexpr (Distance == Colour::MathMode::sRGB) {
+			return { LRGBChannelTosRGB(lrgb[0]), LRGBChannelTosRGB(lrgb[1]), LRGBChannelTosRGB(lrgb[2]) };
+		} else if constexpr (Distance == Colour::MathMode::Linear_RGB) {
+			return { lrgb[0], lrgb[1], lrgb[2] };
+		} else if constexpr (Distance == Colour::MathMode::OkLab_Lightness) {
+			return { LRGBToOkLab(lrgb)[0], 0., 0. };
+		} else {
+			const std::array<float, 3> lab = LRGBToOkLab(lrgb);
+			return { lab[0], lab[1], lab[2] };
+		}
+	} else {
+		// Different colour spaces go through Colour's conversions
+		Colour c;
+		if constexpr (Math == Colour::MathMode::sRGB) {
+			c.SetsRGB_D(col[0], col[1], col[2]);
+		} else if constexpr (Math == Colour::MathMode::Linear_RGB) {
+			c.SetLRGB(col[0], col[1], col[2]);
+		} else {
+			c.SetOkLab(col[0], col[1], col[2]);
+		}
+
+		if constexpr (Distance == Colour::MathMode::sRGB) {
+			const Colour::sRGB v = c.GetsRGB();
+			return { v.r, v.g, v.b };
+		} else if constexpr (Distance == Colour::MathMode::Linear_RGB) {
+			const Colour::LRGB v = c.GetLRGB();
+			return { v.r, v.g, v.b };
+		} else if constexpr (Distance == Colour::MathMode::OkLab_Lightness) {
+			return { c.GetOkLab().l, 0., 0. };
+		} else {
+			const Colour::OkLab v = c.GetOkLab();
+			return { v.l, v.a, v.b };
 		}
 	}
+}
 
-	SetColourMathMode(m_mathMode);
-	const double palMinL = palette.front().MonoGetLightness();
-	const double palMaxL = palette.back().MonoGetLightness();
+/// <summary>
+/// Same as Dither::DiffuseError for a buffer in Math's channels
+/// </summary>
+template<typename T, Colour::MathMode Math>
+static inline void DiffuseErrorAt(PixelBuffer<T>& pixels, const size_t index, const std::array<T, 3>& quantError, const T factor) {
+	T* c0 = pixels.GetChannel(0) + index;
+	T* c1 = pixels.GetChannel(1) + index;
+	T* c2 = pixels.GetChannel(2) + index;
+
+	if constexpr (IsOkLabMode<Math>()) {
+		// Lightness maths leaves a & b alone
+		const T l = *c0 + quantError[0] * factor;
+		const T a = Math == Colour::MathMode::OkLab ? *c1 + quantError[1] * factor : *c1;
+		const T b = Math == Colour::MathMode::OkLab ? *c2 + quantError[2] * factor : *c2;
+
+		// Out of gamut colours are pulled back by Colour
+		Colour col;
+		col.SetOkLab(l, a, b);
+		col.SetAlpha(pixels.GetAlpha(index));
+		col.Clamp(Colour::MathMode::OkLab);
+
+		const Colour::OkLab v = col.GetOkLab();
+		*c0 = static_cast<T>(v.l);
+		*c1 = static_cast<T>(v.a);
+		*c2 = static_cast<T>(v.b);
+	} else {
+		T r = *c0 + quantError[0] * factor;
+		T g = *c1 + quantError[1] * factor;
+		T b = *c2 + quantError[2] * factor;
 
-	// Dither
-	Log::WriteOneLine("  Dithering");
-	for (int y = 0; y < imgHeight; ++y) {
-		for (int x = 0; x < imgWidth; ++x) {
-			const size_t indexCol = size_t(x + y * imgWidth);
-			const size_t index = image.GetIndex(x, y);
+		r = r > T(1) ? T(1) : r;
+		r = r < T(0) ? T(0) : r;
 
-			// Can't use memoisation for Floyd-Steinberg Dithering as the error diffusion means
-			// that the same colour can end up being different colours when it is reached again
+		g = g > T(1) ? T(1) : g;
+		g = g < T(0) ? T(0) : g;
 
-			Colour oldPixel = colours[indexCol];
-			const double alpha = oldPixel.GetAlpha();
+		b = b > T(1) ? T(1) : b;
+		b = b < T(0) ? T(0) : b;
 
-			SetColourMathMode(m_distanceMode);
-			Colour newPixel = ClosestColour(oldPixel, palette, 0, 1);
-			newPixel.SetAlpha(alpha);
-			if (image.HasAlphaChannel() && m_ditherAlpha) DitherAlpha(newPixel, colours, x, y, imgWidth, imgHeight, alphaThreshold);
+		*c0 = r;
+		*c1 = g;
+		*c2 = b;
+	}
+}
 
-			SetColourToImage(newPixel, image, x, y);
+template<typename T, Colour::MathMode Distance, Colour::MathMode Math>
+void Dither::FloydRow(const FloydState<T>& state, const int y, const int imageY, const std::atomic<int>* above, std::atomic<int>& progress) {
+	PixelBuffer<T>& pixels = *state.pixels;
+	const int imgWidth = pixels.GetWidth();
+	const int imgHeight = pixels.GetHeight();
 
-			SetColourMathMode(m_mathMode);
+	// Palette indices are written to the image once the row is done
+	const size_t w = static_cast<size_t>(imgWidth);
+	thread_local std::vector<uint32_t> rowIndices;
+	thread_local std::vector<uint8_t> rowAlpha;
+	rowIndices.resize(w);
+	rowAlpha.resize(w);
 
-			Colour quantError = oldPixel - newPixel;
+	AlphaSpans::Cursor transparent(state.spans ? &state.spans->GetRow(y) : nullptr);
 
-			if (m_mono) {
-				//double oldPixelVal = (oldPixel.MonoGetLightness() - palMinL) / (palMaxL - palMinL);
-				double newPixelVal = newPixel.MonoGetLightness();
-				newPixelVal = (newPixelVal - palMinL) / (palMaxL - palMinL);
-				quantError = Colour::White * (oldPixel.MonoGetLightness() - newPixelVal);
-			}
+	for (int x = 0; x < imgWidth; ++x) {
+		// Fully transparent runs take no error and give none so they don't wait for the row above
+		const int transparentEnd = transparent.Skip(x);
+		if (transparentEnd > x) {
+			std::fill(rowIndices.begin() + x, rowIndices.begin() + transparentEnd, 0u);
+			std::fill(rowAlpha.begin() + x, rowAlpha.begin() + transparentEnd, static_cast<uint8_t>(0));
+
+			x = transparentEnd - 1;
+			progress.store(transparentEnd, std::memory_order_release);
+			continue;
+		}
 
-			size_t neighbourIndex = 0;
+		// (x + 1, y) gets error from (x, y - 1) to (x + 2, y - 1) - wait for all of them so
+		// every pixel adds its error in the same order as a serial scan
+		if (above) {
+			const int needed = std::min(x + 3, imgWidth);
+			while (above->load(std::memory_order_acquire) < needed) std::this_thread::yield();
+		}
 
-			if (x + 1 < imgWidth) {
-				neighbourIndex = size_t((x + 1) + y * imgWidth);
-				colours[neighbourIndex] = colours[neighbourIndex] + (quantError * (7. / 16.));
-				colours[neighbourIndex].Clamp();
-				colours[neighbourIndex].Update();
-			}
+		const size_t indexCol = pixels.GetIndex(x, y);
+		const std::array<T, 3> oldPixel = { pixels.GetChannel(0)[indexCol], pixels.GetChannel(1)[indexCol], pixels.GetChannel(2)[indexCol] };
 
-			if (y + 1 < imgHeight) {
-				if (x - 1 >= 0) {
-					neighbourIndex = size_t((x - 1) + (y + 1) * imgWidth);
-					colours[neighbourIndex] = colours[neighbourIndex] + (quantError * (3. / 16.));
-					colours[neighbourIndex].Clamp();
-					colours[neighbourIndex].Update();
-				}
-				if (x + 1 < imgWidth) {
-					neighbourIndex = size_t((x + 1) + (y + 1) * imgWidth);
-					colours[neighbourIndex] = colours[neighbourIndex] + (quantError * (1. / 16.));
-					colours[neighbourIndex].Clamp();
-					colours[neighbourIndex].Update();
-				}
+		const size_t nearest = state.tree->Nearest(ToDistancePoint<T, Distance, Math>(oldPixel));
 
-				neighbourIndex = size_t(x + (y + 1) * imgWidth);
-				colours[neighbourIndex] = colours[neighbourIndex] + (quantError * (5. / 16.));
-				colours[neighbourIndex].Clamp();
-				colours[neighbourIndex].Update();
-			}
+		rowIndices[x] = static_cast<uint32_t>(nearest);
+		rowAlpha[x] = ToAlphaByte(pixels.GetAlpha(indexCol));
 
-			// -- Check Time --
-			if (Log::CheckTimeSeconds(5.)) {
-				const std::string maxStr = Log::ToString(2 * imgHeight * imgWidth);
-				const std::string currStr = Log::ToString(x + y * imgWidth, static_cast<unsigned int>(maxStr.size()), ' ');
+		const std::array<T, 3>& newMath = state.paletteMath[nearest];
+		const std::array<T, 3> quantError = { oldPixel[0] - newMath[0], oldPixel[1] - newMath[1], oldPixel[2] - newMath[2] };
 
-				Log::WriteOneLine("    " + currStr + " / " + maxStr);
+		if (x + 1 < imgWidth) DiffuseErrorAt<T, Math>(pixels, pixels.GetIndex(x + 1, y), quantError, T(7. / 16.));
 
-				Log::StartTime();
-			}
+		if (y + 1 < imgHeight) {
+			if (x - 1 >= 0) DiffuseErrorAt<T, Math>(pixels, pixels.GetIndex(x - 1, y + 1), quantError, T(3. / 16.));
+			if (x + 1 < imgWidth) DiffuseErrorAt<T, Math>(pixels, pixels.GetIndex(x + 1, y + 1), quantError, T(1. / 16.));
+
+			DiffuseErrorAt<T, Math>(pixels, pixels.GetIndex(x, y + 1), quantError, T(5. / 16.));
 		}
+
+		progress.store(x + 1, std::memory_order_release);
 	}
+
+	DitherKernel::WriteRow(*state.image, 0, imageY, rowIndices.data(), rowAlpha.data(), state.paletteBytes, state.paletteBytes, w);
+	if (state.indices) std::copy(rowIndices.begin(), rowIndices.end(), state.indices + static_cast<size_t>(imageY) * w);
 }
 
-void Dither::NoDither(Image& image, const Palette& palette) {
-	const int imgWidth = image.GetWidth();
-	const int imgHeight = image.GetHeight();
+template<typename T>
+void Dither::FloydRowMono(const FloydState<T>& state, const int y, const int imageY, const std::atomic<int>* above, std::atomic<int>& progress) {
+	PixelBuffer<T>& pixels = *state.pixels;
+	const int imgWidth = pixels.GetWidth();
+	const int imgHeight = pixels.GetHeight();
+
+	// Same as FloydRow - pixels without a palette colour keep their own colour and are written after the row
+	const size_t w = static_cast<size_t>(imgWidth);
+	thread_local std::vector<uint32_t> rowIndices;
+	thread_local std::vector<uint8_t> rowAlpha;
+	thread_local std::vector<std::pair<int, Colour>> ownColours;
+	rowIndices.resize(w);
+	rowAlpha.resize(w);
+	ownColours.clear();
+
+	AlphaSpans::Cursor transparent(state.spans ? &state.spans->GetRow(y) : nullptr);
+
+	for (int x = 0; x < imgWidth; ++x) {
+		// Same as FloydRow
+		const int transparentEnd = transparent.Skip(x);
+		if (transparentEnd > x) {
+			std::fill(rowIndices.begin() + x, rowIndices.begin() + transparentEnd, 0u);
+			std::fill(rowAlpha.begin() + x, rowAlpha.begin() + transparentEnd, static_cast<uint8_t>(0));
+
+			x = transparentEnd - 1;
+			progress.store(transparentEnd, std::memory_order_release);
+			continue;
+		}
+
+		// Same wait as FloydRow
+		if (above) {
+			const int needed = std::min(x + 3, imgWidth);
+			while (above->load(std::memory_order_acquire) < needed) std::this_thread::yield();
+		}
 
-	Threshold alphaThreshold;
-	alphaThreshold.GenerateThreshold(m_matrixType);
+		const size_t indexCol = pixels.GetIndex(x, y);
 
-	std::map<Colour, Colour> noDitherMem;
+		// Can't use memoisation for Floyd-Steinberg Dithering as the error diffusion means
+		// that the same colour can end up being different colours when it is reached again
 
-	// Create a copy of of image in Colour form
-	const size_t coloursSize = (size_t)image.GetHeight() * image.GetWidth();
-	std::vector<Colour> colours;
-	colours.reserve(coloursSize);
+		Colour oldPixel = pixels.GetColour(indexCol);
+		const double alpha = oldPixel.GetAlpha();
+
+		Colour::SetMathMode(state.distanceMode);
+		const uint32_t index = state.dither->ClosestIndex(oldPixel, *state.palette, 0, 1);
+
+		rowIndices[x] = index;
+		rowAlpha[x] = ToAlphaByte(alpha);
+
+		// Same as ClosestColour - no palette colour keeps the pixel's own colour
+		Colour newPixel = index == DitherCache::NoColour ? oldPixel : state.palette->GetColour(index);
+		newPixel.SetAlpha(alpha);
+
+		if (index == DitherCache::NoColour) ownColours.emplace_back(x, newPixel);
+
+		Colour::SetMathMode(state.mathMode);
+
+		//double oldPixelVal = (oldPixel.MonoGetLightness() - palMinL) / (palMaxL - palMinL);
+		double newPixelVal = newPixel.MonoGetLightness();
+		newPixelVal = (newPixelVal - state.palMinL) / (state.palMaxL - state.palMinL);
+		const Colour quantError = Colour::White * (oldPixel.MonoGetLightness() - newPixelVal);
+
+		if (x + 1 < imgWidth) DiffuseError(pixels, pixels.GetIndex(x + 1, y), quantError, 7. / 16.);
+
+		if (y + 1 < imgHeight) {
+			if (x - 1 >= 0) DiffuseError(pixels, pixels.GetIndex(x - 1, y + 1), quantError, 3. / 16.);
+			if (x + 1 < imgWidth) DiffuseError(pixels, pixels.GetIndex(x + 1, y + 1), quantError, 1. / 16.);
+
+			DiffuseError(pixels, pixels.GetIndex(x, y + 1), quantError, 5. / 16.);
+		}
+
+		progress.store(x + 1, std::memory_order_release);
+	}
+
+	DitherKernel::WriteRow(*state.image, 0, imageY, rowIndices.data(), rowAlpha.data(), state.paletteBytes, state.paletteBytes, w);
+	for (const std::pair<int, Colour>& own : ownColours) SetColourToImage(own.second, *state.image, own.first, imageY);
+
+	if (state.indices) std::copy(rowIndices.begin(), rowIndices.end(), state.indices + static_cast<size_t>(imageY) * w);
+}
+
+template<typename T, Colour::MathMode Distance>
+Dither::FloydRowFunc<T> Dither::GetFloydRow(const Colour::MathMode mathMode) {
+	switch (mathMode) {
+	case Colour::MathMode::sRGB:
+		return &FloydRow<T, Distance, Colour::MathMode::sRGB>;
+	case Colour::MathMode::Linear_RGB:
+		return &FloydRow<T, Distance, Colour::MathMode::Linear_RGB>;
+	case Colour::MathMode::OkLab_Lightness:
+		return &FloydRow<T, Distance, Colour::MathMode::OkLab_Lightness>;
+	default:
+		return &FloydRow<T, Distance, Colour::MathMode::OkLab>;
+	}
+}
+
+template<typename T>
+Dither::FloydRowFunc<T> Dither::GetFloydRow() const {
+	if (m_mono) return &FloydRowMono<T>;
+
+	switch (ToColourMathMode(m_distanceMode)) {
+	case Colour::MathMode::sRGB:
+		return GetFloydRow<T, Colour::MathMode::sRGB>(ToColourMathMode(m_mathMode));
+	case Colour::MathMode::Linear_RGB:
+		return GetFloydRow<T, Colour::MathMode::Linear_RGB>(ToColourMathMode(m_mathMode));
+	case Colour::MathMode::OkLab_Lightness:
+		return GetFloydRow<T, Colour::MathMode::OkLab_Lightness>(ToColourMathMode(m_mathMode));
+	default:
+		return GetFloydRow<T, Colour::MathMode::OkLab>(ToColourMathMode(m_mathMode));
+	}
+}
+
+void Dither::NoDither(Image& image, const Palette& palette, ConvertedImage* converted) {
+	MemoryRows rows(image);
+	if (m_useFloat) {
+		NoDitherBuffer<float>(rows, palette, converted);
+	} else {
+		NoDitherBuffer<double>(rows, palette, converted);
+	}
+}
+
+bool Dither::NoDither(ImageRows& rows, const Palette& palette) {
+	return m_useFloat ? NoDitherBuffer<float>(rows, palette, nullptr) : NoDitherBuffer<double>(rows, palette, nullptr);
+}
+
+template<typename T>
+bool Dither::NoDitherBuffer(ImageRows& rows, const Palette& palette, ConvertedImage* converted) {
+	const int imgWidth = rows.GetWidth();
+	const int imgHeight = rows.GetHeight();
+	const int bandHeight = rows.GetBandHeight();
+
+	uint32_t* const indices = StartIndices(rows);
+	AlphaSpans* const spans = StartSpans(rows);
+
+	// Rows of each band are split between threads - Floyd-Steinberg alpha is done after on this thread
+	const bool ditherAlpha = rows.HasAlphaChannel() && m_ditherAlpha;
+	ThreadPool threadPool(m_threads);
+
+	// The image converted once for every profile dithering it is read in place - copied when Floyd-Steinberg alpha error is written into it
+	// Otherwise a copy of of image in the distance mode's channels - a band and the row after it at a time
+	PixelBuffer<T> ownPixels;
+	const PixelBuffer<T>* sharedPixels = nullptr;
+	{
+		Metrics::Timer timer(Metrics::Stage::Colour);
+		const Colour::MathMode bufferMode = ToColourMathMode(m_distanceMode);
+		const bool useConverted = converted && !m_mono;
+		if (useConverted && !(ditherAlpha && m_fsAlpha)) {
+			sharedPixels = &converted->GetPixels<T>(bufferMode);
+		} else if (useConverted) {
+			ownPixels = converted->GetPixels<T>(bufferMode);
+		} else {
+			ownPixels.Resize(imgWidth, imgHeight, bufferMode, std::min(bandHeight + 1, imgHeight));
+		}
+	}
+	const PixelBuffer<T>& pixels = sharedPixels ? *sharedPixels : ownPixels;
 
 	Log::StartTime();
 	Log::WriteOneLine("NO DITHER...");
 
 	double minL = -1, maxL = -1;
 
+	// The lightness range uses the MathMode set before dithering
+	const Colour::MathMode rangeMode = Colour::GetMathMode();
+
+	const auto addRange = [&](const Colour& col) {
+		const double currL = col.MonoGetLightness();
+		if (minL < 0 && maxL < 0) {
+			minL = currL;
+			maxL = currL;
+			return;
+		}
+		if (currL < minL) minL = currL;
+		if (currL > maxL) maxL = currL;
+	};
+
+	// Normalised mono needs the lightness range of every row before the first band
+	const bool rangePass = bandHeight < imgHeight;
+	if (rangePass && m_mono) {
+		Metrics::Timer timer(Metrics::Stage::Colour);
+		const bool success = rows.ForEachRow([&](const Image& image, const int imageY) {
+			Colour::SetMathMode(rangeMode);
+			for (int x = 0; x < imgWidth; ++x) addRange(GetColourFromImage(image, x, imageY));
+		});
+		if (!success) return false;
+	}
+
+	Metrics::Timer paletteTimer(Metrics::Stage::Palette);
+
+	// Palette colours are read by every thread - convert them now instead of lazily
+	palette.ConvertAll();
+	if (!m_mono) palette.GetTree(ToColourMathMode(m_distanceMode));
+
+	// Every colour is already in the table - mono only looks at lightness so doesn't need it
+	const bool useLUT = m_useLUT && !m_mono &&
+		m_noDitherLUT->Prepare(palette, ToColourMathMode(m_distanceMode), PaletteLUT::Type::Nearest, std::is_same_v<T, float>, m_lutDirectory, m_threads);
+
+	// 8 bit colours written for each palette index
+	const std::vector<uint8_t>& paletteBytes = palette.GetBytes();
+	const size_t w = static_cast<size_t>(imgWidth);
+
+	// One memo per thread - a colour gives the same result on every thread so the output matches a serial run
+	// Kept between images with the same palette and settings
+	if (m_noDitherCaches.size() < threadPool.GetThreadCount()) m_noDitherCaches.resize(threadPool.GetThreadCount());
+
+	// Memo hits and misses of each thread - added to Metrics by this thread
+	std::vector<std::array<size_t, 2>> cacheCounts(threadPool.GetThreadCount(), { 0, 0 });
+
+	paletteTimer.Stop();
+
 	Log::WriteOneLine("  Copying Pixels");
-	for (int y = 0; y < imgHeight; ++y) {
-		for (int x = 0; x < imgWidth; ++x) {
-			const size_t index = image.GetIndex(x, y);
-			//Colour pixel = GetColourFromImage(image, x, y);
-			colours.emplace_back(GetColourFromImage(image, x, y));
 
-			// -- Check Time --
-			if (Log::CheckTimeSeconds(5.)) {
-				const std::string maxStr = Log::ToString(2 * imgHeight * imgWidth);
-				const std::string currStr = Log::ToString(x + y * imgWidth, static_cast<unsigned int>(maxStr.size()), ' ');
+	int copiedEnd = 0;
+	for (int bandStart = 0; bandStart < imgHeight; bandStart += bandHeight) {
+		const int bandEnd = std::min(bandStart + bandHeight, imgHeight);
+
+		// Floyd-Steinberg alpha error reaches the row after the band
+		const int loadEnd = std::min(bandEnd + 1, imgHeight);
+		{
+			Metrics::Timer timer(Metrics::Stage::Stream);
+			if (!rows.Load(bandStart, loadEnd)) return false;
+		}
 
-				Log::WriteOneLine("    " + currStr + " / " + maxStr);
+		Image& image = rows.GetImage();
+		ownPixels.MoveWindow(bandStart);
 
-				Log::StartTime();
+		Metrics::Timer colourTimer(Metrics::Stage::Colour);
+		Colour::SetMathMode(rangeMode);
+
+		for (int y = copiedEnd; y < loadEnd; ++y) {
+			const int imageY = y - bandStart;
+			if (spans) spans->SetRow(image, imageY, y);
+
+			if (!m_mono) {
+				if (!converted) ownPixels.SetRow(image, imageY, y);
+				continue;
 			}
 
-			if (m_mono) {
-				const double currL = colours.back().MonoGetLightness();
-				if (minL < 0 && maxL < 0) {
-					minL = currL;
-					maxL = currL;
-					continue;
+			for (int x = 0; x < imgWidth; ++x) {
+				const Colour col = GetColourFromImage(image, x, imageY);
+				ownPixels.SetColour(ownPixels.GetIndex(x, y), col);
+
+				// -- Check Time --
+				if (Log::CheckTimeSeconds(5.)) {
+					const std::string maxStr = Log::ToString(imgHeight * imgWidth);
+					const std::string currStr = Log::ToString(x + y * imgWidth, static_cast<unsigned int>(maxStr.size()), ' ');
+
+					Log::WriteOneLine("    " + currStr + " / " + maxStr);
+
+					Log::StartTime();
 				}
-				if (currL < minL) minL = currL;
-				if (currL > maxL) maxL = currL;
+
+				if (!rangePass) addRange(col);
 			}
 		}
-	}
+		copiedEnd = loadEnd;
+		colourTimer.Stop();
 
-	Log::WriteOneLine("  Quantising");
-	for (int x = 0; x < imgWidth; ++x) {
-		for (int y = 0; y < imgHeight; ++y) {
-			const size_t indexCol = size_t(x + y * imgWidth);
-			const size_t index = image.GetIndex(x, y);
+		SetColourMathMode(m_distanceMode);
 
-			Colour ogPixel = colours[indexCol];
-			const double alpha = ogPixel.GetAlpha();
-			ogPixel.SetAlpha(1.);
+		// MathMode is per thread - workers copy the calling thread's
+		const Colour::MathMode distanceMode = Colour::GetMathMode();
 
-			Colour pixel = ogPixel;
+		// Memoisation to speed up process when there are many repeated colours in the image
+		if (bandStart == 0) {
+			Metrics::Timer timer(Metrics::Stage::Palette);
 
-			// Memoisation to speed up process when there are many repeated colours in the image
-			if (noDitherMem.find(ogPixel) != noDitherMem.end()) {
-				pixel = noDitherMem[ogPixel];
-				pixel.SetAlpha(alpha);
+			const std::string cacheSettings = "none " + CacheSettings(minL, maxL);
+			for (DitherCache& cache : m_noDitherCaches) cache.Prepare(palette, cacheSettings);
 
-				if (image.HasAlphaChannel() && m_ditherAlpha) DitherAlpha(pixel, colours, x, y, imgWidth, imgHeight, alphaThreshold);
+			Log::WriteOneLine("  Quantising");
+			Log::StartTime();
+		}
 
-				SetColourToImage(pixel, image, x, y);
-				continue;
-			}
+		Metrics::Timer ditherTimer(Metrics::Stage::Dither);
+		threadPool.ParallelFor(static_cast<size_t>(bandEnd - bandStart), [&](const size_t row, const unsigned int thread) {
+			DitherCache& ditherCache = m_noDitherCaches[thread];
+			size_t cacheHits = 0, cacheMisses = 0;
+			Colour::SetMathMode(distanceMode);
+
+			const int y = bandStart + static_cast<int>(row);
+			const int imageY = static_cast<int>(row);
+			AlphaSpans::Cursor transparentRow(spans ? &spans->GetRow(y) : nullptr);
+
+			// Palette indices are written to the image once the row is done - pixels without a palette colour keep their own colour and are written after
+			thread_local std::vector<uint32_t> rowIndices;
+			thread_local std::vector<uint8_t> rowAlpha;
+			thread_local std::vector<std::pair<int, Colour>> ownColours;
+			rowIndices.resize(w);
+			rowAlpha.resize(w);
+			ownColours.clear();
+
+			for (int x = 0; x < imgWidth; ++x) {
+				const size_t indexCol = pixels.GetIndex(x, y);
+				const double alpha = pixels.GetAlpha(indexCol);
+
+				// Fully transparent runs are the first palette colour without a search
+				const bool transparent = transparentRow.Skip(x) > x;
+
+				const uint32_t key = DitherCache::GetKey(image, x, imageY);
+				const DitherCache::Entry* cached = useLUT || transparent ? nullptr : ditherCache.Find(key);
+
+				uint32_t index = DitherCache::NoColour;
+				if (transparent) {
+					index = 0;
+				} else if (useLUT) {
+					index = m_noDitherLUT->GetP0(key);
+				} else if (cached) {
+					index = cached->p0;
+					++cacheHits;
+				} else {
+					++cacheMisses;
 
-			//if (m_mono) pixel.ToGrayscale();
+					Colour ogPixel = pixels.GetColour(indexCol);
+					ogPixel.SetAlpha(1.);
 
-			SetColourMathMode(m_distanceMode);
+					//if (m_mono) pixel.ToGrayscale();
 
-			pixel = ClosestColour(pixel, palette, minL, maxL);
+					index = ClosestIndex(ogPixel, palette, minL, maxL);
+					ditherCache.Insert(key, index, index);
+				}
 
-			noDitherMem[ogPixel] = pixel;
-			pixel.SetAlpha(alpha);
+				rowIndices[x] = index;
+				rowAlpha[x] = transparent ? 0 : ToAlphaByte(alpha);
 
-			if (image.HasAlphaChannel() && m_ditherAlpha) DitherAlpha(pixel, colours, x, y, imgWidth, imgHeight, alphaThreshold);
+				// No palette colour keeps the pixel's own colour
+				if (index == DitherCache::NoColour) {
+					Colour pixel = pixels.GetColour(indexCol);
+					pixel.SetAlpha(alpha);
+					ownColours.emplace_back(x, pixel);
+				}
+			}
 
-			SetColourToImage(pixel, image, x, y);
+			DitherKernel::WriteRow(image, 0, imageY, rowIndices.data(), rowAlpha.data(), paletteBytes.data(), paletteBytes.data(), w);
+			for (const std::pair<int, Colour>& own : ownColours) SetColourToImage(own.second, image, own.first, imageY);
 
-			// -- Check Time --
-			if (Log::CheckTimeSeconds(5.)) {
-				const std::string maxStr = Log::ToString(2 * imgHeight * imgWidth);
-				const std::string currStr = Log::ToString(x + y * imgWidth, static_cast<unsigned int>(maxStr.size()), ' ');
+			if (indices) std::copy(rowIndices.begin(), rowIndices.end(), indices + static_cast<size_t>(y) * w);
 
-				Log::WriteOneLine("    " + currStr + " / " + maxStr);
+			cacheCounts[thread][0] += cacheHits;
+			cacheCounts[thread][1] += cacheMisses;
 
-				Log::StartTime();
-			}
+			// Only the calling thread reports progress so the lines stay with this image
+			if (thread == 0) Log::DebugProgress(double(y * imgWidth), double(imgHeight * imgWidth), 5.);
+		});
+		ditherTimer.Stop();
+
+		if (ditherAlpha && m_fsAlpha) {
+			DiffuseAlphaBand(ownPixels, image, bandStart, bandEnd, spans);
+		} else if (ditherAlpha) {
+			DitherAlphaBand(pixels, image, bandStart, bandEnd, threadPool);
 		}
 	}
-	Log::WriteOneLine("  Mem Size: " + Log::ToString(noDitherMem.size()));
+	for (const std::array<size_t, 2>& counts : cacheCounts) Metrics::AddCache(counts[0], counts[1]);
+
+	size_t cacheSize = 0;
+	for (const DitherCache& cache : m_noDitherCaches) cacheSize += cache.size();
+	Log::WriteOneLine("  Mem Size: " + Log::ToString(cacheSize));
+	if (spans) Log::WriteOneLine("  Transparent pixels skipped: " + Log::ToString(spans->GetCount()));
+
+	return true;
+}
+
+template<typename T>
+void Dither::DiffuseError(PixelBuffer<T>& pixels, const size_t index, const Colour& quantError, const double factor) {
+	Colour col = pixels.GetColour(index) + (quantError * factor);
+	col.Clamp();
+	pixels.SetColour(index, col);
 }
 
 void Dither::SetSettings(const std::string distanceType,
@@ -425,7 +1160,8 @@ void Dither::SetSettings(const std::string distanceType,
 	const bool ditherAlpha,
 	const unsigned int ditherAlphaFactor,
 	const std::string ditherAlphaType,
-	const bool normaliseCol) {
+	const bool normaliseCol,
+	const unsigned int threads) {
 	// ============================================================================
 	m_distanceMode = distanceType;
 	m_mathMode = mathMode;
@@ -435,15 +1171,86 @@ void Dither::SetSettings(const std::string distanceType,
 	m_ditherAlphaFactor = ditherAlphaFactor;
 	m_ditherAlphaType = ditherAlphaType;
 	m_normaliseCol = normaliseCol;
+	m_threads = threads;
+
+	m_fsAlpha = m_ditherAlphaType == "fs";
+	m_orderedAlpha = m_ditherAlphaType == "ordered";
+
+	m_thresholdReady = false;
+}
+
+void Dither::SetShape(const int width, const int height, const std::vector<std::vector<int>>& points) {
+	m_threshold.SetShape(width, height, points);
+	m_thresholdReady = false;
+}
+
+void Dither::SetLUT(const bool useLUT, const std::string& directory) {
+	m_useLUT = useLUT;
+	m_lutDirectory = directory;
+}
+
+void Dither::ShareLUT(const Dither& other) {
+	m_orderedLUT = other.m_orderedLUT;
+	m_noDitherLUT = other.m_noDitherLUT;
+}
+
+void Dither::SetFloat(const bool useFloat) {
+	m_useFloat = useFloat;
+}
+
+void Dither::SetKeepIndices(const bool keep) {
+	m_keepIndices = keep;
+	if (!keep) std::vector<uint32_t>().swap(m_indices);
+}
+
+uint32_t* Dither::StartIndices(const ImageRows& rows) {
+	m_indices.clear();
+
+	// A streamed image is never whole in memory so it is written as usual
+	if (!m_keepIndices || rows.GetBandHeight() < rows.GetHeight()) return nullptr;
+
+	m_indices.assign(static_cast<size_t>(rows.GetWidth()) * static_cast<size_t>(rows.GetHeight()), DitherCache::NoColour);
+	return m_indices.data();
+}
+
+void Dither::SetSkipTransparent(const bool skip) {
+	m_skipTransparent = skip;
+	if (!skip) m_spans.Reset(0);
+}
+
+AlphaSpans* Dither::StartSpans(const ImageRows& rows) {
+	if (!m_skipTransparent || !rows.HasAlphaChannel()) return nullptr;
+
+	m_spans.Reset(rows.GetHeight());
+	return &m_spans;
+}
+
+const Threshold& Dither::GetThreshold() {
+	if (!m_thresholdReady) {
+		Metrics::Timer timer(Metrics::Stage::Threshold);
+		m_threshold.GenerateThreshold(m_matrixType);
+		m_thresholdReady = true;
+	}
+	return m_threshold;
+}
+
+Colour Dither::ClosestColour(const Colour& col, const Palette& palette, const double minL, const double maxL) const {
+	const uint32_t index = ClosestIndex(col, palette, minL, maxL);
+	if (index == DitherCache::NoColour) return col;
+
+	Colour closest = palette.GetColour(index);
+	if (!m_mono) closest.SetAlpha(col.GetAlpha());
+
+	return closest;
 }
 
-Colour Dither::ClosestColour(const Colour& col, const Palette& palette, const double minL, const double maxL) {
+uint32_t Dither::ClosestIndex(const Colour& col, const Palette& palette, const double minL, const double maxL) const {
 	if (m_mono) {
 		double colL = col.MonoGetLightness();
 
 		double palMinL = 0., palMaxL = 1.;
-		const Colour firstC = palette.front();
-		const Colour lastC = palette.back();
+		const Colour& firstC = palette.front();
+		const Colour& lastC = palette.back();
 		if (m_normaliseCol) {
 			colL = (colL - minL) / (maxL - minL);
 
@@ -452,107 +1259,162 @@ Colour Dither::ClosestColour(const Colour& col, const Palette& palette, const do
 		}
 
 		const double firstL = (firstC.MonoGetLightness() - palMinL) / (palMaxL - palMinL);
-		if (colL <= firstL) return firstC; // Colour lightness is less than or equal to first colour in palette
+		if (colL <= firstL) return 0; // Colour lightness is less than or equal to first colour in palette
 
 		const double lastL = (lastC.MonoGetLightness() - palMinL) / (palMaxL - palMinL);
-		if (colL >= lastL) return lastC; // Colour lightness is greater than or equal to last colour in palette
+		if (colL >= lastL) return static_cast<uint32_t>(palette.size() - 1); // Colour lightness is greater than or equal to last colour in palette
 
 		for (size_t i = 0; i < palette.size() - 1; ++i) {
-			const Colour currC = palette.GetColour(i);
-			const Colour nextC = palette.GetColour(i + 1);
+			const Colour& currC = palette.GetColour(i);
+			const Colour& nextC = palette.GetColour(i + 1);
 
 			const double currL = (currC.MonoGetLightness() - palMinL) / (palMaxL - palMinL);
 			const double nextL = (nextC.MonoGetLightness() - palMinL) / (palMaxL - palMinL);
 
 			if (!(colL >= currL && colL < nextL)) continue; // Colour lightness is not within current and next colours palette
-			if (colL - currL <= nextL - colL) return currC; // Colour is closer to current colour in palette
-			return nextC; // Colour is closer to next colour in palette
+			if (colL - currL <= nextL - colL) return static_cast<uint32_t>(i); // Colour is closer to current colour in palette
+			return static_cast<uint32_t>(i + 1); // Colour is closer to next colour in palette
 		}
 	} else {
-		Colour closest = palette.GetColour(0);
-		double closestDist = col.MagSq(closest);
-
-		for (size_t i = 1; i < palette.size(); ++i) {
-			Colour current = palette.GetColour(i);
-			const double dist = col.MagSq(current);
-			if (dist < closestDist) {
-				closestDist = dist;
-				closest = current;
-			}
+		return static_cast<uint32_t>(palette.GetTree(Colour::GetMathMode()).Nearest(col));
+	}
+	return DitherCache::NoColour;
+}
+
+std::string Dither::CacheSettings(const double minL, const double maxL) const {
+	std::string settings = m_distanceMode + (m_mono ? " mono" : "") + (m_useFloat ? " float" : "");
+
+	// Only normalised mono results depend on the image's lightness range
+	if (m_mono && m_normaliseCol) settings += " " + Log::ToString(minL, 17) + " " + Log::ToString(maxL, 17);
+
+	return settings;
+}
+
+/// <summary>
+/// Fully opaque and fully transparent pixels keep their alpha, which the colour pass has already written
+/// </summary>
+template<typename T>
+static bool IsAlphaBandSettled(const PixelBuffer<T>& pixels, const int bandStart, const int bandEnd) {
+	const T* bandAlpha = pixels.GetAlphaChannel() + pixels.GetIndex(0, bandStart);
+	const T* bandAlphaEnd = bandAlpha + static_cast<size_t>(pixels.GetWidth()) * static_cast<size_t>(bandEnd - bandStart);
+	return std::all_of(bandAlpha, bandAlphaEnd, [](const T a) { return a == T(0) || a == T(1); });
+}
+
+template<typename T>
+void Dither::DiffuseAlphaBand(PixelBuffer<T>& pixels, Image& image, const int bandStart, const int bandEnd, const AlphaSpans* spans) {
+	if (IsAlphaBandSettled(pixels, bandStart, bandEnd)) return;
+
+	Metrics::Timer timer(Metrics::Stage::Alpha);
+
+	const int imgWidth = pixels.GetWidth();
+
+	std::vector<AlphaSpans::Cursor> transparentRows;
+	for (int y = bandStart; y < bandEnd; ++y) transparentRows.emplace_back(spans ? &spans->GetRow(y) : nullptr);
+
+	const size_t alphaOffset = static_cast<size_t>(image.GetChannels()) - 1;
+	const auto ditherPixel = [&](const int x, const int y) {
+		const size_t index = image.GetIndex(x, y - bandStart) + alphaOffset;
+
+		// Error spread into transparent runs is dropped
+		if (transparentRows[static_cast<size_t>(y - bandStart)].Skip(x) > x) {
+			image.SetData(index, 0);
+			return;
 		}
 
-		closest.SetAlpha(col.GetAlpha());
+		const double alpha = DiffuseAlpha(pixels.GetAlpha(pixels.GetIndex(x, y)), pixels, x, y);
+		image.SetData(index, ToAlphaByte(alpha));
+	};
 
-		return closest;
+	// Error goes to the next pixels so they are done one at a time
+	for (int y = bandStart; y < bandEnd; ++y) {
+		for (int x = 0; x < imgWidth; ++x) ditherPixel(x, y);
 	}
-	return col;
 }
 
-void Dither::DitherAlpha(Colour& col, std::vector<Colour>& colours, const int x, const int y, const int imgWidth, const int imgHeight, const Threshold& threshold) {
-	// Skip fully opaque or fully transparent pixels
-	if (col.GetAlpha() == 1. || col.GetAlpha() == 0) return;
+template<typename T>
+void Dither::DitherAlphaBand(const PixelBuffer<T>& pixels, Image& image, const int bandStart, const int bandEnd, ThreadPool& threadPool) {
+	if (IsAlphaBandSettled(pixels, bandStart, bandEnd)) return;
 
-	//const size_t indexCol = size_t(x + y * imgWidth);
-	if (m_ditherAlphaType == "fs") {
-		// Floyd-Steinberg Dither Alpha
-		const double oldAlpha = col.GetAlpha();
+	Metrics::Timer timer(Metrics::Stage::Alpha);
 
-		double newAlpha = std::floor(static_cast<double>(m_ditherAlphaFactor + 1) * oldAlpha) / static_cast<double>(m_ditherAlphaFactor);
+	const int imgWidth = pixels.GetWidth();
+	const size_t w = static_cast<size_t>(imgWidth);
 
-		col.SetAlpha(newAlpha);
+	const Threshold* threshold = m_orderedAlpha ? &GetThreshold() : nullptr;
 
-		double quantError = oldAlpha - newAlpha;
+	threadPool.ParallelFor(static_cast<size_t>(bandEnd - bandStart), [&](const size_t row, const unsigned int) {
+		const int y = bandStart + static_cast<int>(row);
 
-		if (x + 1 < imgWidth) {
-			size_t neighbourIndex = size_t((x + 1) + y * imgWidth);
-			double currAlpha = colours[neighbourIndex].GetAlpha() + (quantError * (7. / 16.));
-			currAlpha = currAlpha > 1. ? 1. : (currAlpha < 0. ? 0. : currAlpha);
-			colours[neighbourIndex].SetAlpha(currAlpha);
+		thread_local std::vector<double> alphaRow, thresholdRow;
+		thread_local std::vector<uint8_t> alphaBytes;
+		alphaBytes.resize(w);
+
+		const T* rowAlpha = pixels.GetAlphaChannel() + pixels.GetIndex(0, y);
+		const double* alpha = nullptr;
+		if constexpr (std::is_same_v<T, double>) {
+			alpha = rowAlpha;
+		} else {
+			alphaRow.assign(rowAlpha, rowAlpha + w);
+			alpha = alphaRow.data();
 		}
 
-		if (y + 1 < imgHeight) {
-			size_t neighbourIndex = 0;
-			double currAlpha = 0.;
-
-			if (x - 1 >= 0) {
-				neighbourIndex = size_t((x - 1) + (y + 1) * imgWidth);
-				currAlpha = colours[neighbourIndex].GetAlpha() + (quantError * (3. / 16.));
-				currAlpha = currAlpha > 1. ? 1. : (currAlpha < 0. ? 0. : currAlpha);
-				colours[neighbourIndex].SetAlpha(currAlpha);
-			}
+		if (threshold) {
+			thresholdRow.resize(w);
+			for (int x = 0; x < imgWidth; ++x) thresholdRow[static_cast<size_t>(x)] = threshold->GetThreshold(x, y);
+		}
 
-			if (x + 1 < imgWidth) {
-				neighbourIndex = size_t((x + 1) + (y + 1) * imgWidth);
-				currAlpha = colours[neighbourIndex].GetAlpha() + (quantError * (1. / 16.));
-				currAlpha = currAlpha > 1. ? 1. : (currAlpha < 0. ? 0. : currAlpha);
-				colours[neighbourIndex].SetAlpha(currAlpha);
-			}
+		DitherKernel::QuantiseAlpha(alpha, threshold ? thresholdRow.data() : nullptr, m_ditherAlphaFactor, alphaBytes.data(), w);
+		DitherKernel::WriteAlpha(image, 0, static_cast<int>(row), alphaBytes.data(), w);
+	});
+}
 
-			neighbourIndex = size_t(x + (y + 1) * imgWidth);
-			currAlpha = colours[neighbourIndex].GetAlpha() + (quantError * (5. / 16.));
-			currAlpha = currAlpha > 1. ? 1. : (currAlpha < 0. ? 0. : currAlpha);
-			colours[neighbourIndex].SetAlpha(currAlpha);
-		}
-	} else if (m_ditherAlphaType == "ordered") {
-		// Ordered Dither Alpha
+template<typename T>
+double Dither::DiffuseAlpha(const double alpha, PixelBuffer<T>& pixels, const int x, const int y) const {
+	// Skip fully opaque or fully transparent pixels
+	if (alpha == 1. || alpha == 0) return alpha;
 
-		double newAlpha = col.GetAlpha();
+	// Floyd-Steinberg Dither Alpha
+	const double oldAlpha = alpha;
 
-		const double r = 1. / static_cast<double>(m_ditherAlphaFactor);
-		const double M = threshold.GetThreshold(x, y) * -1;
+	double newAlpha = std::floor(static_cast<double>(m_ditherAlphaFactor + 1) * oldAlpha) / static_cast<double>(m_ditherAlphaFactor);
 
-		newAlpha += M * r;
-		newAlpha = newAlpha < 0. ? 0. : (newAlpha > 1. ? 1. : newAlpha);
+	double quantError = oldAlpha - newAlpha;
 
-		newAlpha = std::floor(static_cast<double>(m_ditherAlphaFactor + 1) * newAlpha) / static_cast<double>(m_ditherAlphaFactor);
+	const int imgWidth = pixels.GetWidth();
+	const int imgHeight = pixels.GetHeight();
 
-		col.SetAlpha(newAlpha);
-	} else {
-		// No Dither Alpha
-		double newAlpha = std::floor(static_cast<double>(m_ditherAlphaFactor + 1) * col.GetAlpha()) / static_cast<double>(m_ditherAlphaFactor);
+	if (x + 1 < imgWidth) {
+		size_t neighbourIndex = pixels.GetIndex(x + 1, y);
+		double currAlpha = pixels.GetAlpha(neighbourIndex) + (quantError * (7. / 16.));
+		currAlpha = currAlpha > 1. ? 1. : (currAlpha < 0. ? 0. : currAlpha);
+		pixels.SetAlpha(neighbourIndex, currAlpha);
+	}
+
+	if (y + 1 < imgHeight) {
+		size_t neighbourIndex = 0;
+		double currAlpha = 0.;
+
+		if (x - 1 >= 0) {
+			neighbourIndex = pixels.GetIndex(x - 1, y + 1);
+			currAlpha = pixels.GetAlpha(neighbourIndex) + (quantError * (3. / 16.));
+			currAlpha = currAlpha > 1. ? 1. : (currAlpha < 0. ? 0. : currAlpha);
+			pixels.SetAlpha(neighbourIndex, currAlpha);
+		}
 
-		col.SetAlpha(newAlpha);
+		if (x + 1 < imgWidth) {
+			neighbourIndex = pixels.GetIndex(x + 1, y + 1);
+			currAlpha = pixels.GetAlpha(neighbourIndex) + (quantError * (1. / 16.));
+			currAlpha = currAlpha > 1. ? 1. : (currAlpha < 0. ? 0. : currAlpha);
+			pixels.SetAlpha(neighbourIndex, currAlpha);
+		}
+
+		neighbourIndex = pixels.GetIndex(x, y + 1);
+		currAlpha = pixels.GetAlpha(neighbourIndex) + (quantError * (5. / 16.));
+		currAlpha = currAlpha > 1. ? 1. : (currAlpha < 0. ? 0. : currAlpha);
+		pixels.SetAlpha(neighbourIndex, currAlpha);
 	}
+
+	return newAlpha;
 }
 
 // Fix for E0847: expression must have integral or enum type
@@ -560,17 +1422,20 @@ void Dither::DitherAlpha(Colour& col, std::vector<Colour>& colours, const int x,
 // Replace the switch statement with if-else statements.
 
 void Dither::SetColourMathMode(const std::string& mode) {
+	Colour::SetMathMode(ToColourMathMode(mode));
+}
+
+Colour::MathMode Dither::ToColourMathMode(const std::string& mode) {
 	if (mode == "srgb") {
-		Colour::SetMathMode(Colour::MathMode::sRGB);
+		return Colour::MathMode::sRGB;
 	} else if (mode == "oklab") {
-		Colour::SetMathMode(Colour::MathMode::OkLab);
+		return Colour::MathMode::OkLab;
 	} else if (mode == "oklab_l") {
-		Colour::SetMathMode(Colour::MathMode::OkLab_Lightness);
+		return Colour::MathMode::OkLab_Lightness;
 	} else if (mode == "lrgb") {
-		Colour::SetMathMode(Colour::MathMode::Linear_RGB);
-	} else {
-		Colour::SetMathMode(Colour::MathMode::sRGB);
+		return Colour::MathMode::Linear_RGB;
 	}
+	return Colour::MathMode::sRGB;
 }
 Colour Dither::GetColourFromImage(const Image& image, const int x, const int y) {
 	const size_t index = image.GetIndex(x, y);
@@ -608,13 +1473,7 @@ Colour Dither::GetColourFromImage(const Image& image, const int x, const int y)
 void Dither::SetColourToImage(const Colour& colour, Image& image, const int x, const int y) {
 	const size_t index = image.GetIndex(x, y);
 	Colour::sRGB_UInt colour_int = colour.GetsRGB_UInt();
-
-	double a_d = colour.GetAlpha() * 256.;
-	a_d = std::floor(a_d);
-	a_d = a_d > 255. ? 255. : a_d;
-	a_d = a_d < 0. ? 0. : a_d;
-
-	const uint8_t a = static_cast<uint8_t>(a_d);
+	const uint8_t a = ToAlphaByte(colour.GetAlpha());
 
 	if (image.IsGrayscale()) {
 		if (image.GetChannels() == 2) {
@@ -637,28 +1496,61 @@ void Dither::SetColourToImage(const Colour& colour, Image& image, const int x, c
 	}
 }
 
-void Dither::ImageToGrayscale(Image& image) {
+uint8_t Dither::ToAlphaByte(const double alpha) {
+	double a_d = alpha * 256.;
+	a_d = std::floor(a_d);
+	a_d = a_d > 255. ? 255. : a_d;
+	a_d = a_d < 0. ? 0. : a_d;
+
+	return static_cast<uint8_t>(a_d);
+}
+
+void Dither::ImageToGrayscale(Image& image) const {
 	// Convert image to grayscale
 	SetColourMathMode(m_distanceMode);
+	const Colour::MathMode mode = Colour::GetMathMode();
+
+	const int imgWidth = image.GetWidth();
+	const int imgHeight = image.GetHeight();
+	const size_t w = static_cast<size_t>(imgWidth);
 
 	const int channels = image.GetChannels() == 3 ? 1 : 2;
-	Image newImage(image.GetWidth(), image.GetHeight(), channels);
+	Image newImage(imgWidth, imgHeight, channels);
 
-	for (int x = 0; x < image.GetWidth(); ++x) {
-		for (int y = 0; y < image.GetHeight(); ++y) {
-			const size_t newIndex = newImage.GetIndex(x, y);
-			Colour col = Dither::GetColourFromImage(image, x, y);
-			const double l_d = col.MonoGetLightness();
+	PixelBuffer<double> pixels(imgWidth, imgHeight, mode);
 
-			if (Colour::GetMathMode() == Colour::MathMode::sRGB) {
-				col.SetsRGB_D(l_d, l_d, l_d);
-			} else if (Colour::GetMathMode() == Colour::MathMode::Linear_RGB) {
-				col.SetLRGB(l_d, l_d, l_d);
-			} else {
-				col.SetOkLab(l_d, 0., 0.);
-			}
+	std::vector<double> lightness(w), zeros(w, 0.), lrgb(w * 3), srgb(w);
+	std::vector<uint8_t> gray(w);
+
+	for (int y = 0; y < imgHeight; ++y) {
+		pixels.SetRow(image, y);
 
-			newImage.SetData(newIndex, col.GetsRGB_UInt().r);
+		const size_t rowStart = pixels.GetIndex(0, y);
+		const double* c0 = pixels.GetChannel(0) + rowStart;
+
+		// Same as Colour::MonoGetLightness
+		if (pixels.GetChannels() == 3 && (mode == Colour::MathMode::sRGB || mode == Colour::MathMode::Linear_RGB)) {
+			const double* c1 = pixels.GetChannel(1) + rowStart;
+			const double* c2 = pixels.GetChannel(2) + rowStart;
+			for (size_t x = 0; x < w; ++x) lightness[x] = 0.2126 * c0[x] + 0.7152 * c1[x] + 0.0722 * c2[x];
+		} else {
+			for (size_t x = 0; x < w; ++x) lightness[x] = c0[x];
+		}
+
+		// Lightness is a gray colour in the distance mode - back to sRGB
+		if (mode == Colour::MathMode::sRGB) {
+			srgb = lightness;
+		} else if (mode == Colour::MathMode::Linear_RGB) {
+			ColourBatch::LRGBtosRGB(lightness.data(), srgb.data(), w);
+		} else {
+			ColourBatch::OkLabtoLRGB(lightness.data(), zeros.data(), zeros.data(), lrgb.data(), lrgb.data() + w, lrgb.data() + w * 2, w);
+			ColourBatch::LRGBtosRGB(lrgb.data(), srgb.data(), w);
+		}
+		ColourBatch::sRGBToUint(srgb.data(), gray.data(), w);
+
+		for (int x = 0; x < imgWidth; ++x) {
+			const size_t newIndex = newImage.GetIndex(x, y);
+			newImage.SetData(newIndex, gray[x]);
 
 			if (channels == 2) {
 				const size_t oldIndex = image.GetIndex(x, y) + 3;
@@ -668,4 +1560,4 @@ void Dither::ImageToGrayscale(Image& image) {
 	}
 
 	image = newImage;
-}
\ No newline at end of file
+}
@@ -1,13 +1,27 @@
 #pragma once
 #include "../wrapper/Threshold.h"
+#include "AlphaSpans.h"
 #include "Colour.h"
+#include "ConvertedImage.hpp"
+#include "DitherCache.h"
 #include "Image.h"
+#include "ImageRows.h"
 #include "Palette.h"
+#include "PaletteLUT.h"
+#include "PixelBuffer.hpp"
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+class ThreadPool;
+
+/// <summary>
+/// <para>Settings, memos, tables and the threshold map for one set of dither settings - kept between images</para>
+/// <para>Each thread dithering images at the same time uses its own Dither</para>
+/// </summary>
 class Dither {
 public:
 	Dither() {};
@@ -18,33 +32,112 @@ public:
 	/// </summary>
 	/// <param name="image"></param>
 	/// <param name="palette"></param>
-	static void OrderedDither(Image& image, const Palette& palette);
+	/// <param name="converted">Holds a copy of image - its PixelBuffers are copied instead of converting image again, nullptr converts image</param>
+	void OrderedDither(Image& image, const Palette& palette, ConvertedImage* converted = nullptr);
+
+	/// <summary>
+	/// Bayer Ordered Dithering a band of rows at a time
+	/// </summary>
+	/// <param name="rows"></param>
+	/// <param name="palette"></param>
+	/// <returns>False if rows couldn't be loaded</returns>
+	bool OrderedDither(ImageRows& rows, const Palette& palette);
 
 	/// <summary>
 	/// Floyd-Steinberg Dithering
 	/// </summary>
 	/// <param name="image"></param>
 	/// <param name="palette"></param>
-	/// <param name="distanceType"></param>
-	static void FloydDither(Image& image, const Palette& palette);
+	/// <param name="converted">See OrderedDither() - not used by mono, which converts every pixel itself</param>
+	void FloydDither(Image& image, const Palette& palette, ConvertedImage* converted = nullptr);
 
-	static void NoDither(Image& image, const Palette& palette);
+	/// <summary>
+	/// Floyd-Steinberg Dithering a band of rows at a time
+	/// </summary>
+	/// <param name="rows"></param>
+	/// <param name="palette"></param>
+	/// <returns>False if rows couldn't be loaded</returns>
+	bool FloydDither(ImageRows& rows, const Palette& palette);
+
+	void NoDither(Image& image, const Palette& palette, ConvertedImage* converted = nullptr);
+	bool NoDither(ImageRows& rows, const Palette& palette);
 
-	static void SetSettings(const std::string distanceType,
+	void SetSettings(const std::string distanceType,
 		const std::string mathMode,
 		const bool mono,
 		const std::string matrixType, 
 		const bool ditherAlpha, 
 		const unsigned int ditherAlphaFactor, 
 		const std::string ditherAlphaType, 
-		const bool normaliseCol);
+		const bool normaliseCol,
+		const unsigned int threads = 0);
+
+	/// <summary>
+	/// Cell and points used by bayerShapeN, see Threshold::SetShape()
+	/// </summary>
+	/// <param name="width"></param>
+	/// <param name="height"></param>
+	/// <param name="points"></param>
+	void SetShape(const int width, const int height, const std::vector<std::vector<int>>& points);
+
+	/// <summary>
+	/// Use a PaletteLUT for no dither and ordered dithering instead of searching the palette
+	/// </summary>
+	/// <param name="useLUT"></param>
+	/// <param name="directory">Folder the tables are saved to and loaded from</param>
+	void SetLUT(const bool useLUT, const std::string& directory);
+
+	/// <summary>
+	/// Use the same tables as another Dither with the same palette and distanceMode instead of loading them again
+	/// </summary>
+	/// <param name="other"></param>
+	void ShareLUT(const Dither& other);
+
+	/// <summary>
+	/// <para>Keep the dither buffers and error diffusion in float instead of double - half the memory and twice the SIMD width</para>
+	/// <para>Palette colours and the palette search stay double - DevTools::CheckFloatPrecision bounds how much the output changes</para>
+	/// </summary>
+	/// <param name="useFloat"></param>
+	void SetFloat(const bool useFloat);
+
+	/// <summary>
+	/// Keep the palette index of every pixel when a whole image is dithered - see GetIndices()
+	/// </summary>
+	/// <param name="keep"></param>
+	void SetKeepIndices(const bool keep);
+
+	/// <summary>
+	/// <para>Skip runs of fully transparent pixels instead of dithering them - they are written as the first palette colour with an alpha of 0</para>
+	/// <para>Floyd-Steinberg error isn't spread from or into them, like the edges of the image</para>
+	/// </summary>
+	/// <param name="skip"></param>
+	void SetSkipTransparent(const bool skip);
+
+	/// <summary>
+	/// <para>Palette index of every pixel of the last image dithered, row by row - for writing a palette PNG without finding the colours again</para>
+	/// <para>DitherCache::NoColour for pixels without a palette colour, empty unless SetKeepIndices(true) and the whole image was in memory</para>
+	/// </summary>
+	/// <returns></returns>
+	const std::vector<uint32_t>& GetIndices() const { return m_indices; };
 
 	static Colour GetColourFromImage(const Image& image, const int x, const int y);
 	static void SetColourToImage(const Colour& colour, Image& image, const int x, const int y);
 
-	static void ImageToGrayscale(Image& image);
+	/// <summary>
+	/// 8 bit alpha written by SetColourToImage
+	/// </summary>
+	/// <param name="alpha"></param>
+	/// <returns></returns>
+	static uint8_t ToAlphaByte(const double alpha);
+
+	/// <summary>
+	/// Grayscale in distanceMode
+	/// </summary>
+	/// <param name="image"></param>
+	void ImageToGrayscale(Image& image) const;
 
 	static void SetColourMathMode(const std::string& mode);
+	static Colour::MathMode ToColourMathMode(const std::string& mode);
 
 private:
 
@@ -56,14 +149,195 @@ private:
 	/// <param name="minL">Minimum lightness of image</param>
 	/// <param name="maxL">Maximum lightness of image</param>
 	/// <returns></returns>
-	static Colour ClosestColour(const Colour& col, const Palette& palette, const double minL = 0., const double maxL = 1.);;
+	Colour ClosestColour(const Colour& col, const Palette& palette, const double minL = 0., const double maxL = 1.) const;
+
+	/// <summary>
+	/// Same search as ClosestColour
+	/// </summary>
+	/// <returns>Palette index - DitherCache::NoColour if the colour's lightness isn't in the palette's range</returns>
+	uint32_t ClosestIndex(const Colour& col, const Palette& palette, const double minL = 0., const double maxL = 1.) const;
+
+	/// <summary>
+	/// Settings that change a DitherCache result for a pixel
+	/// </summary>
+	/// <param name="minL">Minimum lightness of image</param>
+	/// <param name="maxL">Maximum lightness of image</param>
+	/// <returns></returns>
+	std::string CacheSettings(const double minL, const double maxL) const;
+
+	std::string m_distanceMode = "oklab", m_mathMode = "srgb", m_matrixType = "bayer", m_ditherAlphaType = "ordered";
+	bool m_mono = false, m_ditherAlpha = false, m_normaliseCol = true;
+
+	// m_ditherAlphaType compared once in SetSettings instead of for every pixel
+	bool m_fsAlpha = false, m_orderedAlpha = true;
+	unsigned int m_ditherAlphaFactor = 1;
+
+	// Worker threads for ordered, Floyd-Steinberg and no dithering - 0 uses every core
+	unsigned int m_threads = 0;
+
+	// Memo of palette indices for each 8 bit colour - one per ordered and no dithering thread
+	std::vector<DitherCache> m_orderedCaches, m_noDitherCaches;
+
+	bool m_useLUT = false, m_useFloat = false, m_keepIndices = false, m_skipTransparent = false;
+	std::vector<uint32_t> m_indices;
+	AlphaSpans m_spans;
+	std::string m_lutDirectory;
 
-	static std::string m_distanceMode, m_mathMode, m_matrixType, m_ditherAlphaType;
-	static bool m_mono, m_ditherAlpha, m_normaliseCol;
-	static unsigned int m_ditherAlphaFactor;
+	// Shared with other Dithers by ShareLUT() - PaletteLUT::Prepare is thread safe
+	std::shared_ptr<PaletteLUT> m_orderedLUT = std::make_shared<PaletteLUT>(), m_noDitherLUT = std::make_shared<PaletteLUT>();
+
+	// Threshold map for matrixType - generated on first use and kept between images
+	Threshold m_threshold;
+	bool m_thresholdReady = false;
+
+	/// <summary>
+	/// Generates m_threshold if the settings changed since it was last made - needs SetShape() first
+	/// </summary>
+	/// <returns></returns>
+	const Threshold& GetThreshold();
+
+	/// <summary>
+	/// Clears m_indices and sizes it for the image when they are kept
+	/// </summary>
+	/// <param name="rows"></param>
+	/// <returns>First index of the image - nullptr when they aren't kept or the image is streamed</returns>
+	uint32_t* StartIndices(const ImageRows& rows);
+
+	/// <summary>
+	/// Clears m_spans for the image when transparent pixels are skipped - rows are added as they are copied
+	/// </summary>
+	/// <param name="rows"></param>
+	/// <returns>nullptr when they aren't skipped or the image has no alpha channel</returns>
+	AlphaSpans* StartSpans(const ImageRows& rows);
 
 	//static double GetThreshold(const int x, const int y);
 
-	//static void DitherAlphaChannel(Image& image, const int x, const int y);
-	static void DitherAlpha(Colour& col, std::vector<Colour>& colours, const int x, const int y, const int imgWidth, const int imgHeight, const Threshold& threshold);
+	/// <summary>
+	/// The public dither functions with a float or double pixel buffer, see SetFloat()
+	/// </summary>
+	/// <typeparam name="T">float or double</typeparam>
+	/// <param name="converted">Only when every row of the image is in rows - nullptr converts the rows</param>
+	template<typename T>
+	bool OrderedDitherBuffer(ImageRows& rows, const Palette& palette, ConvertedImage* converted);
+	template<typename T>
+	bool FloydDitherBuffer(ImageRows& rows, const Palette& palette, ConvertedImage* converted);
+	template<typename T>
+	bool NoDitherBuffer(ImageRows& rows, const Palette& palette, ConvertedImage* converted);
+
+	/// <summary>
+	/// One row of an ordered dither tile for DitherKernel - one per thread
+	/// </summary>
+	template<typename T>
+	struct OrderedRow {
+		std::vector<uint32_t> i0, i1, indices;
+		std::vector<T> alpha, threshold;
+		std::vector<uint8_t> alphaBytes;
+
+		void Resize(const size_t count) {
+			i0.resize(count);
+			i1.resize(count);
+			indices.resize(count);
+			alpha.resize(count);
+			threshold.resize(count);
+			alphaBytes.resize(count);
+		}
+	};
+
+	/// <summary>
+	/// Everything a Floyd-Steinberg row reads - the same for every row of a band
+	/// </summary>
+	template<typename T>
+	struct FloydState {
+		// Mono searches the palette with its settings
+		const Dither* dither = nullptr;
+
+		PixelBuffer<T>* pixels = nullptr;
+		Image* image = nullptr;
+		const Palette* palette = nullptr;
+		const PaletteTree* tree = nullptr;
+
+		// Palette::GetBytes()
+		const uint8_t* paletteBytes = nullptr;
+
+		// First pixel of the band in m_indices - nullptr when they aren't kept
+		uint32_t* indices = nullptr;
+
+		// Transparent runs - nullptr when they aren't skipped
+		const AlphaSpans* spans = nullptr;
+
+		// Palette colours in the math mode's channels
+		std::vector<std::array<T, 3>> paletteMath;
+
+		Colour::MathMode distanceMode = Colour::MathMode::OkLab, mathMode = Colour::MathMode::OkLab;
+		double palMinL = 0., palMaxL = 1.;
+	};
+
+	/// <summary>
+	/// Dithers row y - waits for each pixel's error from the row above and stores how far along the row it is in progress
+	/// </summary>
+	template<typename T>
+	using FloydRowFunc = void (*)(const FloydState<T>& state, const int y, const int imageY, const std::atomic<int>* above, std::atomic<int>& progress);
+
+	/// <summary>
+	/// <para>Floyd-Steinberg row for one distance mode and math mode - works on the buffer's channels directly</para>
+	/// <para>Same output as FloydRowMono's colour maths without switching on the MathMode for every pixel</para>
+	/// </summary>
+	template<typename T, Colour::MathMode Distance, Colour::MathMode Math>
+	static void FloydRow(const FloydState<T>& state, const int y, const int imageY, const std::atomic<int>* above, std::atomic<int>& progress);
+
+	/// <summary>
+	/// Floyd-Steinberg row for mono - lightness error through Colour maths
+	/// </summary>
+	template<typename T>
+	static void FloydRowMono(const FloydState<T>& state, const int y, const int imageY, const std::atomic<int>* above, std::atomic<int>& progress);
+
+	/// <summary>
+	/// FloydRow for the settings
+	/// </summary>
+	/// <returns></returns>
+	template<typename T>
+	FloydRowFunc<T> GetFloydRow() const;
+	template<typename T, Colour::MathMode Distance>
+	static FloydRowFunc<T> GetFloydRow(const Colour::MathMode mathMode);
+
+	/// <summary>
+	/// <para>Floyd-Steinberg dithers the alpha of a band once its colours are written - only the alpha channel of the image is changed</para>
+	/// <para>Skipped when every pixel is fully opaque or fully transparent</para>
+	/// </summary>
+	/// <param name="pixels">Alpha is read from its alpha channel and the error is added to it</param>
+	/// <param name="image">The band - row 0 is bandStart</param>
+	/// <param name="bandStart"></param>
+	/// <param name="bandEnd"></param>
+	/// <param name="spans">Transparent runs are kept at 0 - nullptr when they aren't skipped</param>
+	template<typename T>
+	void DiffuseAlphaBand(PixelBuffer<T>& pixels, Image& image, const int bandStart, const int bandEnd, const AlphaSpans* spans);
+
+	/// <summary>
+	/// <para>Dithers the alpha of a band with the ordered threshold or rounds it - only the alpha channel of the image is changed</para>
+	/// <para>Skipped when every pixel is fully opaque or fully transparent</para>
+	/// </summary>
+	/// <param name="pixels">Alpha is read from its alpha channel</param>
+	/// <param name="image">The band - row 0 is bandStart</param>
+	/// <param name="bandStart"></param>
+	/// <param name="bandEnd"></param>
+	/// <param name="threadPool">Rows are split between its threads</param>
+	template<typename T>
+	void DitherAlphaBand(const PixelBuffer<T>& pixels, Image& image, const int bandStart, const int bandEnd, ThreadPool& threadPool);
+
+	/// <summary>
+	/// Floyd-Steinberg dithering of one pixel's alpha - the error is added to the alpha of the next pixels
+	/// </summary>
+	/// <returns>New alpha</returns>
+	template<typename T>
+	double DiffuseAlpha(const double alpha, PixelBuffer<T>& pixels, const int x, const int y) const;
+
+	/// <summary>
+	/// Adds quantError * factor to a pixel in the current MathMode and clamps it
+	/// </summary>
+	/// <param name="pixels"></param>
+	/// <param name="index"></param>
+	/// <param name="quantError"></param>
+	/// <param name="factor"></param>
+	template<typename T>
+	static void DiffuseError(PixelBuffer<T>& pixels, const size_t index, const Colour& quantError, const double factor);
 };
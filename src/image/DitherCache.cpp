@@ -0,0 +1,85 @@
+#include "Colour.h"
+#include "DitherCache.h"
+#include "Image.h"
+#include "Palette.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+uint32_t DitherCache::GetKey(const Image& image, const int x, const int y) {
+	const size_t index = image.GetIndex(x, y);
+	const int channels = image.GetChannels();
+
+	// Colour::SetsRGB zeroes the colour of fully transparent pixels
+	if ((channels == 2 || channels == 4) && image.GetData(index + static_cast<size_t>(channels) - 1) == 0) return 0;
+
+	const uint32_t r = image.GetData(index);
+	if (image.IsGrayscale()) return (r << 16) | (r << 8) | r;
+
+	const uint32_t g = image.GetData(index + 1);
+	const uint32_t b = image.GetData(index + 2);
+	return (r << 16) | (g << 8) | b;
+}
+
+void DitherCache::Prepare(const Palette& palette, const std::string& settings) {
+	std::vector<uint32_t> paletteKey(palette.size());
+	for (size_t i = 0; i < palette.size(); ++i) {
+		const Colour::sRGB_UInt col = palette.GetColour(i).GetsRGB_UInt();
+		paletteKey[i] = (static_cast<uint32_t>(col.r) << 16) | (static_cast<uint32_t>(col.g) << 8) | static_cast<uint32_t>(col.b);
+	}
+
+	if (paletteKey == m_palette && settings == m_settings) return;
+
+	Clear();
+	m_palette = paletteKey;
+	m_settings = settings;
+}
+
+const DitherCache::Entry* DitherCache::Find(const uint32_t key) const {
+	if (m_entries.empty()) return nullptr;
+
+	const Entry& entry = m_entries[Slot(key)];
+	return entry.key == key ? &entry : nullptr;
+}
+
+void DitherCache::Insert(const uint32_t key, const uint32_t p0, const uint32_t p1, const double alpha) {
+	// Keep at most half of the slots filled so probes stay short
+	if ((m_size + 1) * 2 > m_entries.size()) Grow();
+
+	Entry& entry = m_entries[Slot(key)];
+	if (entry.key == Empty) ++m_size;
+
+	entry.key = key;
+	entry.p0 = p0;
+	entry.p1 = p1;
+	entry.alpha = alpha;
+}
+
+void DitherCache::Clear() {
+	m_entries.clear();
+	m_size = 0;
+	m_mask = 0;
+}
+
+size_t DitherCache::Slot(const uint32_t key) const {
+	// Fibonacci hashing spreads nearby colours over the table
+	size_t slot = static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 32) & m_mask;
+
+	while (m_entries[slot].key != Empty && m_entries[slot].key != key) slot = (slot + 1) & m_mask;
+	return slot;
+}
+
+void DitherCache::Grow() {
+	const size_t capacity = m_entries.empty() ? 1024 : m_entries.size() * 2;
+
+	std::vector<Entry> old;
+	old.swap(m_entries);
+
+	m_entries.assign(capacity, Entry());
+	m_mask = capacity - 1;
+
+	for (const Entry& entry : old) {
+		if (entry.key != Empty) m_entries[Slot(entry.key)] = entry;
+	}
+}
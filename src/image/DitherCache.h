@@ -0,0 +1,69 @@
+#pragma once
+#include "Image.h"
+#include "Palette.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// <para>Memo of dither results keyed on a pixel's 8 bit sRGB value packed into 24 bits</para>
+/// <para>Flat open addressing table - stores palette indices and the blend alpha instead of Colours</para>
+/// </summary>
+class DitherCache {
+public:
+	DitherCache() {};
+	~DitherCache() {};
+
+	struct Entry {
+		uint32_t key = Empty;
+		uint32_t p0 = 0, p1 = 0;
+		double alpha = 0.;
+	};
+
+	// Palette index for a pixel with no palette colour - keep the pixel's own colour
+	static constexpr uint32_t NoColour = 0xFFFFFFFF;
+
+	/// <summary>
+	/// Key for a pixel - same for colours that PixelBuffer stores the same (fully transparent pixels are black)
+	/// </summary>
+	/// <param name="image"></param>
+	/// <param name="x"></param>
+	/// <param name="y"></param>
+	/// <returns></returns>
+	static uint32_t GetKey(const Image& image, const int x, const int y);
+
+	/// <summary>
+	/// Clears the cache if it was filled with a different palette or settings - otherwise keeps the entries for the next image
+	/// </summary>
+	/// <param name="palette"></param>
+	/// <param name="settings">Every setting that changes the result for a pixel</param>
+	void Prepare(const Palette& palette, const std::string& settings);
+
+	/// <summary>
+	/// </summary>
+	/// <param name="key"></param>
+	/// <returns>nullptr if the key isn't in the cache</returns>
+	const Entry* Find(const uint32_t key) const;
+
+	void Insert(const uint32_t key, const uint32_t p0, const uint32_t p1, const double alpha = 0.);
+
+	size_t size() const { return m_size; };
+
+	void Clear();
+
+private:
+	// Packed sRGB only uses 24 bits so this can't be a key
+	static const uint32_t Empty = 0xFFFFFFFF;
+
+	std::vector<Entry> m_entries;
+	size_t m_size = 0;
+	size_t m_mask = 0;
+
+	// What the entries were made with
+	std::vector<uint32_t> m_palette;
+	std::string m_settings;
+
+	size_t Slot(const uint32_t key) const;
+	void Grow();
+};
@@ -0,0 +1,249 @@
+#include "ColourBatch.h"
+#include "Dither.h"
+#include "DitherCache.h"
+#include "DitherKernel.h"
+#include "Image.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+void DitherKernel::SelectIndices(const double* alpha, const double* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count) {
+	switch (ColourBatch::GetInstructions()) {
+	case ColourBatch::Instructions::AVX2:
+		SelectIndices_AVX2(alpha, threshold, i0, i1, out, count);
+		break;
+	case ColourBatch::Instructions::SSE41:
+		SelectIndices_SSE41(alpha, threshold, i0, i1, out, count);
+		break;
+	default:
+		SelectIndices_Scalar(alpha, threshold, i0, i1, out, count);
+		break;
+	}
+}
+
+void DitherKernel::SelectIndices(const float* alpha, const float* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count) {
+	switch (ColourBatch::GetInstructions()) {
+	case ColourBatch::Instructions::AVX2:
+		SelectIndices_AVX2(alpha, threshold, i0, i1, out, count);
+		break;
+	case ColourBatch::Instructions::SSE41:
+		SelectIndices_SSE41(alpha, threshold, i0, i1, out, count);
+		break;
+	default:
+		SelectIndices_Scalar(alpha, threshold, i0, i1, out, count);
+		break;
+	}
+}
+
+void DitherKernel::WriteRow(Image& image, const int x, const int y, const uint32_t* indices, const uint8_t* alpha,
+	const uint8_t* colours, const uint8_t* noColour, const size_t count) {
+	const size_t channels = static_cast<size_t>(image.GetChannels());
+	uint8_t* row = image.GetRow(y) + static_cast<size_t>(x) * channels;
+
+	if (image.IsGrayscale()) {
+		for (size_t i = 0; i < count; ++i) {
+			const uint8_t* col = indices[i] == DitherCache::NoColour ? noColour : colours + static_cast<size_t>(indices[i]) * 3;
+
+			row[i * channels] = col[0];
+			if (channels == 2) row[i * channels + 1] = alpha[i];
+		}
+	} else if (channels == 4) {
+		for (size_t i = 0; i < count; ++i) {
+			const uint8_t* col = indices[i] == DitherCache::NoColour ? noColour : colours + static_cast<size_t>(indices[i]) * 3;
+
+			row[i * 4 + 0] = col[0];
+			row[i * 4 + 1] = col[1];
+			row[i * 4 + 2] = col[2];
+			row[i * 4 + 3] = alpha[i];
+		}
+	} else {
+		for (size_t i = 0; i < count; ++i) {
+			const uint8_t* col = indices[i] == DitherCache::NoColour ? noColour : colours + static_cast<size_t>(indices[i]) * 3;
+
+			row[i * 3 + 0] = col[0];
+			row[i * 3 + 1] = col[1];
+			row[i * 3 + 2] = col[2];
+		}
+	}
+}
+
+void DitherKernel::QuantiseAlpha(const double* alpha, const double* threshold, const unsigned int factor, uint8_t* out, const size_t count) {
+	// A factor of 0 divides by zero - left to the scalar version so it gives what it always has
+	if (factor == 0) {
+		QuantiseAlpha_Scalar(alpha, threshold, factor, out, count);
+		return;
+	}
+
+	switch (ColourBatch::GetInstructions()) {
+	case ColourBatch::Instructions::AVX2:
+		QuantiseAlpha_AVX2(alpha, threshold, factor, out, count);
+		break;
+	case ColourBatch::Instructions::SSE41:
+		QuantiseAlpha_SSE41(alpha, threshold, factor, out, count);
+		break;
+	default:
+		QuantiseAlpha_Scalar(alpha, threshold, factor, out, count);
+		break;
+	}
+}
+
+void DitherKernel::WriteAlpha(Image& image, const int x, const int y, const uint8_t* alpha, const size_t count) {
+	const size_t channels = static_cast<size_t>(image.GetChannels());
+	uint8_t* row = image.GetRow(y) + static_cast<size_t>(x) * channels + channels - 1;
+
+	for (size_t i = 0; i < count; ++i) row[i * channels] = alpha[i];
+}
+
+template<typename T>
+void DitherKernel::SelectIndices_Scalar(const T* alpha, const T* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count) {
+	for (size_t i = 0; i < count; ++i) out[i] = alpha[i] > threshold[i] ? i1[i] : i0[i];
+}
+
+void DitherKernel::QuantiseAlpha_Scalar(const double* alpha, const double* threshold, const unsigned int factor, uint8_t* out, const size_t count) {
+	const double r = 1. / static_cast<double>(factor);
+
+	for (size_t i = 0; i < count; ++i) {
+		double newAlpha = alpha[i];
+
+		if (newAlpha != 1. && newAlpha != 0.) {
+			if (threshold) {
+				newAlpha += (threshold[i] * -1) * r;
+				newAlpha = newAlpha < 0. ? 0. : (newAlpha > 1. ? 1. : newAlpha);
+			}
+
+			newAlpha = std::floor(static_cast<double>(factor + 1) * newAlpha) / static_cast<double>(factor);
+		}
+
+		out[i] = Dither::ToAlphaByte(newAlpha);
+	}
+}
+
+// Same steps as QuantiseAlpha_Scalar in the same order so every value is rounded the same way
+
+void DitherKernel::QuantiseAlpha_SSE41(const double* alpha, const double* threshold, const unsigned int factor, uint8_t* out, const size_t count) {
+	const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.), minusOne = _mm_set1_pd(-1.);
+	const __m128d r = _mm_set1_pd(1. / static_cast<double>(factor));
+	const __m128d levels = _mm_set1_pd(static_cast<double>(factor + 1)), divisor = _mm_set1_pd(static_cast<double>(factor));
+	const __m128d scale = _mm_set1_pd(256.), maxByte = _mm_set1_pd(255.);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const __m128d a = _mm_loadu_pd(alpha + i);
+		const __m128d keep = _mm_or_pd(_mm_cmpeq_pd(a, one), _mm_cmpeq_pd(a, zero));
+
+		__m128d newAlpha = a;
+		if (threshold) {
+			newAlpha = _mm_add_pd(newAlpha, _mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(threshold + i), minusOne), r));
+			newAlpha = _mm_min_pd(_mm_max_pd(newAlpha, zero), one);
+		}
+		newAlpha = _mm_div_pd(_mm_floor_pd(_mm_mul_pd(levels, newAlpha)), divisor);
+		newAlpha = _mm_blendv_pd(newAlpha, a, keep);
+
+		// Dither::ToAlphaByte
+		const __m128d bytes = _mm_max_pd(_mm_min_pd(_mm_floor_pd(_mm_mul_pd(newAlpha, scale)), maxByte), zero);
+		const __m128i ints = _mm_cvttpd_epi32(bytes);
+		out[i + 0] = static_cast<uint8_t>(_mm_cvtsi128_si32(ints));
+		out[i + 1] = static_cast<uint8_t>(_mm_extract_epi32(ints, 1));
+	}
+
+	QuantiseAlpha_Scalar(alpha + i, threshold ? threshold + i : nullptr, factor, out + i, count - i);
+}
+
+void DitherKernel::QuantiseAlpha_AVX2(const double* alpha, const double* threshold, const unsigned int factor, uint8_t* out, const size_t count) {
+	const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.), minusOne = _mm256_set1_pd(-1.);
+	const __m256d r = _mm256_set1_pd(1. / static_cast<double>(factor));
+	const __m256d levels = _mm256_set1_pd(static_cast<double>(factor + 1)), divisor = _mm256_set1_pd(static_cast<double>(factor));
+	const __m256d scale = _mm256_set1_pd(256.), maxByte = _mm256_set1_pd(255.);
+
+	// Low byte of each 32 bit lane
+	const __m128i packBytes = _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m256d a = _mm256_loadu_pd(alpha + i);
+		const __m256d keep = _mm256_or_pd(_mm256_cmp_pd(a, one, _CMP_EQ_OQ), _mm256_cmp_pd(a, zero, _CMP_EQ_OQ));
+
+		__m256d newAlpha = a;
+		if (threshold) {
+			newAlpha = _mm256_add_pd(newAlpha, _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(threshold + i), minusOne), r));
+			newAlpha = _mm256_min_pd(_mm256_max_pd(newAlpha, zero), one);
+		}
+		newAlpha = _mm256_div_pd(_mm256_floor_pd(_mm256_mul_pd(levels, newAlpha)), divisor);
+		newAlpha = _mm256_blendv_pd(newAlpha, a, keep);
+
+		// Dither::ToAlphaByte
+		const __m256d bytes = _mm256_max_pd(_mm256_min_pd(_mm256_floor_pd(_mm256_mul_pd(newAlpha, scale)), maxByte), zero);
+		const __m128i ints = _mm_shuffle_epi8(_mm256_cvttpd_epi32(bytes), packBytes);
+
+		const int packed = _mm_cvtsi128_si32(ints);
+		std::memcpy(out + i, &packed, 4);
+	}
+
+	QuantiseAlpha_Scalar(alpha + i, threshold ? threshold + i : nullptr, factor, out + i, count - i);
+}
+
+// ========== DOUBLE ==========
+
+void DitherKernel::SelectIndices_SSE41(const double* alpha, const double* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count) {
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		const __m128d greater = _mm_cmpgt_pd(_mm_loadu_pd(alpha + i), _mm_loadu_pd(threshold + i));
+
+		// 64 bit masks to the two low 32 bit lanes
+		const __m128i mask = _mm_shuffle_epi32(_mm_castpd_si128(greater), _MM_SHUFFLE(3, 1, 2, 0));
+
+		const __m128i p0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(i0 + i));
+		const __m128i p1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(i1 + i));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_blendv_epi8(p0, p1, mask));
+	}
+
+	SelectIndices_Scalar(alpha + i, threshold + i, i0 + i, i1 + i, out + i, count - i);
+}
+
+void DitherKernel::SelectIndices_AVX2(const double* alpha, const double* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count) {
+	const __m256i packLow = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m256d greater = _mm256_cmp_pd(_mm256_loadu_pd(alpha + i), _mm256_loadu_pd(threshold + i), _CMP_GT_OQ);
+
+		// 64 bit masks to the four low 32 bit lanes
+		const __m128i mask = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(greater), packLow));
+
+		const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i0 + i));
+		const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i1 + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_blendv_epi8(p0, p1, mask));
+	}
+
+	SelectIndices_Scalar(alpha + i, threshold + i, i0 + i, i1 + i, out + i, count - i);
+}
+
+// ========== FLOAT ==========
+
+void DitherKernel::SelectIndices_SSE41(const float* alpha, const float* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const __m128 greater = _mm_cmpgt_ps(_mm_loadu_ps(alpha + i), _mm_loadu_ps(threshold + i));
+
+		const __m128 p0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(i0 + i)));
+		const __m128 p1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(i1 + i)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_castps_si128(_mm_blendv_ps(p0, p1, greater)));
+	}
+
+	SelectIndices_Scalar(alpha + i, threshold + i, i0 + i, i1 + i, out + i, count - i);
+}
+
+void DitherKernel::SelectIndices_AVX2(const float* alpha, const float* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256 greater = _mm256_cmp_ps(_mm256_loadu_ps(alpha + i), _mm256_loadu_ps(threshold + i), _CMP_GT_OQ);
+
+		const __m256 p0 = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(i0 + i)));
+		const __m256 p1 = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(i1 + i)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_castps_si256(_mm256_blendv_ps(p0, p1, greater)));
+	}
+
+	SelectIndices_Scalar(alpha + i, threshold + i, i0 + i, i1 + i, out + i, count - i);
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "Image.h"
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// <para>Row kernels for ordered dithering and alpha - work on rows of palette indices and alpha instead of a Colour per pixel</para>
+/// <para>Uses AVX2 or SSE4.1 like ColourBatch - see ColourBatch::GetInstructions()</para>
+/// </summary>
+class DitherKernel {
+public:
+	DitherKernel() {};
+	~DitherKernel() {};
+
+	/// <summary>
+	/// out[i] = alpha[i] > threshold[i] ? i1[i] : i0[i]
+	/// </summary>
+	/// <param name="alpha">How far each colour is from i0 to i1</param>
+	/// <param name="threshold">Threshold row between 0 and 1</param>
+	/// <param name="i0"></param>
+	/// <param name="i1"></param>
+	/// <param name="out">Can be i0 or i1</param>
+	/// <param name="count"></param>
+	static void SelectIndices(const double* alpha, const double* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count);
+	static void SelectIndices(const float* alpha, const float* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count);
+
+	/// <summary>
+	/// <para>Writes 8 bit palette colours to a row of an image</para>
+	/// <para>Grayscale images take the red channel - alpha is only written if the image has an alpha channel</para>
+	/// </summary>
+	/// <param name="image"></param>
+	/// <param name="x">First pixel written</param>
+	/// <param name="y"></param>
+	/// <param name="indices">Index into colours - DitherCache::NoColour uses noColour</param>
+	/// <param name="alpha">8 bit alpha of each pixel</param>
+	/// <param name="colours">3 bytes (sRGB) for each palette colour</param>
+	/// <param name="noColour">3 bytes for pixels without a palette colour</param>
+	/// <param name="count"></param>
+	static void WriteRow(Image& image, const int x, const int y, const uint32_t* indices, const uint8_t* alpha,
+		const uint8_t* colours, const uint8_t* noColour, const size_t count);
+
+	/// <summary>
+	/// <para>8 bit alpha quantised to factor levels - the same as ordered and no dithering in Dither::DitherAlpha</para>
+	/// <para>0 and 1 are kept as they are</para>
+	/// </summary>
+	/// <param name="alpha">Alpha between 0 and 1</param>
+	/// <param name="threshold">Threshold row between -0.5 and 0.5 - nullptr for no dithering</param>
+	/// <param name="factor">ditherAlphaFactor</param>
+	/// <param name="out"></param>
+	/// <param name="count"></param>
+	static void QuantiseAlpha(const double* alpha, const double* threshold, const unsigned int factor, uint8_t* out, const size_t count);
+
+	/// <summary>
+	/// Writes only the alpha channel of a row - the image must have one
+	/// </summary>
+	/// <param name="image"></param>
+	/// <param name="x">First pixel written</param>
+	/// <param name="y"></param>
+	/// <param name="alpha"></param>
+	/// <param name="count"></param>
+	static void WriteAlpha(Image& image, const int x, const int y, const uint8_t* alpha, const size_t count);
+
+private:
+	template<typename T>
+	static void SelectIndices_Scalar(const T* alpha, const T* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count);
+
+	static void SelectIndices_SSE41(const double* alpha, const double* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count);
+	static void SelectIndices_AVX2(const double* alpha, const double* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count);
+
+	static void SelectIndices_SSE41(const float* alpha, const float* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count);
+	static void SelectIndices_AVX2(const float* alpha, const float* threshold, const uint32_t* i0, const uint32_t* i1, uint32_t* out, const size_t count);
+
+	static void QuantiseAlpha_Scalar(const double* alpha, const double* threshold, const unsigned int factor, uint8_t* out, const size_t count);
+	static void QuantiseAlpha_SSE41(const double* alpha, const double* threshold, const unsigned int factor, uint8_t* out, const size_t count);
+	static void QuantiseAlpha_AVX2(const double* alpha, const double* threshold, const unsigned int factor, uint8_t* out, const size_t count);
+};
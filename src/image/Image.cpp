@@ -1,9 +1,13 @@
 #include "Image.h"
+#include "PNGEncoder.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <filesystem>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -42,7 +46,7 @@ Image::Image(const int w, const int h, const int channels) {
 	m_w = w;
 	m_h = h;
 	m_channels = channels;
-	m_size = (size_t)(m_w * m_h * m_channels);
+	m_size = (size_t)m_w * (size_t)m_h * (size_t)m_channels;
 
 	m_data = new uint8_t[m_size];
 }
@@ -134,7 +138,11 @@ bool Image::Write(const char* file) const {
 
 	switch (type) {
 	case Image::ImageType::PNG:
-		success = stbi_write_png(file, m_w, m_h, m_channels, m_data, m_w * m_channels);
+		if (PNGEncoder::GetCompression() == PNGEncoder::Compression::Default) {
+			success = stbi_write_png(file, m_w, m_h, m_channels, m_data, m_w * m_channels);
+		} else {
+			success = PNGEncoder::Write(file, m_data, m_w, m_h, m_channels);
+		}
 		break;
 	case Image::ImageType::JPG:
 		success = stbi_write_jpg(file, m_w, m_h, m_channels, m_data, 100);
@@ -175,6 +183,136 @@ bool Image::Write(const char* file) const {
 	return success != 0;
 }
 
+bool Image::WriteIndexed(const char* file) const {
+	if (GetFileType(file) != ImageType::PNG || m_size == 0) return Write(file);
+
+	const size_t pixelCount = static_cast<size_t>(m_w) * static_cast<size_t>(m_h);
+	const size_t channels = static_cast<size_t>(m_channels);
+	const bool gray = m_channels <= 2;
+	const bool alpha = m_channels == 2 || m_channels == 4;
+
+	// Palette index of every pixel - colours are RGBA packed into a uint32_t in the order they're found
+	std::vector<uint8_t> indices(pixelCount);
+	std::vector<uint32_t> colours;
+	std::unordered_map<uint32_t, uint8_t> lookup;
+
+	uint32_t lastColour = 0;
+	uint8_t lastIndex = 0;
+	for (size_t i = 0; i < pixelCount; ++i) {
+		const uint8_t* pixel = m_data + i * channels;
+		const uint32_t r = pixel[0];
+		const uint32_t g = gray ? r : pixel[1];
+		const uint32_t b = gray ? r : pixel[2];
+		const uint32_t a = alpha ? pixel[channels - 1] : 255;
+		const uint32_t colour = r | (g << 8) | (b << 16) | (a << 24);
+
+		// Neighbouring pixels are often the same colour
+		if (i > 0 && colour == lastColour) {
+			indices[i] = lastIndex;
+			continue;
+		}
+
+		auto found = lookup.find(colour);
+		if (found == lookup.end()) {
+			if (colours.size() == 256) {
+				Log::WriteOneLine("More than 256 colours - writing without a palette");
+				return Write(file);
+			}
+
+			found = lookup.emplace(colour, static_cast<uint8_t>(colours.size())).first;
+			colours.push_back(colour);
+		}
+
+		lastColour = colour;
+		lastIndex = found->second;
+		indices[i] = lastIndex;
+	}
+
+	return WritePalette(file, indices, colours);
+}
+
+bool Image::WriteIndexed(const char* file, const std::vector<uint32_t>& paletteIndices, const size_t paletteSize) const {
+	const size_t pixelCount = static_cast<size_t>(m_w) * static_cast<size_t>(m_h);
+
+	// 4096 colours is a 2MB table - more than that is quicker to search as usual
+	if (GetFileType(file) != ImageType::PNG || m_size == 0 || paletteIndices.size() != pixelCount || paletteSize == 0 || paletteSize > 4096) {
+		return WriteIndexed(file);
+	}
+
+	const size_t channels = static_cast<size_t>(m_channels);
+	const bool gray = m_channels <= 2;
+	const bool alpha = m_channels == 2 || m_channels == 4;
+
+	// PNG palette index of each palette index and alpha - the colours are still taken from the pixels
+	// so the file is the same as WriteIndexed(file)
+	const uint16_t empty = 0xFFFF;
+	std::vector<uint16_t> slots(paletteSize * 256, empty);
+
+	std::vector<uint8_t> indices(pixelCount);
+	std::vector<uint32_t> colours;
+	std::unordered_map<uint32_t, uint8_t> lookup;
+
+	for (size_t i = 0; i < pixelCount; ++i) {
+		const uint8_t* pixel = m_data + i * channels;
+		const uint32_t a = alpha ? pixel[channels - 1] : 255;
+
+		// DitherCache::NoColour or an out of date plane
+		if (paletteIndices[i] >= paletteSize) return WriteIndexed(file);
+
+		uint16_t& slot = slots[static_cast<size_t>(paletteIndices[i]) * 256 + a];
+		if (slot == empty) {
+			const uint32_t r = pixel[0];
+			const uint32_t g = gray ? r : pixel[1];
+			const uint32_t b = gray ? r : pixel[2];
+			const uint32_t colour = r | (g << 8) | (b << 16) | (a << 24);
+
+			auto found = lookup.find(colour);
+			if (found == lookup.end()) {
+				if (colours.size() == 256) {
+					Log::WriteOneLine("More than 256 colours - writing without a palette");
+					return Write(file);
+				}
+
+				found = lookup.emplace(colour, static_cast<uint8_t>(colours.size())).first;
+				colours.push_back(colour);
+			}
+
+			slot = found->second;
+		}
+
+		indices[i] = static_cast<uint8_t>(slot);
+	}
+
+	return WritePalette(file, indices, colours);
+}
+
+bool Image::WritePalette(const char* file, std::vector<uint8_t>& indices, const std::vector<uint32_t>& colours) const {
+	// Transparent colours first so the tRNS chunk is as short as it can be
+	std::vector<uint8_t> order(colours.size());
+	for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<uint8_t>(i);
+	std::stable_partition(order.begin(), order.end(), [&colours](const uint8_t i) { return (colours[i] >> 24) != 255; });
+
+	uint8_t remap[256] = {};
+	std::vector<uint8_t> palette;
+	for (size_t i = 0; i < order.size(); ++i) {
+		remap[order[i]] = static_cast<uint8_t>(i);
+		for (int shift = 0; shift < 32; shift += 8) palette.push_back(static_cast<uint8_t>(colours[order[i]] >> shift));
+	}
+	for (uint8_t& index : indices) index = remap[index];
+
+	const std::filesystem::path p = file;
+	if (!p.parent_path().empty() && !std::filesystem::exists(p.parent_path())) std::filesystem::create_directory(p.parent_path());
+
+	const bool success = PNGEncoder::WriteIndexed(file, indices.data(), m_w, m_h, palette);
+
+	Log::StartLine();
+	Log::Write(success ? "Write success " : "Write fail ");
+	Log::Write(file);
+	Log::EndLine();
+
+	return success;
+}
+
 size_t Image::GetIndex(const int x, const int y) const {
 	if (x < 0 || x >= m_w || y < 0 || y >= m_h) return (size_t)NAN;
 	return size_t((x + y * m_w) * m_channels);
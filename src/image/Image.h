@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <vector>
 
 class Image {
 public:
@@ -19,12 +20,36 @@ public:
 	bool Read(const char* file, const int forceChannels = 0);
 	bool Write(const char* file) const;
 
+	/// <summary>
+	/// <para>Writes a PNG with a palette of the colours in the image - 1, 2, 4 or 8 bits per pixel</para>
+	/// <para>Same as Write for other file types or more than 256 colours</para>
+	/// </summary>
+	/// <param name="file"></param>
+	/// <returns></returns>
+	bool WriteIndexed(const char* file) const;
+
+	/// <summary>
+	/// <para>Same file as WriteIndexed(file) but the colours are found once for each palette index and alpha instead of for every pixel</para>
+	/// <para>Falls back to WriteIndexed(file) if an index is missing or the plane isn't the size of the image</para>
+	/// </summary>
+	/// <param name="file"></param>
+	/// <param name="paletteIndices">Palette index of every pixel, row by row - Dither::GetIndices()</param>
+	/// <param name="paletteSize"></param>
+	/// <returns></returns>
+	bool WriteIndexed(const char* file, const std::vector<uint32_t>& paletteIndices, const size_t paletteSize) const;
+
 	inline int GetChannels() const { return m_channels; };
 	inline size_t GetSize() const { return m_size; };
 
 	inline uint8_t GetData(const size_t index) const { return m_data[index]; };
 	inline void SetData(const size_t index, const uint8_t data) { m_data[index] = data; };
 
+	/// <summary>
+	/// Start of a row - GetWidth() * GetChannels() bytes
+	/// </summary>
+	inline uint8_t* GetRow(const int y) { return m_data + GetIndex_s(0, y, m_w, m_channels); };
+	inline const uint8_t* GetRow(const int y) const { return m_data + GetIndex_s(0, y, m_w, m_channels); };
+
 	size_t GetIndex(const int x, const int y) const;
 
 	/// <summary>
@@ -58,6 +83,15 @@ public:
 	void ToRGB();
 
 private:
+	/// <summary>
+	/// Writes the palette PNG once every pixel has an index into colours
+	/// </summary>
+	/// <param name="file"></param>
+	/// <param name="indices"></param>
+	/// <param name="colours">RGBA packed into a uint32_t in the order they were found</param>
+	/// <returns></returns>
+	bool WritePalette(const char* file, std::vector<uint8_t>& indices, const std::vector<uint32_t>& colours) const;
+
 	uint8_t* m_data;
 	size_t m_size = 0;
 	int m_w, m_h, m_channels;
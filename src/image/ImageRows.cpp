@@ -0,0 +1,126 @@
+#include "../wrapper/Log.h"
+#include "Image.h"
+#include "ImageRows.h"
+#include "ImageStream.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+
+// ========== MEMORY ROWS ==========
+
+MemoryRows::MemoryRows(Image& image) : m_image(image) {
+	m_w = image.GetWidth();
+	m_h = image.GetHeight();
+	m_channels = image.GetChannels();
+	m_bandHeight = m_h;
+	m_firstRow = 0;
+}
+
+bool MemoryRows::ForEachRow(const std::function<void(const Image& image, const int imageY)>& func) {
+	for (int y = 0; y < m_h; ++y) func(m_image, y);
+	return true;
+}
+
+// ========== STREAM ROWS ==========
+
+StreamRows::StreamRows(const int bandHeight) {
+	m_bandHeight = std::max(bandHeight, 1);
+}
+
+bool StreamRows::Open(const std::string& input, const Transform& transform) {
+	m_input = input;
+	m_transform = transform;
+	m_firstRow = 0;
+	m_loadedEnd = 0;
+
+	const bool success = m_reader.Open(input);
+
+	Log::StartLine();
+	Log::Write(success ? "Read success " : "Read failed ");
+	Log::Write(input);
+	Log::EndLine();
+
+	if (!success) return false;
+
+	m_w = m_reader.GetWidth();
+	m_h = m_reader.GetHeight();
+
+	// Transform a blank row to find the channels the rows end up with
+	Image row(m_w, 1, m_reader.GetChannels());
+	row.Clear();
+	if (m_transform) m_transform(row);
+	m_channels = row.GetChannels();
+
+	m_bandHeight = std::min(m_bandHeight, m_h);
+	try {
+		m_band = Image(m_w, std::min(m_bandHeight + 1, m_h), m_channels);
+	} catch (const std::bad_alloc&) {
+		Log::WriteOneLine("Not enough memory for " + Log::ToString(m_bandHeight) + " rows");
+		return false;
+	}
+
+	Log::WriteOneLine("Streaming " + Log::ToString(m_bandHeight) + " rows at a time");
+	return true;
+}
+
+bool StreamRows::OpenOutput(const std::string& output) {
+	return m_writer.Open(output, m_w, m_h, m_channels);
+}
+
+bool StreamRows::Load(const int first, const int last) {
+	if (first < m_firstRow || last - first > m_band.GetHeight() || last > m_h) return false;
+
+	// Rows above the band are finished
+	const int finishedEnd = std::min(first, m_loadedEnd);
+	for (int y = m_firstRow; y < finishedEnd; ++y) {
+		if (!m_writer.WriteRow(m_band.GetRow(y - m_firstRow))) return false;
+	}
+
+	// Rows still needed go to the top
+	const size_t rowBytes = static_cast<size_t>(m_w) * static_cast<size_t>(m_channels);
+	const int kept = m_loadedEnd - first;
+	if (kept > 0 && first > m_firstRow) {
+		std::memmove(m_band.GetRow(0), m_band.GetRow(first - m_firstRow), static_cast<size_t>(kept) * rowBytes);
+	}
+	m_firstRow = first;
+
+	Image row;
+	for (int y = std::max(m_loadedEnd, first); y < last; ++y) {
+		if (!ReadRow(m_reader, row)) return false;
+		std::memcpy(m_band.GetRow(y - first), row.GetRow(0), rowBytes);
+	}
+	m_loadedEnd = std::max(m_loadedEnd, last);
+
+	return true;
+}
+
+bool StreamRows::ForEachRow(const std::function<void(const Image& image, const int imageY)>& func) {
+	// Second pass over the file - the rows being dithered are left alone
+	ImageReader reader;
+	if (!reader.Open(m_input)) return false;
+
+	Image row;
+	for (int y = 0; y < m_h; ++y) {
+		if (!ReadRow(reader, row)) return false;
+		func(row, 0);
+	}
+	return true;
+}
+
+bool StreamRows::Finish() {
+	bool success = Load(m_loadedEnd, m_loadedEnd);
+	if (success && m_loadedEnd != m_h) success = false;
+
+	return m_writer.Close() && success;
+}
+
+bool StreamRows::ReadRow(ImageReader& reader, Image& row) {
+	row = Image(m_w, 1, reader.GetChannels());
+	if (!reader.ReadRow(row.GetRow(0))) return false;
+
+	if (m_transform) m_transform(row);
+	return row.GetChannels() == m_channels;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "Image.h"
+#include "ImageStream.h"
+#include <functional>
+#include <string>
+
+/// <summary>
+/// <para>Rows of an image for the dither passes - loaded a band of rows at a time</para>
+/// <para>MemoryRows gives a whole Image as one band, StreamRows reads and writes files so only a band is in memory</para>
+/// </summary>
+class ImageRows {
+public:
+	virtual ~ImageRows() {};
+
+	inline int GetWidth() const { return m_w; };
+	inline int GetHeight() const { return m_h; };
+	inline int GetChannels() const { return m_channels; };
+	inline bool HasAlphaChannel() const { return m_channels == 2 || m_channels == 4; };
+
+	/// <summary>
+	/// Rows dithered at a time - the image height when every row is in memory
+	/// </summary>
+	inline int GetBandHeight() const { return m_bandHeight; };
+
+	/// <summary>
+	/// Image row that is row 0 of GetImage()
+	/// </summary>
+	inline int GetFirstRow() const { return m_firstRow; };
+
+	/// <summary>
+	/// Rows loaded by the last Load()
+	/// </summary>
+	/// <returns></returns>
+	virtual Image& GetImage() = 0;
+
+	/// <summary>
+	/// Makes rows first to last - 1 readable and writable through GetImage() - rows before first are finished
+	/// </summary>
+	/// <param name="first">Can't go back up</param>
+	/// <param name="last">At most GetBandHeight() + 1 rows after first</param>
+	/// <returns></returns>
+	virtual bool Load(const int first, const int last) = 0;
+
+	/// <summary>
+	/// For passes that need every row before dithering - calls func for row imageY of image from the top
+	/// </summary>
+	/// <param name="func"></param>
+	/// <returns></returns>
+	virtual bool ForEachRow(const std::function<void(const Image& image, const int imageY)>& func) = 0;
+
+	/// <summary>
+	/// Writes out the rows that are still loaded
+	/// </summary>
+	/// <returns></returns>
+	virtual bool Finish() = 0;
+
+protected:
+	int m_w = 0, m_h = 0, m_channels = 0;
+	int m_bandHeight = 0, m_firstRow = 0;
+};
+
+/// <summary>
+/// Whole Image in memory - dithered as one band
+/// </summary>
+class MemoryRows : public ImageRows {
+public:
+	MemoryRows(Image& image);
+	~MemoryRows() {};
+
+	Image& GetImage() override { return m_image; };
+
+	bool Load(const int /*first*/, const int /*last*/) override { return true; };
+	bool ForEachRow(const std::function<void(const Image& image, const int imageY)>& func) override;
+	bool Finish() override { return true; };
+
+private:
+	Image& m_image;
+};
+
+/// <summary>
+/// <para>Reads the input and writes the output a band of rows at a time - for images too big to load</para>
+/// <para>PNG and BMP only, see ImageReader</para>
+/// </summary>
+class StreamRows : public ImageRows {
+public:
+	/// <summary>
+	/// Changes a row as it's read, like converting to RGB - can change the channels but not the size
+	/// </summary>
+	typedef std::function<void(Image& row)> Transform;
+
+	/// <summary>
+	/// </summary>
+	/// <param name="bandHeight">Rows dithered at a time</param>
+	StreamRows(const int bandHeight = 64);
+	~StreamRows() {};
+
+	/// <summary>
+	/// Reads the size of the input
+	/// </summary>
+	/// <param name="input"></param>
+	/// <param name="transform">Done to every row read</param>
+	/// <returns></returns>
+	bool Open(const std::string& input, const Transform& transform);
+
+	/// <summary>
+	/// Where finished rows are written - has the channels of the transformed rows
+	/// </summary>
+	/// <param name="output"></param>
+	/// <returns></returns>
+	bool OpenOutput(const std::string& output);
+
+	Image& GetImage() override { return m_band; };
+
+	bool Load(const int first, const int last) override;
+	bool ForEachRow(const std::function<void(const Image& image, const int imageY)>& func) override;
+	bool Finish() override;
+
+private:
+	std::string m_input;
+	Transform m_transform;
+
+	ImageReader m_reader;
+	ImageWriter m_writer;
+
+	// Band and the row after it - image rows m_firstRow to m_loadedEnd - 1
+	Image m_band;
+	int m_loadedEnd = 0;
+
+	bool ReadRow(ImageReader& reader, Image& row);
+};
@@ -0,0 +1,803 @@
+#include "../misc/ZStream.h"
+#include "../wrapper/Log.h"
+#include "Image.h"
+#include "ImageStream.h"
+#include "PNGEncoder.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+static uint32_t ReadBE32(const uint8_t* data) {
+	return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+		(static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+}
+
+static uint16_t ReadBE16(const uint8_t* data) {
+	return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+static uint32_t ReadLE32(const uint8_t* data) {
+	return (static_cast<uint32_t>(data[3]) << 24) | (static_cast<uint32_t>(data[2]) << 16) |
+		(static_cast<uint32_t>(data[1]) << 8) | static_cast<uint32_t>(data[0]);
+}
+
+static uint16_t ReadLE16(const uint8_t* data) {
+	return static_cast<uint16_t>((data[1] << 8) | data[0]);
+}
+
+static void PutBE32(std::vector<uint8_t>& data, const uint32_t value) {
+	for (int shift = 24; shift >= 0; shift -= 8) data.push_back(static_cast<uint8_t>(value >> shift));
+}
+
+static void PutLE32(std::vector<uint8_t>& data, const uint32_t value) {
+	for (int shift = 0; shift < 32; shift += 8) data.push_back(static_cast<uint8_t>(value >> shift));
+}
+
+static void PutLE16(std::vector<uint8_t>& data, const uint16_t value) {
+	data.push_back(static_cast<uint8_t>(value));
+	data.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+static int Paeth(const int a, const int b, const int c) {
+	const int p = a + b - c;
+	const int pa = std::abs(p - a);
+	const int pb = std::abs(p - b);
+	const int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
+
+// Same as stb_image - scales a masked BMP value to 8 bits
+static int HighBit(uint32_t z) {
+	if (z == 0) return -1;
+	int n = 0;
+	if (z >= 0x10000) { n += 16; z >>= 16; }
+	if (z >= 0x00100) { n += 8; z >>= 8; }
+	if (z >= 0x00010) { n += 4; z >>= 4; }
+	if (z >= 0x00004) { n += 2; z >>= 2; }
+	if (z >= 0x00002) { n += 1; }
+	return n;
+}
+
+static int BitCount(uint32_t a) {
+	int count = 0;
+	for (; a != 0; a &= a - 1) ++count;
+	return count;
+}
+
+static uint8_t ShiftMasked(uint32_t v, const int shift, const int bits) {
+	static const uint32_t mulTable[9] = { 0, 0xff, 0x55, 0x49, 0x11, 0x21, 0x41, 0x81, 0x01 };
+	static const uint32_t shiftTable[9] = { 0, 0, 0, 1, 0, 2, 4, 6, 0 };
+
+	if (shift < 0) {
+		v <<= -shift;
+	} else {
+		v >>= shift;
+	}
+	v &= 0xff;
+	v >>= (8 - bits);
+	return static_cast<uint8_t>((v * mulTable[bits]) >> shiftTable[bits]);
+}
+
+// ========== READER ==========
+
+bool ImageReader::CanStream(const char* file) {
+	const Image::ImageType type = Image::GetFileType(file);
+	return type == Image::ImageType::PNG || type == Image::ImageType::BMP;
+}
+
+bool ImageReader::Open(const std::string& file) {
+	m_type = Image::GetFileType(file.c_str());
+	m_y = 0;
+
+	if (m_file.is_open()) m_file.close();
+	m_file.clear();
+
+	if (!CanStream(file.c_str())) {
+		Log::WriteOneLine("File type can't be streamed - PNG or BMP");
+		return false;
+	}
+
+	m_file.open(file, std::ios::binary);
+	if (!m_file) return false;
+
+	if (!(m_type == Image::ImageType::PNG ? OpenPNG() : OpenBMP())) return false;
+
+	// Every size worked out from these has to fit in a size_t
+	if (static_cast<size_t>(m_h) > std::numeric_limits<size_t>::max() / (static_cast<size_t>(m_w) * static_cast<size_t>(m_channels))) {
+		Log::WriteOneLine("Image too large");
+		return false;
+	}
+	return true;
+}
+
+bool ImageReader::ReadRow(uint8_t* row) {
+	if (m_y >= m_h) return false;
+
+	const bool success = m_type == Image::ImageType::PNG ? ReadRowPNG(row) : ReadRowBMP(row);
+	if (success) ++m_y;
+	return success;
+}
+
+bool ImageReader::OpenPNG() {
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	uint8_t header[13] = {};
+	m_file.read(reinterpret_cast<char*>(header), 8);
+	if (!m_file || std::memcmp(header, signature, 8) != 0) {
+		Log::WriteOneLine("Corrupt PNG");
+		return false;
+	}
+
+	m_palette.clear();
+	m_hasTransparency = false;
+	bool hasHeader = false;
+	int interlace = 0;
+
+	while (true) {
+		uint8_t chunk[8] = {};
+		m_file.read(reinterpret_cast<char*>(chunk), 8);
+		if (!m_file) {
+			Log::WriteOneLine("Corrupt PNG - no image data");
+			return false;
+		}
+
+		const uint32_t length = ReadBE32(chunk);
+		const std::string type(reinterpret_cast<const char*>(chunk + 4), 4);
+		if (length > MaxChunkLength) {
+			Log::WriteOneLine("Corrupt PNG - bad chunk length");
+			return false;
+		}
+
+		std::vector<uint8_t> data;
+		if (type == "IHDR" || type == "PLTE" || type == "tRNS") {
+			// Checked before reading so a bad length can't make a huge buffer
+			if ((type == "IHDR" && length != 13) || (type == "PLTE" && (length % 3 != 0 || length > 768)) || (type == "tRNS" && length > 256)) {
+				Log::WriteOneLine("Corrupt PNG - bad " + type);
+				return false;
+			}
+
+			data.resize(length);
+			uint8_t crc[4] = {};
+			m_file.read(reinterpret_cast<char*>(data.data()), length);
+			m_file.read(reinterpret_cast<char*>(crc), 4);
+			if (!m_file) {
+				Log::WriteOneLine("Corrupt PNG");
+				return false;
+			}
+			if (ReadBE32(crc) != PNGEncoder::CRC32(type.c_str(), data.data(), data.size())) {
+				Log::WriteOneLine("Corrupt PNG - bad " + type + " CRC");
+				return false;
+			}
+		}
+
+		if (type == "IHDR") {
+			const uint32_t w = ReadBE32(data.data());
+			const uint32_t h = ReadBE32(data.data() + 4);
+			if (w > static_cast<uint32_t>(MaxDimension) || h > static_cast<uint32_t>(MaxDimension)) {
+				Log::WriteOneLine("PNG too large: " + Log::ToString(static_cast<size_t>(w)) + " x " + Log::ToString(static_cast<size_t>(h)));
+				return false;
+			}
+
+			m_w = static_cast<int>(w);
+			m_h = static_cast<int>(h);
+			m_depth = data[8];
+			m_colourType = data[9];
+			interlace = data[12];
+
+			const bool validDepth = m_depth == 1 || m_depth == 2 || m_depth == 4 || m_depth == 8 || m_depth == 16;
+			const bool validType = m_colourType == 0 || (m_colourType == 3 && m_depth <= 8) ||
+				((m_colourType == 2 || m_colourType == 4 || m_colourType == 6) && m_depth >= 8);
+
+			if (m_w <= 0 || m_h <= 0 || !validDepth || !validType || data[10] != 0 || data[11] != 0 || interlace > 1) {
+				Log::WriteOneLine("Corrupt PNG - bad IHDR");
+				return false;
+			}
+			if (interlace == 1) {
+				Log::WriteOneLine("Interlaced PNGs can't be streamed");
+				return false;
+			}
+
+			hasHeader = true;
+		} else if (type == "PLTE") {
+			m_palette.assign(256 * 4, 0);
+			for (size_t i = 0; i < length / 3; ++i) {
+				m_palette[i * 4 + 0] = data[i * 3 + 0];
+				m_palette[i * 4 + 1] = data[i * 3 + 1];
+				m_palette[i * 4 + 2] = data[i * 3 + 2];
+				m_palette[i * 4 + 3] = 255;
+			}
+		} else if (type == "tRNS") {
+			if (m_colourType == 3) {
+				if (m_palette.empty()) {
+					Log::WriteOneLine("Corrupt PNG - bad tRNS");
+					return false;
+				}
+				for (size_t i = 0; i < length; ++i) m_palette[i * 4 + 3] = data[i];
+			} else if ((m_colourType == 0 && length == 2) || (m_colourType == 2 && length == 6)) {
+				for (size_t i = 0; i < length / 2; ++i) m_transparent[i] = ReadBE16(data.data() + i * 2);
+			} else {
+				Log::WriteOneLine("Corrupt PNG - bad tRNS");
+				return false;
+			}
+			m_hasTransparency = true;
+		} else if (type == "IDAT") {
+			if (!hasHeader || (m_colourType == 3 && m_palette.empty())) {
+				Log::WriteOneLine("Corrupt PNG");
+				return false;
+			}
+			m_chunkLeft = length;
+			break;
+		} else if (type == "CgBI") {
+			Log::WriteOneLine("iPhone PNGs can't be streamed");
+			return false;
+		} else if (type == "IEND") {
+			Log::WriteOneLine("Corrupt PNG - no image data");
+			return false;
+		} else {
+			// Unknown critical chunks can't be skipped
+			if (chunk[4] >= 'A' && chunk[4] <= 'Z') {
+				Log::WriteOneLine("PNG not supported: unknown PNG chunk type");
+				return false;
+			}
+			m_file.ignore(static_cast<std::streamsize>(length) + 4);
+		}
+	}
+
+	const int samples[7] = { 1, 0, 3, 1, 2, 0, 4 };
+	m_samples = samples[m_colourType];
+
+	const size_t bitsPerPixel = static_cast<size_t>(m_samples) * static_cast<size_t>(m_depth);
+	m_filterBytes = std::max(1, static_cast<int>(bitsPerPixel / 8));
+	m_rowBytes = (static_cast<size_t>(m_w) * bitsPerPixel + 7) / 8;
+
+	if (m_colourType == 3) {
+		m_channels = m_hasTransparency ? 4 : 3;
+	} else {
+		m_channels = m_samples + (m_hasTransparency ? 1 : 0);
+	}
+
+	m_current.assign(m_rowBytes, 0);
+	m_previous.assign(m_rowBytes, 0);
+	m_chunksDone = false;
+
+	m_inflater.Reset([this](uint8_t* data, const size_t size) { return ReadIDAT(data, size); });
+	return true;
+}
+
+size_t ImageReader::ReadIDAT(uint8_t* data, const size_t size) {
+	size_t total = 0;
+	while (total < size) {
+		if (m_chunkLeft == 0 && !NextIDAT()) break;
+
+		const size_t count = std::min(size - total, static_cast<size_t>(m_chunkLeft));
+		m_file.read(reinterpret_cast<char*>(data + total), static_cast<std::streamsize>(count));
+
+		const size_t read = static_cast<size_t>(m_file.gcount());
+		total += read;
+		m_chunkLeft -= static_cast<uint32_t>(read);
+
+		if (read < count) {
+			m_chunksDone = true;
+			break;
+		}
+	}
+	return total;
+}
+
+bool ImageReader::NextIDAT() {
+	if (m_chunksDone) return false;
+
+	uint8_t chunk[12] = {};
+	m_file.read(reinterpret_cast<char*>(chunk), 12); // CRC of the last chunk and the next header
+	if (!m_file || std::memcmp(chunk + 8, "IDAT", 4) != 0) {
+		m_chunksDone = true;
+		return false;
+	}
+
+	m_chunkLeft = ReadBE32(chunk + 4);
+	if (m_chunkLeft > MaxChunkLength) {
+		m_chunkLeft = 0;
+		m_chunksDone = true;
+		return false;
+	}
+	return true;
+}
+
+bool ImageReader::ReadRowPNG(uint8_t* row) {
+	uint8_t filter = 0;
+	if (m_inflater.Read(&filter, 1) != 1 || m_inflater.Read(m_current.data(), m_rowBytes) != m_rowBytes || filter > 4) {
+		Log::WriteOneLine("Corrupt PNG - row " + Log::ToString(m_y));
+		return false;
+	}
+
+	// Undo the filter - the row above the first is zeros
+	uint8_t* cur = m_current.data();
+	const uint8_t* prev = m_previous.data();
+	const size_t bpp = static_cast<size_t>(m_filterBytes);
+	for (size_t i = 0; i < m_rowBytes; ++i) {
+		const int a = i >= bpp ? cur[i - bpp] : 0;
+		const int b = prev[i];
+		const int c = i >= bpp ? prev[i - bpp] : 0;
+
+		switch (filter) {
+		case 1: cur[i] = static_cast<uint8_t>(cur[i] + a); break;
+		case 2: cur[i] = static_cast<uint8_t>(cur[i] + b); break;
+		case 3: cur[i] = static_cast<uint8_t>(cur[i] + ((a + b) >> 1)); break;
+		case 4: cur[i] = static_cast<uint8_t>(cur[i] + Paeth(a, b, c)); break;
+		default: break;
+		}
+	}
+
+	const size_t w = static_cast<size_t>(m_w);
+	const size_t samples = static_cast<size_t>(m_samples);
+	const size_t channels = static_cast<size_t>(m_channels);
+	const bool keyAlpha = m_hasTransparency && m_colourType != 3;
+
+	if (m_depth == 16) {
+		// stb_image keeps the high byte - transparency compares all 16 bits
+		for (size_t x = 0; x < w; ++x) {
+			bool transparent = keyAlpha;
+			for (size_t s = 0; s < samples; ++s) {
+				const uint16_t value = ReadBE16(cur + (x * samples + s) * 2);
+				row[x * channels + s] = static_cast<uint8_t>(value >> 8);
+				if (keyAlpha && value != m_transparent[s]) transparent = false;
+			}
+			if (keyAlpha) row[x * channels + samples] = transparent ? 0 : 255;
+		}
+	} else if (m_colourType == 3) {
+		const int mask = (1 << m_depth) - 1;
+		for (size_t x = 0; x < w; ++x) {
+			const size_t bit = x * static_cast<size_t>(m_depth);
+			const size_t index = (cur[bit / 8] >> (8 - m_depth - static_cast<int>(bit % 8))) & mask;
+			for (size_t c = 0; c < channels; ++c) row[x * channels + c] = m_palette[index * 4 + c];
+		}
+	} else {
+		// Low bit depths are stretched to 8 bits like stb_image
+		const int scales[9] = { 0, 0xff, 0x55, 0, 0x11, 0, 0, 0, 0x01 };
+		const int scale = scales[m_depth];
+		const int mask = (1 << m_depth) - 1;
+
+		uint8_t key[3] = { 0, 0, 0 };
+		for (size_t s = 0; s < 3; ++s) key[s] = static_cast<uint8_t>((m_transparent[s] & 255) * scale);
+
+		for (size_t x = 0; x < w; ++x) {
+			bool transparent = keyAlpha;
+			for (size_t s = 0; s < samples; ++s) {
+				uint8_t value = 0;
+				if (m_depth == 8) {
+					value = cur[x * samples + s];
+				} else {
+					const size_t bit = x * static_cast<size_t>(m_depth);
+					value = static_cast<uint8_t>(((cur[bit / 8] >> (8 - m_depth - static_cast<int>(bit % 8))) & mask) * scale);
+				}
+				row[x * channels + s] = value;
+				if (keyAlpha && value != key[s]) transparent = false;
+			}
+			if (keyAlpha) row[x * channels + samples] = transparent ? 0 : 255;
+		}
+	}
+
+	m_current.swap(m_previous);
+	return true;
+}
+
+bool ImageReader::OpenBMP() {
+	uint8_t header[14 + 124 + 12] = {};
+	m_file.read(reinterpret_cast<char*>(header), 18);
+	if (!m_file || header[0] != 'B' || header[1] != 'M') {
+		Log::WriteOneLine("Corrupt BMP");
+		return false;
+	}
+
+	m_offset = ReadLE32(header + 10);
+	const uint32_t hsz = ReadLE32(header + 14);
+	if (hsz != 12 && hsz != 40 && hsz != 56 && hsz != 108 && hsz != 124) {
+		Log::WriteOneLine("BMP type not supported: unknown");
+		return false;
+	}
+
+	// Header and the bitfield masks that can come after it
+	m_file.read(reinterpret_cast<char*>(header + 18), static_cast<std::streamsize>(hsz - 4 + 12));
+	m_file.clear();
+
+	const uint8_t* info = header + 14;
+	int32_t height = 0;
+	if (hsz == 12) {
+		m_w = ReadLE16(info + 4);
+		height = ReadLE16(info + 6);
+	} else {
+		m_w = static_cast<int32_t>(ReadLE32(info + 4));
+		height = static_cast<int32_t>(ReadLE32(info + 8));
+	}
+
+	const size_t fieldStart = hsz == 12 ? 8 : 12;
+	if (ReadLE16(info + fieldStart) != 1) {
+		Log::WriteOneLine("Corrupt BMP");
+		return false;
+	}
+	m_bpp = ReadLE16(info + fieldStart + 2);
+
+	uint32_t extraRead = 14;
+	uint32_t compress = 0;
+	m_masks[0] = m_masks[1] = m_masks[2] = m_masks[3] = 0;
+	m_allAlphaZero = false;
+	bool checkAlpha = false;
+
+	auto setDefaultMasks = [&]() {
+		if (m_bpp == 16) {
+			m_masks[0] = 31u << 10;
+			m_masks[1] = 31u << 5;
+			m_masks[2] = 31u;
+		} else if (m_bpp == 32) {
+			m_masks[0] = 0xffu << 16;
+			m_masks[1] = 0xffu << 8;
+			m_masks[2] = 0xffu;
+			m_masks[3] = 0xffu << 24;
+			checkAlpha = true;
+		} else {
+			m_masks[0] = m_masks[1] = m_masks[2] = m_masks[3] = 0;
+		}
+	};
+
+	if (hsz != 12) {
+		compress = ReadLE32(info + 16);
+		if (compress == 1 || compress == 2) {
+			Log::WriteOneLine("BMP type not supported: RLE");
+			return false;
+		}
+		if (compress >= 4 || (compress == 3 && m_bpp != 16 && m_bpp != 32)) {
+			Log::WriteOneLine("BMP type not supported: unsupported compression");
+			return false;
+		}
+
+		if (hsz == 40 || hsz == 56) {
+			if (m_bpp == 16 || m_bpp == 32) {
+				if (compress == 0) {
+					setDefaultMasks();
+				} else {
+					const uint8_t* masks = info + hsz;
+					m_masks[0] = ReadLE32(masks);
+					m_masks[1] = ReadLE32(masks + 4);
+					m_masks[2] = ReadLE32(masks + 8);
+					extraRead += 12;
+
+					if (m_masks[0] == m_masks[1] && m_masks[1] == m_masks[2]) {
+						Log::WriteOneLine("Corrupt BMP");
+						return false;
+					}
+				}
+			}
+		} else {
+			m_masks[0] = ReadLE32(info + 40);
+			m_masks[1] = ReadLE32(info + 44);
+			m_masks[2] = ReadLE32(info + 48);
+			m_masks[3] = ReadLE32(info + 52);
+			if (compress != 3) setDefaultMasks();
+		}
+	}
+
+	m_bottomUp = height > 0;
+	m_h = height == std::numeric_limits<int32_t>::min() ? 0 : std::abs(height);
+	if (m_w <= 0 || m_h <= 0) {
+		Log::WriteOneLine("Corrupt BMP");
+		return false;
+	}
+	if (m_w > MaxDimension || m_h > MaxDimension) {
+		Log::WriteOneLine("BMP too large: " + Log::ToString(m_w) + " x " + Log::ToString(m_h));
+		return false;
+	}
+
+	m_channels = (m_bpp == 24 && m_masks[3] == 0xff000000u) ? 3 : (m_masks[3] ? 4 : 3);
+
+	size_t width = 0;
+	if (m_bpp < 16) {
+		const int paletteSize = hsz == 12 ? static_cast<int>(m_offset - extraRead - 24) / 3 : static_cast<int>(m_offset - extraRead - hsz) >> 2;
+		if (paletteSize <= 0 || paletteSize > 256) {
+			Log::WriteOneLine("Corrupt BMP");
+			return false;
+		}
+
+		const size_t entrySize = hsz == 12 ? 3 : 4;
+		std::vector<uint8_t> entries(static_cast<size_t>(paletteSize) * entrySize);
+		m_file.seekg(14 + hsz);
+		m_file.read(reinterpret_cast<char*>(entries.data()), static_cast<std::streamsize>(entries.size()));
+		if (!m_file) {
+			Log::WriteOneLine("Corrupt BMP");
+			return false;
+		}
+
+		m_palette.assign(256 * 4, 0);
+		for (size_t i = 0; i < static_cast<size_t>(paletteSize); ++i) {
+			m_palette[i * 4 + 0] = entries[i * entrySize + 2];
+			m_palette[i * 4 + 1] = entries[i * entrySize + 1];
+			m_palette[i * 4 + 2] = entries[i * entrySize + 0];
+			m_palette[i * 4 + 3] = 255;
+		}
+
+		if (m_bpp == 1) {
+			width = (static_cast<size_t>(m_w) + 7) >> 3;
+		} else if (m_bpp == 4) {
+			width = (static_cast<size_t>(m_w) + 1) >> 1;
+		} else if (m_bpp == 8) {
+			width = static_cast<size_t>(m_w);
+		} else {
+			Log::WriteOneLine("Corrupt BMP - bad bpp");
+			return false;
+		}
+	} else {
+		if (m_bpp != 16 && m_bpp != 24 && m_bpp != 32) {
+			Log::WriteOneLine("Corrupt BMP - bad bpp");
+			return false;
+		}
+		width = static_cast<size_t>(m_w) * static_cast<size_t>(m_bpp / 8);
+
+		const bool easy = m_bpp == 24 || (m_bpp == 32 && m_masks[0] == 0x00ff0000u && m_masks[1] == 0xff00u &&
+			m_masks[2] == 0xffu && m_masks[3] == 0xff000000u);
+		if (!easy) {
+			if (!m_masks[0] || !m_masks[1] || !m_masks[2] || BitCount(m_masks[0]) > 8 || BitCount(m_masks[1]) > 8 ||
+				BitCount(m_masks[2]) > 8 || BitCount(m_masks[3]) > 8) {
+				Log::WriteOneLine("Corrupt BMP - bad masks");
+				return false;
+			}
+		}
+	}
+
+	// Rows are padded to 4 bytes
+	m_rowBytes = (width + 3) & ~static_cast<size_t>(3);
+	m_current.assign(m_rowBytes, 0);
+
+	if (checkAlpha && m_channels == 4) {
+		// Needs a pass over the file before the first row can be given out
+		m_allAlphaZero = true;
+		m_file.seekg(m_offset);
+		for (int y = 0; y < m_h && m_allAlphaZero; ++y) {
+			m_file.read(reinterpret_cast<char*>(m_current.data()), static_cast<std::streamsize>(m_rowBytes));
+			if (!m_file) break;
+			for (size_t x = 0; x < static_cast<size_t>(m_w); ++x) {
+				if ((ReadLE32(m_current.data() + x * 4) & m_masks[3]) != 0) {
+					m_allAlphaZero = false;
+					break;
+				}
+			}
+		}
+		m_file.clear();
+	}
+
+	return true;
+}
+
+bool ImageReader::ReadRowBMP(uint8_t* row) {
+	const int fileRow = m_bottomUp ? m_h - 1 - m_y : m_y;
+	m_file.seekg(static_cast<std::streamoff>(m_offset) + static_cast<std::streamoff>(fileRow) * static_cast<std::streamoff>(m_rowBytes));
+	m_file.read(reinterpret_cast<char*>(m_current.data()), static_cast<std::streamsize>(m_rowBytes));
+	if (!m_file) {
+		Log::WriteOneLine("Corrupt BMP - row " + Log::ToString(m_y));
+		return false;
+	}
+
+	const uint8_t* data = m_current.data();
+	const size_t w = static_cast<size_t>(m_w);
+	const size_t channels = static_cast<size_t>(m_channels);
+
+	if (m_bpp < 16) {
+		for (size_t x = 0; x < w; ++x) {
+			size_t index = 0;
+			if (m_bpp == 1) {
+				index = (data[x >> 3] >> (7 - (x & 7))) & 1;
+			} else if (m_bpp == 4) {
+				index = (x & 1) ? (data[x >> 1] & 15) : (data[x >> 1] >> 4);
+			} else {
+				index = data[x];
+			}
+			for (size_t c = 0; c < 3; ++c) row[x * channels + c] = m_palette[index * 4 + c];
+			if (channels == 4) row[x * channels + 3] = 255;
+		}
+		return true;
+	}
+
+	if (m_bpp == 24) {
+		for (size_t x = 0; x < w; ++x) {
+			row[x * channels + 0] = data[x * 3 + 2];
+			row[x * channels + 1] = data[x * 3 + 1];
+			row[x * channels + 2] = data[x * 3 + 0];
+			if (channels == 4) row[x * channels + 3] = 255;
+		}
+		return true;
+	}
+
+	int shifts[4] = { 0, 0, 0, 0 }, counts[4] = { 0, 0, 0, 0 };
+	for (int c = 0; c < 4; ++c) {
+		shifts[c] = HighBit(m_masks[c]) - 7;
+		counts[c] = BitCount(m_masks[c]);
+	}
+
+	for (size_t x = 0; x < w; ++x) {
+		const uint32_t v = m_bpp == 16 ? ReadLE16(data + x * 2) : ReadLE32(data + x * 4);
+		for (int c = 0; c < 3; ++c) row[x * channels + static_cast<size_t>(c)] = ShiftMasked(v & m_masks[c], shifts[c], counts[c]);
+
+		if (channels == 4) {
+			const uint8_t alpha = m_masks[3] ? ShiftMasked(v & m_masks[3], shifts[3], counts[3]) : 255;
+			row[x * channels + 3] = m_allAlphaZero ? 255 : alpha;
+		}
+	}
+	return true;
+}
+
+// ========== WRITER ==========
+
+bool ImageWriter::Open(const std::string& file, const int w, const int h, const int channels) {
+	m_w = w;
+	m_h = h;
+	m_channels = channels;
+
+	if (!OpenFile(file)) return false;
+
+	const size_t rowBytes = static_cast<size_t>(w) * static_cast<size_t>(channels);
+
+	if (m_type == Image::ImageType::PNG) {
+		static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+		static const uint8_t colourTypes[5] = { 0, 0, 4, 2, 6 };
+		m_file.write(reinterpret_cast<const char*>(signature), 8);
+
+		std::vector<uint8_t> header;
+		PutBE32(header, static_cast<uint32_t>(w));
+		PutBE32(header, static_cast<uint32_t>(h));
+		header.push_back(8);
+		header.push_back(colourTypes[channels]);
+		header.push_back(0);
+		header.push_back(0);
+		header.push_back(0);
+		WriteChunk("IHDR", header.data(), header.size());
+
+		m_previous.assign(rowBytes, 0);
+		m_filtered.assign(rowBytes + 1, 0);
+		m_best.assign(rowBytes + 1, 0);
+
+		// Compression setting without bands - rows come one at a time
+		const PNGEncoder::Level level = PNGEncoder::GetLevel();
+		m_filter = level.filter;
+
+		m_deflater.Reset([this](const uint8_t* data, const size_t size) { return WriteChunk("IDAT", data, size); }, level.deflate);
+		return static_cast<bool>(m_file);
+	}
+
+	// Top down BMP - 32 bits with a V4 header when there's alpha
+	const bool alpha = channels == 2 || channels == 4;
+	const uint32_t headerSize = alpha ? 108 : 40;
+	const uint32_t bytesPerPixel = alpha ? 4 : 3;
+	const uint32_t stride = (static_cast<uint32_t>(w) * bytesPerPixel + 3) & ~3u;
+	const uint32_t imageSize = stride * static_cast<uint32_t>(h);
+	const uint32_t offset = 14 + headerSize;
+
+	std::vector<uint8_t> header;
+	header.push_back('B');
+	header.push_back('M');
+	PutLE32(header, offset + imageSize);
+	PutLE32(header, 0);
+	PutLE32(header, offset);
+
+	PutLE32(header, headerSize);
+	PutLE32(header, static_cast<uint32_t>(w));
+	PutLE32(header, static_cast<uint32_t>(-h));
+	PutLE16(header, 1);
+	PutLE16(header, static_cast<uint16_t>(bytesPerPixel * 8));
+	PutLE32(header, alpha ? 3 : 0);
+	PutLE32(header, imageSize);
+	PutLE32(header, 2835);
+	PutLE32(header, 2835);
+	PutLE32(header, 0);
+	PutLE32(header, 0);
+	if (alpha) {
+		PutLE32(header, 0x00ff0000u);
+		PutLE32(header, 0x0000ff00u);
+		PutLE32(header, 0x000000ffu);
+		PutLE32(header, 0xff000000u);
+		PutLE32(header, 0x73524742u); // sRGB
+		header.resize(header.size() + 48, 0);
+	}
+
+	m_file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+	m_bmpRow.assign(stride, 0);
+	return static_cast<bool>(m_file);
+}
+
+bool ImageWriter::WriteRow(const uint8_t* row) {
+	if (m_y >= m_h || !m_file) return false;
+	++m_y;
+
+	const size_t w = static_cast<size_t>(m_w);
+	const size_t channels = static_cast<size_t>(m_channels);
+
+	if (m_type == Image::ImageType::PNG) {
+		PNGEncoder::FilterRow(row, m_previous.data(), m_previous.size(), channels, m_filter, m_best, m_filtered);
+
+		std::memcpy(m_previous.data(), row, m_previous.size());
+		return m_deflater.Write(m_best.data(), m_best.size());
+	}
+
+	const bool alpha = channels == 2 || channels == 4;
+	const size_t bytesPerPixel = alpha ? 4 : 3;
+	for (size_t x = 0; x < w; ++x) {
+		const uint8_t* pixel = row + x * channels;
+		const uint8_t r = pixel[0];
+		const uint8_t g = channels >= 3 ? pixel[1] : r;
+		const uint8_t b = channels >= 3 ? pixel[2] : r;
+
+		uint8_t* out = m_bmpRow.data() + x * bytesPerPixel;
+		out[0] = b;
+		out[1] = g;
+		out[2] = r;
+		if (alpha) out[3] = pixel[channels - 1];
+	}
+
+	m_file.write(reinterpret_cast<const char*>(m_bmpRow.data()), static_cast<std::streamsize>(m_bmpRow.size()));
+	return static_cast<bool>(m_file);
+}
+
+ImageWriter::~ImageWriter() {
+	// Not closed - left part way by an error
+	if (m_file.is_open()) Discard();
+}
+
+bool ImageWriter::Close() {
+	const bool opened = m_file.is_open();
+	bool success = opened && m_y == m_h;
+
+	if (success && m_type == Image::ImageType::PNG) {
+		success = m_deflater.Finish() && WriteChunk("IEND", nullptr, 0);
+	}
+
+	if (opened) {
+		m_file.close();
+		success = success && !m_file.fail();
+
+		// Only a file this writer made is removed
+		if (!success) Discard();
+	}
+
+	Log::StartLine();
+	Log::Write(success ? "Write success " : "Write fail ");
+	Log::Write(m_fileName);
+	Log::EndLine();
+
+	return success;
+}
+
+void ImageWriter::Discard() {
+	if (m_file.is_open()) m_file.close();
+
+	std::error_code error;
+	std::filesystem::remove(m_fileName, error);
+}
+
+bool ImageWriter::OpenFile(const std::string& file) {
+	m_type = Image::GetFileType(file.c_str());
+	m_fileName = file;
+	m_y = 0;
+
+	if (m_type != Image::ImageType::PNG && m_type != Image::ImageType::BMP) {
+		Log::WriteOneLine("File type can't be streamed - PNG or BMP");
+		return false;
+	}
+
+	const std::filesystem::path p = file;
+	if (!p.parent_path().empty() && !std::filesystem::exists(p.parent_path())) std::filesystem::create_directory(p.parent_path());
+
+	if (m_file.is_open()) m_file.close();
+	m_file.clear();
+	m_file.open(file, std::ios::binary);
+	return static_cast<bool>(m_file);
+}
+
+bool ImageWriter::WriteChunk(const char* type, const uint8_t* data, const size_t size) {
+	return PNGEncoder::WriteChunk(m_file, type, data, size);
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include "../misc/ZStream.h"
+#include "Image.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// <para>Reads a PNG or BMP one row at a time from the top - gives the same channels and values as stbi_load</para>
+/// <para>NOTE: Interlaced PNGs and compressed BMPs aren't supported</para>
+/// </summary>
+class ImageReader {
+public:
+	ImageReader() {};
+	~ImageReader() {};
+
+	ImageReader(const ImageReader& other) = delete;
+	ImageReader& operator=(const ImageReader& other) = delete;
+
+	/// <summary>
+	/// Reads the header and gets ready for the first row
+	/// </summary>
+	/// <param name="file"></param>
+	/// <returns>false if the file can't be read one row at a time</returns>
+	bool Open(const std::string& file);
+
+	/// <summary>
+	/// Reads the next row - GetWidth() * GetChannels() bytes
+	/// </summary>
+	/// <param name="row"></param>
+	/// <returns></returns>
+	bool ReadRow(uint8_t* row);
+
+	inline int GetWidth() const { return m_w; };
+	inline int GetHeight() const { return m_h; };
+	inline int GetChannels() const { return m_channels; };
+
+	// Widest and tallest image that can be read - same as STBI_MAX_DIMENSIONS
+	static const int MaxDimension = 1 << 24;
+
+	/// <summary>
+	/// File types ImageReader and ImageWriter can open
+	/// </summary>
+	/// <param name="file"></param>
+	/// <returns></returns>
+	static bool CanStream(const char* file);
+
+private:
+	Image::ImageType m_type = Image::ImageType::NA;
+	std::ifstream m_file;
+	int m_w = 0, m_h = 0, m_channels = 0;
+	int m_y = 0;
+
+	// ===== PNG =====
+
+	Inflater m_inflater;
+	int m_colourType = 0, m_depth = 0;
+
+	// Samples per pixel stored in the file and bytes per pixel for the filters
+	int m_samples = 0, m_filterBytes = 1;
+	size_t m_rowBytes = 0;
+
+	// RGBA - PNG palette or BMP colour table
+	std::vector<uint8_t> m_palette;
+	bool m_hasTransparency = false;
+	uint16_t m_transparent[3] = { 0, 0, 0 };
+
+	// Bytes left in the IDAT chunk being read
+	uint32_t m_chunkLeft = 0;
+	bool m_chunksDone = false;
+
+	// Unfiltered rows - previous starts as zeros
+	std::vector<uint8_t> m_current, m_previous;
+
+	// Largest chunk the PNG spec allows
+	static const uint32_t MaxChunkLength = 0x7FFFFFFF;
+
+	bool OpenPNG();
+	bool ReadRowPNG(uint8_t* row);
+	size_t ReadIDAT(uint8_t* data, const size_t size);
+	bool NextIDAT();
+
+	// ===== BMP =====
+
+	int m_bpp = 0;
+	uint32_t m_offset = 0;
+	uint32_t m_masks[4] = { 0, 0, 0, 0 };
+	bool m_bottomUp = false;
+
+	// 32 bit BMPs without an alpha mask often leave it at 0 - stb_image makes it opaque when every alpha is 0
+	bool m_allAlphaZero = false;
+
+	bool OpenBMP();
+	bool ReadRowBMP(uint8_t* row);
+};
+
+/// <summary>
+/// <para>Writes a PNG or BMP one row at a time from the top</para>
+/// <para>PNG rows are filtered and compressed like PNGEncoder without bands - BMPs are stored top down</para>
+/// </summary>
+class ImageWriter {
+public:
+	ImageWriter() {};
+
+	/// <summary>
+	/// Removes the file if Close() wasn't called - an output that failed part way isn't left behind
+	/// </summary>
+	~ImageWriter();
+
+	ImageWriter(const ImageWriter& other) = delete;
+	ImageWriter& operator=(const ImageWriter& other) = delete;
+
+	/// <summary>
+	/// Writes the header
+	/// </summary>
+	/// <param name="file"></param>
+	/// <param name="w"></param>
+	/// <param name="h"></param>
+	/// <param name="channels">1 to 4 - same layout as Image</param>
+	/// <returns></returns>
+	bool Open(const std::string& file, const int w, const int h, const int channels);
+
+	/// <summary>
+	/// Writes the next row - width * channels bytes
+	/// </summary>
+	/// <param name="row"></param>
+	/// <returns></returns>
+	bool WriteRow(const uint8_t* row);
+
+	/// <summary>
+	/// Writes the end of the file - every row has to be written first
+	/// </summary>
+	/// <returns>false if a row is missing or writing failed - the file is removed</returns>
+	bool Close();
+
+private:
+	Image::ImageType m_type = Image::ImageType::NA;
+	std::ofstream m_file;
+	std::string m_fileName;
+	int m_w = 0, m_h = 0, m_channels = 0;
+	int m_y = 0;
+
+	// ===== PNG =====
+
+	Deflater m_deflater;
+	std::vector<uint8_t> m_previous, m_filtered, m_best;
+
+	// PNG filter from PNGEncoder::GetLevel
+	int m_filter = -1;
+
+	bool OpenFile(const std::string& file);
+	void Discard();
+	bool WriteChunk(const char* type, const uint8_t* data, const size_t size);
+
+	// ===== BMP =====
+
+	std::vector<uint8_t> m_bmpRow;
+};
@@ -0,0 +1,319 @@
+#include "../misc/ThreadPool.h"
+#include "../misc/ZStream.h"
+#include "PNGEncoder.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+thread_local PNGEncoder::Compression PNGEncoder::m_compression = PNGEncoder::Compression::Default;
+thread_local unsigned int PNGEncoder::m_threads = 0;
+
+static void PutBE32(std::vector<uint8_t>& data, const uint32_t value) {
+	for (int shift = 24; shift >= 0; shift -= 8) data.push_back(static_cast<uint8_t>(value >> shift));
+}
+
+static int Paeth(const int a, const int b, const int c) {
+	const int p = a + b - c;
+	const int pa = std::abs(p - a);
+	const int pb = std::abs(p - b);
+	const int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
+
+uint32_t PNGEncoder::CRC32(const char* type, const uint8_t* data, const size_t size) {
+	// Made once before any thread uses it - outputs can be encoded at the same time
+	static const std::array<uint32_t, 256> table = []() {
+		std::array<uint32_t, 256> out{};
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			out[i] = c;
+		}
+		return out;
+		}();
+
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < 4; ++i) crc = table[(crc ^ static_cast<uint8_t>(type[i])) & 0xFF] ^ (crc >> 8);
+	for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
+
+// One filter over the row - the bytes before the first pixel count as zeros
+static void FilterWith(const uint8_t* row, const uint8_t* prev, const size_t rowBytes, const size_t n, const int filter, uint8_t* out) {
+	const size_t first = std::min(n, rowBytes);
+
+	switch (filter) {
+	case 0:
+		std::copy(row, row + rowBytes, out);
+		break;
+	case 1:
+		std::copy(row, row + first, out);
+		for (size_t i = first; i < rowBytes; ++i) out[i] = static_cast<uint8_t>(row[i] - row[i - n]);
+		break;
+	case 2:
+		for (size_t i = 0; i < rowBytes; ++i) out[i] = static_cast<uint8_t>(row[i] - prev[i]);
+		break;
+	case 3:
+		for (size_t i = 0; i < first; ++i) out[i] = static_cast<uint8_t>(row[i] - (prev[i] >> 1));
+		for (size_t i = first; i < rowBytes; ++i) out[i] = static_cast<uint8_t>(row[i] - ((row[i - n] + prev[i]) >> 1));
+		break;
+	default:
+		for (size_t i = 0; i < first; ++i) out[i] = static_cast<uint8_t>(row[i] - Paeth(0, prev[i], 0));
+		for (size_t i = first; i < rowBytes; ++i) out[i] = static_cast<uint8_t>(row[i] - Paeth(row[i - n], prev[i], prev[i - n]));
+		break;
+	}
+}
+
+bool PNGEncoder::IsValidSetting(const std::string& compression) {
+	return compression == "default" || compression == "fastest" || compression == "fast" ||
+		compression == "small" || compression == "smallest";
+}
+
+void PNGEncoder::SetCompression(const std::string& compression) {
+	if (compression == "fastest") {
+		m_compression = Compression::Fastest;
+	} else if (compression == "fast") {
+		m_compression = Compression::Fast;
+	} else if (compression == "small") {
+		m_compression = Compression::Small;
+	} else if (compression == "smallest") {
+		m_compression = Compression::Smallest;
+	} else {
+		m_compression = Compression::Default;
+	}
+}
+
+void PNGEncoder::SetThreads(const unsigned int threads) {
+	m_threads = threads;
+}
+
+PNGEncoder::Level PNGEncoder::GetLevel() {
+	Level level;
+	if (m_compression == Compression::Default) return level;
+
+	// "sub" on every row - dithered pixels repeat along a row far more than the smallest sum choice expects
+	level.filter = 1;
+	level.bands = true;
+
+	switch (m_compression) {
+	case Compression::Fastest:
+		level.deflate.maxChain = 1;
+		level.deflate.lazy = false;
+		break;
+	case Compression::Fast:
+		level.deflate.maxChain = 4;
+		level.deflate.lazy = false;
+		level.deflate.dynamic = true;
+		break;
+	case Compression::Small:
+		level.deflate.maxChain = 32;
+		level.deflate.dynamic = true;
+		break;
+	default:
+		level.deflate.maxChain = 512;
+		level.deflate.dynamic = true;
+		break;
+	}
+
+	return level;
+}
+
+bool PNGEncoder::Write(const char* file, const uint8_t* data, const int w, const int h, const int channels) {
+	static const uint8_t colourTypes[5] = { 0, 0, 4, 2, 6 };
+
+	std::vector<uint8_t> header;
+	PutBE32(header, static_cast<uint32_t>(w));
+	PutBE32(header, static_cast<uint32_t>(h));
+	header.push_back(8);
+	header.push_back(colourTypes[channels]);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+
+	const size_t rowBytes = static_cast<size_t>(w) * static_cast<size_t>(channels);
+	return Encode(file, header, std::vector<uint8_t>(), data, rowBytes, h, static_cast<size_t>(channels), GetLevel());
+}
+
+bool PNGEncoder::WriteIndexed(const char* file, const uint8_t* indices, const int w, const int h, const std::vector<uint8_t>& palette) {
+	const size_t colours = palette.size() / 4;
+	if (colours == 0 || colours > 256) return false;
+
+	const int depth = colours <= 2 ? 1 : colours <= 4 ? 2 : colours <= 16 ? 4 : 8;
+
+	std::vector<uint8_t> header;
+	PutBE32(header, static_cast<uint32_t>(w));
+	PutBE32(header, static_cast<uint32_t>(h));
+	header.push_back(static_cast<uint8_t>(depth));
+	header.push_back(3);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+
+	// Leftmost pixel in the highest bits
+	const size_t width = static_cast<size_t>(w);
+	const size_t rowBytes = (width * static_cast<size_t>(depth) + 7) / 8;
+	std::vector<uint8_t> packed(rowBytes * static_cast<size_t>(h), 0);
+
+	const size_t perByte = static_cast<size_t>(8 / depth);
+	for (size_t y = 0; y < static_cast<size_t>(h); ++y) {
+		const uint8_t* row = indices + y * width;
+		uint8_t* out = packed.data() + y * rowBytes;
+
+		if (depth == 8) {
+			std::copy(row, row + width, out);
+			continue;
+		}
+
+		for (size_t x = 0; x < width; ++x) {
+			const int shift = 8 - depth * static_cast<int>(x % perByte + 1);
+			out[x / perByte] |= static_cast<uint8_t>(row[x] << shift);
+		}
+	}
+
+	// Filter "none" - recommended for palette images since their indices aren't a gradient
+	Level level = GetLevel();
+	level.filter = 0;
+
+	return Encode(file, header, palette, packed.data(), rowBytes, h, 1, level);
+}
+
+void PNGEncoder::FilterRow(const uint8_t* row, const uint8_t* previous, const size_t rowBytes, const size_t filterBytes, const int filter,
+	std::vector<uint8_t>& out, std::vector<uint8_t>& scratch) {
+	out.resize(rowBytes + 1);
+
+	if (filter >= 0) {
+		out[0] = static_cast<uint8_t>(filter);
+		FilterWith(row, previous, rowBytes, filterBytes, filter, out.data() + 1);
+		return;
+	}
+
+	// Same filter choice as stbi_write_png - the smallest sum of the filtered bytes
+	scratch.resize(rowBytes + 1);
+
+	int bestSum = 0x7fffffff;
+	for (int f = 0; f < 5; ++f) {
+		scratch[0] = static_cast<uint8_t>(f);
+		FilterWith(row, previous, rowBytes, filterBytes, f, scratch.data() + 1);
+
+		int sum = 0;
+		for (size_t i = 1; i < scratch.size(); ++i) sum += std::abs(static_cast<signed char>(scratch[i]));
+		if (sum < bestSum) {
+			bestSum = sum;
+			out.swap(scratch);
+		}
+	}
+}
+
+bool PNGEncoder::WriteChunk(std::ostream& file, const char* type, const uint8_t* data, const size_t size) {
+	std::vector<uint8_t> length;
+	PutBE32(length, static_cast<uint32_t>(size));
+	file.write(reinterpret_cast<const char*>(length.data()), 4);
+	file.write(type, 4);
+	if (size > 0) file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+
+	std::vector<uint8_t> crc;
+	PutBE32(crc, CRC32(type, data, size));
+	file.write(reinterpret_cast<const char*>(crc.data()), 4);
+
+	return static_cast<bool>(file);
+}
+
+bool PNGEncoder::Encode(const char* file, const std::vector<uint8_t>& header, const std::vector<uint8_t>& palette,
+	const uint8_t* rows, const size_t rowBytes, const int h, const size_t filterBytes, const Level& level) {
+	std::ofstream out(file, std::ios::binary);
+	if (!out) return false;
+
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	out.write(reinterpret_cast<const char*>(signature), 8);
+	WriteChunk(out, "IHDR", header.data(), header.size());
+
+	if (!palette.empty()) {
+		std::vector<uint8_t> rgb, alpha;
+		for (size_t i = 0; i + 3 < palette.size(); i += 4) {
+			rgb.insert(rgb.end(), palette.begin() + i, palette.begin() + i + 3);
+			alpha.push_back(palette[i + 3]);
+		}
+		WriteChunk(out, "PLTE", rgb.data(), rgb.size());
+
+		// Colours after the last transparent one are opaque without being listed
+		while (!alpha.empty() && alpha.back() == 255) alpha.pop_back();
+		if (!alpha.empty()) WriteChunk(out, "tRNS", alpha.data(), alpha.size());
+	}
+
+	const std::vector<uint8_t> zeros(rowBytes, 0);
+	bool success = true;
+
+	if (!level.bands) {
+		Deflater deflater;
+		deflater.Reset([&out](const uint8_t* data, const size_t size) { return WriteChunk(out, "IDAT", data, size); }, level.deflate);
+
+		std::vector<uint8_t> filtered, scratch;
+		for (int y = 0; success && y < h; ++y) {
+			const uint8_t* row = rows + static_cast<size_t>(y) * rowBytes;
+			FilterRow(row, y > 0 ? row - rowBytes : zeros.data(), rowBytes, filterBytes, level.filter, filtered, scratch);
+			success = deflater.Write(filtered.data(), filtered.size());
+		}
+
+		success = success && deflater.Finish();
+	} else {
+		// Each band is its own deflate blocks ending on a whole byte, so they can be put one after the other
+		const int bandRows = static_cast<int>(std::max(size_t(1), BandBytes / (rowBytes + 1)));
+		const size_t bandCount = static_cast<size_t>((h + bandRows - 1) / bandRows);
+
+		std::vector<std::vector<uint8_t>> compressed(bandCount);
+		std::vector<uint32_t> adlers(bandCount, 1);
+
+		Deflater::Options options = level.deflate;
+		options.raw = true;
+
+		ThreadPool threadPool(m_threads);
+		threadPool.ParallelFor(bandCount, [&](const size_t band, const unsigned int) {
+			std::vector<uint8_t>& bandOut = compressed[band];
+
+			Deflater deflater;
+			deflater.Reset([&bandOut](const uint8_t* data, const size_t size) {
+				bandOut.insert(bandOut.end(), data, data + size);
+				return true;
+			}, options);
+
+			std::vector<uint8_t> filtered, scratch;
+			const int end = std::min(h, static_cast<int>(band + 1) * bandRows);
+			for (int y = static_cast<int>(band) * bandRows; y < end; ++y) {
+				const uint8_t* row = rows + static_cast<size_t>(y) * rowBytes;
+				FilterRow(row, y > 0 ? row - rowBytes : zeros.data(), rowBytes, filterBytes, level.filter, filtered, scratch);
+				deflater.Write(filtered.data(), filtered.size());
+			}
+			deflater.Finish();
+
+			adlers[band] = deflater.GetAdler();
+		});
+
+		// zlib header, every band, an empty final block then the Adler-32 of all the bands
+		std::vector<uint8_t> zlib = { 0x78, 0x5e };
+		uint32_t adler = 1;
+		for (size_t band = 0; band < bandCount; ++band) {
+			zlib.insert(zlib.end(), compressed[band].begin(), compressed[band].end());
+
+			const int bandHeight = std::min(h - static_cast<int>(band) * bandRows, bandRows);
+			adler = Deflater::JoinAdler(adler, adlers[band], static_cast<uint64_t>(bandHeight) * (rowBytes + 1));
+		}
+		zlib.push_back(0x03);
+		zlib.push_back(0x00);
+		PutBE32(zlib, adler);
+
+		success = WriteChunk(out, "IDAT", zlib.data(), zlib.size());
+	}
+
+	success = success && WriteChunk(out, "IEND", nullptr, 0);
+
+	out.close();
+	return success && !out.fail();
+}
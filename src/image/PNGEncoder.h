@@ -0,0 +1,110 @@
+#pragma once
+#include "../misc/ZStream.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// <para>PNG encoding with a choice between speed and file size - the "pngCompression" setting</para>
+/// <para>Bands of rows are compressed on their own threads then joined into one zlib stream</para>
+/// </summary>
+class PNGEncoder {
+public:
+	enum class Compression {
+		Default, Fastest, Fast, Small, Smallest
+	};
+
+	struct Level {
+		Deflater::Options deflate;
+
+		// 0 to 4 uses that PNG filter for every row - -1 picks the smallest sum of filtered bytes for each row like stbi_write_png
+		int filter = -1;
+
+		// Compresses bands of rows at once - the output is the same for any number of threads
+		bool bands = false;
+	};
+
+	static bool IsValidSetting(const std::string& compression);
+
+	/// <summary>
+	/// Only changes the calling thread's setting - images dithered at the same time can use different settings
+	/// </summary>
+	/// <param name="compression"></param>
+	static void SetCompression(const std::string& compression);
+
+	/// <summary>
+	/// Threads used by Write and WriteIndexed on the calling thread - 0 uses every core
+	/// </summary>
+	/// <param name="threads"></param>
+	static void SetThreads(const unsigned int threads);
+
+	static inline Compression GetCompression() { return m_compression; };
+
+	/// <summary>
+	/// Deflate options and filter for the compression setting
+	/// </summary>
+	/// <returns></returns>
+	static Level GetLevel();
+
+	/// <summary>
+	/// Writes 8 bit pixels with the same layout as Image
+	/// </summary>
+	/// <param name="file"></param>
+	/// <param name="data"></param>
+	/// <param name="w"></param>
+	/// <param name="h"></param>
+	/// <param name="channels">1 to 4</param>
+	/// <returns></returns>
+	static bool Write(const char* file, const uint8_t* data, const int w, const int h, const int channels);
+
+	/// <summary>
+	/// Writes a palette PNG - 1, 2, 4 or 8 bits per pixel from the number of colours
+	/// </summary>
+	/// <param name="file"></param>
+	/// <param name="indices">One palette index per pixel</param>
+	/// <param name="w"></param>
+	/// <param name="h"></param>
+	/// <param name="palette">RGBA - 1 to 256 colours</param>
+	/// <returns></returns>
+	static bool WriteIndexed(const char* file, const uint8_t* indices, const int w, const int h, const std::vector<uint8_t>& palette);
+
+	/// <summary>
+	/// Filter byte then the filtered row
+	/// </summary>
+	/// <param name="row"></param>
+	/// <param name="previous">Row above - zeros for the first row</param>
+	/// <param name="rowBytes"></param>
+	/// <param name="filterBytes">Bytes per pixel, at least 1</param>
+	/// <param name="filter">See Level::filter</param>
+	/// <param name="out">rowBytes + 1 bytes</param>
+	/// <param name="scratch">Used when the filter is picked for the row</param>
+	static void FilterRow(const uint8_t* row, const uint8_t* previous, const size_t rowBytes, const size_t filterBytes, const int filter,
+		std::vector<uint8_t>& out, std::vector<uint8_t>& scratch);
+
+	static bool WriteChunk(std::ostream& file, const char* type, const uint8_t* data, const size_t size);
+
+	/// <summary>
+	/// CRC stored after a chunk - covers its type and data
+	/// </summary>
+	/// <param name="type">4 characters</param>
+	/// <param name="data"></param>
+	/// <param name="size"></param>
+	/// <returns></returns>
+	static uint32_t CRC32(const char* type, const uint8_t* data, const size_t size);
+
+private:
+	// Per thread - see SetCompression()
+	static thread_local Compression m_compression;
+	static thread_local unsigned int m_threads;
+
+	/// <summary>
+	/// Signature, header and palette chunks, then the rows filtered and compressed
+	/// </summary>
+	static bool Encode(const char* file, const std::vector<uint8_t>& header, const std::vector<uint8_t>& palette,
+		const uint8_t* rows, const size_t rowBytes, const int h, const size_t filterBytes, const Level& level);
+
+	// Filtered bytes in each band
+	static const size_t BandBytes = 262144;
+};
@@ -2,57 +2,110 @@
 #include "Colour.h"
 #include "Palette.h"
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <sstream>
 #include <string>
-#include <unordered_map>
+#include <tuple>
 #include <ios>
 #include <ostream>
+#include <vector>
+
+// Change when the file layout or the values stored change
+static const uint32_t PaletteBinVersion = 1;
+static const char PaletteBinMagic[4] = { 'O', 'K', 'P', 'B' };
+
+struct PaletteBinHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t sections;
+	uint32_t reserved;
+};
+
+// Colours sorted in one MathMode with or without the grayscale setting
+struct PaletteBinSection {
+	uint32_t mode;
+	uint32_t grayscale;
+	uint64_t count;
+};
+
+// The values Colour::ConvertAll() gives an opaque 8 bit colour - kept as double so loaded palettes dither the same
+struct PaletteBinEntry {
+	uint8_t r, g, b;
+	uint8_t reserved[5];
+	double lrgb[3];
+	double oklab[3];
+	double oklch[3];
+};
 
 Palette::Palette() {
 	m_size = 0;
 }
 
 Palette::Palette(const char* file, const bool grayscale) {
-	std::fstream p(file);
-
 	m_size = 0;
-	if (p) {
-		std::string hex;
-		while (std::getline(p, hex)) {
-			if (hex.size() < 6) {
-				Log::WriteOneLine(Log::LeadingCharacter(hex, 6, ' ') + ": is not a valid colour code");
-				break;
-			}
-			hex.resize(6);
-			++m_size;
 
-			bool push = true;
+	std::ifstream p(file, std::ios::binary);
+	if (!p) return;
 
-			Colour col(hex.c_str());
+	const std::string source((std::istreambuf_iterator<char>(p)), std::istreambuf_iterator<char>());
 
-			if (grayscale && !col.IsGrayscale()) push = false;
+	// FNV-1a - any change to the text rebuilds the binary file
+	uint64_t sourceHash = 14695981039346656037ull;
+	for (const char c : source) {
+		sourceHash ^= static_cast<uint8_t>(c);
+		sourceHash *= 1099511628211ull;
+	}
 
-			//Colour col(hex.c_str());
-			//m_colours.push_back(col);
-			
-			if (push) m_colours.emplace_back(hex.c_str());
-		}
+	const std::string binFile = std::filesystem::path(file).replace_extension(".palettebin").string();
 
+	std::vector<char> others;
+	uint32_t otherCount = 0;
+	if (LoadBinary(binFile, sourceHash, grayscale, others, otherCount)) {
+		Log::WriteOneLine("Loaded palette: " + binFile);
 		Log::WriteOneLine("Palette Size: " + Log::ToString(m_size, 0, '0'));
+		return;
+	}
 
-		//Colour::SetMathMode(Colour::MathMode::OkLCh);
+	std::istringstream lines(source);
+	std::string hex;
+	while (std::getline(lines, hex)) {
+		if (hex.size() < 6) {
+			Log::WriteOneLine(Log::LeadingCharacter(hex, 6, ' ') + ": is not a valid colour code");
+			break;
+		}
+		hex.resize(6);
 
-		std::sort(m_colours.begin(), m_colours.end());
+		const Colour col(hex.c_str());
+		if (grayscale && !col.IsGrayscale()) continue;
 
-		for (auto it = m_colours.begin(); it != m_colours.end(); ++it) {
-			std::string hexOut = "  #" + it->GetHex();
-			std::string rgbOut = "rgb(" + it->sRGBUintDebug() + ')';
-			std::string labOut = "oklab(" + it->OkLabDebug() + ')';
-			std::string lchOut = "oklch(" + it->OkLChDebug() + ')';
+		m_colours.push_back(col);
+		++m_size;
+	}
 
-			Log::WriteOneLine(hexOut + " - " + rgbOut + " - " + labOut + " - " + lchOut);
-		}
+	Log::WriteOneLine("Palette Size: " + Log::ToString(m_size, 0, '0'));
+
+	//Colour::SetMathMode(Colour::MathMode::OkLCh);
+
+	Sort();
+
+	for (auto it = m_colours.begin(); it != m_colours.end(); ++it) {
+		std::string hexOut = "  #" + it->GetHex();
+		std::string rgbOut = "rgb(" + it->sRGBUintDebug() + ')';
+		std::string labOut = "oklab(" + it->OkLabDebug() + ')';
+		std::string lchOut = "oklch(" + it->OkLChDebug() + ')';
+
+		Log::WriteOneLine(hexOut + " - " + rgbOut + " - " + labOut + " - " + lchOut);
+	}
+
+	if (SaveBinary(binFile, sourceHash, grayscale, others, otherCount)) {
+		Log::WriteOneLine("Saved palette: " + binFile);
+	} else {
+		Log::WriteOneLine("Failed to save palette: " + binFile);
 	}
 }
 
@@ -60,31 +113,17 @@ Palette::~Palette() {
 }
 
 void Palette::CalculateAverageSpread() {
-	// Memoisastion of spreads between colours
-	std::unordered_map<size_t, Colour> mem;
-
-	// size_t(x + y * imgWidth);
 	size_t count = 0;
 
+	// Each pair of colours once - the spread is the same both ways
 	m_avgSpread.PureBlack();
 	for (size_t i = 0; i < m_size; ++i) {
-		for (size_t j = 0; j < m_size; ++j) {
-			if (i == j) continue;
-
-			// Makes sure that two pairs of indices query from the same key
-			const size_t smaller = i < j ? i : j;
-			const size_t bigger = i > j ? i : j;
-			const size_t key = smaller + bigger * m_size;
-
-			if (mem.find(key) != mem.end()) continue;
-
+		for (size_t j = i + 1; j < m_size; ++j) {
 			++count;
 
 			Colour spread = m_colours[i] - m_colours[j];
 			spread.Abs();
 
-			mem[key] = spread;
-
 			m_avgSpread += spread;
 		}
 	}
@@ -110,14 +149,176 @@ void Palette::Save(const char* file) {
 	output << std::flush;
 }
 
+void Palette::Sort() {
+	if (Colour::GetMathMode() == Colour::MathMode::OkLCh) {
+		// Same comparisons as operator< on the same starting order so std::sort gives the same order
+		struct Key {
+			int hue;
+			double l, c, alpha;
+			size_t index;
+		};
+
+		std::vector<Key> keys(m_colours.size());
+		for (size_t i = 0; i < m_colours.size(); ++i) {
+			const Colour::OkLCh lch = m_colours[i].GetOkLCh();
+			keys[i] = { m_colours[i].GetHueBucket(), lch.l, lch.c, m_colours[i].GetAlpha(), i };
+		}
+
+		std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+			return std::tie(a.hue, a.l, a.c, a.alpha) < std::tie(b.hue, b.l, b.c, b.alpha);
+		});
+
+		std::vector<Colour> sorted;
+		sorted.reserve(m_colours.size());
+		for (const Key& key : keys) sorted.push_back(m_colours[key.index]);
+		m_colours.swap(sorted);
+	} else {
+		std::sort(m_colours.begin(), m_colours.end());
+	}
+
+	m_tree.Clear();
+	m_bytes.clear();
+}
+
 void Palette::SetToNearestUint() {
 	for (size_t i = 0; i < m_colours.size(); ++i) {
 		m_colours[i] = Colour::FromHex(m_colours[i].GetHex().c_str());
 	}
+	m_tree.Clear();
+	m_bytes.clear();
 }
 
 void Palette::UpdateEveryCol() {
 	for (size_t i = 0; i < m_colours.size(); ++i) {
 		m_colours[i].Update();
 	}
+	m_tree.Clear();
+	m_bytes.clear();
+}
+
+void Palette::ConvertAll() const {
+	for (const Colour& col : m_colours) col.ConvertAll();
+	m_avgSpread.ConvertAll();
+}
+
+const PaletteTree& Palette::GetTree(const Colour::MathMode mode) const {
+	if (!m_tree.IsBuilt() || m_tree.GetMode() != mode) m_tree.Build(*this, mode);
+	return m_tree;
+}
+
+void Palette::PrepareShared(const Colour::MathMode distanceMode) const {
+	ConvertAll();
+	GetTree(distanceMode);
+	GetBytes();
+}
+
+const std::vector<uint8_t>& Palette::GetBytes() const {
+	if (m_bytes.size() != m_size * 3) {
+		m_bytes.resize(m_size * 3);
+		for (size_t i = 0; i < m_size; ++i) {
+			const Colour::sRGB_UInt col = m_colours[i].GetsRGB_UInt();
+			m_bytes[i * 3 + 0] = col.r;
+			m_bytes[i * 3 + 1] = col.g;
+			m_bytes[i * 3 + 2] = col.b;
+		}
+	}
+	return m_bytes;
+}
+
+bool Palette::LoadBinary(const std::string& file, const uint64_t sourceHash, const bool grayscale, std::vector<char>& others, uint32_t& otherCount) {
+	others.clear();
+	otherCount = 0;
+
+	// Read whole then walked in place - each colour is copied without converting or sorting
+	std::ifstream in(file, std::ios::binary);
+	if (!in) return false;
+
+	const std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	PaletteBinHeader header{};
+	if (bytes.size() < sizeof(header)) return false;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (std::memcmp(header.magic, PaletteBinMagic, sizeof(PaletteBinMagic)) != 0 || header.version != PaletteBinVersion ||
+		header.sourceHash != sourceHash) return false;
+
+	const uint32_t mode = static_cast<uint32_t>(Colour::GetMathMode());
+
+	bool found = false;
+	size_t offset = sizeof(header);
+	for (uint32_t i = 0; i < header.sections; ++i) {
+		PaletteBinSection section{};
+		if (bytes.size() - offset < sizeof(section)) return false;
+		std::memcpy(&section, bytes.data() + offset, sizeof(section));
+
+		const size_t sectionStart = offset;
+		offset += sizeof(section);
+
+		if (section.count > (bytes.size() - offset) / sizeof(PaletteBinEntry)) return false; // Cut off file - rebuild
+		const size_t entriesSize = static_cast<size_t>(section.count) * sizeof(PaletteBinEntry);
+
+		if (found || section.mode != mode || section.grayscale != static_cast<uint32_t>(grayscale)) {
+			others.insert(others.end(), bytes.begin() + sectionStart, bytes.begin() + offset + entriesSize);
+			++otherCount;
+		} else {
+			m_colours.resize(static_cast<size_t>(section.count));
+			for (size_t j = 0; j < m_colours.size(); ++j) {
+				PaletteBinEntry entry{};
+				std::memcpy(&entry, bytes.data() + offset + j * sizeof(entry), sizeof(entry));
+
+				m_colours[j].SetConverted({ entry.r, entry.g, entry.b },
+					{ entry.lrgb[0], entry.lrgb[1], entry.lrgb[2] },
+					{ entry.oklab[0], entry.oklab[1], entry.oklab[2] },
+					{ entry.oklch[0], entry.oklch[1], entry.oklch[2] });
+			}
+			m_size = m_colours.size();
+			found = true;
+		}
+
+		offset += entriesSize;
+	}
+
+	if (!found) {
+		m_colours.clear();
+		m_size = 0;
+	}
+	return found;
+}
+
+bool Palette::SaveBinary(const std::string& file, const uint64_t sourceHash, const bool grayscale, const std::vector<char>& others, const uint32_t otherCount) const {
+	std::ofstream out(file, std::ios::binary);
+	if (!out) return false;
+
+	PaletteBinHeader header{};
+	std::memcpy(header.magic, PaletteBinMagic, sizeof(PaletteBinMagic));
+	header.version = PaletteBinVersion;
+	header.sourceHash = sourceHash;
+	header.sections = otherCount + 1;
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	// Sections for other settings first - the file only grows by one section for each new setting
+	out.write(others.data(), others.size());
+
+	PaletteBinSection section{};
+	section.mode = static_cast<uint32_t>(Colour::GetMathMode());
+	section.grayscale = static_cast<uint32_t>(grayscale);
+	section.count = static_cast<uint64_t>(m_size);
+	out.write(reinterpret_cast<const char*>(&section), sizeof(section));
+
+	for (const Colour& col : m_colours) {
+		const Colour::sRGB_UInt srgb = col.GetsRGB_UInt();
+		const Colour::LRGB lrgb = col.GetLRGB();
+		const Colour::OkLab oklab = col.GetOkLab();
+		const Colour::OkLCh oklch = col.GetOkLCh();
+
+		PaletteBinEntry entry{};
+		entry.r = srgb.r;
+		entry.g = srgb.g;
+		entry.b = srgb.b;
+		entry.lrgb[0] = lrgb.r; entry.lrgb[1] = lrgb.g; entry.lrgb[2] = lrgb.b;
+		entry.oklab[0] = oklab.l; entry.oklab[1] = oklab.a; entry.oklab[2] = oklab.b;
+		entry.oklch[0] = oklch.l; entry.oklch[1] = oklch.c; entry.oklch[2] = oklch.h;
+		out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+	}
+
+	return static_cast<bool>(out);
 }
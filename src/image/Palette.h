@@ -1,5 +1,8 @@
 #pragma once
 #include "Colour.h"
+#include "PaletteTree.h"
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <utility>
 #include <algorithm>
@@ -12,6 +15,13 @@ public:
 	/// </summary>
 	Palette();
 
+	/// <summary>
+	/// <para>Reads a .palette file of hex colours and sorts it in the current MathMode</para>
+	/// <para>The sorted colours are saved to a .palettebin file next to it with every colour space converted -
+	/// later runs load that instead until the .palette file changes</para>
+	/// </summary>
+	/// <param name="file"></param>
+	/// <param name="grayscale">Only keeps grayscale colours</param>
 	Palette(const char* file, const bool grayscale = false);
 	~Palette();
 
@@ -37,21 +47,66 @@ public:
 	template<typename... Args>
 	Colour& emplace_back(Args&&... args) {
 		++m_size;
+		m_tree.Clear();
+		m_bytes.clear();
 		return m_colours.emplace_back(std::forward<Args>(args)...);
 	}
 
 	void reserve(const size_t size) { m_colours.reserve(size); }
 
-	void Sort() { std::sort(m_colours.begin(), m_colours.end()); }
+	/// <summary>
+	/// Sorts with Colour::operator< in the current MathMode - OkLCh works out each colour's key once instead of in every comparison
+	/// </summary>
+	void Sort();
 
 	void SetToNearestUint();
 	void UpdateEveryCol();
 
+	/// <summary>
+	/// Converts every colour space of every colour so the palette can be read by more than one thread
+	/// </summary>
+	void ConvertAll() const;
+
+	/// <summary>
+	/// Nearest colour search tree for a distance mode - rebuilt only when the mode changes
+	/// </summary>
+	/// <param name="mode"></param>
+	/// <returns></returns>
+	const PaletteTree& GetTree(const Colour::MathMode mode) const;
+
+	/// <summary>
+	/// <para>8 bit sRGB of every colour packed together - 3 bytes each, written for each palette index of a dither result</para>
+	/// <para>NOTE: Call before the palette is read by more than one thread</para>
+	/// </summary>
+	/// <returns></returns>
+	const std::vector<uint8_t>& GetBytes() const;
+
+	/// <summary>
+	/// ConvertAll(), GetTree() and GetBytes() at once so the palette is only read while images are dithered with it at the same time
+	/// </summary>
+	/// <param name="distanceMode">The only mode GetTree() is called with afterwards</param>
+	void PrepareShared(const Colour::MathMode distanceMode) const;
+
 private:
 	std::vector<Colour> m_colours;
 	size_t m_size;
 
+	/// <summary>
+	/// Reads the colours saved for the current MathMode and grayscale setting
+	/// </summary>
+	/// <param name="file"></param>
+	/// <param name="sourceHash">Hash of the .palette text the file was made from</param>
+	/// <param name="grayscale"></param>
+	/// <param name="others">Colours saved for other settings - kept when the file is saved again</param>
+	/// <param name="otherCount"></param>
+	/// <returns></returns>
+	bool LoadBinary(const std::string& file, const uint64_t sourceHash, const bool grayscale, std::vector<char>& others, uint32_t& otherCount);
+	bool SaveBinary(const std::string& file, const uint64_t sourceHash, const bool grayscale, const std::vector<char>& others, const uint32_t otherCount) const;
+
 	Colour m_avgSpread;
 
+	mutable PaletteTree m_tree;
+	mutable std::vector<uint8_t> m_bytes;
+
 };
 
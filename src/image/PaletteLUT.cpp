@@ -0,0 +1,224 @@
+#include "../misc/ThreadPool.h"
+#include "../wrapper/Log.h"
+#include "Colour.h"
+#include "ColourBatch.h"
+#include "Image.h"
+#include "Palette.h"
+#include "PaletteLUT.h"
+#include "PaletteTree.h"
+#include "PixelBuffer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Change when the file layout or the values stored change
+static const uint32_t LUTVersion = 1;
+static const char LUTMagic[4] = { 'O', 'K', 'L', 'T' };
+
+struct LUTHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t hash;
+	uint32_t type;
+	uint32_t size;
+};
+
+bool PaletteLUT::Prepare(const Palette& palette, const Colour::MathMode mode, const Type type, const bool useFloat, const std::string& directory, const unsigned int threads) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const size_t minSize = type == Type::TwoNearest ? 2 : 1;
+	if (palette.size() < minSize || palette.size() > 65536) {
+		Clear();
+		return false;
+	}
+
+	const uint64_t hash = Hash(palette, mode, type, useFloat);
+	if (IsReady() && hash == m_hash) return true;
+
+	std::ostringstream name;
+	name << "palette-" << std::hex << std::setw(16) << std::setfill('0') << hash << (useFloat ? "-float" : "") << ".lut";
+	const std::filesystem::path file = std::filesystem::path(directory) / name.str();
+
+	m_hash = hash;
+	if (Load(file.string(), type)) {
+		Log::WriteOneLine("  Loaded LUT: " + file.string());
+		return true;
+	}
+
+	Log::WriteOneLine("  Building LUT");
+	if (useFloat) {
+		Build<float>(palette, mode, type, threads);
+	} else {
+		Build<double>(palette, mode, type, threads);
+	}
+
+	if (!directory.empty()) std::filesystem::create_directories(directory);
+	if (Save(file.string(), type)) {
+		Log::WriteOneLine("  Saved LUT: " + file.string());
+	} else {
+		Log::WriteOneLine("  Failed to save LUT: " + file.string());
+	}
+
+	return true;
+}
+
+void PaletteLUT::Clear() {
+	m_p0.clear();
+	m_p0.shrink_to_fit();
+	m_p1.clear();
+	m_p1.shrink_to_fit();
+	m_hash = 0;
+}
+
+uint64_t PaletteLUT::Hash(const Palette& palette, const Colour::MathMode mode, const Type type, const bool useFloat) {
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const void* data, const size_t size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	// SIMD and scalar OkLab conversions can differ in the last bits, and float pixels can pick different colours
+	const uint32_t settings[5] = { LUTVersion, static_cast<uint32_t>(mode), static_cast<uint32_t>(type),
+		static_cast<uint32_t>(ColourBatch::GetInstructions()), static_cast<uint32_t>(useFloat) };
+	add(settings, sizeof(settings));
+
+	for (size_t i = 0; i < palette.size(); ++i) {
+		const Colour& col = palette.GetColour(i);
+
+		double values[3] = { 0., 0., 0. };
+		if (mode == Colour::MathMode::sRGB) {
+			const Colour::sRGB v = col.GetsRGB();
+			values[0] = v.r; values[1] = v.g; values[2] = v.b;
+		} else if (mode == Colour::MathMode::Linear_RGB) {
+			const Colour::LRGB v = col.GetLRGB();
+			values[0] = v.r; values[1] = v.g; values[2] = v.b;
+		} else {
+			const Colour::OkLab v = col.GetOkLab();
+			values[0] = v.l; values[1] = v.a; values[2] = v.b;
+		}
+		add(values, sizeof(values));
+
+		// TwoNearest orders the pair by OkLab lightness
+		const double l = col.GetOkLab().l;
+		add(&l, sizeof(l));
+	}
+
+	return hash;
+}
+
+template<typename T>
+void PaletteLUT::Build(const Palette& palette, const Colour::MathMode mode, const Type type, const unsigned int threads) {
+	m_p0.assign(Size, 0);
+	if (type == Type::TwoNearest) {
+		m_p1.assign(Size, 0);
+	} else {
+		m_p1.clear();
+	}
+
+	// Palette colours are read by every thread - convert them now instead of lazily
+	palette.ConvertAll();
+	const PaletteTree& tree = palette.GetTree(mode);
+
+	ThreadPool threadPool(threads);
+
+	// One row of every blue value per thread - goes through PixelBuffer::SetRow so the values match a dither pass
+	std::vector<Image> rows(threadPool.GetThreadCount(), Image(256, 1, 3));
+	std::vector<PixelBuffer<T>> buffers(threadPool.GetThreadCount(), PixelBuffer<T>(256, 1, mode));
+
+	Log::StartTime();
+	threadPool.ParallelFor(256, [&](const size_t r, const unsigned int thread) {
+		Image& row = rows[thread];
+		PixelBuffer<T>& pixels = buffers[thread];
+		Colour::SetMathMode(mode);
+
+		for (size_t g = 0; g < 256; ++g) {
+			for (int b = 0; b < 256; ++b) {
+				const size_t index = row.GetIndex(b, 0);
+				row.SetData(index + 0, static_cast<uint8_t>(r));
+				row.SetData(index + 1, static_cast<uint8_t>(g));
+				row.SetData(index + 2, static_cast<uint8_t>(b));
+			}
+			pixels.SetRow(row, 0);
+
+			const size_t keyStart = (r << 16) | (g << 8);
+			for (size_t b = 0; b < 256; ++b) {
+				const Colour pixel = pixels.GetColour(b);
+
+				if (type == Type::Nearest) {
+					m_p0[keyStart + b] = static_cast<uint16_t>(tree.Nearest(pixel));
+					continue;
+				}
+
+				size_t i0 = 0, i1 = 1;
+				tree.TwoNearest(pixel, i0, i1);
+
+				// Same order as OrderedDither
+				if (palette.GetColour(i0).GetOkLab().l < palette.GetColour(i1).GetOkLab().l) std::swap(i0, i1);
+
+				m_p0[keyStart + b] = static_cast<uint16_t>(i0);
+				m_p1[keyStart + b] = static_cast<uint16_t>(i1);
+			}
+		}
+
+		// Log isn't thread safe - only the calling thread reports progress
+		if (thread == 0) Log::DebugProgress(double(r), 256., 5.);
+	});
+}
+
+bool PaletteLUT::Load(const std::string& file, const Type type) {
+	std::ifstream in(file, std::ios::binary);
+	if (!in) return false;
+
+	LUTHeader header{};
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in || std::memcmp(header.magic, LUTMagic, sizeof(LUTMagic)) != 0 || header.version != LUTVersion ||
+		header.hash != m_hash || header.type != static_cast<uint32_t>(type) || header.size != Size) return false;
+
+	m_p0.resize(Size);
+	in.read(reinterpret_cast<char*>(m_p0.data()), Size * sizeof(uint16_t));
+
+	if (type == Type::TwoNearest) {
+		m_p1.resize(Size);
+		in.read(reinterpret_cast<char*>(m_p1.data()), Size * sizeof(uint16_t));
+	} else {
+		m_p1.clear();
+	}
+
+	if (!in) {
+		// Cut off file - rebuild
+		m_p0.clear();
+		m_p1.clear();
+		return false;
+	}
+	return true;
+}
+
+bool PaletteLUT::Save(const std::string& file, const Type type) const {
+	std::ofstream out(file, std::ios::binary);
+	if (!out) return false;
+
+	LUTHeader header{};
+	std::memcpy(header.magic, LUTMagic, sizeof(LUTMagic));
+	header.version = LUTVersion;
+	header.hash = m_hash;
+	header.type = static_cast<uint32_t>(type);
+	header.size = static_cast<uint32_t>(Size);
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(m_p0.data()), m_p0.size() * sizeof(uint16_t));
+	if (type == Type::TwoNearest) out.write(reinterpret_cast<const char*>(m_p1.data()), m_p1.size() * sizeof(uint16_t));
+
+	return static_cast<bool>(out);
+}
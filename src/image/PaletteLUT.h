@@ -0,0 +1,76 @@
+#pragma once
+#include "Colour.h"
+#include "Palette.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// <para>Palette indices for every 8 bit sRGB colour - 2^24 entries indexed by DitherCache::GetKey()</para>
+/// <para>Built in parallel from the same values PixelBuffer::SetRow makes, so a lookup gives the same
+/// indices as searching the PaletteTree for that pixel</para>
+/// </summary>
+class PaletteLUT {
+public:
+	PaletteLUT() {};
+	~PaletteLUT() {};
+
+	enum class Type : uint32_t {
+		// PaletteTree::Nearest - used by NoDither
+		Nearest,
+
+		// PaletteTree::TwoNearest with the lighter colour first - used by OrderedDither
+		TwoNearest
+	};
+
+	// Number of 8 bit sRGB colours
+	static const size_t Size = size_t(1) << 24;
+
+	/// <summary>
+	/// <para>Makes the table ready for a palette and distance mode - reuses the table in memory,
+	/// then a file in directory, then builds it and saves it to directory</para>
+	/// <para>NOTE: Palette needs at least one colour (two for TwoNearest) and at most 65536</para>
+	/// <para>Thread safe - Dither instances dithering different images with the same settings share a table</para>
+	/// </summary>
+	/// <param name="palette"></param>
+	/// <param name="mode">sRGB, Linear_RGB, OkLab or OkLab_Lightness</param>
+	/// <param name="type"></param>
+	/// <param name="useFloat">Built from PixelBuffer&lt;float&gt; values - the same as Dither::SetFloat(true)</param>
+	/// <param name="directory">Folder for the cached tables - empty is the working directory</param>
+	/// <param name="threads">0 uses every core</param>
+	/// <returns>false if the palette can't be stored in the table</returns>
+	bool Prepare(const Palette& palette, const Colour::MathMode mode, const Type type, const bool useFloat, const std::string& directory, const unsigned int threads);
+
+	inline bool IsReady() const { return !m_p0.empty(); };
+
+	inline uint16_t GetP0(const uint32_t key) const { return m_p0[key]; };
+	inline uint16_t GetP1(const uint32_t key) const { return m_p1[key]; };
+
+	void Clear();
+
+	/// <summary>
+	/// Identifies the palette, distance mode, table type, precision and ColourBatch instruction set a table is built with
+	/// </summary>
+	/// <param name="palette"></param>
+	/// <param name="mode"></param>
+	/// <param name="type"></param>
+	/// <param name="useFloat"></param>
+	/// <returns></returns>
+	static uint64_t Hash(const Palette& palette, const Colour::MathMode mode, const Type type, const bool useFloat);
+
+private:
+	std::vector<uint16_t> m_p0, m_p1;
+	uint64_t m_hash = 0;
+
+	// Held by Prepare - the first thread loads or builds the table and the rest wait for it
+	std::mutex m_mutex;
+
+	// T is the PixelBuffer type of the dither using the table
+	template<typename T>
+	void Build(const Palette& palette, const Colour::MathMode mode, const Type type, const unsigned int threads);
+
+	bool Load(const std::string& file, const Type type);
+	bool Save(const std::string& file, const Type type) const;
+};
@@ -0,0 +1,214 @@
+#include "../wrapper/Maths.hpp"
+#include "Colour.h"
+#include "Palette.h"
+#include "PaletteTree.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <emmintrin.h>
+#include <limits>
+#include <vector>
+
+void PaletteTree::Build(const Palette& palette, const Colour::MathMode mode) {
+	Clear();
+	m_mode = mode;
+
+	std::vector<Node> items(palette.size());
+	for (size_t i = 0; i < palette.size(); ++i) {
+		items[i].point = GetPoint(palette.GetColour(i));
+		items[i].index = i;
+	}
+
+	// Triangle inequality - a colour closer than half the distance to its nearest other colour is the nearest
+	// Slightly under a quarter so rounding can't stop the search early on a tie
+	m_stopDistSq = NearestOtherSq(items);
+	for (double& dist : m_stopDistSq) dist *= 0.25 * (1. - 1e-9);
+
+	m_nodes.reserve(items.size());
+	m_root = BuildNode(items, 0, items.size());
+	m_built = true;
+}
+
+size_t PaletteTree::Nearest(const Colour& col) const {
+	return Nearest(GetPoint(col));
+}
+
+size_t PaletteTree::Nearest(const Point& point) const {
+	size_t best = std::numeric_limits<size_t>::max();
+	double bestDist = std::numeric_limits<double>::infinity();
+
+	if (m_root >= 0) NearestSearch(m_root, point, best, bestDist);
+
+	return best;
+}
+
+void PaletteTree::TwoNearest(const Colour& col, size_t& i0, size_t& i1) const {
+	i0 = std::numeric_limits<size_t>::max();
+	i1 = std::numeric_limits<size_t>::max();
+	double d0 = std::numeric_limits<double>::infinity();
+	double d1 = std::numeric_limits<double>::infinity();
+
+	if (m_root >= 0) TwoNearestSearch(m_root, GetPoint(col), i0, d0, i1, d1);
+}
+
+void PaletteTree::Clear() {
+	m_nodes.clear();
+	m_stopDistSq.clear();
+	m_root = -1;
+	m_built = false;
+}
+
+PaletteTree::Point PaletteTree::GetPoint(const Colour& col) const {
+	switch (m_mode) {
+	case Colour::MathMode::sRGB: {
+		const Colour::sRGB v = col.GetsRGB();
+		return { v.r, v.g, v.b };
+	}
+	case Colour::MathMode::Linear_RGB: {
+		const Colour::LRGB v = col.GetLRGB();
+		return { v.r, v.g, v.b };
+	}
+	case Colour::MathMode::OkLab_Lightness:
+		// Only lightness is compared - (l - l)^2 + 0^2 + 0^2 is the same value as Colour::MagSq
+		return { col.GetOkLab().l, 0., 0. };
+	default: {
+		const Colour::OkLab v = col.GetOkLab();
+		return { v.l, v.a, v.b };
+	}
+	}
+}
+
+int PaletteTree::BuildNode(std::vector<Node>& items, const size_t begin, const size_t end) {
+	if (begin >= end) return -1;
+
+	// Split on the axis with the largest spread
+	int axis = 0;
+	double maxSpread = -1.;
+	for (int a = 0; a < 3; ++a) {
+		auto minMax = std::minmax_element(items.begin() + begin, items.begin() + end,
+			[a](const Node& lhs, const Node& rhs) { return lhs.point[a] < rhs.point[a]; });
+
+		const double spread = minMax.second->point[a] - minMax.first->point[a];
+		if (spread > maxSpread) {
+			maxSpread = spread;
+			axis = a;
+		}
+	}
+
+	const size_t mid = begin + (end - begin) / 2;
+	std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+		[axis](const Node& lhs, const Node& rhs) { return lhs.point[axis] < rhs.point[axis]; });
+
+	const int nodeIndex = static_cast<int>(m_nodes.size());
+	m_nodes.push_back(items[mid]);
+	m_nodes[nodeIndex].axis = axis;
+
+	const int left = BuildNode(items, begin, mid);
+	const int right = BuildNode(items, mid + 1, end);
+
+	m_nodes[nodeIndex].left = left;
+	m_nodes[nodeIndex].right = right;
+
+	return nodeIndex;
+}
+
+std::vector<double> PaletteTree::NearestOtherSq(const std::vector<Node>& items) {
+	const size_t count = items.size();
+
+	// Structure of arrays so two colours are compared at once
+	std::vector<double> xs(count), ys(count), zs(count);
+	for (size_t i = 0; i < count; ++i) {
+		xs[i] = items[i].point[0];
+		ys[i] = items[i].point[1];
+		zs[i] = items[i].point[2];
+	}
+
+	std::vector<double> nearest(count, std::numeric_limits<double>::infinity());
+	for (size_t i = 0; i < count; ++i) {
+		const __m128d x = _mm_set1_pd(xs[i]);
+		const __m128d y = _mm_set1_pd(ys[i]);
+		const __m128d z = _mm_set1_pd(zs[i]);
+		__m128d best = _mm_set1_pd(nearest[i]);
+
+		// Only colours after i - the pair's distance goes to both
+		size_t j = i + 1;
+		for (; j + 2 <= count; j += 2) {
+			const __m128d dx = _mm_sub_pd(_mm_loadu_pd(&xs[j]), x);
+			const __m128d dy = _mm_sub_pd(_mm_loadu_pd(&ys[j]), y);
+			const __m128d dz = _mm_sub_pd(_mm_loadu_pd(&zs[j]), z);
+			const __m128d dist = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+
+			best = _mm_min_pd(best, dist);
+			_mm_storeu_pd(&nearest[j], _mm_min_pd(_mm_loadu_pd(&nearest[j]), dist));
+		}
+
+		double bestPair[2];
+		_mm_storeu_pd(bestPair, best);
+		double bestDist = std::min(bestPair[0], bestPair[1]);
+
+		for (; j < count; ++j) {
+			const double dist = Maths::Pow2(xs[j] - xs[i]) + Maths::Pow2(ys[j] - ys[i]) + Maths::Pow2(zs[j] - zs[i]);
+
+			bestDist = std::min(bestDist, dist);
+			nearest[j] = std::min(nearest[j], dist);
+		}
+		nearest[i] = bestDist;
+	}
+
+	// Back to palette index order
+	std::vector<double> byIndex(count);
+	for (size_t i = 0; i < count; ++i) byIndex[items[i].index] = nearest[i];
+
+	return byIndex;
+}
+
+double PaletteTree::DistSq(const Point& a, const Point& b) {
+	return Maths::Pow2(a[0] - b[0]) +
+		Maths::Pow2(a[1] - b[1]) +
+		Maths::Pow2(a[2] - b[2]);
+}
+
+bool PaletteTree::NearestSearch(const int node, const Point& q, size_t& best, double& bestDist) const {
+	const Node& n = m_nodes[node];
+
+	const double dist = DistSq(q, n.point);
+	if (dist < bestDist || (dist == bestDist && n.index < best)) {
+		bestDist = dist;
+		best = n.index;
+
+		// Every other colour is further away than this one
+		if (dist < m_stopDistSq[best]) return true;
+	}
+
+	const double diff = q[n.axis] - n.point[n.axis];
+	const int nearChild = diff < 0. ? n.left : n.right;
+	const int farChild = diff < 0. ? n.right : n.left;
+
+	if (nearChild >= 0 && NearestSearch(nearChild, q, best, bestDist)) return true;
+
+	// Every colour across the split is at least diff^2 away - equal distances are still visited for the index tie break
+	if (farChild >= 0 && Maths::Pow2(diff) <= bestDist) return NearestSearch(farChild, q, best, bestDist);
+
+	return false;
+}
+
+void PaletteTree::TwoNearestSearch(const int node, const Point& q, size_t& i0, double& d0, size_t& i1, double& d1) const {
+	const Node& n = m_nodes[node];
+
+	// Compared as Colour::Mag (not squared) to match the linear scan in Dither::OrderedDither
+	const double dist = std::sqrt(DistSq(q, n.point));
+	if (dist < d0 || (dist == d0 && n.index < i0)) {
+		d1 = d0; i1 = i0;
+		d0 = dist; i0 = n.index;
+	} else if (dist < d1 || (dist == d1 && n.index < i1)) {
+		d1 = dist; i1 = n.index;
+	}
+
+	const double diff = q[n.axis] - n.point[n.axis];
+	const int nearChild = diff < 0. ? n.left : n.right;
+	const int farChild = diff < 0. ? n.right : n.left;
+
+	if (nearChild >= 0) TwoNearestSearch(nearChild, q, i0, d0, i1, d1);
+	if (farChild >= 0 && std::sqrt(Maths::Pow2(diff)) <= d1) TwoNearestSearch(farChild, q, i0, d0, i1, d1);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "Colour.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class Palette;
+
+/// <summary>
+/// k-d tree over the palette colours in a distance space (sRGB, Linear RGB, OkLab or OkLab lightness).
+/// Queries return the same indices as a linear scan with Colour::MagSq - ties go to the lowest index
+/// </summary>
+class PaletteTree {
+public:
+	/// <summary>
+	/// Colour in the tree's distance space - lightness only uses the first value
+	/// </summary>
+	typedef std::array<double, 3> Point;
+
+	PaletteTree() {};
+	~PaletteTree() {};
+
+	/// <summary>
+	/// Build the tree for the palette colours in the given distance mode
+	/// </summary>
+	/// <param name="palette"></param>
+	/// <param name="mode">sRGB, Linear_RGB, OkLab or OkLab_Lightness</param>
+	void Build(const Palette& palette, const Colour::MathMode mode);
+
+	/// <summary>
+	/// <para>Index of the palette colour with the smallest Colour::MagSq to col</para>
+	/// <para>Stops once a colour is closer than half the distance to its own nearest palette colour - nothing else can be closer</para>
+	/// </summary>
+	/// <param name="col"></param>
+	/// <returns></returns>
+	size_t Nearest(const Colour& col) const;
+
+	/// <summary>
+	/// Nearest() for a colour already in the tree's distance space
+	/// </summary>
+	/// <param name="point"></param>
+	/// <returns></returns>
+	size_t Nearest(const Point& point) const;
+
+	/// <summary>
+	/// <para>Indices of the two palette colours with the smallest Colour::Mag to col</para>
+	/// <para>NOTE: Palette must have at least two colours</para>
+	/// </summary>
+	/// <param name="col"></param>
+	/// <param name="i0">Nearest</param>
+	/// <param name="i1">Second nearest</param>
+	void TwoNearest(const Colour& col, size_t& i0, size_t& i1) const;
+
+	bool IsBuilt() const { return m_built; }
+	Colour::MathMode GetMode() const { return m_mode; }
+
+	void Clear();
+
+private:
+	struct Node {
+		Point point{ 0., 0., 0. };
+		size_t index = 0;
+		int axis = 0;
+		int left = -1, right = -1;
+	};
+
+	std::vector<Node> m_nodes;
+
+	// A quarter of the squared distance from each palette colour to its nearest other colour, by palette index
+	std::vector<double> m_stopDistSq;
+	int m_root = -1;
+	bool m_built = false;
+	Colour::MathMode m_mode = Colour::MathMode::OkLab;
+
+	Point GetPoint(const Colour& col) const;
+
+	int BuildNode(std::vector<Node>& items, const size_t begin, const size_t end);
+
+	/// <summary>
+	/// Squared distance from each point to its nearest other point - each pair is measured once
+	/// </summary>
+	/// <param name="items"></param>
+	/// <returns></returns>
+	static std::vector<double> NearestOtherSq(const std::vector<Node>& items);
+
+	/// <summary>
+	/// Same expression and order as Colour::MagSq so distances are bit identical
+	/// </summary>
+	static double DistSq(const Point& a, const Point& b);
+
+	/// <summary>
+	/// </summary>
+	/// <returns>True if best can't be beaten</returns>
+	bool NearestSearch(const int node, const Point& q, size_t& best, double& bestDist) const;
+	void TwoNearestSearch(const int node, const Point& q, size_t& i0, double& d0, size_t& i1, double& d1) const;
+};
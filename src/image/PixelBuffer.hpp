@@ -0,0 +1,256 @@
+#pragma once
+#include "Colour.h"
+#include "ColourBatch.h"
+#include "Image.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// <para>Planar working copy of an image for the dither passes</para>
+/// <para>Only stores the channels of one MathMode plus alpha - other colour spaces are rebuilt when a pixel is read</para>
+/// </summary>
+/// <typeparam name="T">float or double</typeparam>
+template<typename T>
+class PixelBuffer {
+public:
+	PixelBuffer() {};
+
+	/// <summary>
+	/// </summary>
+	/// <param name="width"></param>
+	/// <param name="height"></param>
+	/// <param name="mode">sRGB, Linear_RGB, OkLab or OkLab_Lightness (lightness only stores one channel)</param>
+	/// <param name="rows">Rows stored at a time - 0 stores every row, see MoveWindow()</param>
+	PixelBuffer(const int width, const int height, const Colour::MathMode mode, const int rows = 0) {
+		Resize(width, height, mode, rows);
+	}
+	~PixelBuffer() {};
+
+	void Resize(const int width, const int height, const Colour::MathMode mode, const int rows = 0) {
+		m_w = width;
+		m_h = height;
+		m_rows = rows > 0 ? rows : height;
+		m_firstRow = 0;
+		m_mode = mode;
+		m_channels = ChannelCount(mode);
+		m_size = static_cast<size_t>(width) * static_cast<size_t>(m_rows);
+
+		m_data.assign(m_size * static_cast<size_t>(m_channels + 1), T(0));
+	}
+
+	/// <summary>
+	/// Number of colour channels (excluding alpha) needed for a MathMode
+	/// </summary>
+	/// <param name="mode"></param>
+	/// <returns></returns>
+	static int ChannelCount(const Colour::MathMode mode) {
+		return mode == Colour::MathMode::OkLab_Lightness ? 1 : 3;
+	}
+
+	inline int GetWidth() const { return m_w; };
+
+	/// <summary>
+	/// Height of the image - can be more than the rows stored
+	/// </summary>
+	inline int GetHeight() const { return m_h; };
+	inline int GetChannels() const { return m_channels; };
+	inline Colour::MathMode GetMode() const { return m_mode; };
+	inline size_t size() const { return m_size; };
+
+	/// <summary>
+	/// Total bytes used by all channels
+	/// </summary>
+	inline size_t MemorySize() const { return m_data.size() * sizeof(T); };
+
+	inline size_t GetIndex(const int x, const int y) const { return size_t(x + (y - m_firstRow) * m_w); };
+
+	/// <summary>
+	/// First image row stored
+	/// </summary>
+	inline int GetFirstRow() const { return m_firstRow; };
+
+	/// <summary>
+	/// <para>Stores rows from firstRow - rows already stored that are still in the window keep their values</para>
+	/// <para>Lets error diffused into the next rows carry over when an image is dithered a band of rows at a time</para>
+	/// </summary>
+	/// <param name="firstRow">Can only move down</param>
+	void MoveWindow(const int firstRow) {
+		// Every row is stored so there is nothing to move
+		const int shift = firstRow - m_firstRow;
+		if (shift <= 0 || m_rows == m_h) return;
+
+		const size_t w = static_cast<size_t>(m_w);
+		if (shift < m_rows) {
+			const size_t offset = static_cast<size_t>(shift) * w;
+			for (int c = 0; c <= m_channels; ++c) {
+				T* channel = GetChannel(c);
+				std::copy(channel + offset, channel + m_size, channel);
+			}
+		}
+
+		m_firstRow = firstRow;
+	}
+
+	inline T* GetChannel(const int channel) { return m_data.data() + static_cast<size_t>(channel) * m_size; };
+	inline const T* GetChannel(const int channel) const { return m_data.data() + static_cast<size_t>(channel) * m_size; };
+
+	inline T* GetAlphaChannel() { return GetChannel(m_channels); };
+	inline const T* GetAlphaChannel() const { return GetChannel(m_channels); };
+
+	inline double GetAlpha(const size_t index) const { return static_cast<double>(GetAlphaChannel()[index]); };
+	inline void SetAlpha(const size_t index, const double alpha) { GetAlphaChannel()[index] = static_cast<T>(alpha); };
+
+	/// <summary>
+	/// Store the channels of the buffer's MathMode and alpha
+	/// </summary>
+	/// <param name="index"></param>
+	/// <param name="col"></param>
+	void SetColour(const size_t index, const Colour& col) {
+		double c0 = 0., c1 = 0., c2 = 0.;
+
+		switch (m_mode) {
+		case Colour::MathMode::sRGB: {
+			const Colour::sRGB v = col.GetsRGB();
+			c0 = v.r; c1 = v.g; c2 = v.b;
+			break;
+		}
+		case Colour::MathMode::Linear_RGB: {
+			const Colour::LRGB v = col.GetLRGB();
+			c0 = v.r; c1 = v.g; c2 = v.b;
+			break;
+		}
+		default: {
+			const Colour::OkLab v = col.GetOkLab();
+			c0 = v.l; c1 = v.a; c2 = v.b;
+			break;
+		}
+		}
+
+		GetChannel(0)[index] = static_cast<T>(c0);
+		if (m_channels == 3) {
+			GetChannel(1)[index] = static_cast<T>(c1);
+			GetChannel(2)[index] = static_cast<T>(c2);
+		}
+
+		SetAlpha(index, col.GetAlpha());
+	}
+
+	/// <summary>
+	/// Rebuild a Colour from the stored channels - other colour spaces are converted from the buffer's MathMode
+	/// </summary>
+	/// <param name="index"></param>
+	/// <returns></returns>
+	Colour GetColour(const size_t index) const {
+		const double c0 = static_cast<double>(GetChannel(0)[index]);
+		const double c1 = m_channels == 3 ? static_cast<double>(GetChannel(1)[index]) : 0.;
+		const double c2 = m_channels == 3 ? static_cast<double>(GetChannel(2)[index]) : 0.;
+
+		Colour out;
+		switch (m_mode) {
+		case Colour::MathMode::sRGB:
+			out.SetsRGB_D(c0, c1, c2);
+			break;
+		case Colour::MathMode::Linear_RGB:
+			out.SetLRGB(c0, c1, c2);
+			break;
+		default:
+			out.SetOkLab(c0, c1, c2);
+			break;
+		}
+
+		// Alpha is set afterwards so transparent pixels keep their colour values
+		out.SetAlpha(GetAlpha(index));
+		return out;
+	}
+
+	/// <summary>
+	/// <para>Copy one row of an 8 bit image into the buffer</para>
+	/// <para>Same values as SetColour(Colour::FromsRGB(...)) without building a Colour per pixel</para>
+	/// </summary>
+	/// <param name="image">Same size as the buffer</param>
+	/// <param name="y"></param>
+	void SetRow(const Image& image, const int y) {
+		SetRow(image, y, y);
+	}
+
+	/// <summary>
+	/// Copy row imageY of an 8 bit image into row y of the buffer
+	/// </summary>
+	/// <param name="image">Same width as the buffer</param>
+	/// <param name="imageY"></param>
+	/// <param name="y"></param>
+	void SetRow(const Image& image, const int imageY, const int y) {
+		const size_t w = static_cast<size_t>(m_w);
+		const size_t rowStart = GetIndex(0, y);
+		const int imgChannels = image.GetChannels();
+		const bool grayscale = image.IsGrayscale();
+		const bool hasAlpha = imgChannels == 2 || imgChannels == 4;
+
+		m_row.resize(w * 6);
+		T* r = m_row.data();
+		T* g = r + w;
+		T* b = g + w;
+
+		T* alphaOut = GetAlphaChannel() + rowStart;
+
+		for (size_t x = 0; x < w; ++x) {
+			const size_t index = image.GetIndex(static_cast<int>(x), imageY);
+			const uint8_t r8 = image.GetData(index);
+			const uint8_t g8 = grayscale ? r8 : image.GetData(index + 1);
+			const uint8_t b8 = grayscale ? r8 : image.GetData(index + 2);
+			const uint8_t a8 = hasAlpha ? image.GetData(index + static_cast<size_t>(imgChannels) - 1) : 255;
+
+			const double alpha = static_cast<double>(a8) / 255.;
+			alphaOut[x] = static_cast<T>(alpha);
+
+			// Colour::SetsRGB zeroes the colour of fully transparent pixels
+			if (alpha <= 0.) {
+				r[x] = g[x] = b[x] = T(0);
+			} else if (m_mode == Colour::MathMode::sRGB) {
+				r[x] = static_cast<T>(static_cast<double>(r8) / 255.);
+				g[x] = static_cast<T>(static_cast<double>(g8) / 255.);
+				b[x] = static_cast<T>(static_cast<double>(b8) / 255.);
+			} else {
+				r[x] = static_cast<T>(Colour::sRGBUintToLRGB(r8));
+				g[x] = static_cast<T>(Colour::sRGBUintToLRGB(g8));
+				b[x] = static_cast<T>(Colour::sRGBUintToLRGB(b8));
+			}
+		}
+
+		if (m_mode != Colour::MathMode::sRGB && m_mode != Colour::MathMode::Linear_RGB) {
+			// Converted in T - float rows use the float conversions
+			T* l = b + w;
+			T* a = l + w;
+			T* bOut = a + w;
+			ColourBatch::LRGBtoOkLab(r, g, b, l, a, bOut, w);
+
+			r = l;
+			g = a;
+			b = bOut;
+		}
+
+		T* c0 = GetChannel(0) + rowStart;
+		std::copy(r, r + w, c0);
+
+		if (m_channels == 3) {
+			T* c1 = GetChannel(1) + rowStart;
+			T* c2 = GetChannel(2) + rowStart;
+			std::copy(g, g + w, c1);
+			std::copy(b, b + w, c2);
+		}
+	}
+
+private:
+	std::vector<T> m_data;
+
+	// Scratch space for SetRow
+	std::vector<T> m_row;
+
+	size_t m_size = 0;
+	int m_w = 0, m_h = 0, m_channels = 3;
+
+	// Rows stored and the image row of the first one
+	int m_rows = 0, m_firstRow = 0;
+	Colour::MathMode m_mode = Colour::MathMode::OkLab;
+};
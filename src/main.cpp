@@ -1,18 +1,28 @@
 #include "../ext/json/json.hpp"
 #include "image/Colour.h"
+#include "image/ConvertedImage.hpp"
 #include "image/Dither.h"
 #include "image/Image.h"
+#include "image/ImageRows.h"
+#include "image/ImageStream.h"
 #include "image/Palette.h"
+#include "image/PNGEncoder.h"
 #include "misc/DevTools.h"
+#include "misc/ThreadPool.h"
 #include "wrapper/Log.h"
+#include "wrapper/Metrics.h"
 #include "wrapper/Threshold.h"
 #include "misc/Random.h"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <new>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -32,15 +42,56 @@ using json = nlohmann::json;
 std::string Extension(const std::string loc);
 std::string NoExtension(const std::string loc);
 
+/// <summary>
+/// Images in a folder, matching a wildcard like "tiles/*.png" or listed one per line in a .txt file - or loc itself
+/// </summary>
+/// <param name="loc"></param>
+/// <returns></returns>
+std::vector<std::string> FindImages(const std::string& loc);
+bool WildcardMatch(const std::string& pattern, const std::string& name);
+
+/// <summary>
+/// Reads, dithers and writes one image
+/// </summary>
+/// <param name="dither">Has the settings applied</param>
+/// <param name="imageLoc"></param>
+/// <param name="settings"></param>
+/// <param name="palette"></param>
+/// <param name="source">Decoded and converted once for every profile that isn't streamed</param>
+/// <param name="order">Number of the output, see Metrics::Begin()</param>
+/// <param name="pixelCount">Pixels of the image are added to it</param>
+/// <returns></returns>
+bool DitherImage(Dither& dither, const std::string& imageLoc, const json& settings, const Palette& palette, SharedImage& source, const size_t order, size_t& pixelCount);
+
 bool CheckColourMathMode(const std::string& mode);
 
+/// <summary>
+/// Logs, checks and lower cases settings
+/// </summary>
+/// <param name="settings"></param>
+/// <returns>False if a setting is missing or invalid</returns>
+bool CheckSettings(json& settings);
+
+/// <summary>
+/// Gives checked settings to a Dither
+/// </summary>
+/// <param name="dither"></param>
+/// <param name="settings"></param>
+/// <param name="paletteLocStr">LUTs are saved next to the palette</param>
+/// <param name="threads">Replaces the "threads" setting - the share of it for each image dithered at the same time</param>
+void ApplySettings(Dither& dither, const json& settings, const std::string& paletteLocStr, const unsigned int threads);
+
 int main(int argc, char* argv[]) {
 	Random::Seed = 20260405;
 
 	// For generating blue noise array from blue noise texture
 	//#define DEV_MODE
 #ifdef DEV_MODE
-	DevTools::Run();
+	// A failed check exits with EXIT_FAILURE
+	if (!DevTools::Run()) {
+		Log::Save();
+		return EXIT_FAILURE;
+	}
 #else
 #ifdef _DEBUG
 	std::ifstream settingsLoc("data/settings.json");
@@ -72,6 +123,7 @@ int main(int argc, char* argv[]) {
 		Log::HoldConsole();
 		return EXIT_FAILURE;
 	}
+	std::vector<std::string> imageLocs = { imageLoc };
 
 	//std::string paletteLocStr = "data/bw.palette";
 	//std::string paletteLocStr = "data/custom128.palette";
@@ -93,6 +145,7 @@ int main(int argc, char* argv[]) {
 	if (argc < 4) {
 		Log::WriteOneLine("Drag and drop an image file, a .palette file and a .json file");
 		Log::WriteOneLine("Note: Only PNG, JPG, BMP or TGA image files are supported");
+		Log::WriteOneLine("Note: More images, a folder of images or a .txt file listing images can be given to dither them all");
 
 		Log::Save();
 		Log::HoldConsole();
@@ -101,7 +154,7 @@ int main(int argc, char* argv[]) {
 
 	json settings;
 	std::string paletteLocStr;
-	std::string imageLoc;
+	std::vector<std::string> imageLocs;
 	for (int i = 0; i < argc; ++i) {
 		Log::WriteOneLine(argv[i]);
 		std::string extension = Extension(argv[i]);
@@ -133,22 +186,494 @@ int main(int argc, char* argv[]) {
 				return EXIT_FAILURE;
 			}
 		} else {
-			imageLoc = argv[i];
-			Image::ImageType imageType = Image::GetFileType(imageLoc.c_str());
-			if (imageType == Image::ImageType::NA) {
+			const std::vector<std::string> found = FindImages(argv[i]);
+			if (found.empty()) {
 				Log::WriteOneLine("Image not found");
 				Log::Save();
 				Log::HoldConsole();
 				return EXIT_FAILURE;
 			}
+
+			imageLocs.insert(imageLocs.end(), found.begin(), found.end());
 		}
 	}
+
+	if (imageLocs.empty()) {
+		Log::WriteOneLine("Image not found");
+		Log::Save();
+		Log::HoldConsole();
+		return EXIT_FAILURE;
+	}
 	Log::EndLine();
 #endif // _DEBUG
 
 	// ========== GET SETTINGS ==========
 
 	Log::WriteOneLine("===== GETTING SETINGS =====");
+
+	// Optional - each profile is the settings with its keys replaced, all dithered from the same decoded image
+	std::vector<json> profiles;
+	if (settings.contains("profiles")) {
+		if (settings["profiles"].type() != json::value_t::array || settings["profiles"].empty()) {
+			Log::WriteOneLine("Wrong value type: profiles");
+			Log::Save();
+			Log::HoldConsole();
+			return EXIT_FAILURE;
+		}
+
+		for (auto it = settings["profiles"].begin(); it != settings["profiles"].end(); ++it) {
+			if ((*it).type() != json::value_t::object) {
+				Log::WriteOneLine("Wrong value type: profiles[]");
+				Log::Save();
+				Log::HoldConsole();
+				return EXIT_FAILURE;
+			}
+
+			json profile = settings;
+			profile.erase("profiles");
+			profile.update(*it);
+			profiles.push_back(profile);
+		}
+	} else {
+		profiles.push_back(settings);
+	}
+
+	bool validSettings = true;
+	for (size_t i = 0; i < profiles.size(); ++i) {
+		if (profiles.size() > 1) {
+			Log::EndLine();
+			Log::WriteOneLine("Profile " + Log::ToString(i + 1) + " / " + Log::ToString(profiles.size()));
+		}
+
+		if (!CheckSettings(profiles[i])) validSettings = false;
+	}
+
+	if (!validSettings) {
+		Log::Save();
+		Log::HoldConsole();
+		return EXIT_FAILURE;
+	}
+
+	// ========== GET PALETTE ==========
+
+	Log::EndLine();
+	Log::WriteOneLine("===== GETTING PALETTE =====");
+
+	// Each palette is sorted in this MathMode and every image starts in it
+	std::vector<Colour::MathMode> paletteModes;
+	std::vector<Palette> palettes;
+	palettes.reserve(profiles.size());
+	for (const json& profile : profiles) {
+		paletteModes.push_back(profile["mono"] ? Colour::MathMode::OkLab_Lightness : Colour::MathMode::OkLCh);
+		Colour::SetMathMode(paletteModes.back());
+
+		Metrics::Timer timer(Metrics::Stage::Palette);
+		palettes.emplace_back(paletteLocStr.c_str(), profile["grayscale"]);
+
+		// Only read from here on so every image can be dithered with it at the same time
+		palettes.back().PrepareShared(Dither::ToColourMathMode(profile["distanceMode"]));
+	}
+	Colour::White.ConvertAll();
+
+	// ========== DITHER IMAGES ==========
+
+	// Every profile of every image is dithered at the same time - each worker has its own Dither for every profile and the threads are split between them
+	const size_t outputs = imageLocs.size() * profiles.size();
+	const unsigned int threads = ThreadPool::ResolveThreadCount(settings.value("threads", 0u));
+	const unsigned int workers = static_cast<unsigned int>(std::min<size_t>(threads, outputs));
+
+	// The palettes, threshold maps, caches and tables are kept between the images of each worker
+	std::vector<Dither> dithers(static_cast<size_t>(workers) * profiles.size());
+	for (unsigned int w = 0; w < workers; ++w) {
+		for (size_t j = 0; j < profiles.size(); ++j) {
+			Dither& dither = dithers[w * profiles.size() + j];
+			ApplySettings(dither, profiles[j], paletteLocStr, std::max(1u, ThreadPool::ResolveThreadCount(profiles[j].value("threads", 0u)) / workers));
+
+			// Every worker reads the same tables
+			if (w > 0) dither.ShareLUT(dithers[j]);
+		}
+	}
+
+	const std::chrono::steady_clock::time_point batchStart = std::chrono::steady_clock::now();
+	std::atomic<size_t> pixelCount = 0, failed = 0;
+
+	// Decoded and converted by the first profile that needs it - freed once the image's last profile is done
+	std::vector<SharedImage> sources(imageLocs.size());
+	std::vector<std::atomic<size_t>> profilesLeft(imageLocs.size());
+	for (std::atomic<size_t>& left : profilesLeft) left = profiles.size();
+
+	// Lines of each output are kept together and written in order once the outputs before it are done
+	std::vector<std::string> logs(outputs);
+	std::vector<char> logDone(outputs, 0);
+	size_t nextLog = 0;
+	std::mutex logMutex;
+
+	// Outputs are handed out in order so only a few images are held at a time
+	ThreadPool outputPool(workers);
+	outputPool.ParallelFor(outputs, [&](const size_t output, const unsigned int worker) {
+		const size_t i = output / profiles.size();
+		const size_t j = output % profiles.size();
+
+		if (workers > 1) Log::BeginCapture(logs[output]);
+
+		if (outputs > 1) {
+			Log::EndLine();
+			Log::WriteOneLine("===== IMAGE " + Log::ToString(i + 1) + " / " + Log::ToString(imageLocs.size()) +
+				" - PROFILE " + Log::ToString(j + 1) + " / " + Log::ToString(profiles.size()) + " =====");
+		}
+
+		// Per thread settings
+		Colour::SetMathMode(paletteModes[j]);
+		PNGEncoder::SetCompression(profiles[j].value("pngCompression", "default"));
+		PNGEncoder::SetThreads(std::max(1u, ThreadPool::ResolveThreadCount(profiles[j].value("threads", 0u)) / workers));
+
+		size_t pixels = 0;
+		bool success = false;
+		try {
+			success = DitherImage(dithers[worker * profiles.size() + j], imageLocs[i], profiles[j], palettes[j], sources[i], output, pixels);
+		} catch (const std::bad_alloc&) {
+			// Only this output fails - the rest of the batch carries on
+			Log::WriteOneLine("Not enough memory");
+		}
+
+		if (!success) {
+			Metrics::End("", 0, false);
+
+			Log::WriteOneLine("Failed: " + imageLocs[i]);
+			++failed;
+		}
+		pixelCount += pixels;
+
+		if (--profilesLeft[i] == 0) sources[i].Clear();
+
+		if (workers == 1) return;
+		Log::EndCapture();
+
+		std::lock_guard<std::mutex> lock(logMutex);
+		logDone[output] = 1;
+		for (; nextLog < logs.size() && logDone[nextLog]; ++nextLog) {
+			Log::WriteCaptured(logs[nextLog]);
+			std::string().swap(logs[nextLog]);
+		}
+	});
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+
+	if (outputs > 1) {
+		const double done = static_cast<double>(outputs - failed);
+
+		Log::EndLine();
+		Log::WriteOneLine("===== BATCH =====");
+		Log::WriteOneLine("Outputs: " + Log::ToString(outputs - failed) + " / " + Log::ToString(outputs));
+		Log::WriteOneLine("Outputs at once: " + Log::ToString(workers));
+		Log::WriteOneLine("Time: " + Log::ToString(seconds, 3) + "s");
+		Log::WriteOneLine("Outputs/s: " + Log::ToString(done / seconds, 3));
+		Log::WriteOneLine("Megapixels/s: " + Log::ToString(static_cast<double>(pixelCount.load()) / 1000000. / seconds, 3));
+
+		Metrics::LogTotal();
+	}
+
+	// Optional - checked with the other settings
+	const std::string metricsLoc = settings.value("metrics", std::string());
+	if (!metricsLoc.empty()) Metrics::Save(metricsLoc);
+
+	if (failed > 0) {
+		Log::Save();
+		Log::HoldConsole();
+		return EXIT_FAILURE;
+	}
+
+#endif // DEV_MODE
+
+	Log::Save();
+	//Log::HoldConsole();
+	Log::Sound(1);
+	return EXIT_SUCCESS;
+}
+
+std::string Extension(const std::string loc) {
+	std::filesystem::path p = loc;
+	return p.extension().string();
+}
+
+std::string NoExtension(const std::string loc) {
+	std::filesystem::path p = loc;
+	std::filesystem::path noExt = p.parent_path() / p.stem();
+	return noExt.string();
+}
+
+std::vector<std::string> FindImages(const std::string& loc) {
+	std::vector<std::string> images;
+	const std::filesystem::path p = loc;
+
+	if (Extension(loc) == ".txt") {
+		// One image per line - relative to the list's folder
+		std::ifstream list(loc);
+		if (!list) return images;
+
+		std::string line;
+		while (std::getline(list, line)) {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (line.empty()) continue;
+
+			std::filesystem::path image = line;
+			if (image.is_relative()) image = p.parent_path() / image;
+
+			if (Image::GetFileType(image.string().c_str()) == Image::ImageType::NA) {
+				Log::WriteOneLine("Not an image: " + line);
+				continue;
+			}
+			images.push_back(image.string());
+		}
+		return images;
+	}
+
+	std::filesystem::path folder;
+	std::string pattern = "*";
+	if (std::filesystem::is_directory(p)) {
+		folder = p;
+	} else if (p.filename().string().find_first_of("*?") != std::string::npos) {
+		folder = p.has_parent_path() ? p.parent_path() : std::filesystem::path(".");
+		pattern = p.filename().string();
+	} else {
+		if (Image::GetFileType(loc.c_str()) != Image::ImageType::NA) images.push_back(loc);
+		return images;
+	}
+
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(folder, error)) {
+		if (!entry.is_regular_file()) continue;
+
+		const std::string name = entry.path().filename().string();
+		if (!WildcardMatch(pattern, name)) continue;
+
+		const std::string image = entry.path().string();
+		if (Image::GetFileType(image.c_str()) != Image::ImageType::NA) images.push_back(image);
+	}
+
+	// Directory order isn't the same on every system
+	std::sort(images.begin(), images.end());
+	return images;
+}
+
+bool WildcardMatch(const std::string& pattern, const std::string& name) {
+	// '*' is any number of characters, '?' is one
+	size_t p = 0, n = 0;
+	size_t starP = std::string::npos, starN = 0;
+
+	while (n < name.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+			++p;
+			++n;
+		} else if (p < pattern.size() && pattern[p] == '*') {
+			starP = p++;
+			starN = n;
+		} else if (starP != std::string::npos) {
+			p = starP + 1;
+			n = ++starN;
+		} else {
+			return false;
+		}
+	}
+
+	while (p < pattern.size() && pattern[p] == '*') ++p;
+	return p == pattern.size();
+}
+
+bool DitherImage(Dither& dither, const std::string& imageLoc, const json& settings, const Palette& palette, SharedImage& source, const size_t order, size_t& pixelCount) {
+	// ========== GET IMAGE ==========
+
+	Log::EndLine();
+	Log::WriteOneLine("===== GETTING IMAGE =====");
+
+	Metrics::Begin(imageLoc, order);
+
+	// JPG and TGA can't be read a row at a time
+	bool stream = settings.value("stream", false) && ImageReader::CanStream(imageLoc.c_str());
+
+	Image image;
+	ConvertedImage* converted = nullptr;
+	StreamRows streamRows;
+	if (stream) {
+		// Same as below for every row - the grayscale version isn't saved
+		const StreamRows::Transform transform = [&settings, &dither](Image& row) {
+			if (settings["mono"] || !bool(settings["grayscale"])) {
+				row.ToRGB();
+			} else if ((bool)settings["grayscale"] && row.GetChannels() >= 3) {
+				const Colour::MathMode mode = Colour::GetMathMode();
+
+				Dither::SetColourMathMode(settings["distanceMode"]);
+				dither.ImageToGrayscale(row);
+				row.ToRGB();
+
+				Colour::SetMathMode(mode);
+			}
+
+			if ((bool)settings["hideSemiTransparent"]) row.HideSemiTransparent(settings["hideThreshold"]);
+		};
+
+		// Interlaced PNGs can't be read a row at a time either
+		if (!streamRows.Open(imageLoc, transform)) {
+			Log::WriteOneLine("Loading whole image instead");
+			stream = false;
+		}
+	}
+
+	if (!stream) {
+		ConvertedImage& decoded = source.Get("decoded");
+		{
+			Metrics::Timer timer(Metrics::Stage::Decode);
+			if (!decoded.Make([&imageLoc](Image& read) { return read.Read(imageLoc.c_str()); })) return false;
+		}
+
+		// Profiles with the same preprocessing share the image and its conversions
+		const bool grayscale = !settings["mono"] && (bool)settings["grayscale"];
+		std::string key = grayscale ? "grayscale " + (std::string)settings["distanceMode"] : "rgb";
+		if ((bool)settings["hideSemiTransparent"]) key += " hide " + Log::ToString((unsigned int)settings["hideThreshold"]);
+
+		converted = &source.Get(key);
+
+		Metrics::Timer colourTimer(Metrics::Stage::Colour);
+		converted->Make([&](Image& prepared) {
+			prepared = decoded.GetImage();
+
+			if (!grayscale) {
+				prepared.ToRGB();
+			} else if (prepared.GetChannels() >= 3) {
+				const Colour::MathMode mode = Colour::GetMathMode();
+
+				Dither::SetColourMathMode(settings["distanceMode"]);
+				//Dither::ImageToGrayscale(image);
+				dither.ImageToGrayscale(prepared);
+
+				// saves grayscale version
+				std::string folder = NoExtension(imageLoc);
+				std::filesystem::create_directories(folder);
+
+				folder += "\\grayscale-" + (std::string)settings["distanceMode"] + ".png";
+
+				// Not counted as colour conversion
+				colourTimer.Stop();
+				{
+					Metrics::Timer timer(Metrics::Stage::Encode);
+					prepared.Write(folder.c_str());
+				}
+
+				prepared.ToRGB();
+
+				Colour::SetMathMode(mode);
+			}
+
+			//if (settings["mono"]) image.ToRGB();
+			//Log::WriteOneLine("Is Grayscale: " + Log::ToString(image.IsGrayscale()));
+
+			if ((bool)settings["hideSemiTransparent"]) prepared.HideSemiTransparent(settings["hideThreshold"]);
+			return true;
+		});
+
+		image = converted->GetImage();
+	}
+
+	// ===== Generate Output Path =====
+
+	const std::string folder = NoExtension(imageLoc);
+
+	std::string outputLoc = folder + '\\';
+
+	if (settings["mono"]) {
+		outputLoc += "mono";
+	} else if (settings["grayscale"]) {
+		outputLoc += "grayscale";
+	} else {
+		outputLoc += "regular";
+	}
+
+	std::filesystem::create_directories(outputLoc);
+
+	outputLoc += "\\" + (std::string)settings["ditherType"];
+
+	if (settings["ditherType"] == "ordered") outputLoc += "-" + (std::string)settings["matrixType"];
+
+	outputLoc += "-" + (std::string)settings["distanceMode"];
+
+	if (settings["ditherType"] != "none" && 
+		settings["ditherType"] != "ordered") outputLoc += "-" + (std::string)settings["mathMode"];
+
+	if (stream ? streamRows.HasAlphaChannel() : image.HasAlphaChannel()) {
+		if (settings["ditherAlpha"] && settings["ditherAlphaType"] == "ordered" && settings["ditherType"] != "ordered") outputLoc += "-" + (std::string)settings["matrixType"];
+
+		if (settings["ditherAlpha"] && settings["ditherAlphaType"] == "fs") outputLoc += "-fs";
+	}
+
+	outputLoc += ".png";
+
+	// ========== DITHERING ==========
+
+	Log::EndLine();
+	Log::WriteOneLine("===== DITHERING =====");
+
+	if (stream) {
+		// Finished rows are written as each band is done
+		bool success = streamRows.OpenOutput(outputLoc);
+
+		if (success) {
+			if (settings["ditherType"] == "ordered") {
+				success = dither.OrderedDither(streamRows, palette);
+			} else if (settings["ditherType"] == "fs") {
+				success = dither.FloydDither(streamRows, palette);
+			} else {
+				success = dither.NoDither(streamRows, palette);
+			}
+		}
+
+		{
+			// Writes the last band
+			Metrics::Timer timer(Metrics::Stage::Stream);
+			if (!streamRows.Finish() || !success) return false;
+		}
+
+		const size_t pixels = static_cast<size_t>(streamRows.GetWidth()) * static_cast<size_t>(streamRows.GetHeight());
+		pixelCount += pixels;
+		Metrics::End(outputLoc, pixels, true);
+	} else {
+		if (settings["ditherType"] == "ordered") {
+			dither.OrderedDither(image, palette, converted);
+		} else if (settings["ditherType"] == "fs") {
+			dither.FloydDither(image, palette, converted);
+		} else {
+			dither.NoDither(image, palette, converted);
+		}
+
+		{
+			Metrics::Timer timer(Metrics::Stage::Encode);
+
+			// Every pixel is a palette colour so it fits in a palette PNG unless there are too many alpha levels
+			// The palette indices kept while dithering save finding every pixel's colour again
+			const bool written = settings.value("indexed", false) ? image.WriteIndexed(outputLoc.c_str(), dither.GetIndices(), palette.size()) : image.Write(outputLoc.c_str());
+			if (!written) return false;
+		}
+
+		const size_t pixels = static_cast<size_t>(image.GetWidth()) * static_cast<size_t>(image.GetHeight());
+		pixelCount += pixels;
+		Metrics::End(outputLoc, pixels, true);
+	}
+
+	return true;
+}
+
+bool CheckColourMathMode(const std::string& mode) {
+	if (mode == "srgb") {
+		return true;
+	} else if (mode == "oklab") {
+		return true;
+	} else if (mode == "oklab_l") {
+		return true;
+	} else if (mode == "lrgb") {
+		return true;
+	}
+	return false;
+}
+
+bool CheckSettings(json& settings) {
 	std::unordered_map<std::string, json::value_t> required = {
 		//{ "grayscale", json::value_t::boolean },
 		//{ "dist_lightness", json::value_t::boolean },
@@ -190,12 +715,97 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	if (!allFound) {
-		Log::Save();
-		Log::HoldConsole();
-		return EXIT_FAILURE;
+	// Optional - 0 uses every core
+	unsigned int threads = 0;
+	if (settings.contains("threads")) {
+		if (settings["threads"].type() != json::value_t::number_unsigned) {
+			Log::WriteOneLine("Wrong value type: threads");
+			allFound = false;
+		} else {
+			threads = static_cast<unsigned int>(settings["threads"]);
+			Log::WriteOneLine("threads: " + Log::ToString(threads, 0, '0'));
+		}
 	}
 
+	// Optional - table of palette indices for every colour
+	bool useLUT = false;
+	if (settings.contains("lut")) {
+		if (settings["lut"].type() != json::value_t::boolean) {
+			Log::WriteOneLine("Wrong value type: lut");
+			allFound = false;
+		} else {
+			useLUT = (bool)settings["lut"];
+			Log::WriteOneLine("lut: " + Log::ToString(useLUT));
+		}
+	}
+
+	// Optional - reads and writes a band of rows at a time for images too big to load
+	bool useStream = false;
+	if (settings.contains("stream")) {
+		if (settings["stream"].type() != json::value_t::boolean) {
+			Log::WriteOneLine("Wrong value type: stream");
+			allFound = false;
+		} else {
+			useStream = (bool)settings["stream"];
+			Log::WriteOneLine("stream: " + Log::ToString(useStream));
+		}
+	}
+
+	// Optional - float dither buffers instead of double
+	if (settings.contains("float")) {
+		if (settings["float"].type() != json::value_t::boolean) {
+			Log::WriteOneLine("Wrong value type: float");
+			allFound = false;
+		} else {
+			Log::WriteOneLine("float: " + Log::ToString((bool)settings["float"]));
+		}
+	}
+
+	// Optional - palette PNG output
+	if (settings.contains("indexed")) {
+		if (settings["indexed"].type() != json::value_t::boolean) {
+			Log::WriteOneLine("Wrong value type: indexed");
+			allFound = false;
+		} else {
+			Log::WriteOneLine("indexed: " + Log::ToString((bool)settings["indexed"]));
+		}
+	}
+
+	// Optional - skip fully transparent pixels
+	if (settings.contains("skipTransparent")) {
+		if (settings["skipTransparent"].type() != json::value_t::boolean) {
+			Log::WriteOneLine("Wrong value type: skipTransparent");
+			allFound = false;
+		} else {
+			Log::WriteOneLine("skipTransparent: " + Log::ToString((bool)settings["skipTransparent"]));
+		}
+	}
+
+	// Optional - PNG encoding speed against file size
+	if (settings.contains("pngCompression")) {
+		if (settings["pngCompression"].type() != json::value_t::string) {
+			Log::WriteOneLine("Wrong value type: pngCompression");
+			allFound = false;
+		} else {
+			std::string value = settings["pngCompression"];
+			std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+			settings["pngCompression"] = value;
+			Log::WriteOneLine("pngCompression: \"" + value + "\"");
+		}
+	}
+
+	// Optional - JSON file the stage timings of every output are saved to
+	if (settings.contains("metrics")) {
+		if (settings["metrics"].type() != json::value_t::string) {
+			Log::WriteOneLine("Wrong value type: metrics");
+			allFound = false;
+		} else {
+			Log::WriteOneLine("metrics: \"" + (std::string)settings["metrics"] + "\"");
+		}
+	}
+
+	if (!allFound) return false;
+
 	Log::EndLine();
 
 	bool invalidType = false;
@@ -233,6 +843,11 @@ int main(int argc, char* argv[]) {
 		invalidType = true;
 	}
 
+	if (!PNGEncoder::IsValidSetting(settings.value("pngCompression", "default"))) {
+		Log::WriteOneLine("Invalid pngCompression: " + static_cast<std::string>(settings["pngCompression"]));
+		invalidType = true;
+	}
+
 	if (!Threshold::IsValidSetting(settings["matrixType"])) {
 		Log::WriteOneLine("Invalid matrixType: " + static_cast<std::string>(settings["matrixType"]));
 		invalidType = true;
@@ -325,13 +940,11 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	if (invalidType) {
-		Log::Save();
-		Log::HoldConsole();
-		return EXIT_FAILURE;
-	}
+	return !invalidType;
+}
 
-	Dither::SetSettings(
+void ApplySettings(Dither& dither, const json& settings, const std::string& paletteLocStr, const unsigned int threads) {
+	dither.SetSettings(
 		settings["distanceMode"],
 		settings["mathMode"],
 		(bool)settings["mono"],
@@ -339,133 +952,17 @@ int main(int argc, char* argv[]) {
 		((bool)settings["hideSemiTransparent"] ? false : (bool)settings["ditherAlpha"]),
 		static_cast<unsigned int>(settings["ditherAlphaFactor"]),
 		settings["ditherAlphaType"], 
-		static_cast<bool>(settings["normaliseCol"]));
-	Threshold::SetShape(sizes[0], sizes[1], points);
-
-	// ========== GET IMAGE ==========
-
-	Log::EndLine();
-	Log::WriteOneLine("===== GETTING IMAGE =====");
-
-	Image image;
-	if (!image.Read(imageLoc.c_str())) {
-		Log::Save();
-		Log::HoldConsole();
-		return EXIT_FAILURE;
-	}
-
-	if (settings["mono"] || !bool(settings["grayscale"])) {
-		image.ToRGB();
-	} else if ((bool)settings["grayscale"] && image.GetChannels() >= 3) {
-		Dither::SetColourMathMode(settings["distanceMode"]);
-		//Dither::ImageToGrayscale(image);
-		Dither::ImageToGrayscale(image);
-
-		// saves grayscale version
-		std::string folder = NoExtension(imageLoc);
-		std::filesystem::create_directories(folder);
-
-		folder += "\\grayscale-" + (std::string)settings["distanceMode"] + ".png";
-
-		image.Write(folder.c_str());
-
-		image.ToRGB();
-	}
-
-	//if (settings["mono"]) image.ToRGB();
-	//Log::WriteOneLine("Is Grayscale: " + Log::ToString(image.IsGrayscale()));
-
-	if ((bool)settings["hideSemiTransparent"]) image.HideSemiTransparent(settings["hideThreshold"]);
-
-	// ========== GET PALETTE ==========
-
-	Log::EndLine();
-	Log::WriteOneLine("===== GETTING PALETTE =====");
-	
-	if (settings["mono"]) {
-		Colour::SetMathMode(Colour::MathMode::OkLab_Lightness);
-	} else {
-		Colour::SetMathMode(Colour::MathMode::OkLCh);
-	}
-	
-	Palette palette(paletteLocStr.c_str(), settings["grayscale"]);
-
-	// ========== DITHERING ==========
-
-	Log::EndLine();
-	Log::WriteOneLine("===== DITHERING =====");
-
-	if (settings["ditherType"] == "ordered") {
-		Dither::OrderedDither(image, palette);
-	} else if (settings["ditherType"] == "fs") {
-		Dither::FloydDither(image, palette);
-	} else {
-		Dither::NoDither(image, palette);
-	}
-
-	// ===== Generate Output Path =====
-
-	const std::string folder = NoExtension(imageLoc);
-
-	std::string outputLoc = folder + '\\';
-
-	if (settings["mono"]) {
-		outputLoc += "mono";
-	} else if (settings["grayscale"]) {
-		outputLoc += "grayscale";
-	} else {
-		outputLoc += "regular";
-	}
-
-	std::filesystem::create_directories(outputLoc);
-
-	outputLoc += "\\" + (std::string)settings["ditherType"];
-
-	if (settings["ditherType"] == "ordered") outputLoc += "-" + (std::string)settings["matrixType"];
-
-	outputLoc += "-" + (std::string)settings["distanceMode"];
-
-	if (settings["ditherType"] != "none" && 
-		settings["ditherType"] != "ordered") outputLoc += "-" + (std::string)settings["mathMode"];
-
-	if (image.HasAlphaChannel()) {
-		if (settings["ditherAlpha"] && settings["ditherAlphaType"] == "ordered" && settings["ditherType"] != "ordered") outputLoc += "-" + (std::string)settings["matrixType"];
-
-		if (settings["ditherAlpha"] && settings["ditherAlphaType"] == "fs") outputLoc += "-fs";
-	}
-
-	outputLoc += ".png";
-
-	image.Write(outputLoc.c_str());
-
-#endif // DEV_MODE
-
-	Log::Save();
-	//Log::HoldConsole();
-	Log::Sound(1);
-	return EXIT_SUCCESS;
-}
-
-std::string Extension(const std::string loc) {
-	std::filesystem::path p = loc;
-	return p.extension().string();
-}
-
-std::string NoExtension(const std::string loc) {
-	std::filesystem::path p = loc;
-	std::filesystem::path noExt = p.parent_path() / p.stem();
-	return noExt.string();
+		static_cast<bool>(settings["normaliseCol"]),
+		threads);
+	std::vector<int> sizes;
+	std::vector<std::vector<int>> points;
+	settings["shape"]["size"].get_to(sizes);
+	settings["shape"]["points"].get_to(points);
+	dither.SetShape(sizes[0], sizes[1], points);
+
+	// Tables are saved next to the palette so every image using it can load them
+	dither.SetLUT(settings.value("lut", false), (std::filesystem::path(paletteLocStr).parent_path() / "lut").string());
+	dither.SetFloat(settings.value("float", false));
+	dither.SetKeepIndices(settings.value("indexed", false));
+	dither.SetSkipTransparent(settings.value("skipTransparent", false));
 }
-
-bool CheckColourMathMode(const std::string& mode) {
-	if (mode == "srgb") {
-		return true;
-	} else if (mode == "oklab") {
-		return true;
-	} else if (mode == "oklab_l") {
-		return true;
-	} else if (mode == "lrgb") {
-		return true;
-	}
-	return false;
-}
\ No newline at end of file
@@ -5,19 +5,29 @@
 #include "../../ext/json/json.hpp"
 #include "../../res/resource.h"
 #include "../image/Colour.h"
+#include "../image/ColourBatch.h"
+#include "../image/Dither.h"
+#include "../image/DitherKernel.h"
 #include "../image/Image.h"
+#include "../image/ImageRows.h"
 #include "../image/Palette.h"
+#include "../image/PaletteTree.h"
+#include "../image/PNGEncoder.h"
 #include "../misc/Random.h"
 #include "../wrapper/Log.h"
 #include "../wrapper/Threshold.h"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <iterator>
 #include <limits>
 #include <string>
 #include <cstring>
+#include <thread>
 #include <vector>
 #include <windows.h>
 
@@ -25,7 +35,7 @@
 
 using json = nlohmann::json;
 
-void DevTools::Run() {
+bool DevTools::Run() {
 	GenerateBlueNoisePalette();
 	//Log::EndLine();
 	//Log::EndLine();
@@ -45,6 +55,97 @@ void DevTools::Run() {
 
 	//Misc();
 	//PaletteToImage("vga256");
+	//BenchmarkColourConversion();
+	//BenchmarkFloydThreads();
+	//CheckFloatPrecision();
+	//BenchmarkOrderedKernel();
+	//BenchmarkIndexedPNG();
+	//BenchmarkPNGCompression();
+	//BenchmarkPaletteBinary();
+	//BenchmarkPaletteSort();
+	//BenchmarkAlphaKernel();
+	//BenchmarkSkipTransparent();
+
+	return RunChecks();
+}
+
+bool DevTools::RunChecks() {
+	Log::EndLine();
+	Log::WriteOneLine("===== CHECKS =====");
+
+	bool passed = true;
+	passed = CheckColourBatch() && passed;
+	passed = CheckFloydThreads() && passed;
+	passed = CheckPaletteTree() && passed;
+	passed = CheckThreshold() && passed;
+	passed = CheckFloatPrecision() && passed;
+	passed = CheckSelectIndices() && passed;
+	passed = CheckIndexedPNG() && passed;
+	passed = CheckPNGCompression() && passed;
+	passed = CheckPaletteBinary() && passed;
+	passed = CheckPaletteSort() && passed;
+	passed = CheckAlphaKernel() && passed;
+	passed = CheckSkipTransparent() && passed;
+	passed = CheckOrderedThreads() && passed;
+	passed = CheckLUT() && passed;
+	passed = CheckStream() && passed;
+
+	Log::WriteOneLine(passed ? "Every check passed" : "CHECKS FAILED");
+	Log::Save("dev/misc/checks.txt");
+	return passed;
+}
+
+bool DevTools::Report(const std::string& check, const bool pass, const std::string& detail) {
+	Log::WriteOneLine((pass ? "PASS " : "FAIL ") + check + (detail.empty() ? "" : " - " + detail));
+	return pass;
+}
+
+double DevTools::TimeSeconds(const std::function<void()>& func, const int runs) {
+	const auto start = std::chrono::steady_clock::now();
+	for (int run = 0; run < runs; ++run) func();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(runs);
+}
+
+void DevTools::DitherWith(Dither& dither, const std::string& ditherType, Image& image, const Palette& palette) {
+	if (ditherType == "ordered") {
+		dither.OrderedDither(image, palette);
+	} else if (ditherType == "fs") {
+		dither.FloydDither(image, palette);
+	} else {
+		dither.NoDither(image, palette);
+	}
+}
+
+bool DevTools::SameData(const Image& a, const Image& b) {
+	if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight() || a.GetChannels() != b.GetChannels()) return false;
+
+	for (size_t i = 0; i < a.GetSize(); ++i) {
+		if (a.GetData(i) != b.GetData(i)) return false;
+	}
+	return true;
+}
+
+void DevTools::WriteRandomPalette(const std::string& file, const size_t count) {
+	std::filesystem::create_directories(std::filesystem::path(file).parent_path());
+
+	Random::Seed = 20260405;
+	std::ofstream text(file);
+	for (size_t i = 0; i < count; ++i) {
+		const Colour col(static_cast<uint8_t>(Random::RandUInt(0, 255)), static_cast<uint8_t>(Random::RandUInt(0, 255)), static_cast<uint8_t>(Random::RandUInt(0, 255)));
+		text << col.GetHex() << (i + 1 < count ? "\n" : "");
+	}
+}
+
+bool DevTools::SamePixels(const std::string& fileA, const std::string& fileB) {
+	Image a(fileA.c_str()), b(fileB.c_str());
+	if (a.GetSize() == 0 || b.GetSize() == 0) return false;
+
+	// Palette PNGs read back as RGB(A) and grayscale ones as gray
+	for (Image* image : { &a, &b }) {
+		image->ToRGB();
+		image->AddAlphaChannel();
+	}
+	return SameData(a, b);
 }
 
 void DevTools::GenerateGSTiles() {
@@ -295,9 +396,8 @@ void DevTools::DebugThreshold() {
 	std::vector<std::vector<int>> points;
 	settings["shape"]["points"].get_to(points);
 
-	Threshold::SetShape(sizes[0], sizes[1], points);
-
 	Threshold threshold;
+	threshold.SetShape(sizes[0], sizes[1], points);
 	threshold.GenerateThreshold("bayershape16");
 
 	Image img(sizes[0] * 16, sizes[1] * 16, 3);
@@ -382,4 +482,1229 @@ void DevTools::ReadBlueNoiseBin(const int res) {
 	std::string outLoc = "dev/res/blueNoise" + Log::ToString(imgSize) + ".png";
 	img.Write(outLoc.c_str());
 }
+void DevTools::BenchmarkColourConversion() {
+	const size_t count = 1 << 20;
+	Random::Seed = 0;
+
+	std::vector<uint8_t> data(count * 3);
+	for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(Random::RandUInt(0, 255));
+
+	auto benchmark = [&data, count](const std::string& name, const Colour::MathMode mode, const bool allSpaces) {
+		Colour::SetMathMode(mode);
+		double sum = 0.;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; ++i) {
+			Colour col = Colour::FromsRGB(data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2]);
+
+			if (allSpaces) {
+				// Same work as the old eager Update()
+				sum += col.GetLRGB().r + col.GetOkLab().l + col.GetOkLCh().l + col.GetsRGB_UInt().r;
+			}
+
+			// Error diffusion neighbour update - only the MathMode colour space is read and written
+			col *= 0.5;
+			col.Clamp();
+			sum += col.LengthSq();
+		}
+		const auto stop = std::chrono::steady_clock::now();
+
+		const double nsPerPixel = std::chrono::duration<double, std::nano>(stop - start).count() / static_cast<double>(count);
+		Log::WriteOneLine(name + ": " + Log::ToString(nsPerPixel, 2) + " ns/pixel (" + Log::ToString(sum, 2) + ")");
+	};
+
+	benchmark("sRGB  - all spaces", Colour::MathMode::sRGB, true);
+	benchmark("sRGB  - lazy", Colour::MathMode::sRGB, false);
+	benchmark("LRGB  - all spaces", Colour::MathMode::Linear_RGB, true);
+	benchmark("LRGB  - lazy", Colour::MathMode::Linear_RGB, false);
+	benchmark("OkLab - all spaces", Colour::MathMode::OkLab, true);
+	benchmark("OkLab - lazy", Colour::MathMode::OkLab, false);
+
+	Log::Save("dev/misc/colourConversion.txt");
+}
+
+bool DevTools::CheckColourBatch() {
+	// Largest allowed absolute difference to the Colour conversions
+	const double tolerance = 1e-12;
+	const double floatTolerance = 1e-5;
+	const size_t count = 1 << 16;
+	Random::Seed = 0;
+
+	std::vector<double> in(count * 3), out(count * 3);
+	double* r = in.data();
+	double* g = r + count;
+	double* b = g + count;
+
+	for (size_t i = 0; i < count; ++i) {
+		// Error diffusion can push colours slightly out of range
+		r[i] = Random::RandDouble(-0.1, 1.1);
+		g[i] = Random::RandDouble(-0.1, 1.1);
+		b[i] = Random::RandDouble(-0.1, 1.1);
+
+		// Grayscale and black take a different path
+		if (i % 16 == 0) g[i] = b[i] = r[i];
+		if (i % 64 == 0) r[i] = g[i] = b[i] = 0.;
+	}
+
+	const ColourBatch::Instructions supported = ColourBatch::GetSupported();
+	const ColourBatch::Instructions previous = ColourBatch::GetInstructions();
+
+	bool passed = true;
+	for (int i = 0; i <= static_cast<int>(supported); ++i) {
+		const ColourBatch::Instructions instructions = static_cast<ColourBatch::Instructions>(i);
+		ColourBatch::SetInstructions(instructions);
+
+		double maxOkLab = 0.;
+		ColourBatch::LRGBtoOkLab(r, g, b, out.data(), out.data() + count, out.data() + count * 2, count);
+		for (size_t j = 0; j < count; ++j) {
+			Colour col;
+			col.SetLRGB(r[j], g[j], b[j]);
+			const Colour::OkLab expected = col.GetOkLab();
+
+			maxOkLab = std::max(maxOkLab, std::abs(out[j] - expected.l));
+			maxOkLab = std::max(maxOkLab, std::abs(out[j + count] - expected.a));
+			maxOkLab = std::max(maxOkLab, std::abs(out[j + count * 2] - expected.b));
+		}
+
+		// Use the OkLab values as input going back
+		double maxLRGB = 0.;
+		std::vector<double> lab = out;
+		ColourBatch::OkLabtoLRGB(lab.data(), lab.data() + count, lab.data() + count * 2, out.data(), out.data() + count, out.data() + count * 2, count);
+		for (size_t j = 0; j < count; ++j) {
+			const Colour col = Colour::FromOkLab(lab[j], lab[j + count], lab[j + count * 2]);
+			const Colour::LRGB expected = col.GetLRGB();
+
+			maxLRGB = std::max(maxLRGB, std::abs(out[j] - expected.r));
+			maxLRGB = std::max(maxLRGB, std::abs(out[j + count] - expected.g));
+			maxLRGB = std::max(maxLRGB, std::abs(out[j + count * 2] - expected.b));
+		}
+
+		// Float rows - compared to the double values with float tolerance
+		std::vector<float> inFloat(in.begin(), in.end()), outFloat(count * 3);
+		ColourBatch::LRGBtoOkLab(inFloat.data(), inFloat.data() + count, inFloat.data() + count * 2,
+			outFloat.data(), outFloat.data() + count, outFloat.data() + count * 2, count);
+
+		double maxFloat = 0.;
+		for (size_t j = 0; j < count; ++j) {
+			Colour col;
+			col.SetLRGB(inFloat[j], inFloat[j + count], inFloat[j + count * 2]);
+			const Colour::OkLab expected = col.GetOkLab();
+
+			maxFloat = std::max(maxFloat, std::abs(outFloat[j] - expected.l));
+			maxFloat = std::max(maxFloat, std::abs(outFloat[j + count] - expected.a));
+			maxFloat = std::max(maxFloat, std::abs(outFloat[j + count * 2] - expected.b));
+		}
+
+		passed = Report("ColourBatch " + ColourBatch::ToString(instructions),
+			maxOkLab <= tolerance && maxLRGB <= tolerance && maxFloat <= floatTolerance,
+			"LRGB to OkLab max error " + Log::ToString(maxOkLab, 17) +
+			", OkLab to LRGB max error " + Log::ToString(maxLRGB, 17) +
+			", float LRGB to OkLab max error " + Log::ToString(maxFloat, 17)) && passed;
+	}
+
+	ColourBatch::SetInstructions(previous);
+	return passed;
+}
+
+bool DevTools::CheckFloydThreads() {
+	const Palette palette("data/custom64.palette");
+
+	bool passed = true;
+	for (const std::string name : { "lenna", "alphaTest" }) {
+		const Image original(("data/" + name + ".png").c_str());
+		if (original.GetSize() == 0 || palette.size() == 0) {
+			passed = Report("Floyd-Steinberg threads " + name, false, "data/" + name + ".png or data/custom64.palette not found");
+			continue;
+		}
+
+		// Threads are made even on fewer cores - rows still wait for the row above
+		Dither dither;
+		Image serial;
+		for (const unsigned int threads : { 1u, 2u, 3u, 4u, 7u }) {
+			dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "fs", true, threads);
+
+			Image image(original);
+			Dither::SetColourMathMode("oklab");
+			dither.FloydDither(image, palette);
+
+			if (threads == 1) {
+				serial = image;
+				continue;
+			}
+
+			passed = Report("Floyd-Steinberg " + name + " " + Log::ToString(threads) + " threads", SameData(image, serial)) && passed;
+		}
+	}
+
+	return passed;
+}
+
+void DevTools::BenchmarkFloydThreads() {
+	const Image original("data/lenna.png");
+	const Palette palette("data/custom64.palette");
+
+	if (original.GetSize() == 0 || palette.size() == 0) {
+		Log::WriteOneLine("data/lenna.png or data/custom64.palette not found");
+		return;
+	}
+
+	const unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+	Log::WriteOneLine("Cores: " + Log::ToString(cores));
+
+	Dither dither;
+	double serialSeconds = 0.;
+
+	for (unsigned int threads = 1; threads <= cores; threads *= 2) {
+		dither.SetSettings("oklab", "oklab", false, "bayer8", false, 1, "none", true, threads);
+
+		const double seconds = TimeSeconds([&]() {
+			Image image(original);
+			dither.FloydDither(image, palette);
+		});
+		if (threads == 1) serialSeconds = seconds;
+
+		Log::WriteOneLine(Log::ToString(threads) + " threads: " + Log::ToString(seconds, 3) + "s - " + Log::ToString(serialSeconds / seconds, 2) + "x");
+	}
+
+	Log::Save("dev/misc/floydThreads.txt");
+}
+
+bool DevTools::CheckPaletteTree() {
+	const size_t queries = 4096;
+
+	std::vector<std::pair<std::string, Palette>> palettes;
+	for (const std::string name : { "bw", "custom64", "vga256", "wplace_premium", "minecraft_map_sc" }) {
+		palettes.emplace_back(name, Palette(("data/" + name + ".palette").c_str()));
+	}
+
+	// Random colours where every tenth is a repeat - ties go to the lowest index
+	Random::Seed = 20260405;
+	Palette repeats;
+	for (size_t i = 0; i < 512; ++i) {
+		if (i % 10 == 0 && i > 0) {
+			repeats.emplace_back(repeats.GetColour(Random::RandUInt(0, static_cast<uint32_t>(i - 1))));
+		} else {
+			repeats.emplace_back(static_cast<uint8_t>(Random::RandUInt(0, 255)), static_cast<uint8_t>(Random::RandUInt(0, 255)), static_cast<uint8_t>(Random::RandUInt(0, 255)));
+		}
+	}
+	palettes.emplace_back("repeats", repeats);
+
+	bool passed = true;
+	for (const auto& [name, palette] : palettes) {
+		if (palette.size() == 0) {
+			passed = Report("PaletteTree " + name, false, "data/" + name + ".palette not found");
+			continue;
+		}
+
+		// Floyd-Steinberg error can push colours a little out of range
+		std::vector<Colour> colours;
+		for (size_t i = 0; i < queries; ++i) {
+			colours.push_back(Colour::FromsRGB_D(Random::RandDouble(-0.1, 1.1), Random::RandDouble(-0.1, 1.1), Random::RandDouble(-0.1, 1.1)));
+		}
+		for (size_t i = 0; i < palette.size(); ++i) colours.push_back(palette.GetColour(i));
+
+		for (const std::string distanceMode : { "srgb", "lrgb", "oklab", "oklab_l" }) {
+			const Colour::MathMode mode = Dither::ToColourMathMode(distanceMode);
+			Colour::SetMathMode(mode);
+			const PaletteTree& tree = palette.GetTree(mode);
+
+			size_t different = 0;
+			for (const Colour& col : colours) {
+				size_t expected = 0;
+				double expectedDist = col.MagSq(palette.GetColour(0));
+				for (size_t i = 1; i < palette.size(); ++i) {
+					const double dist = col.MagSq(palette.GetColour(i));
+					if (dist < expectedDist) {
+						expected = i;
+						expectedDist = dist;
+					}
+				}
+
+				if (tree.Nearest(col) != expected) ++different;
+			}
+
+			passed = Report("PaletteTree " + name + " " + distanceMode, different == 0,
+				Log::ToString(different) + " / " + Log::ToString(colours.size()) + " different") && passed;
+		}
+	}
+
+	return passed;
+}
+
+bool DevTools::CheckThreshold() {
+	struct Case {
+		std::string matrixType;
+
+		// Size the thresholds repeat at - 0 for IGN which doesn't repeat
+		int width, height;
+
+		// Bayer matrices have every value from 1 to width * height once
+		bool bayer;
+	};
+	const std::vector<Case> cases = {
+		{ "bayer2", 2, 2, true },
+		{ "bayer4", 4, 4, true },
+		{ "bayer8", 8, 8, true },
+		{ "bayer16", 16, 16, true },
+		{ "bluenoise16", 16, 16, false },
+		{ "bluenoise32", 32, 32, false },
+		{ "bluenoise64", 64, 64, false },
+		{ "bluenoise128", 128, 128, false },
+		{ "parkerdither", 3, 3, false },
+		{ "heart", 9, 6, false },
+		{ "circle", 15, 15, false },
+		{ "bayershape4", 4 * 3, 4 * 2, false },
+		{ "ign", 0, 0, false }
+	};
+
+	// Shape from the README
+	const std::vector<std::vector<int>> points = { { 0, 0 }, { 2, 0 }, { 0, 1 }, { 1, 1 }, { 2, 1 }, { 1, 2 } };
+	const int area = 300;
+
+	bool passed = true;
+	for (const Case& c : cases) {
+		Threshold threshold;
+		threshold.SetShape(3, 2, points);
+		threshold.GenerateThreshold(c.matrixType);
+
+		size_t outside = 0, notRepeated = 0, wrongRow = 0, wrongIGN = 0;
+		std::vector<double> row(area);
+		for (int y = 0; y < area; ++y) {
+			threshold.GetRow(0, y, row.data(), row.size());
+
+			for (int x = 0; x < area; ++x) {
+				const double t = threshold.GetThreshold(x, y);
+
+				if (t < -0.5 || t > 0.5) ++outside;
+				if (row[static_cast<size_t>(x)] != t + 0.5) ++wrongRow;
+
+				if (c.width > 0) {
+					if (threshold.GetThreshold(x + c.width, y) != t || threshold.GetThreshold(x, y + c.height) != t) ++notRepeated;
+				} else {
+					// https://blog.demofox.org/2022/01/01/interleaved-gradient-noise-a-different-kind-of-low-discrepancy-sequence/
+					const double expected = std::fmod(52.9829189 * std::fmod(0.06711056 * double(x) + 0.00583715 * double(y), 1.), 1.) - 0.5;
+					if (t != expected) ++wrongIGN;
+				}
+			}
+		}
+
+		size_t wrongValues = 0;
+		if (c.bayer) {
+			// Same maths as the threshold worked out for each pixel
+			std::vector<double> tile;
+			for (int y = 0; y < c.height; ++y) {
+				for (int x = 0; x < c.width; ++x) tile.push_back(threshold.GetThreshold(x, y));
+			}
+			std::sort(tile.begin(), tile.end());
+
+			const double divisor = static_cast<double>(c.width * c.height) + 1.;
+			for (size_t i = 0; i < tile.size(); ++i) {
+				if (tile[i] != static_cast<double>(i + 1) / divisor - 0.5) ++wrongValues;
+			}
+		}
+
+		const bool pass = outside == 0 && notRepeated == 0 && wrongRow == 0 && wrongIGN == 0 && wrongValues == 0;
+		passed = Report("Threshold " + c.matrixType, pass, pass ? "" :
+			Log::ToString(outside) + " outside, " + Log::ToString(notRepeated) + " not repeated, " + Log::ToString(wrongRow) + " wrong in GetRow, " +
+			Log::ToString(wrongIGN) + " not IGN, " + Log::ToString(wrongValues) + " wrong Bayer values") && passed;
+	}
+
+	return passed;
+}
+
+bool DevTools::CheckFloatPrecision() {
+	// Ordered and no dithering only change pixels on a threshold or halfway between two palette colours
+	const double maxPercent = 0.5;
+
+	// Floyd-Steinberg spreads any change to the pixels after it - the same areas still average to the same colour
+	const int block = 8;
+	const double maxBlockError = 2.;
+
+	const Palette palette("data/custom64.palette");
+	if (palette.size() == 0) return Report("Float precision", false, "data/custom64.palette not found");
+
+	struct Case {
+		std::string ditherType, distanceMode, mathMode;
+	};
+	const std::vector<Case> cases = {
+		{ "ordered", "oklab", "oklab" },
+		{ "ordered", "srgb", "srgb" },
+		{ "none", "oklab", "oklab" },
+		{ "none", "lrgb", "lrgb" },
+		{ "fs", "oklab", "lrgb" },
+		{ "fs", "oklab", "oklab" },
+		{ "fs", "srgb", "srgb" },
+		{ "fs", "srgb", "oklab_l" }
+	};
+
+	std::vector<std::filesystem::path> images;
+	for (const auto& entry : std::filesystem::directory_iterator("data")) {
+		if (entry.is_regular_file() && entry.path().extension() == ".png") images.push_back(entry.path());
+	}
+	std::sort(images.begin(), images.end());
+
+	Dither dither;
+	bool passed = true;
+
+	for (const std::filesystem::path& path : images) {
+		const Image original(path.string().c_str());
+		if (original.GetSize() == 0) continue;
+
+		for (const Case& c : cases) {
+			dither.SetSettings(c.distanceMode, c.mathMode, false, "bayer8", true, 1, "ordered", true);
+
+			Image results[2] = { Image(original), Image(original) };
+			for (int i = 0; i < 2; ++i) {
+				dither.SetFloat(i == 1);
+				Dither::SetColourMathMode(c.distanceMode);
+				DitherWith(dither, c.ditherType, results[i], palette);
+			}
+
+			// A pixel differs if any of its channels does
+			const size_t channels = static_cast<size_t>(original.GetChannels());
+			const size_t pixels = original.GetSize() / channels;
+			size_t diff = 0;
+			for (size_t p = 0; p < pixels; ++p) {
+				for (size_t ch = 0; ch < channels; ++ch) {
+					if (results[0].GetData(p * channels + ch) != results[1].GetData(p * channels + ch)) {
+						++diff;
+						break;
+					}
+				}
+			}
+
+			const double percent = 100. * static_cast<double>(diff) / static_cast<double>(pixels);
+			std::string detail = Log::ToString(diff) + " / " + Log::ToString(pixels) + " pixels differ (" + Log::ToString(percent, 3) + "%)";
+
+			bool pass = percent <= maxPercent;
+			if (c.ditherType == "fs") {
+				// Mean difference of a channel's average over a block - 0 to 255
+				double blockError = 0.;
+				size_t blocks = 0;
+				for (int by = 0; by < original.GetHeight(); by += block) {
+					for (int bx = 0; bx < original.GetWidth(); bx += block) {
+						for (size_t ch = 0; ch < channels; ++ch) {
+							double sum = 0.;
+							int count = 0;
+							for (int y = by; y < std::min(by + block, original.GetHeight()); ++y) {
+								for (int x = bx; x < std::min(bx + block, original.GetWidth()); ++x) {
+									const size_t index = original.GetIndex(x, y) + ch;
+									sum += static_cast<double>(results[0].GetData(index)) - static_cast<double>(results[1].GetData(index));
+									++count;
+								}
+							}
+							blockError += std::abs(sum) / static_cast<double>(count);
+							++blocks;
+						}
+					}
+				}
+
+				blockError /= static_cast<double>(blocks);
+
+				pass = blockError <= maxBlockError;
+				detail += " - mean " + Log::ToString(block) + "x" + Log::ToString(block) + " block average difference " + Log::ToString(blockError, 2);
+			}
+
+			passed = Report("Float precision " + path.filename().string() + " " + c.ditherType + " " + c.distanceMode + "-" + c.mathMode, pass, detail) && passed;
+		}
+	}
+
+	return passed;
+}
+
+bool DevTools::CheckSelectIndices() {
+	// Not a multiple of any vector width so the scalar tail runs too
+	const size_t count = (1 << 16) + 7;
+	Random::Seed = 0;
+
+	std::vector<double> alpha(count), threshold(count);
+	std::vector<uint32_t> i0(count), i1(count), out(count);
+	for (size_t i = 0; i < count; ++i) {
+		alpha[i] = Random::RandDouble(0., 1.);
+		threshold[i] = Random::RandDouble(0., 1.);
+		i0[i] = static_cast<uint32_t>(Random::RandUInt(0, 65535));
+		i1[i] = static_cast<uint32_t>(Random::RandUInt(0, 65535));
+
+		// Equal values keep i0
+		if (i % 8 == 0) alpha[i] = threshold[i];
+	}
+	const std::vector<float> alphaFloat(alpha.begin(), alpha.end()), thresholdFloat(threshold.begin(), threshold.end());
+
+	const ColourBatch::Instructions supported = ColourBatch::GetSupported();
+	const ColourBatch::Instructions previous = ColourBatch::GetInstructions();
+
+	bool passed = true;
+	for (int i = 0; i <= static_cast<int>(supported); ++i) {
+		const ColourBatch::Instructions instructions = static_cast<ColourBatch::Instructions>(i);
+		ColourBatch::SetInstructions(instructions);
+
+		size_t different = 0;
+		DitherKernel::SelectIndices(alpha.data(), threshold.data(), i0.data(), i1.data(), out.data(), count);
+		for (size_t j = 0; j < count; ++j) different += out[j] != (alpha[j] > threshold[j] ? i1[j] : i0[j]);
+
+		DitherKernel::SelectIndices(alphaFloat.data(), thresholdFloat.data(), i0.data(), i1.data(), out.data(), count);
+		for (size_t j = 0; j < count; ++j) different += out[j] != (alphaFloat[j] > thresholdFloat[j] ? i1[j] : i0[j]);
+
+		passed = Report("SelectIndices " + ColourBatch::ToString(instructions), different == 0,
+			Log::ToString(different) + " / " + Log::ToString(count * 2) + " different") && passed;
+	}
+
+	ColourBatch::SetInstructions(previous);
+	return passed;
+}
+
+void DevTools::BenchmarkOrderedKernel() {
+	const Image original("data/lenna.png");
+	const Palette palette("data/custom64.palette");
+
+	if (original.GetSize() == 0 || palette.size() == 0) {
+		Log::WriteOneLine("data/lenna.png or data/custom64.palette not found");
+		return;
+	}
+
+	const double megapixels = static_cast<double>(original.GetWidth()) * static_cast<double>(original.GetHeight()) / 1e6;
+	const int runs = 10;
+	Dither dither;
+
+	// Whole ordered dither - the first run fills the memo so the rest time the per pixel work
+	for (const std::string matrixType : { "bayer16", "circle", "ign" }) {
+		for (int useFloat = 0; useFloat < 2; ++useFloat) {
+			dither.SetSettings("oklab", "oklab", false, matrixType, false, 1, "none", true);
+			dither.SetFloat(useFloat == 1);
+
+			const auto ordered = [&]() {
+				Image image(original);
+				Dither::SetColourMathMode("oklab");
+				dither.OrderedDither(image, palette);
+			};
+			ordered();
+			const double seconds = TimeSeconds(ordered, runs);
+
+			Log::WriteOneLine("OrderedDither " + matrixType + (useFloat ? " float" : " double") + ": " + Log::ToString(megapixels / seconds, 2) + " MP/s");
+		}
+	}
+
+	// Index select on its own
+	const size_t count = 1 << 20;
+	Random::Seed = 0;
+
+	std::vector<double> alpha(count), threshold(count);
+	std::vector<uint32_t> i0(count), i1(count), out(count);
+	for (size_t i = 0; i < count; ++i) {
+		alpha[i] = Random::RandDouble(0., 1.);
+		threshold[i] = Random::RandDouble(0., 1.);
+		i0[i] = static_cast<uint32_t>(Random::RandUInt(0, 255));
+		i1[i] = static_cast<uint32_t>(Random::RandUInt(0, 255));
+	}
+	const std::vector<float> alphaFloat(alpha.begin(), alpha.end()), thresholdFloat(threshold.begin(), threshold.end());
+
+	const ColourBatch::Instructions supported = ColourBatch::GetSupported();
+	const ColourBatch::Instructions previous = ColourBatch::GetInstructions();
+	const double selectMegapixels = static_cast<double>(count) / 1e6;
+
+	for (int i = 0; i <= static_cast<int>(supported); ++i) {
+		const ColourBatch::Instructions instructions = static_cast<ColourBatch::Instructions>(i);
+		ColourBatch::SetInstructions(instructions);
+
+		const double doubleSeconds = TimeSeconds([&]() { DitherKernel::SelectIndices(alpha.data(), threshold.data(), i0.data(), i1.data(), out.data(), count); }, runs);
+		const double floatSeconds = TimeSeconds([&]() { DitherKernel::SelectIndices(alphaFloat.data(), thresholdFloat.data(), i0.data(), i1.data(), out.data(), count); }, runs);
+
+		Log::WriteOneLine("SelectIndices " + ColourBatch::ToString(instructions) + ": double " +
+			Log::ToString(selectMegapixels / doubleSeconds, 2) + " MP/s, float " +
+			Log::ToString(selectMegapixels / floatSeconds, 2) + " MP/s");
+	}
+
+	ColourBatch::SetInstructions(previous);
+	Log::Save("dev/misc/orderedKernel.txt");
+}
+
+bool DevTools::CheckIndexedPNG() {
+	const Palette palette("data/custom64.palette");
+
+	Dither dither;
+	dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "ordered", true);
+	dither.SetKeepIndices(true);
+
+	bool passed = true;
+	for (const std::string name : { "lenna", "test", "alphaTest" }) {
+		Image image(("data/" + name + ".png").c_str());
+		if (image.GetSize() == 0 || palette.size() == 0) {
+			passed = Report("IndexedPNG " + name, false, "data/" + name + ".png or data/custom64.palette not found");
+			continue;
+		}
+
+		image.ToRGB();
+		Dither::SetColourMathMode("oklab");
+		dither.OrderedDither(image, palette);
+
+		const std::string rgbFile = "dev/misc/" + name + "-rgb.png";
+		const std::string indexedFile = "dev/misc/" + name + "-indexed.png";
+		const std::string planeFile = "dev/misc/" + name + "-plane.png";
+
+		const bool written = image.Write(rgbFile.c_str()) && image.WriteIndexed(indexedFile.c_str());
+		passed = Report("IndexedPNG " + name, written && SamePixels(rgbFile, indexedFile)) && passed;
+
+		const bool planeWritten = image.WriteIndexed(planeFile.c_str(), dither.GetIndices(), palette.size());
+		passed = Report("IndexedPNG from indices " + name, planeWritten && SamePixels(indexedFile, planeFile)) && passed;
+	}
+
+	return passed;
+}
+
+void DevTools::BenchmarkIndexedPNG() {
+	const Palette palette("data/custom64.palette");
+	const int runs = 5;
+
+	Dither dither;
+	dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "ordered", true);
+	dither.SetKeepIndices(true);
+
+	for (const std::string name : { "lenna", "test", "alphaTest" }) {
+		Image image(("data/" + name + ".png").c_str());
+		if (image.GetSize() == 0) continue;
+
+		image.ToRGB();
+		Dither::SetColourMathMode("oklab");
+		dither.OrderedDither(image, palette);
+
+		const std::string rgbFile = "dev/misc/" + name + "-rgb.png";
+		const std::string indexedFile = "dev/misc/" + name + "-indexed.png";
+		const std::string planeFile = "dev/misc/" + name + "-plane.png";
+
+		const double rgbSeconds = TimeSeconds([&]() { image.Write(rgbFile.c_str()); }, runs);
+		const double indexedSeconds = TimeSeconds([&]() { image.WriteIndexed(indexedFile.c_str()); }, runs);
+
+		// Colours found once for each palette index kept while dithering
+		const double planeSeconds = TimeSeconds([&]() { image.WriteIndexed(planeFile.c_str(), dither.GetIndices(), palette.size()); }, runs);
+
+		Log::WriteOneLine(name + " RGB: " + Log::ToString(std::filesystem::file_size(rgbFile) / 1024) + " KB " +
+			Log::ToString(rgbSeconds * 1000., 1) + " ms - indexed: " +
+			Log::ToString(std::filesystem::file_size(indexedFile) / 1024) + " KB " +
+			Log::ToString(indexedSeconds * 1000., 1) + " ms - from indices: " +
+			Log::ToString(planeSeconds * 1000., 1) + " ms");
+	}
+
+	Log::Save("dev/misc/indexedPNG.txt");
+}
+
+bool DevTools::CheckPNGCompression() {
+	const Palette palette("data/custom64.palette");
+
+	Dither dither;
+	dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "ordered", true);
+
+	const auto readBytes = [](const std::string& file) {
+		std::ifstream in(file, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	};
+
+	bool passed = true;
+	for (const std::string name : { "lenna", "alphaTest" }) {
+		Image image(("data/" + name + ".png").c_str());
+		if (image.GetSize() == 0 || palette.size() == 0) {
+			passed = Report("PNGCompression " + name, false, "data/" + name + ".png or data/custom64.palette not found");
+			continue;
+		}
+
+		image.ToRGB();
+		Dither::SetColourMathMode("oklab");
+		dither.OrderedDither(image, palette);
+
+		// stbi_write_png with default compression
+		const std::string referenceFile = "dev/misc/" + name + "-reference.png";
+		PNGEncoder::SetCompression("default");
+		image.Write(referenceFile.c_str());
+
+		for (const std::string compression : { "default", "fastest", "fast", "small", "smallest" }) {
+			PNGEncoder::SetCompression(compression);
+
+			for (int indexed = 0; indexed < 2; ++indexed) {
+				const std::string check = "PNGCompression " + name + " " + compression + (indexed ? " indexed" : "");
+
+				// Bands are joined into the same file for any number of threads
+				std::vector<char> firstBytes;
+				bool same = true, sameBytes = true;
+				for (const unsigned int threads : { 1u, 2u, 3u, 7u }) {
+					PNGEncoder::SetThreads(threads);
+
+					const std::string file = "dev/misc/" + name + "-" + compression + (indexed ? "-indexed" : "") + "-" + Log::ToString(static_cast<int>(threads)) + ".png";
+					const bool written = indexed ? image.WriteIndexed(file.c_str()) : image.Write(file.c_str());
+					same = same && written && SamePixels(referenceFile, file);
+
+					const std::vector<char> bytes = readBytes(file);
+					if (firstBytes.empty()) firstBytes = bytes;
+					sameBytes = sameBytes && bytes == firstBytes;
+				}
+
+				passed = Report(check, same && sameBytes, same ? (sameBytes ? "" : "threads change the file") : "different pixels") && passed;
+			}
+		}
+	}
+
+	PNGEncoder::SetCompression("default");
+	PNGEncoder::SetThreads(0);
+	return passed;
+}
+
+void DevTools::BenchmarkPNGCompression() {
+	const Palette palette("data/custom64.palette");
+	const int runs = 5;
+
+	Dither dither;
+	dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "ordered", true);
+
+	for (const std::string name : { "lenna", "test" }) {
+		Image image(("data/" + name + ".png").c_str());
+		if (image.GetSize() == 0) continue;
+
+		image.ToRGB();
+		Dither::SetColourMathMode("oklab");
+		dither.OrderedDither(image, palette);
+
+		for (const std::string compression : { "default", "fastest", "fast", "small", "smallest" }) {
+			PNGEncoder::SetCompression(compression);
+
+			for (int indexed = 0; indexed < 2; ++indexed) {
+				const std::string file = "dev/misc/" + name + "-" + compression + (indexed ? "-indexed" : "") + ".png";
+				const double seconds = TimeSeconds([&]() { indexed ? image.WriteIndexed(file.c_str()) : image.Write(file.c_str()); }, runs);
+
+				Log::WriteOneLine(name + " " + compression + (indexed ? " indexed: " : ": ") +
+					Log::ToString(std::filesystem::file_size(file) / 1024) + " KB " +
+					Log::ToString(seconds * 1000., 1) + " ms");
+			}
+		}
+	}
+
+	PNGEncoder::SetCompression("default");
+	Log::Save("dev/misc/pngCompression.txt");
+}
+
+bool DevTools::CheckPaletteBinary() {
+	const std::string textFile = "dev/misc/check.palette";
+	const std::string binFile = "dev/misc/check.palettebin";
+	const Colour::MathMode previous = Colour::GetMathMode();
+
+	bool passed = true;
+	for (const size_t count : { size_t(256), size_t(4096), size_t(65536) }) {
+		WriteRandomPalette(textFile, count);
+
+		for (const Colour::MathMode mode : { Colour::MathMode::OkLCh, Colour::MathMode::OkLab_Lightness }) {
+			Colour::SetMathMode(mode);
+			const std::string check = "PaletteBinary " + Log::ToString(count) + (mode == Colour::MathMode::OkLCh ? " OkLCh" : " lightness");
+
+			// Every colour is logged when the text is read
+			std::string lines;
+			Log::BeginCapture(lines);
+			std::filesystem::remove(binFile);
+			const Palette built(textFile.c_str());
+			lines.clear();
+			const Palette loaded(textFile.c_str());
+			Log::EndCapture();
+
+			if (lines.find("Loaded palette") == std::string::npos) {
+				passed = Report(check, false, binFile + " not loaded") && passed;
+				continue;
+			}
+
+			bool same = built.size() == loaded.size();
+			size_t i = 0;
+			for (; same && i < built.size(); ++i) {
+				const Colour& a = built.GetColour(i);
+				const Colour& b = loaded.GetColour(i);
+
+				const Colour::OkLab labA = a.GetOkLab(), labB = b.GetOkLab();
+				const Colour::OkLCh lchA = a.GetOkLCh(), lchB = b.GetOkLCh();
+				const Colour::LRGB lrgbA = a.GetLRGB(), lrgbB = b.GetLRGB();
+
+				same = a.GetHex() == b.GetHex() &&
+					labA.l == labB.l && labA.a == labB.a && labA.b == labB.b &&
+					lchA.l == lchB.l && lchA.c == lchB.c && lchA.h == lchB.h &&
+					lrgbA.r == lrgbB.r && lrgbA.g == lrgbB.g && lrgbA.b == lrgbB.b;
+			}
+
+			const std::string detail = built.size() != loaded.size() ? "different sizes" : "different at colour " + Log::ToString(i - 1);
+			passed = Report(check, same, same ? "" : detail) && passed;
+		}
+	}
+
+	Colour::SetMathMode(previous);
+	return passed;
+}
+
+void DevTools::BenchmarkPaletteBinary() {
+	const std::string textFile = "dev/misc/large.palette";
+	const std::string binFile = "dev/misc/large.palettebin";
+	const int runs = 5;
+
+	std::vector<std::string> lines;
+	for (const size_t count : { size_t(256), size_t(4096), size_t(65536) }) {
+		WriteRandomPalette(textFile, count);
+
+		for (const Colour::MathMode mode : { Colour::MathMode::OkLCh, Colour::MathMode::OkLab_Lightness }) {
+			Colour::SetMathMode(mode);
+
+			// Removing the binary file each run makes the text be read again
+			const double textSeconds = TimeSeconds([&]() {
+				std::filesystem::remove(binFile);
+				const Palette built(textFile.c_str());
+			}, runs);
+			const double binSeconds = TimeSeconds([&]() { const Palette loaded(textFile.c_str()); }, runs);
+
+			// Every colour is logged when the text is read
+			Log::Clear();
+
+			lines.push_back(Log::ToString(count) + (mode == Colour::MathMode::OkLCh ? " colours OkLCh" : " colours lightness") +
+				" - text: " + Log::ToString(textSeconds * 1000., 2) + " ms - palettebin: " + Log::ToString(binSeconds * 1000., 2) + " ms");
+		}
+	}
+
+	for (const std::string& line : lines) Log::WriteOneLine(line);
+	Log::Save("dev/misc/paletteBinary.txt");
+}
+
+bool DevTools::OldPaletteLess(const Colour& a, const Colour& b) {
+	// M_PI and M_TAU in Colour.cpp
+	constexpr double pi = 3.14159265358979323846;
+	constexpr double tau = pi * 2;
+
+	const Colour red(static_cast<uint8_t>(255), 0, 0);
+	const double n = 12.;
+	const double offset = -red.GetOkLCh().h + (pi / n);
+
+	const Colour::OkLCh lchA = a.GetOkLCh(), lchB = b.GetOkLCh();
+	double currH = lchA.h + offset;
+	double otherH = lchB.h + offset;
+
+	currH = currH < 0. ? currH + tau : currH;
+	otherH = otherH < 0. ? otherH + tau : otherH;
+
+	currH = currH >= tau ? currH - tau : currH;
+	otherH = otherH >= tau ? otherH - tau : otherH;
+
+	currH = (std::floor((n * currH) / tau) * tau) / (n - 1.);
+	otherH = (std::floor((n * otherH) / tau) * tau) / (n - 1.);
+
+	if (lchA.c <= 1. / 100.) currH = -1.;
+	if (lchB.c <= 1. / 100.) otherH = -1.;
+
+	if (currH != otherH) return currH < otherH;
+
+	if (lchA.l != lchB.l) return lchA.l < lchB.l;
+	if (lchA.c != lchB.c) return lchA.c < lchB.c;
+	return a.GetAlpha() < b.GetAlpha();
+}
+
+std::vector<std::pair<std::string, std::vector<Colour>>> DevTools::PaletteSortSets() {
+	std::vector<std::pair<std::string, std::vector<Colour>>> sets;
+	for (const std::string name : { "bw", "custom64", "custom256", "gameboy", "minecraft_map_sc", "vga256", "wplace_premium" }) {
+		std::ifstream text("data/" + name + ".palette");
+		std::vector<Colour> colours;
+
+		std::string hex;
+		while (std::getline(text, hex) && hex.size() >= 6) colours.emplace_back(hex.substr(0, 6).c_str());
+		sets.emplace_back(name, colours);
+	}
+
+	// Random colours with repeats and grays
+	Random::Seed = 20260405;
+	for (const size_t count : { size_t(1000), size_t(10000), size_t(100000) }) {
+		std::vector<Colour> colours;
+		for (size_t i = 0; i < count; ++i) {
+			if (i % 10 == 0 && i > 0) {
+				colours.push_back(colours[Random::RandUInt(0, static_cast<uint32_t>(i - 1))]);
+			} else if (i % 10 == 1) {
+				const uint8_t v = static_cast<uint8_t>(Random::RandUInt(0, 255));
+				colours.emplace_back(v, v, v);
+			} else {
+				colours.emplace_back(static_cast<uint8_t>(Random::RandUInt(0, 255)), static_cast<uint8_t>(Random::RandUInt(0, 255)), static_cast<uint8_t>(Random::RandUInt(0, 255)));
+			}
+		}
+		sets.emplace_back("random" + std::to_string(count), colours);
+	}
+
+	return sets;
+}
+
+bool DevTools::CheckPaletteSort() {
+	const Colour::MathMode previous = Colour::GetMathMode();
+	Colour::SetMathMode(Colour::MathMode::OkLCh);
+
+	bool passed = true;
+	for (const auto& [name, colours] : PaletteSortSets()) {
+		std::vector<Colour> expected = colours;
+		std::sort(expected.begin(), expected.end(), OldPaletteLess);
+
+		Palette palette;
+		palette.reserve(colours.size());
+		for (const Colour& col : colours) palette.emplace_back(col);
+		palette.Sort();
+
+		bool same = palette.size() == expected.size();
+		for (size_t i = 0; same && i < expected.size(); ++i) {
+			const Colour::sRGB_UInt a = palette.GetColour(i).GetsRGB_UInt(), b = expected[i].GetsRGB_UInt();
+			same = a.r == b.r && a.g == b.g && a.b == b.b;
+		}
+
+		passed = Report("PaletteSort " + name + " (" + Log::ToString(colours.size()) + ")", same) && passed;
+	}
+
+	Colour::SetMathMode(previous);
+	return passed;
+}
+
+void DevTools::BenchmarkPaletteSort() {
+	Colour::SetMathMode(Colour::MathMode::OkLCh);
+
+	const int runs = 5;
+	for (const auto& [name, colours] : PaletteSortSets()) {
+		// Fresh copies each run - both sides convert every colour
+		const double oldSeconds = TimeSeconds([&]() {
+			std::vector<Colour> expected = colours;
+			std::sort(expected.begin(), expected.end(), OldPaletteLess);
+		}, runs);
+
+		const double newSeconds = TimeSeconds([&]() {
+			Palette palette;
+			palette.reserve(colours.size());
+			for (const Colour& col : colours) palette.emplace_back(col);
+			palette.Sort();
+		}, runs);
+
+		Log::WriteOneLine(name + " (" + Log::ToString(colours.size()) + ") - old: " + Log::ToString(oldSeconds * 1000., 3) +
+			" ms - keyed: " + Log::ToString(newSeconds * 1000., 3) + " ms");
+	}
+
+	Log::Save("dev/misc/paletteSort.txt");
+}
+
+uint8_t DevTools::OldAlpha(double a, const double* t, const unsigned int factor) {
+	if (a == 1. || a == 0) return Dither::ToAlphaByte(a);
+
+	if (t) {
+		const double r = 1. / static_cast<double>(factor);
+		const double M = *t * -1;
+
+		a += M * r;
+		a = a < 0. ? 0. : (a > 1. ? 1. : a);
+	}
+	return Dither::ToAlphaByte(std::floor(static_cast<double>(factor + 1) * a) / static_cast<double>(factor));
+}
+
+void DevTools::AlphaKernelValues(std::vector<double>& alpha, std::vector<double>& threshold, const size_t count) {
+	Random::Seed = 0;
+
+	alpha.resize(count);
+	threshold.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		alpha[i] = i % 2 == 0 ? static_cast<double>(Random::RandUInt(0, 255)) / 255. : Random::RandDouble(0., 1.);
+		if (i % 16 == 0) alpha[i] = 1.;
+		if (i % 32 == 0) alpha[i] = 0.;
+
+		threshold[i] = Random::RandDouble(-0.5, 0.5);
+	}
+}
+
+bool DevTools::CheckAlphaKernel() {
+	// Not a multiple of any vector width so the scalar tail runs too
+	const size_t count = (1 << 16) + 7;
+	std::vector<double> alpha, threshold;
+	AlphaKernelValues(alpha, threshold, count);
+
+	const ColourBatch::Instructions supported = ColourBatch::GetSupported();
+	const ColourBatch::Instructions previous = ColourBatch::GetInstructions();
+
+	bool passed = true;
+	std::vector<uint8_t> expected(count), out(count);
+	for (const unsigned int factor : { 1u, 2u, 3u, 7u, 16u, 100u, 255u }) {
+		for (const bool ordered : { true, false }) {
+			const double* t = ordered ? threshold.data() : nullptr;
+			for (size_t i = 0; i < count; ++i) expected[i] = OldAlpha(alpha[i], t ? t + i : nullptr, factor);
+
+			for (int i = 0; i <= static_cast<int>(supported); ++i) {
+				const ColourBatch::Instructions instructions = static_cast<ColourBatch::Instructions>(i);
+				ColourBatch::SetInstructions(instructions);
+
+				DitherKernel::QuantiseAlpha(alpha.data(), t, factor, out.data(), count);
+
+				size_t different = 0;
+				for (size_t j = 0; j < count; ++j) different += out[j] != expected[j];
+
+				passed = Report("QuantiseAlpha " + ColourBatch::ToString(instructions) + " factor " + Log::ToString(factor) + (ordered ? " ordered" : " none"),
+					different == 0, different == 0 ? "" : Log::ToString(different) + " / " + Log::ToString(count) + " different") && passed;
+			}
+		}
+	}
+
+	ColourBatch::SetInstructions(previous);
+	return passed;
+}
+
+void DevTools::BenchmarkAlphaKernel() {
+	const size_t count = 1 << 18;
+	const int runs = 10;
+	std::vector<double> alpha, threshold;
+	AlphaKernelValues(alpha, threshold, count);
+
+	const ColourBatch::Instructions supported = ColourBatch::GetSupported();
+	const ColourBatch::Instructions previous = ColourBatch::GetInstructions();
+	Log::WriteOneLine("Supported: " + ColourBatch::ToString(supported));
+
+	std::vector<uint8_t> out(count);
+	for (const unsigned int factor : { 1u, 2u, 3u, 7u, 16u, 100u, 255u }) {
+		for (const bool ordered : { true, false }) {
+			const double* t = ordered ? threshold.data() : nullptr;
+
+			const double oldSeconds = TimeSeconds([&]() {
+				for (size_t i = 0; i < count; ++i) out[i] = OldAlpha(alpha[i], t ? t + i : nullptr, factor);
+			}, runs);
+
+			std::string line = "Factor " + Log::ToString(factor) + (ordered ? " ordered" : " none") +
+				" - per pixel: " + Log::ToString(oldSeconds * 1000., 3) + " ms";
+
+			for (int i = 0; i <= static_cast<int>(supported); ++i) {
+				const ColourBatch::Instructions instructions = static_cast<ColourBatch::Instructions>(i);
+				ColourBatch::SetInstructions(instructions);
+
+				const double seconds = TimeSeconds([&]() { DitherKernel::QuantiseAlpha(alpha.data(), t, factor, out.data(), count); }, runs);
+				line += " - " + ColourBatch::ToString(instructions) + ": " + Log::ToString(seconds * 1000., 3) + " ms";
+			}
+
+			Log::WriteOneLine(line);
+		}
+	}
+
+	ColourBatch::SetInstructions(previous);
+	Log::Save("dev/misc/alphaKernel.txt");
+}
+
+Image DevTools::SpriteSheet(const Image& original) {
+	// 64 x 64 cells with a 35 x 35 sprite in the middle of each - 70% of the pixels are transparent
+	const int cell = 64, sprite = 35;
+	const int border = (cell - sprite) / 2;
+
+	Image sheet(original.GetWidth(), original.GetHeight(), 4);
+	for (int y = 0; y < sheet.GetHeight(); ++y) {
+		for (int x = 0; x < sheet.GetWidth(); ++x) {
+			const size_t from = original.GetIndex(x, y), to = sheet.GetIndex(x, y);
+			for (int c = 0; c < 3; ++c) sheet.SetData(to + c, original.GetData(from + (original.IsGrayscale() ? 0 : c)));
+
+			const int cellX = x % cell, cellY = y % cell;
+			const bool visible = cellX >= border && cellX < border + sprite && cellY >= border && cellY < border + sprite;
+			sheet.SetData(to + 3, visible ? 255 : 0);
+		}
+	}
+	return sheet;
+}
+
+bool DevTools::CheckSkipTransparent() {
+	const Image original("data/lenna.png");
+	const Palette palette("data/custom64.palette");
+
+	if (original.GetSize() == 0 || palette.size() == 0) {
+		return Report("SkipTransparent", false, "data/lenna.png or data/custom64.palette not found");
+	}
+
+	const Image sheet = SpriteSheet(original);
+	const Colour::sRGB_UInt first = palette.GetColour(0).GetsRGB_UInt();
+
+	bool passed = true;
+	Dither dither;
+	for (const std::string type : { "ordered", "fs", "none" }) {
+		dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "ordered", true);
+
+		Image every(sheet), skipped(sheet);
+		dither.SetSkipTransparent(false);
+		Dither::SetColourMathMode("oklab");
+		DitherWith(dither, type, every, palette);
+
+		dither.SetSkipTransparent(true);
+		Dither::SetColourMathMode("oklab");
+		DitherWith(dither, type, skipped, palette);
+
+		// Floyd-Steinberg error isn't spread from skipped pixels so only ordered and no dithering keep the opaque pixels
+		size_t wrongSkipped = 0, changedOpaque = 0;
+		for (int y = 0; y < sheet.GetHeight(); ++y) {
+			for (int x = 0; x < sheet.GetWidth(); ++x) {
+				const size_t index = sheet.GetIndex(x, y);
+
+				if (sheet.GetData(index + 3) == 0) {
+					wrongSkipped += skipped.GetData(index) != first.r || skipped.GetData(index + 1) != first.g ||
+						skipped.GetData(index + 2) != first.b || skipped.GetData(index + 3) != 0;
+				} else {
+					bool changed = false;
+					for (int c = 0; c < 4; ++c) changed = changed || skipped.GetData(index + c) != every.GetData(index + c);
+					changedOpaque += changed;
+				}
+			}
+		}
+
+		passed = Report("SkipTransparent " + type + " skipped pixels", wrongSkipped == 0,
+			wrongSkipped == 0 ? "" : Log::ToString(wrongSkipped) + " not the first palette colour with an alpha of 0") && passed;
+
+		if (type != "fs") {
+			passed = Report("SkipTransparent " + type + " opaque pixels", changedOpaque == 0,
+				changedOpaque == 0 ? "" : Log::ToString(changedOpaque) + " changed") && passed;
+		}
+	}
+
+	return passed;
+}
+
+void DevTools::BenchmarkSkipTransparent() {
+	const Image original("data/lenna.png");
+	const Palette palette("data/custom64.palette");
+
+	if (original.GetSize() == 0 || palette.size() == 0) {
+		Log::WriteOneLine("data/lenna.png or data/custom64.palette not found");
+		return;
+	}
+
+	const Image sheet = SpriteSheet(original);
+
+	const int runs = 3;
+	Dither dither;
+	for (const std::string type : { "ordered", "fs", "none" }) {
+		dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "ordered", true);
+
+		const auto time = [&](const bool skip) {
+			dither.SetSkipTransparent(skip);
+			return TimeSeconds([&]() {
+				Image image(sheet);
+				Dither::SetColourMathMode("oklab");
+				DitherWith(dither, type, image, palette);
+			}, runs);
+		};
+
+		// The first run fills the memos - later runs are compared with them full
+		time(false);
+		const double allSeconds = time(false);
+		const double skipSeconds = time(true);
+
+		Log::WriteOneLine(type + " - every pixel: " + Log::ToString(allSeconds * 1000., 1) + " ms - skipping transparent: " +
+			Log::ToString(skipSeconds * 1000., 1) + " ms - " + Log::ToString(allSeconds / skipSeconds, 2) + "x");
+	}
+
+	Log::Save("dev/misc/skipTransparent.txt");
+}
+
+bool DevTools::CheckOrderedThreads() {
+	const Palette palette("data/custom64.palette");
+
+	bool passed = true;
+	for (const std::string name : { "lenna", "alphaTest" }) {
+		const Image original(("data/" + name + ".png").c_str());
+		if (original.GetSize() == 0 || palette.size() == 0) {
+			passed = Report("Ordered threads " + name, false, "data/" + name + ".png or data/custom64.palette not found");
+			continue;
+		}
+
+		// Threads are made even on fewer cores - tiles are shared out however many there are
+		Dither dither;
+		Image serial;
+		for (const unsigned int threads : { 1u, 2u, 3u, 4u, 7u }) {
+			dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "ordered", true, threads);
+
+			Image image(original);
+			Dither::SetColourMathMode("oklab");
+			dither.OrderedDither(image, palette);
+
+			if (threads == 1) {
+				serial = image;
+				continue;
+			}
+
+			passed = Report("Ordered " + name + " " + Log::ToString(threads) + " threads", SameData(image, serial)) && passed;
+		}
+	}
+
+	return passed;
+}
+
+bool DevTools::CheckLUT() {
+	const Palette palette("data/custom64.palette");
+
+	bool passed = true;
+	for (const std::string name : { "lenna", "alphaTest" }) {
+		const Image original(("data/" + name + ".png").c_str());
+		if (original.GetSize() == 0 || palette.size() == 0) {
+			passed = Report("LUT " + name, false, "data/" + name + ".png or data/custom64.palette not found");
+			continue;
+		}
+
+		// Only ordered and no dithering use the tables - one is built for each type and precision then loaded from dev/misc/lut
+		for (const std::string type : { "ordered", "none" }) {
+			for (const bool useFloat : { false, true }) {
+				// Separate Dithers so the table isn't skipped for colours already in the memo
+				Dither search, lookUp;
+				for (Dither* dither : { &search, &lookUp }) {
+					dither->SetSettings("oklab", "oklab", false, "bayer8", true, 1, "ordered", true);
+					dither->SetFloat(useFloat);
+				}
+				lookUp.SetLUT(true, "dev/misc/lut");
+
+				Image searched(original), looked(original);
+				Dither::SetColourMathMode("oklab");
+				DitherWith(search, type, searched, palette);
+
+				Dither::SetColourMathMode("oklab");
+				DitherWith(lookUp, type, looked, palette);
+
+				passed = Report("LUT " + name + " " + type + (useFloat ? " float" : " double"), SameData(searched, looked)) && passed;
+			}
+		}
+	}
+
+	return passed;
+}
+
+bool DevTools::CheckStream() {
+	const Palette palette("data/custom64.palette");
+	std::filesystem::create_directories("dev/misc");
+
+	bool passed = true;
+	for (const std::string name : { "lenna", "alphaTest" }) {
+		const std::string input = "data/" + name + ".png";
+		const Image original(input.c_str());
+		if (original.GetSize() == 0 || palette.size() == 0) {
+			passed = Report("Stream " + name, false, input + " or data/custom64.palette not found");
+			continue;
+		}
+
+		for (const std::string type : { "ordered", "fs", "none" }) {
+			// Floyd-Steinberg alpha checks error carried into the row after each band
+			Dither dither;
+			dither.SetSettings("oklab", "oklab", false, "bayer8", true, 1, "fs", true);
+
+			Image image(original);
+			image.ToRGB();
+			Dither::SetColourMathMode("oklab");
+			DitherWith(dither, type, image, palette);
+
+			// Bands that divide the height and ones that don't
+			for (const int bandHeight : { 64, 13 }) {
+				const std::string check = "Stream " + name + " " + type + " " + Log::ToString(bandHeight) + " rows";
+				const std::string output = "dev/misc/stream-" + name + "-" + type + ".png";
+
+				StreamRows rows(bandHeight);
+				bool written = rows.Open(input, [](Image& row) { row.ToRGB(); }) && rows.OpenOutput(output);
+
+				Dither::SetColourMathMode("oklab");
+				if (written && type == "ordered") {
+					written = dither.OrderedDither(rows, palette);
+				} else if (written && type == "fs") {
+					written = dither.FloydDither(rows, palette);
+				} else if (written) {
+					written = dither.NoDither(rows, palette);
+				}
+				written = rows.Finish() && written;
+
+				const Image streamed(output.c_str());
+				passed = Report(check, written && SameData(streamed, image), written ? "" : output + " not written") && passed;
+			}
+		}
+	}
+
+	return passed;
+}
+
 #endif // DEV_MODE
\ No newline at end of file
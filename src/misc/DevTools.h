@@ -2,15 +2,67 @@
 #ifdef DEV_MODE
 
 #include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Colour;
+class Dither;
+class Image;
+class Palette;
 
 class DevTools {
 public:
 	DevTools() {};
 	~DevTools() {};
 
-	static void Run();
+	/// <summary>
+	/// Runs the dev tools picked in DevTools.cpp then every check
+	/// </summary>
+	/// <returns>False if a check failed</returns>
+	static bool Run();
 
 private:
+	/// <summary>
+	/// Runs every check even after one fails and saves the results to dev/misc/checks.txt
+	/// </summary>
+	/// <returns>False if a check failed</returns>
+	static bool RunChecks();
+
+	/// <summary>
+	/// Logs PASS or FAIL for a check
+	/// </summary>
+	/// <param name="check"></param>
+	/// <param name="pass"></param>
+	/// <param name="detail">Measured values - logged either way</param>
+	/// <returns>pass</returns>
+	static bool Report(const std::string& check, const bool pass, const std::string& detail = "");
+
+	/// <summary>
+	/// Average time of a function for benchmarks
+	/// </summary>
+	/// <param name="func"></param>
+	/// <param name="runs"></param>
+	/// <returns>Seconds</returns>
+	static double TimeSeconds(const std::function<void()>& func, const int runs = 1);
+
+	/// <summary>
+	/// Same size, channels and bytes
+	/// </summary>
+	static bool SameData(const Image& a, const Image& b);
+
+	// A .palette file of count random colours - the same colours for the same count
+	static void WriteRandomPalette(const std::string& file, const size_t count);
+
+	// Both files read back as RGBA with the same pixels
+	static bool SamePixels(const std::string& fileA, const std::string& fileB);
+
+	/// <summary>
+	/// Dithers with a ditherType setting - "ordered", "fs" or "none"
+	/// </summary>
+	static void DitherWith(Dither& dither, const std::string& ditherType, Image& image, const Palette& palette);
+
 	static void GenerateGSTiles();
 	static void PaletteValues();
 	static void PaletteToImage(const char* name);
@@ -26,6 +78,93 @@ private:
 
 	static void GenerateBlueNoise(const uint32_t size, const char* filename);
 	static void ReadBlueNoiseBin(const int res);
+
+	// Time converting every colour space vs only the ones a dither pass reads
+	static void BenchmarkColourConversion();
+
+	// Compare every supported ColourBatch instruction set against the Colour conversions
+	static bool CheckColourBatch();
+
+	// Check wavefront Floyd-Steinberg gives the same output as one thread for any number of threads
+	static bool CheckFloydThreads();
+
+	// Time wavefront Floyd-Steinberg with more threads
+	static void BenchmarkFloydThreads();
+
+	// Check PaletteTree::Nearest stopping early gives the same colour as searching every palette colour
+	static bool CheckPaletteTree();
+
+	// Check every threshold tile repeats at its size, stays between -0.5 and 0.5 and has the values of the matrix, and IGN matches std::fmod
+	static bool CheckThreshold();
+
+	// Check few output pixels change when dithering with float buffers instead of double
+	static bool CheckFloatPrecision();
+
+	// Check DitherKernel::SelectIndices matches alpha > threshold ? i1 : i0 for each instruction set
+	static bool CheckSelectIndices();
+
+	// Megapixels per second of ordered dithering and of the DitherKernel index select for each instruction set
+	static void BenchmarkOrderedKernel();
+
+	// Check a dithered image saved as a palette PNG, searched or from the kept palette indices, reads back the same pixels as saved as RGB(A)
+	static bool CheckIndexedPNG();
+
+	// Time and file size of saving a dithered image as a palette PNG vs RGB(A)
+	static void BenchmarkIndexedPNG();
+
+	// Check every pngCompression setting and thread count reads back the same pixels, truecolour and palette PNGs
+	static bool CheckPNGCompression();
+
+	// Time and file size of every pngCompression setting on dithered outputs, truecolour and palette PNGs
+	static void BenchmarkPNGCompression();
+
+	// Check a palette loaded from its .palettebin has the same colours as one read from the .palette text
+	static bool CheckPaletteBinary();
+
+	// Time reading a large .palette file vs loading its .palettebin
+	static void BenchmarkPaletteBinary();
+
+	// Colour::operator< for OkLCh before the hue groups were worked out once
+	static bool OldPaletteLess(const Colour& a, const Colour& b);
+
+	// Colours of the data palettes and of random palettes with repeats and grays
+	static std::vector<std::pair<std::string, std::vector<Colour>>> PaletteSortSets();
+
+	// Check the keyed OkLCh palette sort gives the same order as sorting with the old comparison
+	static bool CheckPaletteSort();
+
+	// Time the keyed OkLCh palette sort vs sorting with the old comparison
+	static void BenchmarkPaletteSort();
+
+	// Ordered and no dithering alpha from Dither::DitherAlpha before alpha had its own pass
+	static uint8_t OldAlpha(double a, const double* t, const unsigned int factor);
+
+	// Alpha from 8 bit values like an image plus values moved by Floyd-Steinberg error, with some fully opaque and transparent
+	static void AlphaKernelValues(std::vector<double>& alpha, std::vector<double>& threshold, const size_t count);
+
+	// Check DitherKernel::QuantiseAlpha matches the old per pixel ordered and no dithering alpha for each instruction set
+	static bool CheckAlphaKernel();
+
+	// Time DitherKernel::QuantiseAlpha for each instruction set vs the old per pixel alpha
+	static void BenchmarkAlphaKernel();
+
+	// A sprite sheet of the image that is 70% transparent - 35 x 35 sprites in 64 x 64 cells
+	static Image SpriteSheet(const Image& original);
+
+	// Check skipTransparent writes skipped pixels as the first palette colour with an alpha of 0 and leaves the opaque pixels of ordered and no dithering the same
+	static bool CheckSkipTransparent();
+
+	// Time each dither type on a sprite sheet that is 70% transparent with and without skipTransparent
+	static void BenchmarkSkipTransparent();
+
+	// Check ordered dithering gives the same output as one thread for any number of threads
+	static bool CheckOrderedThreads();
+
+	// Check ordered and no dithering with a PaletteLUT give the same output as searching the palette, double and float
+	static bool CheckLUT();
+
+	// Check dithering a PNG a band of rows at a time with StreamRows writes the same pixels as dithering it in memory
+	static bool CheckStream();
 };
 
 
@@ -0,0 +1,92 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+ThreadPool::ThreadPool(const unsigned int threads) {
+	const unsigned int count = ResolveThreadCount(threads);
+
+	m_workers.reserve(count - 1);
+	for (unsigned int i = 1; i < count; ++i) {
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_start.notify_all();
+
+	for (std::thread& worker : m_workers) worker.join();
+}
+
+void ThreadPool::ParallelFor(const size_t count, const std::function<void(const size_t index, const unsigned int thread)>& task) {
+	if (count == 0) return;
+
+	if (m_workers.empty() || count == 1) {
+		for (size_t i = 0; i < count; ++i) task(i, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_count = count;
+		m_next = 0;
+		m_busy = static_cast<unsigned int>(m_workers.size());
+		++m_generation;
+	}
+	m_start.notify_all();
+
+	RunTasks(0);
+
+	// Wait for the workers to finish their last task
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this]() { return m_busy == 0; });
+	m_task = nullptr;
+}
+
+unsigned int ThreadPool::ResolveThreadCount(const unsigned int threads) {
+	if (threads > 0) return threads;
+
+	const unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+void ThreadPool::WorkerLoop(const unsigned int thread) {
+	size_t generation = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [this, generation]() { return m_stop || m_generation != generation; });
+
+			if (m_stop) return;
+			generation = m_generation;
+		}
+
+		RunTasks(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_busy;
+		}
+		m_done.notify_one();
+	}
+}
+
+void ThreadPool::RunTasks(const unsigned int thread) {
+	while (true) {
+		const size_t index = m_next.fetch_add(1);
+		if (index >= m_count) return;
+
+		(*m_task)(index, thread);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// <para>Fixed number of worker threads that split a range of tasks between them</para>
+/// <para>The calling thread also works on the tasks as thread 0</para>
+/// </summary>
+class ThreadPool {
+public:
+	/// <summary>
+	/// </summary>
+	/// <param name="threads">0 uses every core</param>
+	ThreadPool(const unsigned int threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+
+	/// <summary>
+	/// Number of threads including the calling thread
+	/// </summary>
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_workers.size()) + 1; }
+
+	/// <summary>
+	/// <para>Runs task(index, thread) for every index from 0 to count - 1 and waits for all of them</para>
+	/// <para>Indices are handed out in order - thread is 0 to GetThreadCount() - 1 so it can pick per thread data</para>
+	/// </summary>
+	/// <param name="count"></param>
+	/// <param name="task"></param>
+	void ParallelFor(const size_t count, const std::function<void(const size_t index, const unsigned int thread)>& task);
+
+	/// <summary>
+	/// Thread count for a "threads" setting - 0 uses every core
+	/// </summary>
+	/// <param name="threads"></param>
+	/// <returns></returns>
+	static unsigned int ResolveThreadCount(const unsigned int threads);
+
+private:
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_start, m_done;
+
+	const std::function<void(const size_t, const unsigned int)>* m_task = nullptr;
+	size_t m_count = 0;
+	std::atomic<size_t> m_next = 0;
+
+	// Increased for every ParallelFor call so workers know there is new work
+	size_t m_generation = 0;
+	unsigned int m_busy = 0;
+	bool m_stop = false;
+
+	void WorkerLoop(const unsigned int thread);
+	void RunTasks(const unsigned int thread);
+};
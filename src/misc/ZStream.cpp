@@ -0,0 +1,762 @@
+#include "ZStream.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// RFC 1951 tables
+static const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+static const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// ========== INFLATER ==========
+
+void Inflater::Reset(const Source& source) {
+	m_source = source;
+	m_state = State::Header;
+	m_error = false;
+	m_lastBlock = false;
+
+	m_in.resize(65536);
+	m_inPos = 0;
+	m_inSize = 0;
+
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+
+	m_window.assign(WindowSize, 0);
+	m_windowPos = 0;
+	m_total = 0;
+
+	m_copyLength = 0;
+	m_copyDistance = 0;
+	m_storedLength = 0;
+}
+
+size_t Inflater::Read(uint8_t* out, const size_t size) {
+	size_t written = 0;
+
+	while (written < size && !m_error) {
+		if (m_copyLength > 0) {
+			while (m_copyLength > 0 && written < size) {
+				Output(out, written, m_window[(m_windowPos - m_copyDistance) & (WindowSize - 1)]);
+				--m_copyLength;
+			}
+			continue;
+		}
+
+		switch (m_state) {
+		case State::Header:
+			if (!ReadHeader()) m_error = true;
+			break;
+		case State::Block:
+			if (m_lastBlock) {
+				m_state = State::Done;
+			} else if (!ReadBlockHeader()) {
+				m_error = true;
+			}
+			break;
+		case State::Stored:
+			if (m_storedLength == 0) {
+				m_state = State::Block;
+			} else {
+				const uint8_t value = static_cast<uint8_t>(GetBits(8));
+				if (!m_error) {
+					Output(out, written, value);
+					--m_storedLength;
+				}
+			}
+			break;
+		case State::Huffman: {
+			const int symbol = Decode(m_literals);
+			if (symbol < 0) break;
+
+			if (symbol < 256) {
+				Output(out, written, static_cast<uint8_t>(symbol));
+				break;
+			}
+			if (symbol == 256) {
+				m_state = State::Block;
+				break;
+			}
+
+			const int lengthIndex = symbol - 257;
+			if (lengthIndex >= 29) {
+				m_error = true;
+				break;
+			}
+			const size_t length = LengthBase[lengthIndex] + GetBits(LengthExtra[lengthIndex]);
+
+			const int distanceIndex = Decode(m_distances);
+			if (distanceIndex < 0 || distanceIndex >= 30) {
+				m_error = true;
+				break;
+			}
+			const size_t distance = DistanceBase[distanceIndex] + GetBits(DistanceExtra[distanceIndex]);
+
+			if (m_error || distance > m_total) {
+				m_error = true;
+				break;
+			}
+
+			m_copyLength = length;
+			m_copyDistance = distance;
+			break;
+		}
+		case State::Done:
+			return written;
+		}
+	}
+
+	return written;
+}
+
+int Inflater::NextByte() {
+	if (m_inPos == m_inSize) {
+		m_inSize = m_source ? m_source(m_in.data(), m_in.size()) : 0;
+		m_inPos = 0;
+		if (m_inSize == 0) return -1;
+	}
+	return m_in[m_inPos++];
+}
+
+bool Inflater::Fill(const int bits) {
+	while (m_bitCount < bits) {
+		const int byte = NextByte();
+		if (byte < 0) return false;
+
+		m_bitBuffer |= static_cast<uint64_t>(byte) << m_bitCount;
+		m_bitCount += 8;
+	}
+	return true;
+}
+
+uint32_t Inflater::GetBits(const int bits) {
+	if (bits == 0) return 0;
+	if (!Fill(bits)) {
+		m_error = true;
+		return 0;
+	}
+
+	const uint32_t value = static_cast<uint32_t>(m_bitBuffer & ((uint64_t(1) << bits) - 1));
+	m_bitBuffer >>= bits;
+	m_bitCount -= bits;
+	return value;
+}
+
+int Inflater::Decode(const Huffman& huffman) {
+	// The last code can be shorter than maxBits so running out of input isn't an error yet
+	Fill(huffman.maxBits);
+
+	const uint16_t entry = huffman.table[static_cast<size_t>(m_bitBuffer & ((uint64_t(1) << huffman.maxBits) - 1))];
+	const int length = entry & 15;
+	if (length == 0 || length > m_bitCount) {
+		m_error = true;
+		return -1;
+	}
+
+	m_bitBuffer >>= length;
+	m_bitCount -= length;
+	return entry >> 4;
+}
+
+bool Inflater::BuildHuffman(Huffman& huffman, const uint8_t* lengths, const int count) {
+	int lengthCount[16] = {};
+	int maxBits = 1;
+	for (int i = 0; i < count; ++i) {
+		++lengthCount[lengths[i]];
+		maxBits = std::max(maxBits, static_cast<int>(lengths[i]));
+	}
+	lengthCount[0] = 0;
+
+	// More codes than the lengths allow can't be decoded
+	int left = 1;
+	for (int bits = 1; bits <= 15; ++bits) {
+		left = (left << 1) - lengthCount[bits];
+		if (left < 0) return false;
+	}
+
+	int nextCode[16] = {};
+	int code = 0;
+	for (int bits = 1; bits <= 15; ++bits) {
+		code = (code + lengthCount[bits - 1]) << 1;
+		nextCode[bits] = code;
+	}
+
+	huffman.maxBits = maxBits;
+	huffman.table.assign(size_t(1) << maxBits, 0);
+
+	for (int symbol = 0; symbol < count; ++symbol) {
+		const int length = lengths[symbol];
+		if (length == 0) continue;
+
+		// Codes start from their highest bit - reverse them to index with the bit buffer
+		uint32_t codeBits = static_cast<uint32_t>(nextCode[length]++);
+		size_t reversed = 0;
+		for (int i = 0; i < length; ++i) {
+			reversed = (reversed << 1) | (codeBits & 1);
+			codeBits >>= 1;
+		}
+
+		const uint16_t entry = static_cast<uint16_t>((symbol << 4) | length);
+		for (size_t i = reversed; i < huffman.table.size(); i += size_t(1) << length) huffman.table[i] = entry;
+	}
+
+	return true;
+}
+
+bool Inflater::ReadHeader() {
+	const uint32_t cmf = GetBits(8);
+	const uint32_t flg = GetBits(8);
+	if (m_error) return false;
+
+	// Deflate, valid check bits and no preset dictionary
+	if ((cmf & 15) != 8 || (cmf * 256 + flg) % 31 != 0 || (flg & 32) != 0) return false;
+
+	m_state = State::Block;
+	return true;
+}
+
+bool Inflater::ReadBlockHeader() {
+	m_lastBlock = GetBits(1) == 1;
+	const uint32_t type = GetBits(2);
+	if (m_error) return false;
+
+	if (type == 0) {
+		// Stored blocks start on a byte
+		GetBits(m_bitCount % 8);
+
+		const uint32_t length = GetBits(16);
+		const uint32_t inverse = GetBits(16);
+		if (m_error || (length ^ 0xFFFF) != inverse) return false;
+
+		m_storedLength = length;
+		m_state = State::Stored;
+		return true;
+	}
+
+	if (type == 1) {
+		uint8_t lengths[288 + 30] = {};
+		for (int i = 0; i < 144; ++i) lengths[i] = 8;
+		for (int i = 144; i < 256; ++i) lengths[i] = 9;
+		for (int i = 256; i < 280; ++i) lengths[i] = 7;
+		for (int i = 280; i < 288; ++i) lengths[i] = 8;
+		for (int i = 288; i < 288 + 30; ++i) lengths[i] = 5;
+
+		BuildHuffman(m_literals, lengths, 288);
+		BuildHuffman(m_distances, lengths + 288, 30);
+
+		m_state = State::Huffman;
+		return true;
+	}
+
+	if (type == 2 && ReadDynamicTables()) {
+		m_state = State::Huffman;
+		return true;
+	}
+
+	return false;
+}
+
+bool Inflater::ReadDynamicTables() {
+	const int literalCount = static_cast<int>(GetBits(5)) + 257;
+	const int distanceCount = static_cast<int>(GetBits(5)) + 1;
+	const int codeLengthCount = static_cast<int>(GetBits(4)) + 4;
+
+	uint8_t codeLengths[19] = {};
+	for (int i = 0; i < codeLengthCount; ++i) codeLengths[CodeLengthOrder[i]] = static_cast<uint8_t>(GetBits(3));
+	if (m_error) return false;
+
+	Huffman codeLengthCode;
+	if (!BuildHuffman(codeLengthCode, codeLengths, 19)) return false;
+
+	uint8_t lengths[286 + 32] = {};
+	const int total = literalCount + distanceCount;
+	int n = 0;
+	while (n < total) {
+		const int symbol = Decode(codeLengthCode);
+		if (symbol < 0) return false;
+
+		if (symbol < 16) {
+			lengths[n++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+
+		uint8_t value = 0;
+		int repeat = 0;
+		if (symbol == 16) {
+			if (n == 0) return false;
+			value = lengths[n - 1];
+			repeat = 3 + static_cast<int>(GetBits(2));
+		} else if (symbol == 17) {
+			repeat = 3 + static_cast<int>(GetBits(3));
+		} else {
+			repeat = 11 + static_cast<int>(GetBits(7));
+		}
+
+		if (m_error || n + repeat > total) return false;
+		for (int i = 0; i < repeat; ++i) lengths[n++] = value;
+	}
+
+	// Every block needs an end of block code
+	if (lengths[256] == 0) return false;
+
+	return BuildHuffman(m_literals, lengths, literalCount) && BuildHuffman(m_distances, lengths + literalCount, distanceCount);
+}
+
+// ========== DEFLATER ==========
+
+static const int HashBits = 15;
+
+static int LengthIndex(const size_t length) {
+	return static_cast<int>(std::upper_bound(LengthBase, LengthBase + 29, length) - LengthBase) - 1;
+}
+
+static int DistanceIndex(const size_t distance) {
+	return static_cast<int>(std::upper_bound(DistanceBase, DistanceBase + 30, distance) - DistanceBase) - 1;
+}
+
+// Huffman code lengths for the symbol counts - counts are flattened until no code is longer than maxBits
+static void HuffmanLengths(const uint32_t* counts, const int count, const int maxBits, uint8_t* lengths) {
+	std::vector<uint64_t> weights(counts, counts + count);
+
+	// A code needs at least two symbols - the extra one is never used
+	int used = 0;
+	for (const uint64_t weight : weights) used += weight > 0;
+	for (int i = 0; used < 2 && i < count; ++i) {
+		if (weights[i] == 0) {
+			weights[i] = 1;
+			++used;
+		}
+	}
+
+	while (true) {
+		// Nodes up to count - 1 are symbols, the rest join two nodes
+		typedef std::pair<uint64_t, int> Node;
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+		std::vector<int> parent(static_cast<size_t>(count) * 2, -1);
+
+		for (int i = 0; i < count; ++i) {
+			if (weights[i] > 0) queue.push({ weights[i], i });
+		}
+
+		int next = count;
+		while (queue.size() > 1) {
+			const Node a = queue.top();
+			queue.pop();
+			const Node b = queue.top();
+			queue.pop();
+
+			parent[a.second] = next;
+			parent[b.second] = next;
+			queue.push({ a.first + b.first, next++ });
+		}
+
+		int longest = 0;
+		for (int i = 0; i < count; ++i) {
+			int depth = 0;
+			if (weights[i] > 0) {
+				for (int node = i; parent[node] >= 0; node = parent[node]) ++depth;
+			}
+
+			lengths[i] = static_cast<uint8_t>(depth);
+			longest = std::max(longest, depth);
+		}
+
+		if (longest <= maxBits) return;
+
+		for (uint64_t& weight : weights) {
+			if (weight > 0) weight = (weight + 1) / 2;
+		}
+	}
+}
+
+// Canonical Huffman codes for the lengths - bit reversed so they can go straight to PutBits
+static void HuffmanCodes(const uint8_t* lengths, const int count, uint32_t* codes) {
+	int lengthCount[16] = {};
+	for (int i = 0; i < count; ++i) ++lengthCount[lengths[i]];
+	lengthCount[0] = 0;
+
+	int nextCode[16] = {};
+	int code = 0;
+	for (int bits = 1; bits <= 15; ++bits) {
+		code = (code + lengthCount[bits - 1]) << 1;
+		nextCode[bits] = code;
+	}
+
+	for (int symbol = 0; symbol < count; ++symbol) {
+		const int length = lengths[symbol];
+		codes[symbol] = 0;
+		if (length == 0) continue;
+
+		const uint32_t codeBits = static_cast<uint32_t>(nextCode[length]++);
+		for (int i = 0; i < length; ++i) codes[symbol] |= ((codeBits >> i) & 1) << (length - 1 - i);
+	}
+}
+
+void Deflater::Reset(const Sink& sink) {
+	Reset(sink, Options());
+}
+
+void Deflater::Reset(const Sink& sink, const Options& options) {
+	m_sink = sink;
+	m_options = options;
+	m_error = false;
+
+	m_buffer.clear();
+	m_bufferStart = 0;
+	m_pos = 0;
+
+	m_head.assign(size_t(1) << HashBits, -1);
+	m_prev.assign(WindowSize, -1);
+
+	m_adlerA = 1;
+	m_adlerB = 0;
+
+	m_out.clear();
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+	m_symbols.clear();
+
+	// zlib header - deflate with a 32 KB window
+	if (!m_options.raw) {
+		m_out.push_back(0x78);
+		m_out.push_back(0x5e);
+	}
+
+	// Everything goes in one block with the fixed Huffman codes - dynamic blocks start when they're full
+	if (!m_options.dynamic) {
+		PutBits(m_options.raw ? 0 : 1, 1);
+		PutBits(1, 2);
+	}
+}
+
+bool Deflater::Write(const uint8_t* data, const size_t size) {
+	if (m_error) return false;
+
+	// Adler-32 - sums are reduced before they can overflow
+	size_t i = 0;
+	while (i < size) {
+		const size_t blockEnd = std::min(size, i + 5552);
+		for (; i < blockEnd; ++i) {
+			m_adlerA += data[i];
+			m_adlerB += m_adlerA;
+		}
+		m_adlerA %= 65521;
+		m_adlerB %= 65521;
+	}
+
+	m_buffer.insert(m_buffer.end(), data, data + size);
+	Compress(false);
+
+	// Drop input the window can't reach anymore
+	const uint64_t keepFrom = m_pos > WindowSize ? m_pos - WindowSize : 0;
+	if (keepFrom > m_bufferStart && keepFrom - m_bufferStart >= WindowSize * 2) {
+		m_buffer.erase(m_buffer.begin(), m_buffer.begin() + static_cast<std::ptrdiff_t>(keepFrom - m_bufferStart));
+		m_bufferStart = keepFrom;
+	}
+
+	return FlushOutput(false);
+}
+
+bool Deflater::Finish() {
+	if (m_error) return false;
+
+	Compress(true);
+	if (m_options.dynamic) {
+		PutDynamicBlock(!m_options.raw);
+	} else {
+		PutLiteral(256);
+	}
+
+	if (m_options.raw) {
+		PutSyncFlush();
+		return FlushOutput(true);
+	}
+
+	// Pad to a byte then the Adler-32 with the highest byte first
+	if (m_bitCount > 0) PutBits(0, 8 - m_bitCount);
+
+	const uint32_t adler = GetAdler();
+	for (int shift = 24; shift >= 0; shift -= 8) m_out.push_back(static_cast<uint8_t>(adler >> shift));
+
+	return FlushOutput(true);
+}
+
+uint32_t Deflater::JoinAdler(const uint32_t first, const uint32_t second, const uint64_t secondSize) {
+	const uint64_t mod = 65521;
+	const uint64_t a1 = first & 0xFFFF, b1 = first >> 16;
+	const uint64_t a2 = second & 0xFFFF, b2 = second >> 16;
+
+	// Every sum in the second part also has the first part's sum - less the 1 both start with
+	const uint64_t a = (a1 + a2 + mod - 1) % mod;
+	const uint64_t b = (b1 + b2 + (secondSize % mod) * ((a1 + mod - 1) % mod)) % mod;
+	return static_cast<uint32_t>((b << 16) | a);
+}
+
+void Deflater::Compress(const bool finish) {
+	const uint64_t end = m_bufferStart + m_buffer.size();
+
+	// A match can reach MaxMatch bytes past the next position - wait for more input until the end
+	const uint64_t limit = finish ? end : (end > MaxMatch + 1 ? end - MaxMatch - 1 : 0);
+
+	while (m_pos < limit && m_pos + 3 <= end) {
+		size_t distance = 0;
+		size_t length = LongestMatch(m_pos, end, distance);
+		InsertHash(m_pos);
+
+		// Lazy matching - a longer match from the next byte is better than this one
+		if (m_options.lazy && length >= 3 && m_pos + 4 <= end) {
+			size_t nextDistance = 0;
+			if (LongestMatch(m_pos + 1, end, nextDistance) > length) length = 0;
+		}
+
+		if (length < 3) {
+			Literal(m_buffer[static_cast<size_t>(m_pos - m_bufferStart)]);
+			++m_pos;
+			continue;
+		}
+
+		Match(length, distance);
+		for (size_t i = 1; i < length; ++i) {
+			if (m_pos + i + 3 <= end) InsertHash(m_pos + i);
+		}
+		m_pos += length;
+	}
+
+	if (finish) {
+		while (m_pos < end) {
+			Literal(m_buffer[static_cast<size_t>(m_pos - m_bufferStart)]);
+			++m_pos;
+		}
+	}
+}
+
+void Deflater::Literal(const uint32_t value) {
+	if (!m_options.dynamic) {
+		PutLiteral(value);
+		return;
+	}
+
+	m_symbols.push_back({ static_cast<uint16_t>(value), 0 });
+	if (m_symbols.size() >= BlockSymbols) PutDynamicBlock(false);
+}
+
+void Deflater::Match(const size_t length, const size_t distance) {
+	if (!m_options.dynamic) {
+		PutMatch(length, distance);
+		return;
+	}
+
+	m_symbols.push_back({ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+	if (m_symbols.size() >= BlockSymbols) PutDynamicBlock(false);
+}
+
+void Deflater::PutDynamicBlock(const bool last) {
+	uint32_t literalCounts[286] = {}, distanceCounts[30] = {};
+	for (const Symbol& symbol : m_symbols) {
+		if (symbol.distance == 0) {
+			++literalCounts[symbol.value];
+		} else {
+			++literalCounts[257 + LengthIndex(symbol.value)];
+			++distanceCounts[DistanceIndex(symbol.distance)];
+		}
+	}
+	literalCounts[256] = 1;
+
+	uint8_t literalLengths[286] = {}, distanceLengths[30] = {};
+	HuffmanLengths(literalCounts, 286, 15, literalLengths);
+	HuffmanLengths(distanceCounts, 30, 15, distanceLengths);
+
+	int literalCount = 286, distanceCount = 30;
+	while (literalCount > 257 && literalLengths[literalCount - 1] == 0) --literalCount;
+	while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) --distanceCount;
+
+	// Both sets of lengths as one list with runs replaced by codes 16 to 18
+	std::vector<uint8_t> lengths(literalLengths, literalLengths + literalCount);
+	lengths.insert(lengths.end(), distanceLengths, distanceLengths + distanceCount);
+
+	std::vector<uint8_t> runSymbols, runExtras;
+	for (size_t i = 0; i < lengths.size();) {
+		const uint8_t length = lengths[i];
+		size_t run = 1;
+		while (i + run < lengths.size() && lengths[i + run] == length) ++run;
+
+		if (length == 0 && run >= 3) {
+			// 17 repeats a zero 3 to 10 times, 18 repeats it 11 to 138 times
+			const size_t repeat = std::min(run, size_t(138));
+			runSymbols.push_back(repeat >= 11 ? 18 : 17);
+			runExtras.push_back(static_cast<uint8_t>(repeat >= 11 ? repeat - 11 : repeat - 3));
+			i += repeat;
+		} else if (length != 0 && run >= 4) {
+			// 16 repeats the previous length 3 to 6 times
+			const size_t repeat = std::min(run - 1, size_t(6));
+			runSymbols.push_back(length);
+			runExtras.push_back(0);
+			runSymbols.push_back(16);
+			runExtras.push_back(static_cast<uint8_t>(repeat - 3));
+			i += 1 + repeat;
+		} else {
+			runSymbols.push_back(length);
+			runExtras.push_back(0);
+			++i;
+		}
+	}
+
+	uint32_t runCounts[19] = {};
+	for (const uint8_t code : runSymbols) ++runCounts[code];
+
+	uint8_t runLengths[19] = {};
+	HuffmanLengths(runCounts, 19, 7, runLengths);
+
+	int runLengthCount = 19;
+	while (runLengthCount > 4 && runLengths[CodeLengthOrder[runLengthCount - 1]] == 0) --runLengthCount;
+
+	uint32_t literalCodes[286], distanceCodes[30], runCodes[19];
+	HuffmanCodes(literalLengths, 286, literalCodes);
+	HuffmanCodes(distanceLengths, 30, distanceCodes);
+	HuffmanCodes(runLengths, 19, runCodes);
+
+	PutBits(last ? 1 : 0, 1);
+	PutBits(2, 2);
+	PutBits(static_cast<uint32_t>(literalCount - 257), 5);
+	PutBits(static_cast<uint32_t>(distanceCount - 1), 5);
+	PutBits(static_cast<uint32_t>(runLengthCount - 4), 4);
+	for (int i = 0; i < runLengthCount; ++i) PutBits(runLengths[CodeLengthOrder[i]], 3);
+
+	static const int runExtraBits[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+	for (size_t i = 0; i < runSymbols.size(); ++i) {
+		const uint8_t code = runSymbols[i];
+		PutBits(runCodes[code], runLengths[code]);
+		if (runExtraBits[code] > 0) PutBits(runExtras[i], runExtraBits[code]);
+	}
+
+	for (const Symbol& symbol : m_symbols) {
+		if (symbol.distance == 0) {
+			PutBits(literalCodes[symbol.value], literalLengths[symbol.value]);
+			continue;
+		}
+
+		const int lengthIndex = LengthIndex(symbol.value);
+		PutBits(literalCodes[257 + lengthIndex], literalLengths[257 + lengthIndex]);
+		PutBits(static_cast<uint32_t>(symbol.value - LengthBase[lengthIndex]), LengthExtra[lengthIndex]);
+
+		const int distanceIndex = DistanceIndex(symbol.distance);
+		PutBits(distanceCodes[distanceIndex], distanceLengths[distanceIndex]);
+		PutBits(static_cast<uint32_t>(symbol.distance - DistanceBase[distanceIndex]), DistanceExtra[distanceIndex]);
+	}
+	PutBits(literalCodes[256], literalLengths[256]);
+
+	m_symbols.clear();
+}
+
+void Deflater::PutSyncFlush() {
+	// Empty stored block - ends on a whole byte so another deflate stream can follow
+	PutBits(0, 3);
+	if (m_bitCount > 0) PutBits(0, 8 - m_bitCount);
+	PutBits(0x0000, 16);
+	PutBits(0xFFFF, 16);
+}
+
+size_t Deflater::LongestMatch(const uint64_t pos, const uint64_t end, size_t& distance) {
+	if (pos + 3 > end) return 0;
+
+	const size_t maxLength = static_cast<size_t>(std::min(static_cast<uint64_t>(MaxMatch), end - pos));
+	const uint8_t* current = m_buffer.data() + (pos - m_bufferStart);
+
+	size_t best = 0;
+	int64_t candidate = m_head[Hash(pos)];
+	for (int chain = 0; chain < m_options.maxChain && candidate >= 0; ++chain) {
+		const uint64_t from = static_cast<uint64_t>(candidate);
+		if (from >= pos || pos - from > WindowSize || from < m_bufferStart) break;
+
+		const uint8_t* previous = m_buffer.data() + (from - m_bufferStart);
+		size_t length = 0;
+		while (length < maxLength && previous[length] == current[length]) ++length;
+
+		if (length > best) {
+			best = length;
+			distance = static_cast<size_t>(pos - from);
+			if (best == maxLength) break;
+		}
+
+		// Slots are reused once they leave the window - older positions always come next
+		const int64_t next = m_prev[static_cast<size_t>(from & (WindowSize - 1))];
+		if (next >= candidate) break;
+		candidate = next;
+	}
+
+	return best;
+}
+
+void Deflater::InsertHash(const uint64_t pos) {
+	const uint32_t hash = Hash(pos);
+	m_prev[static_cast<size_t>(pos & (WindowSize - 1))] = m_head[hash];
+	m_head[hash] = static_cast<int64_t>(pos);
+}
+
+uint32_t Deflater::Hash(const uint64_t pos) const {
+	const uint8_t* data = m_buffer.data() + (pos - m_bufferStart);
+	const uint32_t value = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[1]) << 8) | data[2];
+	return (value * 2654435761u) >> (32 - HashBits);
+}
+
+void Deflater::PutBits(const uint32_t value, const int bits) {
+	m_bitBuffer |= static_cast<uint64_t>(value) << m_bitCount;
+	m_bitCount += bits;
+
+	while (m_bitCount >= 8) {
+		m_out.push_back(static_cast<uint8_t>(m_bitBuffer));
+		m_bitBuffer >>= 8;
+		m_bitCount -= 8;
+	}
+}
+
+void Deflater::PutCode(const uint32_t code, const int bits) {
+	// Huffman codes are stored from their highest bit
+	uint32_t reversed = 0;
+	for (int i = 0; i < bits; ++i) reversed |= ((code >> i) & 1) << (bits - 1 - i);
+	PutBits(reversed, bits);
+}
+
+void Deflater::PutLiteral(const uint32_t value) {
+	if (value <= 143) {
+		PutCode(0x30 + value, 8);
+	} else if (value <= 255) {
+		PutCode(0x190 + value - 144, 9);
+	} else if (value <= 279) {
+		PutCode(value - 256, 7);
+	} else {
+		PutCode(0xC0 + value - 280, 8);
+	}
+}
+
+void Deflater::PutMatch(const size_t length, const size_t distance) {
+	const int lengthIndex = LengthIndex(length);
+	PutLiteral(257 + static_cast<uint32_t>(lengthIndex));
+	PutBits(static_cast<uint32_t>(length - LengthBase[lengthIndex]), LengthExtra[lengthIndex]);
+
+	const int distanceIndex = DistanceIndex(distance);
+	PutCode(static_cast<uint32_t>(distanceIndex), 5);
+	PutBits(static_cast<uint32_t>(distance - DistanceBase[distanceIndex]), DistanceExtra[distanceIndex]);
+}
+
+bool Deflater::FlushOutput(const bool all) {
+	if (m_error) return false;
+	if (m_out.empty() || (!all && m_out.size() < 65536)) return true;
+
+	if (!m_sink(m_out.data(), m_out.size())) m_error = true;
+	m_out.clear();
+
+	return !m_error;
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// <summary>
+/// <para>zlib decompressor that gives the output a few bytes at a time</para>
+/// <para>Only keeps the 32 KB window - stb_image needs the whole compressed and decompressed data in memory</para>
+/// </summary>
+class Inflater {
+public:
+	/// <summary>
+	/// Fills data with up to size compressed bytes - returns the number of bytes given, 0 when there are no more
+	/// </summary>
+	typedef std::function<size_t(uint8_t* data, const size_t size)> Source;
+
+	Inflater() {};
+	~Inflater() {};
+
+	/// <summary>
+	/// Starts a new zlib stream
+	/// </summary>
+	/// <param name="source"></param>
+	void Reset(const Source& source);
+
+	/// <summary>
+	/// Decompresses the next bytes of the stream
+	/// </summary>
+	/// <param name="out"></param>
+	/// <param name="size"></param>
+	/// <returns>Less than size at the end of the stream or on an error</returns>
+	size_t Read(uint8_t* out, const size_t size);
+
+	inline bool HasError() const { return m_error; };
+	inline bool IsDone() const { return m_state == State::Done; };
+
+private:
+	enum class State {
+		Header, Block, Stored, Huffman, Done
+	};
+
+	struct Huffman {
+		// Indexed by the next maxBits bits - symbol << 4 | code length, 0 for no code
+		std::vector<uint16_t> table;
+		int maxBits = 0;
+	};
+
+	Source m_source;
+	State m_state = State::Header;
+	bool m_error = false, m_lastBlock = false;
+
+	std::vector<uint8_t> m_in;
+	size_t m_inPos = 0, m_inSize = 0;
+
+	uint64_t m_bitBuffer = 0;
+	int m_bitCount = 0;
+
+	// Last 32 KB of output for back references
+	std::vector<uint8_t> m_window;
+	size_t m_windowPos = 0;
+
+	// Bytes given out so far - back references can't reach before the start
+	size_t m_total = 0;
+
+	// Back reference still being copied
+	size_t m_copyLength = 0, m_copyDistance = 0;
+
+	// Bytes left in a stored block
+	size_t m_storedLength = 0;
+
+	Huffman m_literals, m_distances;
+
+	int NextByte();
+	bool Fill(const int bits);
+	uint32_t GetBits(const int bits);
+	int Decode(const Huffman& huffman);
+
+	bool BuildHuffman(Huffman& huffman, const uint8_t* lengths, const int count);
+	bool ReadHeader();
+	bool ReadBlockHeader();
+	bool ReadDynamicTables();
+
+	inline void Output(uint8_t* out, size_t& written, const uint8_t value) {
+		out[written++] = value;
+		m_window[m_windowPos] = value;
+		m_windowPos = (m_windowPos + 1) & (WindowSize - 1);
+		++m_total;
+	};
+
+	static const size_t WindowSize = 32768;
+};
+
+/// <summary>
+/// <para>zlib compressor that takes the input a few bytes at a time</para>
+/// <para>Same method as stb_image_write by default - LZ77 with hash chains and the fixed Huffman codes in one block</para>
+/// </summary>
+class Deflater {
+public:
+	/// <summary>
+	/// Takes size compressed bytes - returns false if they can't be written
+	/// </summary>
+	typedef std::function<bool(const uint8_t* data, const size_t size)> Sink;
+
+	struct Options {
+		// Earlier positions with the same hash compared for each match - 16 is the same as stb_image_write
+		int maxChain = 16;
+
+		// Checks if the next byte starts a longer match before taking one
+		bool lazy = true;
+
+		// Huffman codes made for each block's symbols instead of the fixed ones
+		bool dynamic = false;
+
+		// Only deflate blocks - no zlib header or Adler-32, and ends on a whole byte without a final block
+		// For compressing parts of one stream at once, see JoinAdler
+		bool raw = false;
+	};
+
+	Deflater() {};
+	~Deflater() {};
+
+	/// <summary>
+	/// Starts a new zlib stream with the same options as stb_image_write
+	/// </summary>
+	/// <param name="sink"></param>
+	void Reset(const Sink& sink);
+
+	/// <summary>
+	/// Starts a new zlib stream
+	/// </summary>
+	/// <param name="sink"></param>
+	/// <param name="options"></param>
+	void Reset(const Sink& sink, const Options& options);
+
+	/// <summary>
+	/// Compresses the next bytes - output is held back until enough input is buffered
+	/// </summary>
+	/// <param name="data"></param>
+	/// <param name="size"></param>
+	/// <returns>false if the sink failed</returns>
+	bool Write(const uint8_t* data, const size_t size);
+
+	/// <summary>
+	/// Compresses the rest of the input and ends the stream
+	/// </summary>
+	/// <returns>false if the sink failed</returns>
+	bool Finish();
+
+	/// <summary>
+	/// Adler-32 of every byte written so far
+	/// </summary>
+	inline uint32_t GetAdler() const { return (m_adlerB << 16) | m_adlerA; };
+
+	/// <summary>
+	/// Adler-32 of two parts one after the other
+	/// </summary>
+	/// <param name="first">Adler-32 of the first part</param>
+	/// <param name="second">Adler-32 of the second part</param>
+	/// <param name="secondSize">Bytes in the second part</param>
+	/// <returns></returns>
+	static uint32_t JoinAdler(const uint32_t first, const uint32_t second, const uint64_t secondSize);
+
+private:
+	Sink m_sink;
+	Options m_options;
+	bool m_error = false;
+
+	// Input from m_bufferStart - keeps the window behind m_pos and the lookahead after it
+	std::vector<uint8_t> m_buffer;
+	uint64_t m_bufferStart = 0, m_pos = 0;
+
+	// Last position for each hash and the previous position with the same hash
+	std::vector<int64_t> m_head, m_prev;
+
+	uint32_t m_adlerA = 1, m_adlerB = 0;
+
+	std::vector<uint8_t> m_out;
+	uint64_t m_bitBuffer = 0;
+	int m_bitCount = 0;
+
+	// Dynamic blocks - a literal is its value with distance 0, a match is its length and distance
+	struct Symbol {
+		uint16_t value, distance;
+	};
+	std::vector<Symbol> m_symbols;
+
+	void Compress(const bool finish);
+	void Literal(const uint32_t value);
+	void Match(const size_t length, const size_t distance);
+	void PutDynamicBlock(const bool last);
+	void PutSyncFlush();
+	size_t LongestMatch(const uint64_t pos, const uint64_t end, size_t& distance);
+	void InsertHash(const uint64_t pos);
+	uint32_t Hash(const uint64_t pos) const;
+
+	void PutBits(const uint32_t value, const int bits);
+	void PutCode(const uint32_t code, const int bits);
+	void PutLiteral(const uint32_t value);
+	void PutMatch(const size_t length, const size_t distance);
+	bool FlushOutput(const bool all);
+
+	static const size_t WindowSize = 32768;
+	static const size_t MaxMatch = 258;
+	static const size_t BlockSymbols = 32768;
+};
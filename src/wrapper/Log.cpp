@@ -9,16 +9,18 @@
 #include <iomanip>
 #include <ios>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
 
 std::string Log::m_console = "";
-std::chrono::steady_clock::time_point Log::m_time = std::chrono::high_resolution_clock::now();
+std::mutex Log::m_mutex;
+thread_local std::string* Log::m_capture = nullptr;
+thread_local std::chrono::steady_clock::time_point Log::m_time = std::chrono::high_resolution_clock::now();
 
 void Log::Write(const std::string input) {
-	std::cout << input;
-	Log::m_console += input;
+	Log::Append(input);
 }
 
 void Log::WriteOneLine(const std::string input) {
@@ -28,8 +30,7 @@ void Log::WriteOneLine(const std::string input) {
 }
 
 void Log::EndLine() {
-	std::cout << '\n';
-	Log::m_console += "\n";
+	Log::Append("\n");
 }
 
 void Log::StartLine() {
@@ -72,8 +73,7 @@ void Log::StartLine() {
 	std::string line = std::to_string(tmnow.tm_year + 1900) + "-" + month + "-" + day + " "
 		+ hour + ":" + min + ":" + sec + "." + mil + " ";
 
-	std::cout << line;
-	Log::m_console += line;
+	Log::Append(line);
 }
 
 void Log::Save(const std::string save, const bool overwrite) {
@@ -100,11 +100,39 @@ void Log::Save(const std::string save, const bool overwrite) {
 		}
 	}
 
-	consoleLog << Log::m_console;
+	{
+		std::lock_guard<std::mutex> lock(Log::m_mutex);
+		consoleLog << Log::m_console;
+	}
 
 	consoleLog.close();
 }
 
+void Log::BeginCapture(std::string& buffer) {
+	Log::m_capture = &buffer;
+}
+
+void Log::EndCapture() {
+	Log::m_capture = nullptr;
+}
+
+void Log::WriteCaptured(const std::string& lines) {
+	std::lock_guard<std::mutex> lock(Log::m_mutex);
+	std::cout << lines;
+	Log::m_console += lines;
+}
+
+void Log::Append(const std::string& text) {
+	if (Log::m_capture) {
+		*Log::m_capture += text;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(Log::m_mutex);
+	std::cout << text;
+	Log::m_console += text;
+}
+
 void Log::StartTime() {
 	Log::m_time = std::chrono::high_resolution_clock::now();
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <mutex>
 #include <string>
 
 class Log {
@@ -16,6 +17,20 @@ public:
 
 	static void Save(const std::string save = "console.log", const bool overwrite = true);
 
+	/// <summary>
+	/// <para>Lines written on the calling thread are added to buffer instead of the console until EndCapture()</para>
+	/// <para>Lets images dithered at the same time write their lines together, see WriteCaptured()</para>
+	/// </summary>
+	/// <param name="buffer"></param>
+	static void BeginCapture(std::string& buffer);
+	static void EndCapture();
+
+	/// <summary>
+	/// Writes lines kept by BeginCapture() to the console
+	/// </summary>
+	/// <param name="lines"></param>
+	static void WriteCaptured(const std::string& lines);
+
 	static void StartTime();
 	static bool CheckTime(const long long milliseconds);
 	static bool CheckTimeSeconds(const double seconds);
@@ -40,5 +55,13 @@ public:
 
 private:
 	static std::string m_console;
-	static std::chrono::steady_clock::time_point m_time;
+
+	// Every thread can write to the console - lines of one thread can only be kept together with BeginCapture()
+	static std::mutex m_mutex;
+	static thread_local std::string* m_capture;
+
+	// Per thread so each image being dithered times its own progress
+	static thread_local std::chrono::steady_clock::time_point m_time;
+
+	static void Append(const std::string& text);
 };
\ No newline at end of file
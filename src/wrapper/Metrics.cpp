@@ -0,0 +1,190 @@
+#include "../../ext/json/json.hpp"
+#include "Log.h"
+#include "Metrics.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+Metrics::Record Metrics::m_setup;
+thread_local Metrics::Record Metrics::m_current;
+thread_local bool Metrics::m_inOutput = false;
+thread_local std::chrono::steady_clock::time_point Metrics::m_start = std::chrono::steady_clock::now();
+std::mutex Metrics::m_mutex;
+std::vector<Metrics::Record> Metrics::m_records;
+
+void Metrics::Timer::Stop() {
+	if (m_stopped) return;
+	m_stopped = true;
+
+	Metrics::AddTime(m_stage, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+}
+
+double Metrics::Record::OtherSeconds() const {
+	double staged = 0.;
+	for (const double s : seconds) staged += s;
+
+	// Setup has no total - every second of it is in a stage
+	return totalSeconds > staged ? totalSeconds - staged : 0.;
+}
+
+void Metrics::Begin(const std::string& image, const size_t order) {
+	m_current = Record();
+	m_current.image = image;
+	m_current.order = order;
+	m_inOutput = true;
+
+	m_start = std::chrono::steady_clock::now();
+}
+
+void Metrics::End(const std::string& output, const size_t pixels, const bool success) {
+	if (!m_inOutput) return;
+
+	m_current.totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+	m_current.output = output;
+	m_current.pixels = static_cast<uint64_t>(pixels);
+	m_current.success = success;
+
+	m_inOutput = false;
+
+	Log::EndLine();
+	Log::WriteOneLine("===== METRICS =====");
+	LogRecord(m_current);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_records.push_back(m_current);
+}
+
+void Metrics::AddTime(const Stage stage, const double seconds) {
+	Record& record = m_inOutput ? m_current : m_setup;
+	record.seconds[static_cast<size_t>(stage)] += seconds;
+}
+
+void Metrics::AddCache(const size_t hits, const size_t misses) {
+	m_current.cacheHits += static_cast<uint64_t>(hits);
+	m_current.cacheMisses += static_cast<uint64_t>(misses);
+}
+
+void Metrics::LogTotal() {
+	Log::EndLine();
+	Log::WriteOneLine("===== METRICS - SETUP =====");
+	LogRecord(m_setup);
+
+	Log::EndLine();
+	Log::WriteOneLine("===== METRICS - ALL OUTPUTS =====");
+	LogRecord(Sum());
+}
+
+bool Metrics::Save(const std::string& file) {
+	const auto toJson = [](const Record& record) {
+		json seconds = json::object();
+		for (size_t i = 0; i < StageCount; ++i) seconds[ToString(static_cast<Stage>(i))] = record.seconds[i];
+		seconds["other"] = record.OtherSeconds();
+		seconds["total"] = record.totalSeconds;
+
+		json out = json::object();
+		out["seconds"] = seconds;
+		out["pixels"] = record.pixels;
+		out["cache"] = { { "hits", record.cacheHits }, { "misses", record.cacheMisses } };
+		out["megapixelsPerSecond"] = record.totalSeconds > 0. ? static_cast<double>(record.pixels) / 1000000. / record.totalSeconds : 0.;
+		return out;
+	};
+
+	// Finished in any order when outputs are dithered at the same time
+	std::vector<Record> records = m_records;
+	std::stable_sort(records.begin(), records.end(), [](const Record& a, const Record& b) { return a.order < b.order; });
+
+	json outputs = json::array();
+	for (const Record& record : records) {
+		json out = toJson(record);
+		out["image"] = record.image;
+		out["output"] = record.output;
+		out["success"] = record.success;
+		outputs.push_back(out);
+	}
+
+	json metrics = json::object();
+	metrics["setup"] = toJson(m_setup);
+	metrics["outputs"] = outputs;
+	metrics["total"] = toJson(Sum());
+
+	std::ofstream out(file);
+	if (!out) {
+		Log::WriteOneLine("Failed to save metrics: " + file);
+		return false;
+	}
+	out << metrics.dump(1, '\t') << '\n';
+
+	Log::WriteOneLine("Saved metrics: " + file);
+	return true;
+}
+
+std::string Metrics::ToString(const Stage stage) {
+	switch (stage) {
+	case Stage::Decode:
+		return "decode";
+	case Stage::Colour:
+		return "colour";
+	case Stage::Palette:
+		return "palette";
+	case Stage::Threshold:
+		return "threshold";
+	case Stage::Dither:
+		return "dither";
+	case Stage::Alpha:
+		return "alpha";
+	case Stage::Stream:
+		return "stream";
+	case Stage::Encode:
+		return "encode";
+	default:
+		return "";
+	}
+}
+
+void Metrics::LogRecord(const Record& record) {
+	const auto line = [](const std::string& name, const double seconds) {
+		Log::WriteOneLine("  " + name + ":" + Log::LeadingCharacter(Log::ToString(seconds * 1000., 3), static_cast<unsigned int>(22 - name.size()), ' ') + " ms");
+	};
+
+	for (size_t i = 0; i < StageCount; ++i) line(ToString(static_cast<Stage>(i)), record.seconds[i]);
+	if (record.totalSeconds > 0.) {
+		line("other", record.OtherSeconds());
+		line("total", record.totalSeconds);
+	}
+
+	const uint64_t lookups = record.cacheHits + record.cacheMisses;
+	if (lookups > 0) {
+		const double rate = static_cast<double>(record.cacheHits) / static_cast<double>(lookups) * 100.;
+		Log::WriteOneLine("  Memo hits: " + Log::ToString(static_cast<size_t>(record.cacheHits)) + " / " + Log::ToString(static_cast<size_t>(lookups)) +
+			" (" + Log::ToString(rate, 2) + "%)");
+	}
+
+	if (record.pixels > 0 && record.totalSeconds > 0.) {
+		const double megapixels = static_cast<double>(record.pixels) / 1000000.;
+		const double ditherSeconds = record.seconds[static_cast<size_t>(Stage::Dither)];
+
+		std::string throughput = "  Megapixels/s: " + Log::ToString(megapixels / record.totalSeconds, 3);
+		if (ditherSeconds > 0.) throughput += " - dither only: " + Log::ToString(megapixels / ditherSeconds, 3);
+		Log::WriteOneLine(throughput);
+	}
+}
+
+Metrics::Record Metrics::Sum() {
+	Record total;
+	for (const Record& record : m_records) {
+		for (size_t i = 0; i < StageCount; ++i) total.seconds[i] += record.seconds[i];
+		total.totalSeconds += record.totalSeconds;
+		total.cacheHits += record.cacheHits;
+		total.cacheMisses += record.cacheMisses;
+		total.pixels += record.pixels;
+		total.success = total.success && record.success;
+	}
+	return total;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// <para>Time spent in each stage of every output, memo hits and pixels per second</para>
+/// <para>Logged after each output and optionally saved as JSON with the "metrics" setting</para>
+/// <para>Each thread times its own output - outputs can be dithered at the same time</para>
+/// </summary>
+class Metrics {
+public:
+	enum class Stage {
+		Decode, Colour, Palette, Threshold, Dither, Alpha, Stream, Encode, Count
+	};
+
+	/// <summary>
+	/// Adds the time from construction to Stop or destruction to a stage - only used on the thread dithering the output
+	/// </summary>
+	class Timer {
+	public:
+		Timer(const Stage stage) : m_stage(stage), m_start(std::chrono::steady_clock::now()) {};
+		~Timer() { Stop(); };
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+
+		/// <summary>
+		/// For stages that end before the scope does - only the first call adds the time
+		/// </summary>
+		void Stop();
+
+	private:
+		Stage m_stage;
+		std::chrono::steady_clock::time_point m_start;
+		bool m_stopped = false;
+	};
+
+	/// <summary>
+	/// Times on the calling thread after this are added to a new output instead of setup
+	/// </summary>
+	/// <param name="image"></param>
+	/// <param name="order">Outputs are saved in this order whichever finishes first</param>
+	static void Begin(const std::string& image, const size_t order = 0);
+
+	/// <summary>
+	/// Logs the output's stages and keeps them for Save
+	/// </summary>
+	/// <param name="output">Empty if it failed before the path was known</param>
+	/// <param name="pixels"></param>
+	/// <param name="success"></param>
+	static void End(const std::string& output, const size_t pixels, const bool success);
+
+	static void AddTime(const Stage stage, const double seconds);
+
+	/// <summary>
+	/// Called by the thread dithering the output - ThreadPool workers count their own then it adds them together
+	/// </summary>
+	/// <param name="hits"></param>
+	/// <param name="misses"></param>
+	static void AddCache(const size_t hits, const size_t misses);
+
+	/// <summary>
+	/// Stages of every output added together, with setup
+	/// </summary>
+	static void LogTotal();
+
+	static bool Save(const std::string& file);
+
+	static std::string ToString(const Stage stage);
+
+private:
+	static const size_t StageCount = static_cast<size_t>(Stage::Count);
+
+	struct Record {
+		std::string image, output;
+		std::array<double, StageCount> seconds = {};
+		double totalSeconds = 0.;
+		uint64_t cacheHits = 0, cacheMisses = 0, pixels = 0;
+		size_t order = 0;
+		bool success = true;
+
+		double OtherSeconds() const;
+	};
+
+	static void LogRecord(const Record& record);
+	static Record Sum();
+
+	// Palette loading and anything else outside an output - only the main thread adds to it
+	static Record m_setup;
+
+	// The output being dithered on each thread
+	static thread_local Record m_current;
+	static thread_local bool m_inOutput;
+	static thread_local std::chrono::steady_clock::time_point m_start;
+
+	static std::mutex m_mutex;
+	static std::vector<Record> m_records;
+};
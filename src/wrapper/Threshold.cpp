@@ -48,12 +48,9 @@ const std::array<uint8_t, 225> Threshold::m_circleDither{
 	10, 9, 9, 8, 8, 7, 7, 7, 7, 7, 8, 8, 9, 9, 10
 };
 
-Threshold::Shape Threshold::m_shape{
-	0, 0, std::vector<std::vector<int>>()
-};
-
 void Threshold::GenerateThreshold(const std::string& matrixType) {
 	m_matrixType = matrixType;
+	m_ign = false;
 
 	if (IsValidBayerSetting(m_matrixType)) {
 		Log::WriteOneLine("Generating Threshold Map");
@@ -61,12 +58,16 @@ void Threshold::GenerateThreshold(const std::string& matrixType) {
 
 		m_bayerSize = std::stoi(numberPart);
 		m_bayer = GenerateBayerHalf(m_bayerSize);
+
+		SetTile(m_bayer, m_bayerSize, m_bayerSize, static_cast<double>(m_bayerSize * m_bayerSize) + 1.);
 	} else if (IsValidBlueNoiseSetting(m_matrixType)) {
 		Log::WriteOneLine("Generating Threshold Map");
 		std::string numberPart = m_matrixType.substr(9);
 
 		m_blueNoiseSize = std::stoi(numberPart);
 		m_blueNoise = BN_Helper::GetMap(m_blueNoiseSize);
+
+		SetTile(m_blueNoise, m_blueNoiseSize, m_blueNoiseSize, static_cast<double>(m_blueNoiseSize * m_blueNoiseSize) + 1.);
 	} else if (IsValidBayerShapeSetting(m_matrixType)) {
 		Log::WriteOneLine("Generating Threshold Map");
 		std::string numberPart = m_matrixType.substr(10);
@@ -75,37 +76,38 @@ void Threshold::GenerateThreshold(const std::string& matrixType) {
 		m_bayer = GenerateBayerHalf(m_bayerSize);
 
 		GenerateBayerShape();
-	}
-}
 
-double Threshold::GetThreshold(const int x, const int y) const {
-	double out = 0.5;
-	if (IsValidBayerSetting(m_matrixType)) {
-		out = static_cast<double>(m_bayer[MatrixIndex(x % m_bayerSize, y % m_bayerSize, m_bayerSize)]) + 1.;
-		out /= static_cast<double>(m_bayerSize * m_bayerSize) + 1.;
-	} else if (IsValidBlueNoiseSetting(m_matrixType)) {
-		out = static_cast<double>(m_blueNoise[MatrixIndex(x % m_blueNoiseSize, y % m_blueNoiseSize, m_blueNoiseSize)]) + 1.;
-		out /= static_cast<double>(m_blueNoiseSize * m_blueNoiseSize) + 1.;
+		SetTile(m_bayerShape, m_bayerSize * m_shape.width, m_bayerSize * m_shape.height, static_cast<double>(m_bayerSize * m_bayerSize) + 1.);
 	} else if (m_matrixType == "ign") {
-		// https://blog.demofox.org/2022/01/01/interleaved-gradient-noise-a-different-kind-of-low-discrepancy-sequence/
-		out = std::fmod(52.9829189 * std::fmod(0.06711056 * double(x) + 0.00583715 * double(y), 1.), 1.);
+		m_ign = true;
 	} else if (m_matrixType == "parkerdither") {
-		out = static_cast<double>(m_parkerDither[MatrixIndex(x % 3, y % 3, 3)]) / 100.;
+		SetTile(m_parkerDither, 3, 3, 100., 0.);
 	} else if (m_matrixType == "heart") {
-		out = static_cast<double>(m_heartDither[static_cast<size_t>((x % 9) + (y % 6) * 9)]) + 1.;
-		out /= 2. + 2.;
+		SetTile(m_heartDither, 9, 6, 2. + 2.);
 	} else if (m_matrixType == "circle") {
-		out = static_cast<double>(m_circleDither[MatrixIndex(x % 15, y % 15, 15)]) + 1.;
-		out /= 10. + 2.;
-	} else if (IsValidBayerShapeSetting(m_matrixType)) {
-		const int width = m_bayerSize * m_shape.width;
-		const int height = m_bayerSize * m_shape.height;
-
-		out = static_cast<double>(m_bayerShape[static_cast<size_t>((x % width) + (y % height) * width)]) + 1.;
-		out /= static_cast<double>(m_bayerSize * m_bayerSize) + 1.;
+		SetTile(m_circleDither, 15, 15, 10. + 2.);
+	} else {
+		// Unknown matrix - every threshold is the middle
+		m_tile.assign(1, 0.);
+		m_tileWidth = m_tileHeight = 1;
+		m_maskX = m_maskY = 0;
 	}
+}
 
-	return out - 0.5;
+template<typename V>
+void Threshold::SetTile(const V& values, const int width, const int height, const double divisor, const double offset) {
+	m_tileWidth = width;
+	m_tileHeight = height;
+	m_maskX = IsPowerOfTwo(width) ? width - 1 : -1;
+	m_maskY = IsPowerOfTwo(height) ? height - 1 : -1;
+
+	// Same maths as working it out for each pixel
+	m_tile.resize(static_cast<size_t>(width) * static_cast<size_t>(height));
+	for (size_t i = 0; i < m_tile.size(); ++i) {
+		double out = static_cast<double>(values[i]) + offset;
+		out /= divisor;
+		m_tile[i] = out - 0.5;
+	}
 }
 
 void Threshold::SetShape(const int width, const int height, const std::vector<std::vector<int>>& points) {
@@ -1,7 +1,9 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <cstddef>
 #include <string>
+#include <cmath>
 #include <cstdint>
 //#include <cstdint>
 
@@ -10,11 +12,48 @@ public:
 	Threshold() {};
 	~Threshold() {};
 
+	/// <summary>
+	/// Builds the tile GetThreshold() reads - matrixType is only looked at here
+	/// </summary>
+	/// <param name="matrixType"></param>
 	void GenerateThreshold(const std::string& matrixType);
 
-	double GetThreshold(const int x, const int y) const;
+	/// <summary>
+	/// Threshold between -0.5 and 0.5 - repeats every tile, IGN is worked out for each pixel
+	/// </summary>
+	/// <param name="x"></param>
+	/// <param name="y"></param>
+	/// <returns></returns>
+	inline double GetThreshold(const int x, const int y) const {
+		if (m_ign) {
+			// https://blog.demofox.org/2022/01/01/interleaved-gradient-noise-a-different-kind-of-low-discrepancy-sequence/
+			// v - floor(v) is the same as std::fmod(v, 1.) for v >= 0 without the division
+			double v = 0.06711056 * double(x) + 0.00583715 * double(y);
+			v = 52.9829189 * (v - std::floor(v));
+			return (v - std::floor(v)) - 0.5;
+		}
+
+		const int tx = m_maskX >= 0 ? x & m_maskX : x % m_tileWidth;
+		const int ty = m_maskY >= 0 ? y & m_maskY : y % m_tileHeight;
+		return m_tile[static_cast<size_t>(tx + ty * m_tileWidth)];
+	};
+
+	/// <summary>
+	/// GetThreshold() + 0.5 for count pixels from (x, y) - between 0 and 1
+	/// </summary>
+	/// <typeparam name="T">float or double</typeparam>
+	template<typename T>
+	void GetRow(const int x, const int y, T* out, const size_t count) const {
+		for (size_t i = 0; i < count; ++i) out[i] = static_cast<T>(GetThreshold(x + static_cast<int>(i), y) + 0.5);
+	}
 
-	static void SetShape(const int width, const int height, const std::vector<std::vector<int>>& points);
+	/// <summary>
+	/// Cell and points used by bayerShapeN - read by the next GenerateThreshold()
+	/// </summary>
+	/// <param name="width"></param>
+	/// <param name="height"></param>
+	/// <param name="points"></param>
+	void SetShape(const int width, const int height, const std::vector<std::vector<int>>& points);
 
 	static bool IsValidSetting(const std::string& matrixType);
 
@@ -33,7 +72,19 @@ private:
 	int m_blueNoiseSize = 2;
 	std::string m_matrixType = "bayer16";
 
-	static Shape m_shape;
+	Shape m_shape;
+
+	// Normalised thresholds for one tile of the matrix - the mask is size - 1 for power of two sizes and -1 otherwise
+	std::vector<double> m_tile{ 0. };
+	int m_tileWidth = 1, m_tileHeight = 1;
+	int m_maskX = 0, m_maskY = 0;
+	bool m_ign = false;
+
+	/// <summary>
+	/// Fill m_tile with (value + 1) / divisor - 0.5 for every value in a matrix
+	/// </summary>
+	template<typename V>
+	void SetTile(const V& values, const int width, const int height, const double divisor, const double offset = 1.);
 
 	inline size_t MatrixIndex(const int x, const int y, const int size) const { return size_t(x + y * size); };
 